@@ -0,0 +1,1076 @@
+#include "codegen/CEmitter.hpp"
+#include "semantic_analyzer/type_table/ConstantFolding.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// support code every emitted program starts with
+const char *const kRuntime = R"C(#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+_Noreturn static void cc_fail(const char *routine, const char *message) {
+  fflush(stdout);
+  fprintf(stderr, "Runtime error in %s: %s\n", routine, message);
+  exit(1);
+}
+
+static inline int64_t cc_add(int64_t l, int64_t r) {
+  return (int64_t)((uint64_t)l + (uint64_t)r);
+}
+
+static inline int64_t cc_sub(int64_t l, int64_t r) {
+  return (int64_t)((uint64_t)l - (uint64_t)r);
+}
+
+static inline int64_t cc_mul(int64_t l, int64_t r) {
+  return (int64_t)((uint64_t)l * (uint64_t)r);
+}
+
+static inline int64_t cc_neg(int64_t value) {
+  return (int64_t)(0 - (uint64_t)value);
+}
+
+static inline int64_t cc_div(int64_t l, int64_t r, const char *routine) {
+  if (r == 0)
+    cc_fail(routine, "division by zero");
+  return r == -1 ? cc_neg(l) : l / r;
+}
+
+static inline int64_t cc_mod(int64_t l, int64_t r, const char *routine) {
+  if (r == 0)
+    cc_fail(routine, "division by zero");
+  return r == -1 ? 0 : l % r;
+}
+
+static inline double cc_div_real(double l, double r, const char *routine) {
+  if (r == 0)
+    cc_fail(routine, "division by zero");
+  return l / r;
+}
+
+static inline int64_t cc_real_to_int(double value, const char *routine) {
+  if (!(fabs(value) < 9.2e18))
+    cc_fail(routine, "real does not fit integer");
+  return llround(value);
+}
+
+static inline uint8_t cc_int_to_bool(int64_t value, const char *routine) {
+  if (value != 0 && value != 1) {
+    char message[64];
+    snprintf(message, sizeof message, "cannot convert %" PRId64
+             " to boolean", value);
+    cc_fail(routine, message);
+  }
+  return (uint8_t)value;
+}
+
+static inline int64_t cc_index(int64_t index, int64_t length,
+                               const char *routine) {
+  if (index < 1 || index > length) {
+    char message[96];
+    snprintf(message, sizeof message, "index %" PRId64 " is out of 1..%"
+             PRId64, index, length);
+    cc_fail(routine, message);
+  }
+  return index - 1;
+}
+
+#ifdef CC_NO_BOUNDS_CHECKS
+#define CC_INDEX(index, length, routine) ((index) - 1)
+#else
+#define CC_INDEX(index, length, routine) cc_index((index), (length), (routine))
+#endif
+
+static inline void *cc_allocate(int64_t length, size_t item_size,
+                                const char *routine) {
+  void *items = NULL;
+  if (length >= 0 && (item_size == 0 ||
+                      (uint64_t)length <= (UINT64_C(1) << 40) / item_size))
+    items = calloc(length > 0 ? (size_t)length : 1,
+                   item_size > 0 ? item_size : 1);
+  if (items == NULL) {
+    char message[64];
+    snprintf(message, sizeof message,
+             "cannot allocate array of length %" PRId64, length);
+    cc_fail(routine, message);
+  }
+  return items;
+}
+
+static inline void *cc_duplicate(const void *items, int64_t length,
+                                 size_t item_size, const char *routine) {
+  void *copy = cc_allocate(length, item_size, routine);
+  memcpy(copy, items, (size_t)length * item_size);
+  return copy;
+}
+
+static inline void cc_assign(void *target, int64_t target_length,
+                             const void *source, int64_t source_length,
+                             size_t item_size, const char *routine) {
+  if (target_length != source_length)
+    cc_fail(routine, "assigned arrays differ in length");
+  memmove(target, source, (size_t)source_length * item_size);
+}
+
+// lowest address of the machine stack calls may use, as deep recursion
+// fails with an error like in the virtual machines
+static uintptr_t cc_stack_limit;
+
+static inline void cc_enter(const char *routine) {
+  char probe;
+  if ((uintptr_t)&probe < cc_stack_limit)
+    cc_fail(routine, "stack overflow");
+}
+
+// shortest text that reads back as the same value
+static inline void cc_print_real(double value) {
+  char text[40];
+  for (int precision = 1; precision <= 17; precision++) {
+    snprintf(text, sizeof text, "%.*g", precision, value);
+    if (strtod(text, NULL) == value)
+      break;
+  }
+  if (strpbrk(text, ".en") == NULL)
+    strcat(text, ".0");
+  printf("Result: %s\n", text);
+}
+)C";
+
+bool isBinary(const CNode *node) {
+  return node->children.size() == 3 &&
+         (node->name == "expression" || node->name == "relation" ||
+          node->name == "simple" || node->name == "factor");
+}
+
+bool hasCall(const CNode *node) {
+  if (node == nullptr || node->constant)
+    return false;
+  if (node->name == "routine_call")
+    return true;
+  for (const CNode *child : node->children) {
+    if (hasCall(child))
+      return true;
+  }
+  return false;
+}
+
+// a counter at the last value of the range may step past the integers,
+// unless the value is a constant away from their end
+bool mayWrap(const CNode *last, bool reverse) {
+  if (!last->constant || last->value.kind != ConstantValue::Integer)
+    return true;
+  return last->value.integer == (reverse
+                                     ? std::numeric_limits<int64_t>::min()
+                                     : std::numeric_limits<int64_t>::max());
+}
+
+} // namespace
+
+CEmitter::CEmitter(const ControlTable &table, std::ostream &err)
+    : table_(table), err_(&err) {}
+
+bool CEmitter::emit(CNode *program, const std::vector<std::string> &entries,
+                    const std::string &entry, std::ostream &out) {
+  std::vector<CNode *> globals;
+  for (CNode *child : program->children) {
+    if (child->name == "routine_declaration")
+      bodies_[child->children[0]->name] = child->children[3];
+    else
+      globals.push_back(child);
+  }
+
+  // globals are file scope variables set by a function of their own
+  std::ostringstream variables, initialization;
+  routine_ = "<globals>";
+  function_ = nullptr;
+  out_ = &initialization;
+  indent_ = 1;
+  temporaries_ = 0;
+  scopes_.clear();
+  for (CNode *global : globals) {
+    CNode *node = global->children[0];
+    if (node->name == "type_declaration")
+      continue;
+    CNode *identifier = node->children[0];
+    std::string type;
+    if (!typeName(identifier->type, type))
+      return false;
+    variables << "static " << type << " "
+              << variable(identifier->name, 0, identifier->slot) << ";\n";
+    if (!declaration(node))
+      return false;
+  }
+
+  if (entries.empty()) {
+    for (CNode *child : program->children) {
+      if (child->name == "routine_declaration")
+        request(child->children[0]->name);
+    }
+  }
+  for (const std::string &name : entries) {
+    if (!request(name)) {
+      *err_ << "Routine " << name << " is not declared" << std::endl;
+      return false;
+    }
+  }
+  if (!entry.empty() && !request(entry)) {
+    *err_ << "Routine " << entry << " is not declared" << std::endl;
+    return false;
+  }
+  const FunctionNode *main = table_.findFunction(entry);
+  if (main != nullptr && !main->parameters_.empty()) {
+    *err_ << "Routine " << entry << " takes parameters" << std::endl;
+    return false;
+  }
+  // emitted routines request their callees
+  for (size_t i = 0; i < queue_.size(); i++) {
+    if (!routine(queue_[i], bodies_[queue_[i]]))
+      return false;
+  }
+
+  out << kRuntime << "\n" << definitions_.str();
+  for (const std::string &name : queue_) {
+    std::string declared;
+    if (!signature(name, declared))
+      return false;
+    out << "static " << declared << ";\n";
+  }
+  out << "\n" << variables.str() << "\nstatic void cc_globals(void) {\n"
+      << initialization.str() << "}\n\n" << functions_.str();
+
+  out << "int main(void) {\n  char base;\n"
+      << "  cc_stack_limit = (uintptr_t)&base - ((uintptr_t)4 << 20);\n"
+      << "  cc_globals();\n";
+  if (main != nullptr) {
+    std::string call = "r_" + entry + "()";
+    switch (primitive(main->return_type_)) {
+    case Primitive::Integer:
+      out << "  printf(\"Result: %\" PRId64 \"\\n\", " << call << ");\n";
+      break;
+    case Primitive::Real:
+      out << "  cc_print_real(" << call << ");\n";
+      break;
+    case Primitive::Boolean:
+      out << "  printf(\"Result: %s\\n\", " << call
+          << " ? \"true\" : \"false\");\n";
+      break;
+    default:
+      out << "  " << call << ";\n";
+      break;
+    }
+  }
+  out << "  return 0;\n}\n";
+  return true;
+}
+
+bool CEmitter::request(const std::string &name) {
+  if (requested_.count(name) != 0)
+    return true;
+  if (table_.findFunction(name) == nullptr || bodies_.count(name) == 0)
+    return false;
+  requested_[name] = true;
+  queue_.push_back(name);
+  return true;
+}
+
+bool CEmitter::signature(const std::string &name, std::string &result) {
+  const FunctionNode *function = table_.findFunction(name);
+  std::string returned = "void";
+  if (function->return_type_ != nullptr &&
+      function->return_type_->getType() != Types::NoType) {
+    if (runtimeArray(function->return_type_)) {
+      *err_ << "Routine " << name
+            << " returns an array of runtime length, which C cannot"
+            << std::endl;
+      return false;
+    }
+    if (!typeName(function->return_type_, returned))
+      return false;
+  }
+  result = returned + " r_" + name + "(";
+  for (size_t i = 0; i < function->parameters_.size(); i++) {
+    const auto &parameter = function->parameters_[i];
+    std::string type;
+    if (!typeName(parameter->variable_type_, type))
+      return false;
+    result += (i == 0 ? "" : ", ") + type + " " +
+              variable(parameter->variable_name_, 1, (int)i);
+  }
+  result += function->parameters_.empty() ? "void)" : ")";
+  return true;
+}
+
+bool CEmitter::routine(const std::string &name, CNode *body) {
+  std::string declared;
+  if (!signature(name, declared))
+    return false;
+  std::ostringstream text;
+  routine_ = name;
+  function_ = table_.findFunction(name);
+  out_ = &text;
+  indent_ = 1;
+  temporaries_ = 0;
+  scopes_.assign(1, {});
+  // only routines that call others can run out of stack
+  if (hasCall(body))
+    line("cc_enter(" + quoted() + ");");
+  // parameters are copies, so arrays of runtime length get their own items
+  for (size_t i = 0; i < function_->parameters_.size(); i++) {
+    const auto &parameter = function_->parameters_[i];
+    if (!runtimeArray(parameter->variable_type_))
+      continue;
+    std::string own = variable(parameter->variable_name_, 1, (int)i);
+    line(own + ".items = cc_duplicate(" + own + ".items, " + own +
+         ".length, sizeof *" + own + ".items, " + quoted() + ");");
+    scopes_.back().push_back(own);
+  }
+  returned_ = false;
+  if (!block(body)) {
+    *err_ << "ERROR: in C code of routine " << name << std::endl;
+    return false;
+  }
+  bool returns = function_->return_type_ != nullptr &&
+                 function_->return_type_->getType() != Types::NoType;
+  if (!returned_ && returns)
+    line("cc_fail(" + quoted() +
+         ", \"routine ends without returning a value\");");
+  else if (!returned_)
+    release(0);
+  functions_ << "static " << declared << " {\n" << text.str() << "}\n\n";
+  return true;
+}
+
+bool CEmitter::block(CNode *body) {
+  if (body == nullptr)
+    return true;
+  scopes_.emplace_back();
+  for (CNode *child : body->children) {
+    bool emitted = child->name == "statement"
+                       ? statement(child->children[0])
+                       : declaration(child->children[0]);
+    if (!emitted)
+      return false;
+    returned_ = child->name == "statement" &&
+                child->children[0]->name == "return";
+  }
+  if (!returned_)
+    release(scopes_.size() - 1);
+  scopes_.pop_back();
+  return true;
+}
+
+void CEmitter::release(size_t depth) {
+  for (size_t scope = scopes_.size(); scope-- > depth;) {
+    for (auto owned = scopes_[scope].rbegin(); owned != scopes_[scope].rend();
+         ++owned)
+      line("free(" + *owned + ".items);");
+  }
+}
+
+bool CEmitter::declaration(CNode *node) {
+  if (node->name == "type_declaration")
+    return true;
+  CNode *identifier = node->children[0];
+  CNode *initial = node->name == "variable_declaration_auto"
+                       ? node->children[1]
+                       : node->children[2];
+  if (identifier->slot == -1) {
+    *err_ << "Variable " << identifier->name << " was not analysed"
+          << std::endl;
+    return false;
+  }
+  bool global = identifier->depth == 0;
+  std::string name =
+      variable(identifier->name, identifier->depth, identifier->slot);
+  std::string type, text;
+  if (!typeName(identifier->type, type))
+    return false;
+  // globals are declared at file scope
+  std::string declared = global ? name : type + " " + name;
+
+  Primitive scalar = primitive(identifier->type);
+  if (scalar != Primitive::Invalid) {
+    text = "0";
+    if (initial != nullptr && !value(initial, scalar, text))
+      return false;
+    line(declared + " = " + text + ";");
+    return true;
+  }
+  if (!runtimeArray(identifier->type)) {
+    if (initial != nullptr) {
+      Primitive ignored;
+      if (!expression(initial, ignored, text))
+        return false;
+      line(declared + " = " + text + ";");
+      return true;
+    }
+    std::string fill;
+    if (!initializer(identifier->type, fill))
+      return false;
+    if (!global)
+      line(declared + ";");
+    line(fill + "(&" + name + ");");
+    return true;
+  }
+
+  // the length comes from the initializer when there is one, else from
+  // the size expression of the type
+  auto array = static_cast<ArrayType *>(identifier->type.get());
+  std::string source;
+  if (initial != nullptr) {
+    Primitive ignored;
+    if (!expression(initial, ignored, source))
+      return false;
+    text = source + ".length";
+  } else if (!value(array->expression, Primitive::Integer, text)) {
+    return false;
+  }
+  if (!global)
+    line(declared + ";");
+  line(name + ".length = " + text + ";");
+  line(name + ".items = cc_allocate(" + name + ".length, sizeof *" + name +
+       ".items, " + quoted() + ");");
+  if (!global)
+    scopes_.back().push_back(name);
+  if (!source.empty()) {
+    line("cc_assign(" + name + ".items, " + name + ".length, " + source +
+         ".items, " + source + ".length, sizeof *" + name + ".items, " +
+         quoted() + ");");
+  } else if (defaults(array->arrayType)) {
+    std::string fill;
+    if (!initializer(array->arrayType, fill))
+      return false;
+    line("for (int64_t cc_i = 0; cc_i < " + name + ".length; cc_i++)");
+    line("  " + fill + "(&" + name + ".items[cc_i]);");
+  }
+  return true;
+}
+
+bool CEmitter::statement(CNode *node) {
+  if (node->name == "return") {
+    if (node->children[0] == nullptr) {
+      release(0);
+      line("return;");
+      return true;
+    }
+    CNode *result = node->children[0]->children[0];
+    std::string text;
+    Primitive type = primitive(function_->return_type_);
+    bool emitted;
+    if (type == Primitive::Invalid) {
+      Primitive ignored;
+      emitted = expression(result, ignored, text);
+    } else {
+      emitted = value(result, type, text);
+    }
+    if (!emitted)
+      return false;
+    bool owned = false;
+    for (const auto &scope : scopes_)
+      owned |= !scope.empty();
+    if (!owned) {
+      line("return " + text + ";");
+      return true;
+    }
+    // the result may read the arrays about to be freed
+    std::string returned;
+    if (!typeName(function_->return_type_, returned))
+      return false;
+    text = temporary(returned, text);
+    release(0);
+    line("return " + text + ";");
+    return true;
+  } else if (node->name == "assignment") {
+    return assignment(node);
+  } else if (node->name == "routine_call") {
+    std::string text;
+    if (!call(node, text))
+      return false;
+    line(text + ";");
+    return true;
+  } else if (node->name == "if_statement") {
+    std::string condition;
+    if (!value(node->children[0], Primitive::Boolean, condition))
+      return false;
+    line("if (" + condition + ") {");
+    indent_++;
+    if (!block(node->children[1]))
+      return false;
+    indent_--;
+    if (node->children[2] != nullptr) {
+      line("} else {");
+      indent_++;
+      if (!block(node->children[2]->children[0]))
+        return false;
+      indent_--;
+    }
+    line("}");
+    return true;
+  } else if (node->name == "while_loop") {
+    return whileLoop(node);
+  } else if (node->name == "for_loop") {
+    return forLoop(node);
+  }
+  *err_ << "Statement " << node->name << " has no C code" << std::endl;
+  return false;
+}
+
+bool CEmitter::assignment(CNode *node) {
+  CNode *target = node->children[0];
+  CNode *source = node->children[1];
+  std::string text, assigned;
+  Primitive type = primitive(target->type);
+  bool emitted;
+  if (type == Primitive::Invalid) {
+    Primitive ignored;
+    emitted = expression(source, ignored, text);
+  } else {
+    emitted = value(source, type, text);
+  }
+  if (!emitted)
+    return false;
+  // the value is computed before the target is located
+  if (hasCall(source)) {
+    std::string kept;
+    if (!typeName(target->type, kept))
+      return false;
+    text = temporary(kept, text);
+  }
+  if (!place(target, assigned))
+    return false;
+  if (runtimeArray(target->type)) {
+    line("cc_assign(" + assigned + ".items, " + assigned + ".length, " +
+         text + ".items, " + text + ".length, sizeof *" + assigned +
+         ".items, " + quoted() + ");");
+    return true;
+  }
+  line(assigned + " = " + text + ";");
+  return true;
+}
+
+bool CEmitter::whileLoop(CNode *node) {
+  std::string condition;
+  // a condition with calls is evaluated by statements inside the loop
+  if (!hasCall(node->children[0])) {
+    if (!value(node->children[0], Primitive::Boolean, condition))
+      return false;
+    line("while (" + condition + ") {");
+    indent_++;
+  } else {
+    line("for (;;) {");
+    indent_++;
+    if (!value(node->children[0], Primitive::Boolean, condition))
+      return false;
+    line("if (!(" + condition + "))");
+    line("  break;");
+  }
+  if (!block(node->children[1]))
+    return false;
+  indent_--;
+  line("}");
+  return true;
+}
+
+// the bounds are evaluated once, the lower one first
+bool CEmitter::forLoop(CNode *node) {
+  CNode *counter = node->children[0];
+  CNode *range = node->children[1];
+  bool reverse = range->name == "reverse_range";
+  if (counter->slot == -1) {
+    *err_ << "Loop counter " << counter->name << " was not analysed"
+          << std::endl;
+    return false;
+  }
+  std::string name = variable(counter->name, counter->depth, counter->slot);
+  std::string bound = "cc_bound" + std::to_string(temporaries_++);
+  std::vector<std::string> bounds;
+  if (!operands({range->children[0], range->children[1]},
+                {Primitive::Integer, Primitive::Integer}, bounds))
+    return false;
+  line("{");
+  indent_++;
+  if (reverse) {
+    line("int64_t " + bound + " = " + bounds[0] + ";");
+    line("int64_t " + name + " = " + bounds[1] + ";");
+  } else {
+    line("int64_t " + name + " = " + bounds[0] + ";");
+    line("int64_t " + bound + " = " + bounds[1] + ";");
+  }
+  line(std::string("for (; ") + name + (reverse ? " >= " : " <= ") + bound +
+       "; " + name + " = " + (reverse ? "cc_sub(" : "cc_add(") + name +
+       ", 1)) {");
+  indent_++;
+  if (!block(node->children[2]))
+    return false;
+  // the loop ends at the bound instead of stepping past it
+  if (mayWrap(range->children[reverse ? 0 : 1], reverse)) {
+    line("if (" + name + " == " + bound + ")");
+    line("  break;");
+  }
+  indent_--;
+  line("}");
+  indent_--;
+  line("}");
+  return true;
+}
+
+bool CEmitter::call(CNode *node, std::string &result) {
+  const std::string &name = node->children[0]->name;
+  const FunctionNode *function = table_.findFunction(name);
+  if (function == nullptr || !request(name)) {
+    *err_ << "Routine " << name << " has no body to call" << std::endl;
+    return false;
+  }
+  std::vector<CNode *> arguments;
+  std::vector<Primitive> types;
+  if (node->children[1] != nullptr) {
+    arguments = node->children[1]->children;
+    for (size_t i = 0; i < arguments.size(); i++)
+      types.push_back(primitive(function->parameters_[i]->variable_type_));
+  }
+  std::vector<std::string> texts;
+  if (!operands(arguments, types, texts))
+    return false;
+  result = "r_" + name + "(";
+  for (size_t i = 0; i < texts.size(); i++)
+    result += (i == 0 ? "" : ", ") + texts[i];
+  result += ")";
+  return true;
+}
+
+bool CEmitter::operands(const std::vector<CNode *> &nodes,
+                        const std::vector<Primitive> &types,
+                        std::vector<std::string> &result) {
+  result.clear();
+  for (size_t i = 0; i < nodes.size(); i++) {
+    std::string text;
+    Primitive actual = types[i];
+    bool emitted = types[i] == Primitive::Invalid
+                       ? expression(nodes[i], actual, text)
+                       : value(nodes[i], types[i], text);
+    if (!emitted)
+      return false;
+    bool later = false;
+    for (size_t j = i + 1; j < nodes.size(); j++)
+      later |= hasCall(nodes[j]);
+    if (later && !nodes[i]->constant) {
+      std::string type = scalarName(types[i]);
+      if (types[i] == Primitive::Invalid && !typeName(nodes[i]->type, type))
+        return false;
+      text = temporary(type, text);
+    }
+    result.push_back(text);
+  }
+  return true;
+}
+
+bool CEmitter::value(CNode *node, Primitive type, std::string &result) {
+  ConstantValue converted;
+  std::ostringstream ignored;
+  if (node->constant &&
+      convertValue(node->value, type, converted, ignored)) {
+    result = literal(converted);
+    return true;
+  }
+  Primitive actual;
+  return expression(node, actual, result) && convert(actual, type, result);
+}
+
+bool CEmitter::expression(CNode *node, Primitive &type, std::string &result) {
+  if (node->constant) {
+    type = typeOf(node);
+    result = literal(node->value);
+    return true;
+  }
+  type = primitive(node->type);
+  if (isBinary(node))
+    return binary(node, type, result);
+  if (node->name == "unary_factor") {
+    Primitive operand_type;
+    if (!expression(node->children[1], operand_type, result))
+      return false;
+    if (node->children[0]->name == "-")
+      result = operand_type == Primitive::Real ? "(-" + result + ")"
+                                               : "cc_neg(" + result + ")";
+    return convert(operand_type, type, result);
+  } else if (node->name == "not_factor") {
+    if (!value(node->children[1], Primitive::Boolean, result))
+      return false;
+    result = "(" + result + " ^ 1)";
+    return true;
+  } else if (node->name == "routine_call") {
+    return call(node, result);
+  }
+  return place(node, result);
+}
+
+bool CEmitter::binary(CNode *node, Primitive type, std::string &result) {
+  Operator op = toOperator(node->children[1]->name);
+  std::vector<std::string> texts;
+  if (op >= Operator::Less && op <= Operator::NotEqual) {
+    Primitive left = typeOf(node->children[0]);
+    Primitive right = typeOf(node->children[2]);
+    Primitive common = left == Primitive::Real || right == Primitive::Real
+                           ? Primitive::Real
+                           : Primitive::Integer;
+    if (!operands({node->children[0], node->children[2]}, {common, common},
+                  texts))
+      return false;
+    static const char *const relations[] = {" < ",  " <= ", " > ",
+                                            " >= ", " == ", " != "};
+    result = "(" + texts[0] +
+             relations[(int)op - (int)Operator::Less] + texts[1] + ")";
+    return true;
+  }
+  if (!operands({node->children[0], node->children[2]}, {type, type}, texts))
+    return false;
+  const std::string &l = texts[0], &r = texts[1];
+  bool real = type == Primitive::Real;
+  switch (op) {
+  case Operator::And:
+    result = "(" + l + " & " + r + ")";
+    return true;
+  case Operator::Or:
+    result = "(" + l + " | " + r + ")";
+    return true;
+  case Operator::Xor:
+    result = "(" + l + " ^ " + r + ")";
+    return true;
+  case Operator::Add:
+    result = real ? "(" + l + " + " + r + ")" : "cc_add(" + l + ", " + r + ")";
+    return true;
+  case Operator::Sub:
+    result = real ? "(" + l + " - " + r + ")" : "cc_sub(" + l + ", " + r + ")";
+    return true;
+  case Operator::Mul:
+    result = real ? "(" + l + " * " + r + ")" : "cc_mul(" + l + ", " + r + ")";
+    return true;
+  case Operator::Div:
+    result = (real ? "cc_div_real(" : "cc_div(") + l + ", " + r + ", " +
+             quoted() + ")";
+    return true;
+  case Operator::Mod:
+    result = "cc_mod(" + l + ", " + r + ", " + quoted() + ")";
+    return true;
+  default:
+    *err_ << "Operator " << node->children[1]->name << " has no C code"
+          << std::endl;
+    return false;
+  }
+}
+
+bool CEmitter::convert(Primitive from, Primitive to, std::string &text) {
+  if (from == to || (from == Primitive::Boolean && to == Primitive::Integer))
+    return true;
+  if (to == Primitive::Real && from != Primitive::Invalid) {
+    text = "(double)" + text;
+    return true;
+  }
+  if (to == Primitive::Integer && from == Primitive::Real) {
+    text = "cc_real_to_int(" + text + ", " + quoted() + ")";
+    return true;
+  }
+  if (to == Primitive::Boolean && from == Primitive::Integer) {
+    text = "cc_int_to_bool(" + text + ", " + quoted() + ")";
+    return true;
+  }
+  *err_ << "Cannot convert " << primitiveName(from) << " to "
+        << primitiveName(to) << std::endl;
+  return false;
+}
+
+bool CEmitter::place(CNode *node, std::string &result) {
+  if (node->name == "modifiable_primary") {
+    if (node->slot == -1) {
+      *err_ << "Variable " << node->children[0]->name << " was not analysed"
+            << std::endl;
+      return false;
+    }
+    result = variable(node->children[0]->name, node->depth, node->slot);
+    return true;
+  }
+  return place(node->children[0], result) && selector(node, result);
+}
+
+bool CEmitter::selector(CNode *node, std::string &result) {
+  CNode *base = node->children[0];
+  std::string items = result;
+  if (node->name == "modifiable_primary_array") {
+    auto array = base->type == nullptr || base->type->getType() != Types::Array
+                     ? nullptr
+                     : static_cast<ArrayType *>(base->type.get());
+    std::string index;
+    if (array == nullptr ||
+        !value(node->children[1], Primitive::Integer, index))
+      return false;
+    std::string length = array->length < 0
+                             ? items + ".length"
+                             : literal(ConstantValue::ofInteger(array->length));
+    CNode *subscript = node->children[1];
+    if ((node->proven & CNode::InBounds) != 0 && subscript->constant)
+      index = literal(ConstantValue::ofInteger(subscript->value.integer - 1));
+    else if ((node->proven & CNode::InBounds) != 0)
+      index = "(" + index + ") - 1";
+    else
+      index = "CC_INDEX(" + index + ", " + length + ", " + quoted() + ")";
+    result = items + ".items[" + index + "]";
+    return true;
+  }
+  // the grammar nests the rest of a chain such as a.b[i].c to the right
+  return member(node->children[1], base->type, result);
+}
+
+bool CEmitter::member(CNode *node, const std::shared_ptr<TypeNode> &record,
+                      std::string &result) {
+  if (node->name != "modifiable_primary")
+    return member(node->children[0], record, result) &&
+           selector(node, result);
+  auto fields = record == nullptr || record->getType() != Types::Record
+                    ? nullptr
+                    : static_cast<RecordType *>(record.get());
+  const std::string &field = node->children[0]->name;
+  if (fields == nullptr || fields->findField(field) == nullptr) {
+    *err_ << "Field access " << field << " is not typed" << std::endl;
+    return false;
+  }
+  result += ".f_" + field;
+  return true;
+}
+
+std::string CEmitter::variable(const std::string &name, int depth,
+                               int slot) const {
+  // slots tell apart variables of a routine that share a name
+  return depth == 0 ? "g_" + name : "v_" + name + "_" + std::to_string(slot);
+}
+
+std::string CEmitter::literal(const ConstantValue &value) const {
+  switch (value.kind) {
+  case ConstantValue::Boolean:
+    return value.boolean ? "1" : "0";
+  case ConstantValue::Real: {
+    if (std::isnan(value.real))
+      return "NAN";
+    if (std::isinf(value.real))
+      return value.real < 0 ? "(-HUGE_VAL)" : "HUGE_VAL";
+    std::string text = value.toString();
+    return value.real < 0 ? "(" + text + ")" : text;
+  }
+  default:
+    if (value.integer == INT64_MIN)
+      return "INT64_MIN";
+    if (value.integer == (int32_t)value.integer)
+      return value.integer < 0 ? "(" + value.toString() + ")"
+                               : value.toString();
+    return "INT64_C(" + value.toString() + ")";
+  }
+}
+
+std::string CEmitter::temporary(const std::string &type,
+                                const std::string &text) {
+  std::string name = "cc_t" + std::to_string(temporaries_++);
+  line(type + " " + name + " = " + text + ";");
+  return name;
+}
+
+std::string CEmitter::quoted() const { return "\"" + routine_ + "\""; }
+
+bool CEmitter::typeName(const std::shared_ptr<TypeNode> &type,
+                        std::string &result) {
+  Primitive scalar = primitive(type);
+  if (scalar != Primitive::Invalid) {
+    result = scalarName(scalar);
+    return true;
+  }
+  if (type == nullptr ||
+      (type->getType() != Types::Array && type->getType() != Types::Record)) {
+    *err_ << "Type " << (type == nullptr ? "?" : type->toStr())
+          << " has no C type" << std::endl;
+    return false;
+  }
+  std::string key = structure(type);
+  auto known = types_.find(key);
+  if (known != types_.end()) {
+    result = known->second;
+    return true;
+  }
+
+  // parts are defined before the structure that holds them, which is named
+  // after them
+  std::ostringstream definition;
+  if (type->getType() == Types::Array) {
+    auto array = static_cast<ArrayType *>(type.get());
+    std::string item;
+    if (!typeName(array->arrayType, item))
+      return false;
+    if (runtimeArray(array->arrayType)) {
+      *err_ << "Arrays of runtime length must be variables of their own"
+            << std::endl;
+      return false;
+    }
+    if (array->length < 0)
+      definition << "  int64_t length;\n  " << item << " *items;\n";
+    else
+      definition << "  " << item << " items["
+                 << std::max<int64_t>(array->length, 1) << "];\n";
+  } else {
+    auto record = static_cast<RecordType *>(type.get());
+    std::vector<std::string> fields;
+    for (const auto &field : record->fields) {
+      std::string field_type;
+      if (!typeName(field->variable_type_, field_type))
+        return false;
+      if (runtimeArray(field->variable_type_)) {
+        *err_ << "Arrays of runtime length must be variables of their own"
+              << std::endl;
+        return false;
+      }
+      fields.push_back("  " + field_type + " f_" + field->variable_name_ +
+                       ";\n");
+    }
+    for (const std::string &field : fields)
+      definition << field;
+    if (fields.empty())
+      definition << "  char unused;\n";
+  }
+  std::string name = "struct t" + std::to_string(types_.size());
+  types_[key] = name;
+  definitions_ << name << " {\n" << definition.str() << "};\n\n";
+  result = name;
+  return true;
+}
+
+bool CEmitter::initializer(const std::shared_ptr<TypeNode> &type,
+                           std::string &result) {
+  auto known = initializers_.find(type.get());
+  if (known != initializers_.end()) {
+    result = known->second;
+    return true;
+  }
+  std::string name;
+  if (!typeName(type, name))
+    return false;
+  // named before the initializers of its parts are generated
+  std::ostringstream definition;
+  std::string function = "cc_init" + std::to_string(initializers_.size());
+  initializers_[type.get()] = function;
+  definition << "static void " << function << "(" << name << " *value) {\n"
+             << "  memset(value, 0, sizeof *value);\n";
+  if (type->getType() == Types::Array) {
+    auto array = static_cast<ArrayType *>(type.get());
+    if (defaults(array->arrayType)) {
+      std::string item;
+      if (!initializer(array->arrayType, item))
+        return false;
+      definition << "  for (int64_t i = 0; i < " << array->length
+                 << "; i++)\n    " << item << "(&value->items[i]);\n";
+    }
+  } else if (type->getType() == Types::Record) {
+    auto record = static_cast<RecordType *>(type.get());
+    for (const auto &field : record->fields) {
+      const std::string member = "value->f_" + field->variable_name_;
+      CNode *initial = field->default_value_;
+      if (initial == nullptr) {
+        if (!defaults(field->variable_type_))
+          continue;
+        std::string part;
+        if (!initializer(field->variable_type_, part))
+          return false;
+        definition << "  " << part << "(&" << member << ");\n";
+        continue;
+      }
+      ConstantValue converted;
+      std::ostringstream ignored;
+      if (!initial->constant ||
+          !convertValue(initial->value, primitive(field->variable_type_),
+                        converted, ignored)) {
+        *err_ << "Default of field " << field->variable_name_
+              << " is not a constant" << std::endl;
+        return false;
+      }
+      definition << "  " << member << " = " << literal(converted) << ";\n";
+    }
+  }
+  definition << "}\n\n";
+  definitions_ << definition.str();
+  result = function;
+  return true;
+}
+
+bool CEmitter::defaults(const std::shared_ptr<TypeNode> &type) const {
+  if (type == nullptr)
+    return false;
+  if (type->getType() == Types::Array)
+    return defaults(static_cast<ArrayType *>(type.get())->arrayType);
+  if (type->getType() != Types::Record)
+    return false;
+  for (const auto &field :
+       static_cast<RecordType *>(type.get())->fields) {
+    if (field->default_value_ != nullptr || defaults(field->variable_type_))
+      return true;
+  }
+  return false;
+}
+
+std::string CEmitter::structure(const std::shared_ptr<TypeNode> &type) const {
+  Primitive scalar = primitive(type);
+  if (scalar != Primitive::Invalid)
+    return primitiveName(scalar);
+  if (type->getType() == Types::Array) {
+    auto array = static_cast<ArrayType *>(type.get());
+    return "[" + std::to_string(array->length) + "]" +
+           structure(array->arrayType);
+  }
+  std::string result = "{";
+  for (const auto &field : static_cast<RecordType *>(type.get())->fields)
+    result += field->variable_name_ + ":" +
+              structure(field->variable_type_) + ";";
+  return result + "}";
+}
+
+bool CEmitter::runtimeArray(const std::shared_ptr<TypeNode> &type) const {
+  return type != nullptr && type->getType() == Types::Array &&
+         static_cast<ArrayType *>(type.get())->length < 0;
+}
+
+Primitive CEmitter::primitive(const std::shared_ptr<TypeNode> &type) const {
+  return type == nullptr ? Primitive::Invalid
+                         : table_.typeArena().toPrimitive(type);
+}
+
+Primitive CEmitter::typeOf(const CNode *node) const {
+  if (!node->constant)
+    return primitive(node->type);
+  switch (node->value.kind) {
+  case ConstantValue::Integer:
+    return Primitive::Integer;
+  case ConstantValue::Real:
+    return Primitive::Real;
+  case ConstantValue::Boolean:
+    return Primitive::Boolean;
+  default:
+    return Primitive::Invalid;
+  }
+}
+
+const char *CEmitter::scalarName(Primitive type) const {
+  switch (type) {
+  case Primitive::Integer:
+    return "int64_t";
+  case Primitive::Real:
+    return "double";
+  case Primitive::Boolean:
+    return "uint8_t";
+  default:
+    return "void";
+  }
+}
+
+void CEmitter::line(const std::string &text) {
+  *out_ << std::string(2 * indent_, ' ') << text << "\n";
+}
@@ -0,0 +1,109 @@
+#ifndef CC_PROJECT_CEMITTER_HPP
+#define CC_PROJECT_CEMITTER_HPP
+
+#include "semantic_analyzer/ControlTable.hpp"
+#include <sstream>
+#include <unordered_map>
+
+// Translation of an analysed program to C source for the system compiler.
+// Integers, reals and booleans become int64_t, double and uint8_t; records
+// become structs and arrays of constant length structs around a C array,
+// so that assignment and parameter passing copy them as the language
+// requires. Arrays of runtime length are heap allocated, copied on entry
+// to a routine and freed when their scope ends. Integer arithmetic wraps
+// and division and conversions are checked as in the virtual machines;
+// index checks are dropped by compiling with -DCC_NO_BOUNDS_CHECKS, and
+// are never emitted for indices the analyzer proved in bounds.
+class CEmitter {
+public:
+  CEmitter(const ControlTable &table, std::ostream &err);
+  ~CEmitter() = default;
+
+  // Emit the globals and the routines reachable from entries, or every
+  // routine when entries is empty, followed by a main that runs the
+  // routine entry, if not empty, and prints its scalar result. The bodies
+  // must have been checked by the analyzer
+  bool emit(CNode *program, const std::vector<std::string> &entries,
+            const std::string &entry, std::ostream &out);
+
+private:
+  // false when the routine has no body; queued for emission when new
+  bool request(const std::string &name);
+  bool routine(const std::string &name, CNode *body);
+  bool signature(const std::string &name, std::string &result);
+
+  bool block(CNode *body);
+  bool statement(CNode *node);
+  bool declaration(CNode *node);
+  bool assignment(CNode *node);
+  bool whileLoop(CNode *node);
+  bool forLoop(CNode *node);
+  // free the arrays of runtime length of scopes from the innermost one
+  // down to depth
+  void release(size_t depth);
+
+  // C expression for the value of node converted to type; statements it
+  // needs to run first are emitted before
+  bool value(CNode *node, Primitive type, std::string &result);
+  bool expression(CNode *node, Primitive &type, std::string &result);
+  // C text of the operands in evaluation order: an operand followed by a
+  // routine call is saved in a temporary first, since C leaves the order
+  // of evaluation unspecified
+  bool operands(const std::vector<CNode *> &nodes,
+                const std::vector<Primitive> &types,
+                std::vector<std::string> &result);
+  bool binary(CNode *node, Primitive type, std::string &result);
+  bool convert(Primitive from, Primitive to, std::string &text);
+  bool call(CNode *node, std::string &result);
+  // lvalue of a variable, array item or record field
+  bool place(CNode *node, std::string &result);
+  // lvalue of node given the lvalue of its base
+  bool selector(CNode *node, std::string &result);
+  // lvalue of a chain of selectors such as b[i].c, which starts with a
+  // field of record, given the lvalue of the record
+  bool member(CNode *node, const std::shared_ptr<TypeNode> &record,
+              std::string &result);
+  std::string variable(const std::string &name, int depth, int slot) const;
+  std::string literal(const ConstantValue &value) const;
+  std::string temporary(const std::string &type, const std::string &text);
+  std::string quoted() const;
+
+  // C type of a language type; aggregates are defined on first use
+  bool typeName(const std::shared_ptr<TypeNode> &type, std::string &result);
+  // function filling an aggregate with its default value
+  bool initializer(const std::shared_ptr<TypeNode> &type,
+                   std::string &result);
+  // some part of the default value is not zero
+  bool defaults(const std::shared_ptr<TypeNode> &type) const;
+  std::string structure(const std::shared_ptr<TypeNode> &type) const;
+  bool runtimeArray(const std::shared_ptr<TypeNode> &type) const;
+  Primitive primitive(const std::shared_ptr<TypeNode> &type) const;
+  Primitive typeOf(const CNode *node) const;
+  const char *scalarName(Primitive type) const;
+
+  void line(const std::string &text);
+
+  const ControlTable &table_;
+  std::ostream *err_;
+  std::unordered_map<std::string, CNode *> bodies_;
+  std::vector<std::string> queue_;
+  std::unordered_map<std::string, bool> requested_;
+  // C type of each structure, keyed by its layout
+  std::unordered_map<std::string, std::string> types_;
+  std::unordered_map<const TypeNode *, std::string> initializers_;
+  std::ostringstream definitions_;
+  std::ostringstream functions_;
+
+  // state of the function being emitted
+  std::string routine_;
+  const FunctionNode *function_ = nullptr;
+  std::ostringstream *out_ = nullptr;
+  int indent_ = 0;
+  int temporaries_ = 0;
+  // the last statement emitted in the current block was a return
+  bool returned_ = false;
+  // names of the arrays of runtime length each open scope owns
+  std::vector<std::vector<std::string>> scopes_;
+};
+
+#endif // CC_PROJECT_CEMITTER_HPP
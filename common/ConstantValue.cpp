@@ -0,0 +1,94 @@
+#include "ConstantValue.hpp"
+#include <charconv>
+#include <cstring>
+
+ConstantValue ConstantValue::ofInteger(int64_t value) {
+  ConstantValue result;
+  result.kind = Integer;
+  result.integer = value;
+  return result;
+}
+
+ConstantValue ConstantValue::ofReal(double value) {
+  ConstantValue result;
+  result.kind = Real;
+  result.real = value;
+  return result;
+}
+
+ConstantValue ConstantValue::ofBoolean(bool value) {
+  ConstantValue result;
+  result.kind = Boolean;
+  result.boolean = value;
+  return result;
+}
+
+ConstantValue ConstantValue::parse(const std::string &kind,
+                                   const std::string &text) {
+  const char *first = text.data();
+  const char *last = text.data() + text.size();
+  if (kind == "integer") {
+    int64_t value = 0;
+    if (std::from_chars(first, last, value).ec != std::errc())
+      return ConstantValue();
+    return ofInteger(value);
+  } else if (kind == "real") {
+    double value = 0;
+    if (std::from_chars(first, last, value).ec != std::errc())
+      return ConstantValue();
+    return ofReal(value);
+  } else if (kind == "boolean") {
+    return ofBoolean(text == "true");
+  }
+  return ConstantValue();
+}
+
+bool ConstantValue::same(const ConstantValue &other) const {
+  if (kind != other.kind)
+    return false;
+  switch (kind) {
+  case Integer:
+    return integer == other.integer;
+  case Real:
+    return std::memcmp(&real, &other.real, sizeof(double)) == 0;
+  case Boolean:
+    return boolean == other.boolean;
+  default:
+    return true;
+  }
+}
+
+double ConstantValue::asReal() const {
+  switch (kind) {
+  case Integer:
+    return (double)integer;
+  case Real:
+    return real;
+  case Boolean:
+    return boolean;
+  default:
+    return 0;
+  }
+}
+
+std::string ConstantValue::toString() const {
+  char buffer[32];
+  switch (kind) {
+  case Integer:
+    return std::string(buffer,
+                       std::to_chars(buffer, buffer + sizeof buffer, integer)
+                           .ptr);
+  case Real: {
+    char *end = std::to_chars(buffer, buffer + sizeof buffer, real).ptr;
+    std::string text(buffer, end);
+    // keep reals distinguishable from integers
+    if (text.find_first_of(".en") == std::string::npos)
+      text += ".0";
+    return text;
+  }
+  case Boolean:
+    return boolean ? "true" : "false";
+  default:
+    return "";
+  }
+}
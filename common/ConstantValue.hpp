@@ -0,0 +1,37 @@
+#ifndef CC_PROJECT_CONSTANTVALUE_HPP
+#define CC_PROJECT_CONSTANTVALUE_HPP
+
+#include <cstdint>
+#include <string>
+
+// Compile-time value of a literal or folded expression
+class ConstantValue {
+public:
+  enum Kind : char { None, Integer, Real, Boolean };
+
+  ConstantValue() : integer(0) {}
+  static ConstantValue ofInteger(int64_t value);
+  static ConstantValue ofReal(double value);
+  static ConstantValue ofBoolean(bool value);
+
+  // kind is taken from literal node name: integer, real or boolean
+  static ConstantValue parse(const std::string &kind, const std::string &text);
+
+  double asReal() const;
+
+  // same kind and value; reals are compared bitwise, so 0.0 and -0.0
+  // differ and a NaN equals itself
+  bool same(const ConstantValue &other) const;
+
+  // shortest text that parses back to the same value
+  std::string toString() const;
+
+  Kind kind = None;
+  union {
+    int64_t integer;
+    double real;
+    bool boolean;
+  };
+};
+
+#endif // CC_PROJECT_CONSTANTVALUE_HPP
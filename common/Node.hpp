@@ -1,15 +1,31 @@
 #ifndef CC_PROJECT_NODE_HPP
 #define CC_PROJECT_NODE_HPP
 
+#include "common/ConstantValue.hpp"
 #include <string>
 #include <vector>
 #include <memory>
 
+class TypeNode;
+
 class CNode {
 public:
       std::string name;
       std::vector<CNode*> children;
 
+      // filled by semantic analysis for expression nodes
+      std::shared_ptr<TypeNode> type;
+      bool constant = false;
+      // valid for literals and folded constants
+      ConstantValue value;
+      // facts proven by analysis that let a backend skip runtime checks
+      enum Proof : unsigned { InBounds = 1 };
+      unsigned proven = 0;
+      // variable references and declarations: frame of the variable
+      // (0 globals, 1 enclosing routine) and its slot in that frame
+      int depth = -1;
+      int slot = -1;
+
       CNode(const std::string &name);
 };
 
@@ -0,0 +1,87 @@
+#include "WorkStealingPool.hpp"
+
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+  if (threads == 0)
+    threads = std::thread::hardware_concurrency();
+  if (threads == 0)
+    threads = 1;
+  for (unsigned i = 0; i < threads; i++)
+    queues_.push_back(std::make_unique<Queue>());
+  for (unsigned i = 0; i < threads; i++)
+    workers_.emplace_back(&WorkStealingPool::run, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto &worker : workers_)
+    worker.join();
+}
+
+unsigned WorkStealingPool::size() const { return (unsigned)workers_.size(); }
+
+void WorkStealingPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_++;
+    queued_++;
+  }
+  Queue &queue = *queues_[next_++ % queues_.size()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  wake_.notify_one();
+}
+
+void WorkStealingPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return pending_ == 0; });
+}
+
+bool WorkStealingPool::pop(unsigned index, std::function<void()> &task) {
+  {
+    Queue &own = *queues_[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.front());
+      own.tasks.pop_front();
+      return true;
+    }
+  }
+  for (size_t i = 1; i < queues_.size(); i++) {
+    Queue &victim = *queues_[(index + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.back());
+      victim.tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::run(unsigned index) {
+  std::function<void()> task;
+  while (true) {
+    if (pop(index, task)) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_--;
+      }
+      task();
+      task = nullptr;
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--pending_ == 0)
+        done_.notify_all();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    wake_.wait(lock, [this] { return stop_ || queued_ > 0; });
+    if (stop_ && queued_ == 0)
+      return;
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef CC_PROJECT_WORKSTEALINGPOOL_HPP
+#define CC_PROJECT_WORKSTEALINGPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers, each with its own task deque.
+// A worker takes tasks from the front of its own deque and, when it runs
+// dry, steals from the back of the others.
+class WorkStealingPool {
+public:
+  // 0 threads means one per hardware thread
+  explicit WorkStealingPool(unsigned threads = 0);
+  ~WorkStealingPool();
+
+  void submit(std::function<void()> task);
+
+  // block until every submitted task has finished
+  void wait();
+
+  unsigned size() const;
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void run(unsigned index);
+  bool pop(unsigned index, std::function<void()> &task);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> workers_;
+  std::atomic<unsigned> next_{0};
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  // submitted but unfinished, and submitted but not yet taken by a worker
+  size_t pending_ = 0;
+  size_t queued_ = 0;
+  bool stop_ = false;
+};
+
+#endif // CC_PROJECT_WORKSTEALINGPOOL_HPP
@@ -0,0 +1,1879 @@
+// A Bison parser, made by GNU Bison 3.8.2.
+
+// Skeleton implementation for Bison LALR(1) parsers in C++
+
+// Copyright (C) 2002-2015, 2018-2021 Free Software Foundation, Inc.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// As a special exception, you may create a larger work that contains
+// part or all of the Bison parser skeleton and distribute that work
+// under terms of your choice, so long as that work isn't itself a
+// parser generator using the skeleton or a modified version thereof
+// as a parser skeleton.  Alternatively, if you modify or redistribute
+// the parser skeleton itself, you may (at your option) remove this
+// special exception, which will cause the skeleton and the resulting
+// Bison output files to be licensed under the GNU General Public
+// License without this special exception.
+
+// This special exception was added by the Free Software Foundation in
+// version 2.2 of Bison.
+
+// DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+// especially those whose name start with YY_ or yy_.  They are
+// private implementation details that can be changed or removed.
+
+
+
+// First part of user prologue.
+#line 8 "/root/repo/grammar/grammar.ypp"
+
+#include <stdio.h>
+#include <iostream>
+#include <string>
+#include <stdarg.h>
+#include "lexer/Token.hpp"
+#include "lexer/Lexer.hpp"
+#include "common/Node.hpp"
+
+
+//void yyerror(yycontrol& some, char const *s);
+
+#define YYSTYPE CNode*
+
+CNode* add_node(const std::string& name, int argc, ...);
+void print_tree(CNode* root);
+void print_node(CNode* node, int margin);
+void pick_up_children(CNode* parent, CNode* bad_parent);
+void add_child(CNode* parent, CNode* child);
+
+#line 62 "Parser.cpp"
+
+
+#include "Parser.hpp"
+
+
+// Unqualified %code blocks.
+#line 30 "/root/repo/grammar/grammar.ypp"
+
+    namespace yy {
+    int yylex (YYSTYPE *lvalp, location *llocp, void* lexer);
+    void error (const location& loc, const std::string& msg);
+    }
+
+#line 76 "Parser.cpp"
+
+
+#ifndef YY_
+# if defined YYENABLE_NLS && YYENABLE_NLS
+#  if ENABLE_NLS
+#   include <libintl.h> // FIXME: INFRINGES ON USER NAME SPACE.
+#   define YY_(msgid) dgettext ("bison-runtime", msgid)
+#  endif
+# endif
+# ifndef YY_
+#  define YY_(msgid) msgid
+# endif
+#endif
+
+
+// Whether we are compiled with exception support.
+#ifndef YY_EXCEPTIONS
+# if defined __GNUC__ && !defined __EXCEPTIONS
+#  define YY_EXCEPTIONS 0
+# else
+#  define YY_EXCEPTIONS 1
+# endif
+#endif
+
+#define YYRHSLOC(Rhs, K) ((Rhs)[K].location)
+/* YYLLOC_DEFAULT -- Set CURRENT to span from RHS[1] to RHS[N].
+   If N is 0, then set CURRENT to the empty location which ends
+   the previous symbol: RHS[0] (always defined).  */
+
+# ifndef YYLLOC_DEFAULT
+#  define YYLLOC_DEFAULT(Current, Rhs, N)                               \
+    do                                                                  \
+      if (N)                                                            \
+        {                                                               \
+          (Current).begin  = YYRHSLOC (Rhs, 1).begin;                   \
+          (Current).end    = YYRHSLOC (Rhs, N).end;                     \
+        }                                                               \
+      else                                                              \
+        {                                                               \
+          (Current).begin = (Current).end = YYRHSLOC (Rhs, 0).end;      \
+        }                                                               \
+    while (false)
+# endif
+
+
+// Enable debugging if requested.
+#if YYDEBUG
+
+// A pseudo ostream that takes yydebug_ into account.
+# define YYCDEBUG if (yydebug_) (*yycdebug_)
+
+# define YY_SYMBOL_PRINT(Title, Symbol)         \
+  do {                                          \
+    if (yydebug_)                               \
+    {                                           \
+      *yycdebug_ << Title << ' ';               \
+      yy_print_ (*yycdebug_, Symbol);           \
+      *yycdebug_ << '\n';                       \
+    }                                           \
+  } while (false)
+
+# define YY_REDUCE_PRINT(Rule)          \
+  do {                                  \
+    if (yydebug_)                       \
+      yy_reduce_print_ (Rule);          \
+  } while (false)
+
+# define YY_STACK_PRINT()               \
+  do {                                  \
+    if (yydebug_)                       \
+      yy_stack_print_ ();                \
+  } while (false)
+
+#else // !YYDEBUG
+
+# define YYCDEBUG if (false) std::cerr
+# define YY_SYMBOL_PRINT(Title, Symbol)  YY_USE (Symbol)
+# define YY_REDUCE_PRINT(Rule)           static_cast<void> (0)
+# define YY_STACK_PRINT()                static_cast<void> (0)
+
+#endif // !YYDEBUG
+
+#define yyerrok         (yyerrstatus_ = 0)
+#define yyclearin       (yyla.clear ())
+
+#define YYACCEPT        goto yyacceptlab
+#define YYABORT         goto yyabortlab
+#define YYERROR         goto yyerrorlab
+#define YYRECOVERING()  (!!yyerrstatus_)
+
+namespace yy {
+#line 168 "Parser.cpp"
+
+  /// Build a parser object.
+  parser::parser (void *lexer_yyarg, void **root_yyarg)
+#if YYDEBUG
+    : yydebug_ (false),
+      yycdebug_ (&std::cerr),
+#else
+    :
+#endif
+      lexer (lexer_yyarg),
+      root (root_yyarg)
+  {}
+
+  parser::~parser ()
+  {}
+
+  parser::syntax_error::~syntax_error () YY_NOEXCEPT YY_NOTHROW
+  {}
+
+  /*---------.
+  | symbol.  |
+  `---------*/
+
+  // basic_symbol.
+  template <typename Base>
+  parser::basic_symbol<Base>::basic_symbol (const basic_symbol& that)
+    : Base (that)
+    , value (that.value)
+    , location (that.location)
+  {}
+
+
+  /// Constructor for valueless symbols.
+  template <typename Base>
+  parser::basic_symbol<Base>::basic_symbol (typename Base::kind_type t, YY_MOVE_REF (location_type) l)
+    : Base (t)
+    , value ()
+    , location (l)
+  {}
+
+  template <typename Base>
+  parser::basic_symbol<Base>::basic_symbol (typename Base::kind_type t, YY_RVREF (value_type) v, YY_RVREF (location_type) l)
+    : Base (t)
+    , value (YY_MOVE (v))
+    , location (YY_MOVE (l))
+  {}
+
+
+  template <typename Base>
+  parser::symbol_kind_type
+  parser::basic_symbol<Base>::type_get () const YY_NOEXCEPT
+  {
+    return this->kind ();
+  }
+
+
+  template <typename Base>
+  bool
+  parser::basic_symbol<Base>::empty () const YY_NOEXCEPT
+  {
+    return this->kind () == symbol_kind::S_YYEMPTY;
+  }
+
+  template <typename Base>
+  void
+  parser::basic_symbol<Base>::move (basic_symbol& s)
+  {
+    super_type::move (s);
+    value = YY_MOVE (s.value);
+    location = YY_MOVE (s.location);
+  }
+
+  // by_kind.
+  parser::by_kind::by_kind () YY_NOEXCEPT
+    : kind_ (symbol_kind::S_YYEMPTY)
+  {}
+
+#if 201103L <= YY_CPLUSPLUS
+  parser::by_kind::by_kind (by_kind&& that) YY_NOEXCEPT
+    : kind_ (that.kind_)
+  {
+    that.clear ();
+  }
+#endif
+
+  parser::by_kind::by_kind (const by_kind& that) YY_NOEXCEPT
+    : kind_ (that.kind_)
+  {}
+
+  parser::by_kind::by_kind (token_kind_type t) YY_NOEXCEPT
+    : kind_ (yytranslate_ (t))
+  {}
+
+
+
+  void
+  parser::by_kind::clear () YY_NOEXCEPT
+  {
+    kind_ = symbol_kind::S_YYEMPTY;
+  }
+
+  void
+  parser::by_kind::move (by_kind& that)
+  {
+    kind_ = that.kind_;
+    that.clear ();
+  }
+
+  parser::symbol_kind_type
+  parser::by_kind::kind () const YY_NOEXCEPT
+  {
+    return kind_;
+  }
+
+
+  parser::symbol_kind_type
+  parser::by_kind::type_get () const YY_NOEXCEPT
+  {
+    return this->kind ();
+  }
+
+
+
+  // by_state.
+  parser::by_state::by_state () YY_NOEXCEPT
+    : state (empty_state)
+  {}
+
+  parser::by_state::by_state (const by_state& that) YY_NOEXCEPT
+    : state (that.state)
+  {}
+
+  void
+  parser::by_state::clear () YY_NOEXCEPT
+  {
+    state = empty_state;
+  }
+
+  void
+  parser::by_state::move (by_state& that)
+  {
+    state = that.state;
+    that.clear ();
+  }
+
+  parser::by_state::by_state (state_type s) YY_NOEXCEPT
+    : state (s)
+  {}
+
+  parser::symbol_kind_type
+  parser::by_state::kind () const YY_NOEXCEPT
+  {
+    if (state == empty_state)
+      return symbol_kind::S_YYEMPTY;
+    else
+      return YY_CAST (symbol_kind_type, yystos_[+state]);
+  }
+
+  parser::stack_symbol_type::stack_symbol_type ()
+  {}
+
+  parser::stack_symbol_type::stack_symbol_type (YY_RVREF (stack_symbol_type) that)
+    : super_type (YY_MOVE (that.state), YY_MOVE (that.value), YY_MOVE (that.location))
+  {
+#if 201103L <= YY_CPLUSPLUS
+    // that is emptied.
+    that.state = empty_state;
+#endif
+  }
+
+  parser::stack_symbol_type::stack_symbol_type (state_type s, YY_MOVE_REF (symbol_type) that)
+    : super_type (s, YY_MOVE (that.value), YY_MOVE (that.location))
+  {
+    // that is emptied.
+    that.kind_ = symbol_kind::S_YYEMPTY;
+  }
+
+#if YY_CPLUSPLUS < 201103L
+  parser::stack_symbol_type&
+  parser::stack_symbol_type::operator= (const stack_symbol_type& that)
+  {
+    state = that.state;
+    value = that.value;
+    location = that.location;
+    return *this;
+  }
+
+  parser::stack_symbol_type&
+  parser::stack_symbol_type::operator= (stack_symbol_type& that)
+  {
+    state = that.state;
+    value = that.value;
+    location = that.location;
+    // that is emptied.
+    that.state = empty_state;
+    return *this;
+  }
+#endif
+
+  template <typename Base>
+  void
+  parser::yy_destroy_ (const char* yymsg, basic_symbol<Base>& yysym) const
+  {
+    if (yymsg)
+      YY_SYMBOL_PRINT (yymsg, yysym);
+
+    // User destructor.
+    YY_USE (yysym.kind ());
+  }
+
+#if YYDEBUG
+  template <typename Base>
+  void
+  parser::yy_print_ (std::ostream& yyo, const basic_symbol<Base>& yysym) const
+  {
+    std::ostream& yyoutput = yyo;
+    YY_USE (yyoutput);
+    if (yysym.empty ())
+      yyo << "empty symbol";
+    else
+      {
+        symbol_kind_type yykind = yysym.kind ();
+        yyo << (yykind < YYNTOKENS ? "token" : "nterm")
+            << ' ' << yysym.name () << " ("
+            << yysym.location << ": ";
+        YY_USE (yykind);
+        yyo << ')';
+      }
+  }
+#endif
+
+  void
+  parser::yypush_ (const char* m, YY_MOVE_REF (stack_symbol_type) sym)
+  {
+    if (m)
+      YY_SYMBOL_PRINT (m, sym);
+    yystack_.push (YY_MOVE (sym));
+  }
+
+  void
+  parser::yypush_ (const char* m, state_type s, YY_MOVE_REF (symbol_type) sym)
+  {
+#if 201103L <= YY_CPLUSPLUS
+    yypush_ (m, stack_symbol_type (s, std::move (sym)));
+#else
+    stack_symbol_type ss (s, sym);
+    yypush_ (m, ss);
+#endif
+  }
+
+  void
+  parser::yypop_ (int n) YY_NOEXCEPT
+  {
+    yystack_.pop (n);
+  }
+
+#if YYDEBUG
+  std::ostream&
+  parser::debug_stream () const
+  {
+    return *yycdebug_;
+  }
+
+  void
+  parser::set_debug_stream (std::ostream& o)
+  {
+    yycdebug_ = &o;
+  }
+
+
+  parser::debug_level_type
+  parser::debug_level () const
+  {
+    return yydebug_;
+  }
+
+  void
+  parser::set_debug_level (debug_level_type l)
+  {
+    yydebug_ = l;
+  }
+#endif // YYDEBUG
+
+  parser::state_type
+  parser::yy_lr_goto_state_ (state_type yystate, int yysym)
+  {
+    int yyr = yypgoto_[yysym - YYNTOKENS] + yystate;
+    if (0 <= yyr && yyr <= yylast_ && yycheck_[yyr] == yystate)
+      return yytable_[yyr];
+    else
+      return yydefgoto_[yysym - YYNTOKENS];
+  }
+
+  bool
+  parser::yy_pact_value_is_default_ (int yyvalue) YY_NOEXCEPT
+  {
+    return yyvalue == yypact_ninf_;
+  }
+
+  bool
+  parser::yy_table_value_is_error_ (int yyvalue) YY_NOEXCEPT
+  {
+    return yyvalue == yytable_ninf_;
+  }
+
+  int
+  parser::operator() ()
+  {
+    return parse ();
+  }
+
+  int
+  parser::parse ()
+  {
+    int yyn;
+    /// Length of the RHS of the rule being reduced.
+    int yylen = 0;
+
+    // Error handling.
+    int yynerrs_ = 0;
+    int yyerrstatus_ = 0;
+
+    /// The lookahead symbol.
+    symbol_type yyla;
+
+    /// The locations where the error started and ended.
+    stack_symbol_type yyerror_range[3];
+
+    /// The return value of parse ().
+    int yyresult;
+
+#if YY_EXCEPTIONS
+    try
+#endif // YY_EXCEPTIONS
+      {
+    YYCDEBUG << "Starting parse\n";
+
+
+    /* Initialize the stack.  The initial state will be set in
+       yynewstate, since the latter expects the semantical and the
+       location values to have been already stored, initialize these
+       stacks with a primary value.  */
+    yystack_.clear ();
+    yypush_ (YY_NULLPTR, 0, YY_MOVE (yyla));
+
+  /*-----------------------------------------------.
+  | yynewstate -- push a new symbol on the stack.  |
+  `-----------------------------------------------*/
+  yynewstate:
+    YYCDEBUG << "Entering state " << int (yystack_[0].state) << '\n';
+    YY_STACK_PRINT ();
+
+    // Accept?
+    if (yystack_[0].state == yyfinal_)
+      YYACCEPT;
+
+    goto yybackup;
+
+
+  /*-----------.
+  | yybackup.  |
+  `-----------*/
+  yybackup:
+    // Try to take a decision without lookahead.
+    yyn = yypact_[+yystack_[0].state];
+    if (yy_pact_value_is_default_ (yyn))
+      goto yydefault;
+
+    // Read a lookahead token.
+    if (yyla.empty ())
+      {
+        YYCDEBUG << "Reading a token\n";
+#if YY_EXCEPTIONS
+        try
+#endif // YY_EXCEPTIONS
+          {
+            yyla.kind_ = yytranslate_ (yylex (&yyla.value, &yyla.location, lexer));
+          }
+#if YY_EXCEPTIONS
+        catch (const syntax_error& yyexc)
+          {
+            YYCDEBUG << "Caught exception: " << yyexc.what() << '\n';
+            error (yyexc);
+            goto yyerrlab1;
+          }
+#endif // YY_EXCEPTIONS
+      }
+    YY_SYMBOL_PRINT ("Next token is", yyla);
+
+    if (yyla.kind () == symbol_kind::S_YYerror)
+    {
+      // The scanner already issued an error message, process directly
+      // to error recovery.  But do not keep the error token as
+      // lookahead, it is too special and may lead us to an endless
+      // loop in error recovery. */
+      yyla.kind_ = symbol_kind::S_YYUNDEF;
+      goto yyerrlab1;
+    }
+
+    /* If the proper action on seeing token YYLA.TYPE is to reduce or
+       to detect an error, take that action.  */
+    yyn += yyla.kind ();
+    if (yyn < 0 || yylast_ < yyn || yycheck_[yyn] != yyla.kind ())
+      {
+        goto yydefault;
+      }
+
+    // Reduce or error.
+    yyn = yytable_[yyn];
+    if (yyn <= 0)
+      {
+        if (yy_table_value_is_error_ (yyn))
+          goto yyerrlab;
+        yyn = -yyn;
+        goto yyreduce;
+      }
+
+    // Count tokens shifted since error; after three, turn off error status.
+    if (yyerrstatus_)
+      --yyerrstatus_;
+
+    // Shift the lookahead token.
+    yypush_ ("Shifting", state_type (yyn), YY_MOVE (yyla));
+    goto yynewstate;
+
+
+  /*-----------------------------------------------------------.
+  | yydefault -- do the default action for the current state.  |
+  `-----------------------------------------------------------*/
+  yydefault:
+    yyn = yydefact_[+yystack_[0].state];
+    if (yyn == 0)
+      goto yyerrlab;
+    goto yyreduce;
+
+
+  /*-----------------------------.
+  | yyreduce -- do a reduction.  |
+  `-----------------------------*/
+  yyreduce:
+    yylen = yyr2_[yyn];
+    {
+      stack_symbol_type yylhs;
+      yylhs.state = yy_lr_goto_state_ (yystack_[yylen].state, yyr1_[yyn]);
+      /* If YYLEN is nonzero, implement the default value of the
+         action: '$$ = $1'.  Otherwise, use the top of the stack.
+
+         Otherwise, the following line sets YYLHS.VALUE to garbage.
+         This behavior is undocumented and Bison users should not rely
+         upon it.  */
+      if (yylen)
+        yylhs.value = yystack_[yylen - 1].value;
+      else
+        yylhs.value = yystack_[0].value;
+
+      // Default location.
+      {
+        stack_type::slice range (yystack_, yylen);
+        YYLLOC_DEFAULT (yylhs.location, range, yylen);
+        yyerror_range[1].location = yylhs.location;
+      }
+
+      // Perform the reduction.
+      YY_REDUCE_PRINT (yyn);
+#if YY_EXCEPTIONS
+      try
+#endif // YY_EXCEPTIONS
+        {
+          switch (yyn)
+            {
+  case 2: // program: %empty
+#line 58 "/root/repo/grammar/grammar.ypp"
+      {yylhs.value = nullptr;}
+#line 642 "Parser.cpp"
+    break;
+
+  case 3: // program: program simple_declaration
+#line 59 "/root/repo/grammar/grammar.ypp"
+                                 { yylhs.value = add_node("program", 0); pick_up_children(yylhs.value, yystack_[1].value); add_child(yylhs.value, yystack_[0].value); *root = yylhs.value;}
+#line 648 "Parser.cpp"
+    break;
+
+  case 4: // program: program routine_declaration
+#line 60 "/root/repo/grammar/grammar.ypp"
+                                  { yylhs.value = add_node("program", 0); pick_up_children(yylhs.value, yystack_[1].value); add_child(yylhs.value, yystack_[0].value); *root = yylhs.value;}
+#line 654 "Parser.cpp"
+    break;
+
+  case 5: // simple_declaration: variable_declaration
+#line 64 "/root/repo/grammar/grammar.ypp"
+                           { yylhs.value = add_node("simple_declaration", 1, yystack_[0].value); }
+#line 660 "Parser.cpp"
+    break;
+
+  case 6: // simple_declaration: type_declaration
+#line 65 "/root/repo/grammar/grammar.ypp"
+                       { yylhs.value = add_node("simple_declaration", 1, yystack_[0].value); }
+#line 666 "Parser.cpp"
+    break;
+
+  case 7: // variable_declaration: VAR IDENTIFIER COLON type variable_expression
+#line 69 "/root/repo/grammar/grammar.ypp"
+                                                    { yylhs.value = add_node("variable_declaration", 3, yystack_[3].value, yystack_[1].value, yystack_[0].value);}
+#line 672 "Parser.cpp"
+    break;
+
+  case 8: // variable_declaration: VAR IDENTIFIER IS expression
+#line 70 "/root/repo/grammar/grammar.ypp"
+                                   { yylhs.value = add_node("variable_declaration_auto", 2, yystack_[2].value, yystack_[0].value);}
+#line 678 "Parser.cpp"
+    break;
+
+  case 9: // variable_expression: %empty
+#line 74 "/root/repo/grammar/grammar.ypp"
+      {yylhs.value = nullptr;}
+#line 684 "Parser.cpp"
+    break;
+
+  case 10: // variable_expression: IS expression
+#line 75 "/root/repo/grammar/grammar.ypp"
+                    { yylhs.value = yystack_[0].value;}
+#line 690 "Parser.cpp"
+    break;
+
+  case 11: // type_declaration: TYPE IDENTIFIER IS type
+#line 79 "/root/repo/grammar/grammar.ypp"
+                              { yylhs.value = add_node("type_declaration", 2, yystack_[2].value, yystack_[0].value);}
+#line 696 "Parser.cpp"
+    break;
+
+  case 12: // routine_declaration: ROUTINE IDENTIFIER L_BR routine_parameters R_BR routine_return_type IS body END
+#line 83 "/root/repo/grammar/grammar.ypp"
+                                                                                      { yylhs.value = add_node("routine_declaration", 4, yystack_[7].value, yystack_[5].value, yystack_[3].value, yystack_[1].value);}
+#line 702 "Parser.cpp"
+    break;
+
+  case 13: // routine_return_type: %empty
+#line 87 "/root/repo/grammar/grammar.ypp"
+      {yylhs.value = nullptr;}
+#line 708 "Parser.cpp"
+    break;
+
+  case 14: // routine_return_type: COLON type
+#line 88 "/root/repo/grammar/grammar.ypp"
+                 { yylhs.value = yystack_[0].value;}
+#line 714 "Parser.cpp"
+    break;
+
+  case 15: // routine_parameters: %empty
+#line 92 "/root/repo/grammar/grammar.ypp"
+      {yylhs.value = nullptr;}
+#line 720 "Parser.cpp"
+    break;
+
+  case 16: // routine_parameters: parameters
+#line 93 "/root/repo/grammar/grammar.ypp"
+                 { yylhs.value = yystack_[0].value;}
+#line 726 "Parser.cpp"
+    break;
+
+  case 17: // parameters: parameters COMMA parameter_declaration
+#line 97 "/root/repo/grammar/grammar.ypp"
+                                             { yylhs.value = add_node("parameters", 0); pick_up_children(yylhs.value, yystack_[2].value); add_child(yylhs.value, yystack_[0].value);}
+#line 732 "Parser.cpp"
+    break;
+
+  case 18: // parameters: parameter_declaration
+#line 98 "/root/repo/grammar/grammar.ypp"
+                            { yylhs.value = add_node("parameters", 1, yystack_[0].value);}
+#line 738 "Parser.cpp"
+    break;
+
+  case 19: // parameter_declaration: IDENTIFIER COLON IDENTIFIER
+#line 103 "/root/repo/grammar/grammar.ypp"
+                                  { yylhs.value = add_node("parameter_declaration", 2, yystack_[2].value, yystack_[0].value);}
+#line 744 "Parser.cpp"
+    break;
+
+  case 20: // parameter_declaration: IDENTIFIER COLON primitive_type
+#line 104 "/root/repo/grammar/grammar.ypp"
+                                      { yylhs.value = add_node("parameter_declaration", 2, yystack_[2].value, yystack_[0].value);}
+#line 750 "Parser.cpp"
+    break;
+
+  case 21: // type: primitive_type
+#line 108 "/root/repo/grammar/grammar.ypp"
+                     { yylhs.value = add_node("type", 1, yystack_[0].value);}
+#line 756 "Parser.cpp"
+    break;
+
+  case 22: // type: array_type
+#line 109 "/root/repo/grammar/grammar.ypp"
+                 { yylhs.value = add_node("type", 1, yystack_[0].value);}
+#line 762 "Parser.cpp"
+    break;
+
+  case 23: // type: record_type
+#line 110 "/root/repo/grammar/grammar.ypp"
+                  { yylhs.value = add_node("type", 1, yystack_[0].value);}
+#line 768 "Parser.cpp"
+    break;
+
+  case 24: // type: IDENTIFIER
+#line 111 "/root/repo/grammar/grammar.ypp"
+                 { yylhs.value = add_node("type", 1, yystack_[0].value);}
+#line 774 "Parser.cpp"
+    break;
+
+  case 25: // primitive_type: INTEGER
+#line 115 "/root/repo/grammar/grammar.ypp"
+              { yylhs.value = yystack_[0].value;}
+#line 780 "Parser.cpp"
+    break;
+
+  case 26: // primitive_type: REAL
+#line 116 "/root/repo/grammar/grammar.ypp"
+           { yylhs.value = yystack_[0].value;}
+#line 786 "Parser.cpp"
+    break;
+
+  case 27: // primitive_type: BOOLEAN
+#line 117 "/root/repo/grammar/grammar.ypp"
+              { yylhs.value = yystack_[0].value;}
+#line 792 "Parser.cpp"
+    break;
+
+  case 28: // record_type: RECORD variables_declaration END
+#line 121 "/root/repo/grammar/grammar.ypp"
+                                       { yylhs.value = add_node("record_type", 1, yystack_[1].value);}
+#line 798 "Parser.cpp"
+    break;
+
+  case 29: // variables_declaration: variable_declaration variables_declaration
+#line 125 "/root/repo/grammar/grammar.ypp"
+                                                 { yylhs.value = add_node("variables_declaration", 1, yystack_[1].value); pick_up_children(yylhs.value, yystack_[0].value);}
+#line 804 "Parser.cpp"
+    break;
+
+  case 30: // variables_declaration: %empty
+#line 126 "/root/repo/grammar/grammar.ypp"
+      {yylhs.value = nullptr;}
+#line 810 "Parser.cpp"
+    break;
+
+  case 31: // array_type: ARRAY L_SQ_BR expression R_SQ_BR type
+#line 130 "/root/repo/grammar/grammar.ypp"
+                                            { yylhs.value = add_node("array_type", 2, yystack_[2].value, yystack_[0].value);}
+#line 816 "Parser.cpp"
+    break;
+
+  case 32: // body: %empty
+#line 134 "/root/repo/grammar/grammar.ypp"
+      {yylhs.value = nullptr;}
+#line 822 "Parser.cpp"
+    break;
+
+  case 33: // body: body simple_declaration
+#line 135 "/root/repo/grammar/grammar.ypp"
+                              { yylhs.value = add_node("body", 0);  pick_up_children(yylhs.value, yystack_[1].value); add_child(yylhs.value, yystack_[0].value);}
+#line 828 "Parser.cpp"
+    break;
+
+  case 34: // body: body statement
+#line 136 "/root/repo/grammar/grammar.ypp"
+                     { yylhs.value = add_node("body", 0); pick_up_children(yylhs.value, yystack_[1].value); add_child(yylhs.value, yystack_[0].value);}
+#line 834 "Parser.cpp"
+    break;
+
+  case 35: // statement: assignment
+#line 140 "/root/repo/grammar/grammar.ypp"
+                  { yylhs.value = add_node("statement", 1, yystack_[0].value);}
+#line 840 "Parser.cpp"
+    break;
+
+  case 36: // statement: routine_call
+#line 141 "/root/repo/grammar/grammar.ypp"
+                   { yylhs.value = add_node("statement", 1, yystack_[0].value);}
+#line 846 "Parser.cpp"
+    break;
+
+  case 37: // statement: while_loop
+#line 142 "/root/repo/grammar/grammar.ypp"
+                 { yylhs.value = add_node("statement", 1, yystack_[0].value);}
+#line 852 "Parser.cpp"
+    break;
+
+  case 38: // statement: for_loop
+#line 143 "/root/repo/grammar/grammar.ypp"
+               { yylhs.value = add_node("statement", 1, yystack_[0].value);}
+#line 858 "Parser.cpp"
+    break;
+
+  case 39: // statement: if_statement
+#line 144 "/root/repo/grammar/grammar.ypp"
+                   { yylhs.value = add_node("statement", 1, yystack_[0].value);}
+#line 864 "Parser.cpp"
+    break;
+
+  case 40: // statement: return
+#line 145 "/root/repo/grammar/grammar.ypp"
+             { yylhs.value = add_node("statement", 1, yystack_[0].value);}
+#line 870 "Parser.cpp"
+    break;
+
+  case 41: // return: RETURN return_value
+#line 149 "/root/repo/grammar/grammar.ypp"
+                          { yylhs.value = add_node("return", 1, yystack_[0].value); }
+#line 876 "Parser.cpp"
+    break;
+
+  case 42: // return_value: %empty
+#line 153 "/root/repo/grammar/grammar.ypp"
+      {yylhs.value = nullptr;}
+#line 882 "Parser.cpp"
+    break;
+
+  case 43: // return_value: expression
+#line 154 "/root/repo/grammar/grammar.ypp"
+                 { yylhs.value = add_node("return_value", 1, yystack_[0].value);}
+#line 888 "Parser.cpp"
+    break;
+
+  case 44: // assignment: modifiable_primary ASSIGNMENT_SIGN expression
+#line 158 "/root/repo/grammar/grammar.ypp"
+                                                    { yylhs.value = add_node("assignment", 2, yystack_[2].value, yystack_[0].value);}
+#line 894 "Parser.cpp"
+    break;
+
+  case 45: // routine_call: IDENTIFIER L_BR arguments R_BR
+#line 162 "/root/repo/grammar/grammar.ypp"
+                                     { yylhs.value = add_node("routine_call", 2, yystack_[3].value, yystack_[1].value);}
+#line 900 "Parser.cpp"
+    break;
+
+  case 46: // arguments: %empty
+#line 166 "/root/repo/grammar/grammar.ypp"
+      {yylhs.value = nullptr;}
+#line 906 "Parser.cpp"
+    break;
+
+  case 47: // arguments: expressions
+#line 167 "/root/repo/grammar/grammar.ypp"
+                  { yylhs.value = yystack_[0].value;}
+#line 912 "Parser.cpp"
+    break;
+
+  case 48: // expressions: expressions COMMA expression
+#line 171 "/root/repo/grammar/grammar.ypp"
+                                   { yylhs.value = add_node("arguments", 0);  pick_up_children(yylhs.value, yystack_[2].value); add_child(yylhs.value, yystack_[0].value);}
+#line 918 "Parser.cpp"
+    break;
+
+  case 49: // expressions: expression
+#line 172 "/root/repo/grammar/grammar.ypp"
+                 { yylhs.value = add_node("arguments", 1, yystack_[0].value);}
+#line 924 "Parser.cpp"
+    break;
+
+  case 50: // while_loop: WHILE expression LOOP body END
+#line 176 "/root/repo/grammar/grammar.ypp"
+                                     { yylhs.value = add_node("while_loop", 2, yystack_[3].value, yystack_[1].value);}
+#line 930 "Parser.cpp"
+    break;
+
+  case 51: // for_loop: FOR IDENTIFIER range LOOP body END
+#line 180 "/root/repo/grammar/grammar.ypp"
+                                         { yylhs.value = add_node("for_loop", 3, yystack_[4].value, yystack_[3].value, yystack_[1].value);}
+#line 936 "Parser.cpp"
+    break;
+
+  case 52: // range: IN reverse expression RANGE_SIGN expression
+#line 184 "/root/repo/grammar/grammar.ypp"
+                                                  { yylhs.value = add_node("range", 3, yystack_[3].value, yystack_[2].value, yystack_[0].value);}
+#line 942 "Parser.cpp"
+    break;
+
+  case 53: // reverse: %empty
+#line 188 "/root/repo/grammar/grammar.ypp"
+      {yylhs.value = nullptr;}
+#line 948 "Parser.cpp"
+    break;
+
+  case 54: // reverse: REVERSE
+#line 189 "/root/repo/grammar/grammar.ypp"
+              { yylhs.value = yystack_[0].value;}
+#line 954 "Parser.cpp"
+    break;
+
+  case 55: // if_statement: IF expression THEN body else_body END
+#line 193 "/root/repo/grammar/grammar.ypp"
+                                            { yylhs.value = add_node("if_statement", 3, yystack_[4].value, yystack_[2].value, yystack_[1].value);}
+#line 960 "Parser.cpp"
+    break;
+
+  case 56: // else_body: %empty
+#line 197 "/root/repo/grammar/grammar.ypp"
+      {yylhs.value = nullptr;}
+#line 966 "Parser.cpp"
+    break;
+
+  case 57: // else_body: ELSE body
+#line 198 "/root/repo/grammar/grammar.ypp"
+                { yylhs.value = add_node("else_body", 1, yystack_[0].value);}
+#line 972 "Parser.cpp"
+    break;
+
+  case 58: // expression: expression logic_operation relation
+#line 202 "/root/repo/grammar/grammar.ypp"
+                                          { yylhs.value = add_node("expression", 3, yystack_[2].value, yystack_[1].value, yystack_[0].value);}
+#line 978 "Parser.cpp"
+    break;
+
+  case 59: // expression: relation
+#line 203 "/root/repo/grammar/grammar.ypp"
+               { yylhs.value = add_node("expression", 1, yystack_[0].value);}
+#line 984 "Parser.cpp"
+    break;
+
+  case 60: // logic_operation: AND
+#line 207 "/root/repo/grammar/grammar.ypp"
+          { yylhs.value = yystack_[0].value;}
+#line 990 "Parser.cpp"
+    break;
+
+  case 61: // logic_operation: OR
+#line 208 "/root/repo/grammar/grammar.ypp"
+         { yylhs.value = yystack_[0].value;}
+#line 996 "Parser.cpp"
+    break;
+
+  case 62: // logic_operation: XOR
+#line 209 "/root/repo/grammar/grammar.ypp"
+          { yylhs.value = yystack_[0].value;}
+#line 1002 "Parser.cpp"
+    break;
+
+  case 63: // relation: simple
+#line 213 "/root/repo/grammar/grammar.ypp"
+             { yylhs.value = add_node("relation", 1, yystack_[0].value);}
+#line 1008 "Parser.cpp"
+    break;
+
+  case 64: // relation: simple compare_sign simple
+#line 214 "/root/repo/grammar/grammar.ypp"
+                                 { yylhs.value = add_node("relation", 3, yystack_[2].value, yystack_[1].value, yystack_[0].value);}
+#line 1014 "Parser.cpp"
+    break;
+
+  case 65: // compare_sign: LT_SIGN
+#line 218 "/root/repo/grammar/grammar.ypp"
+              { yylhs.value = yystack_[0].value;}
+#line 1020 "Parser.cpp"
+    break;
+
+  case 66: // compare_sign: LET_SIGN
+#line 219 "/root/repo/grammar/grammar.ypp"
+               { yylhs.value = yystack_[0].value;}
+#line 1026 "Parser.cpp"
+    break;
+
+  case 67: // compare_sign: GT_SIGN
+#line 220 "/root/repo/grammar/grammar.ypp"
+              { yylhs.value = yystack_[0].value;}
+#line 1032 "Parser.cpp"
+    break;
+
+  case 68: // compare_sign: GET_SIGN
+#line 221 "/root/repo/grammar/grammar.ypp"
+               { yylhs.value = yystack_[0].value;}
+#line 1038 "Parser.cpp"
+    break;
+
+  case 69: // compare_sign: EQ_SIGN
+#line 222 "/root/repo/grammar/grammar.ypp"
+              { yylhs.value = yystack_[0].value;}
+#line 1044 "Parser.cpp"
+    break;
+
+  case 70: // compare_sign: NEQ_SIGN
+#line 223 "/root/repo/grammar/grammar.ypp"
+               { yylhs.value = yystack_[0].value;}
+#line 1050 "Parser.cpp"
+    break;
+
+  case 71: // simple: simple mult_sign_f factor
+#line 227 "/root/repo/grammar/grammar.ypp"
+                                { yylhs.value = add_node("simple", 3, yystack_[2].value, yystack_[1].value, yystack_[0].value);}
+#line 1056 "Parser.cpp"
+    break;
+
+  case 72: // simple: factor
+#line 228 "/root/repo/grammar/grammar.ypp"
+             { yylhs.value = add_node("simple", 1, yystack_[0].value);}
+#line 1062 "Parser.cpp"
+    break;
+
+  case 73: // mult_sign_f: MULT_SIGN
+#line 232 "/root/repo/grammar/grammar.ypp"
+                { yylhs.value = yystack_[0].value;}
+#line 1068 "Parser.cpp"
+    break;
+
+  case 74: // mult_sign_f: DIV_SIGN
+#line 233 "/root/repo/grammar/grammar.ypp"
+               { yylhs.value = yystack_[0].value;}
+#line 1074 "Parser.cpp"
+    break;
+
+  case 75: // mult_sign_f: MOD_SIGN
+#line 234 "/root/repo/grammar/grammar.ypp"
+               { yylhs.value = yystack_[0].value;}
+#line 1080 "Parser.cpp"
+    break;
+
+  case 76: // factor: factor mult_sign_s summand
+#line 238 "/root/repo/grammar/grammar.ypp"
+                                 { yylhs.value = add_node("factor", 3, yystack_[2].value, yystack_[1].value, yystack_[0].value);}
+#line 1086 "Parser.cpp"
+    break;
+
+  case 77: // factor: summand
+#line 239 "/root/repo/grammar/grammar.ypp"
+              { yylhs.value = add_node("factor", 1, yystack_[0].value);}
+#line 1092 "Parser.cpp"
+    break;
+
+  case 78: // factor: mult_sign_s summand
+#line 240 "/root/repo/grammar/grammar.ypp"
+                          { yylhs.value = add_node("unary_factor", 2, yystack_[1].value, yystack_[0].value);}
+#line 1098 "Parser.cpp"
+    break;
+
+  case 79: // factor: NOT summand
+#line 241 "/root/repo/grammar/grammar.ypp"
+                  { yylhs.value = add_node("not_factor", 2, yystack_[1].value, yystack_[0].value);}
+#line 1104 "Parser.cpp"
+    break;
+
+  case 80: // mult_sign_s: PLUS_SIGN
+#line 245 "/root/repo/grammar/grammar.ypp"
+                { yylhs.value = yystack_[0].value;}
+#line 1110 "Parser.cpp"
+    break;
+
+  case 81: // mult_sign_s: MINUS_SIGN
+#line 246 "/root/repo/grammar/grammar.ypp"
+                 { yylhs.value = yystack_[0].value;}
+#line 1116 "Parser.cpp"
+    break;
+
+  case 82: // summand: primary
+#line 250 "/root/repo/grammar/grammar.ypp"
+              { yylhs.value = add_node("summand", 1, yystack_[0].value);}
+#line 1122 "Parser.cpp"
+    break;
+
+  case 83: // summand: L_BR expression R_BR
+#line 251 "/root/repo/grammar/grammar.ypp"
+                           { yylhs.value = add_node("summand", 1, yystack_[1].value);}
+#line 1128 "Parser.cpp"
+    break;
+
+  case 84: // primary: TRUE
+#line 256 "/root/repo/grammar/grammar.ypp"
+           { yylhs.value = add_node("boolean", 1, yystack_[0].value);}
+#line 1134 "Parser.cpp"
+    break;
+
+  case 85: // primary: FALSE
+#line 257 "/root/repo/grammar/grammar.ypp"
+            { yylhs.value = add_node("boolean", 1, yystack_[0].value);}
+#line 1140 "Parser.cpp"
+    break;
+
+  case 86: // primary: REAL_LITERAL
+#line 258 "/root/repo/grammar/grammar.ypp"
+                   { yylhs.value = add_node("real", 1, yystack_[0].value);}
+#line 1146 "Parser.cpp"
+    break;
+
+  case 87: // primary: INTEGER_LITERAL
+#line 259 "/root/repo/grammar/grammar.ypp"
+                      { yylhs.value = add_node("integer", 1, yystack_[0].value);}
+#line 1152 "Parser.cpp"
+    break;
+
+  case 88: // primary: modifiable_primary
+#line 260 "/root/repo/grammar/grammar.ypp"
+                         { yylhs.value = yystack_[0].value;}
+#line 1158 "Parser.cpp"
+    break;
+
+  case 89: // primary: routine_call
+#line 261 "/root/repo/grammar/grammar.ypp"
+                   { yylhs.value = yystack_[0].value;}
+#line 1164 "Parser.cpp"
+    break;
+
+  case 90: // modifiable_primary: IDENTIFIER
+#line 265 "/root/repo/grammar/grammar.ypp"
+                 { yylhs.value = add_node("modifiable_primary", 1, yystack_[0].value);}
+#line 1170 "Parser.cpp"
+    break;
+
+  case 91: // modifiable_primary: modifiable_primary L_SQ_BR expression R_SQ_BR
+#line 266 "/root/repo/grammar/grammar.ypp"
+                                                    { yylhs.value = add_node("modifiable_primary_array", 2, yystack_[3].value, yystack_[1].value);}
+#line 1176 "Parser.cpp"
+    break;
+
+  case 92: // modifiable_primary: modifiable_primary DOT modifiable_primary
+#line 267 "/root/repo/grammar/grammar.ypp"
+                                                { yylhs.value = add_node("modifiable_primary_field", 2, yystack_[2].value, yystack_[0].value);}
+#line 1182 "Parser.cpp"
+    break;
+
+
+#line 1186 "Parser.cpp"
+
+            default:
+              break;
+            }
+        }
+#if YY_EXCEPTIONS
+      catch (const syntax_error& yyexc)
+        {
+          YYCDEBUG << "Caught exception: " << yyexc.what() << '\n';
+          error (yyexc);
+          YYERROR;
+        }
+#endif // YY_EXCEPTIONS
+      YY_SYMBOL_PRINT ("-> $$ =", yylhs);
+      yypop_ (yylen);
+      yylen = 0;
+
+      // Shift the result of the reduction.
+      yypush_ (YY_NULLPTR, YY_MOVE (yylhs));
+    }
+    goto yynewstate;
+
+
+  /*--------------------------------------.
+  | yyerrlab -- here on detecting error.  |
+  `--------------------------------------*/
+  yyerrlab:
+    // If not already recovering from an error, report this error.
+    if (!yyerrstatus_)
+      {
+        ++yynerrs_;
+        context yyctx (*this, yyla);
+        std::string msg = yysyntax_error_ (yyctx);
+        error (yyla.location, YY_MOVE (msg));
+      }
+
+
+    yyerror_range[1].location = yyla.location;
+    if (yyerrstatus_ == 3)
+      {
+        /* If just tried and failed to reuse lookahead token after an
+           error, discard it.  */
+
+        // Return failure if at end of input.
+        if (yyla.kind () == symbol_kind::S_YYEOF)
+          YYABORT;
+        else if (!yyla.empty ())
+          {
+            yy_destroy_ ("Error: discarding", yyla);
+            yyla.clear ();
+          }
+      }
+
+    // Else will try to reuse lookahead token after shifting the error token.
+    goto yyerrlab1;
+
+
+  /*---------------------------------------------------.
+  | yyerrorlab -- error raised explicitly by YYERROR.  |
+  `---------------------------------------------------*/
+  yyerrorlab:
+    /* Pacify compilers when the user code never invokes YYERROR and
+       the label yyerrorlab therefore never appears in user code.  */
+    if (false)
+      YYERROR;
+
+    /* Do not reclaim the symbols of the rule whose action triggered
+       this YYERROR.  */
+    yypop_ (yylen);
+    yylen = 0;
+    YY_STACK_PRINT ();
+    goto yyerrlab1;
+
+
+  /*-------------------------------------------------------------.
+  | yyerrlab1 -- common code for both syntax error and YYERROR.  |
+  `-------------------------------------------------------------*/
+  yyerrlab1:
+    yyerrstatus_ = 3;   // Each real token shifted decrements this.
+    // Pop stack until we find a state that shifts the error token.
+    for (;;)
+      {
+        yyn = yypact_[+yystack_[0].state];
+        if (!yy_pact_value_is_default_ (yyn))
+          {
+            yyn += symbol_kind::S_YYerror;
+            if (0 <= yyn && yyn <= yylast_
+                && yycheck_[yyn] == symbol_kind::S_YYerror)
+              {
+                yyn = yytable_[yyn];
+                if (0 < yyn)
+                  break;
+              }
+          }
+
+        // Pop the current state because it cannot handle the error token.
+        if (yystack_.size () == 1)
+          YYABORT;
+
+        yyerror_range[1].location = yystack_[0].location;
+        yy_destroy_ ("Error: popping", yystack_[0]);
+        yypop_ ();
+        YY_STACK_PRINT ();
+      }
+    {
+      stack_symbol_type error_token;
+
+      yyerror_range[2].location = yyla.location;
+      YYLLOC_DEFAULT (error_token.location, yyerror_range, 2);
+
+      // Shift the error token.
+      error_token.state = state_type (yyn);
+      yypush_ ("Shifting", YY_MOVE (error_token));
+    }
+    goto yynewstate;
+
+
+  /*-------------------------------------.
+  | yyacceptlab -- YYACCEPT comes here.  |
+  `-------------------------------------*/
+  yyacceptlab:
+    yyresult = 0;
+    goto yyreturn;
+
+
+  /*-----------------------------------.
+  | yyabortlab -- YYABORT comes here.  |
+  `-----------------------------------*/
+  yyabortlab:
+    yyresult = 1;
+    goto yyreturn;
+
+
+  /*-----------------------------------------------------.
+  | yyreturn -- parsing is finished, return the result.  |
+  `-----------------------------------------------------*/
+  yyreturn:
+    if (!yyla.empty ())
+      yy_destroy_ ("Cleanup: discarding lookahead", yyla);
+
+    /* Do not reclaim the symbols of the rule whose action triggered
+       this YYABORT or YYACCEPT.  */
+    yypop_ (yylen);
+    YY_STACK_PRINT ();
+    while (1 < yystack_.size ())
+      {
+        yy_destroy_ ("Cleanup: popping", yystack_[0]);
+        yypop_ ();
+      }
+
+    return yyresult;
+  }
+#if YY_EXCEPTIONS
+    catch (...)
+      {
+        YYCDEBUG << "Exception caught: cleaning lookahead and stack\n";
+        // Do not try to display the values of the reclaimed symbols,
+        // as their printers might throw an exception.
+        if (!yyla.empty ())
+          yy_destroy_ (YY_NULLPTR, yyla);
+
+        while (1 < yystack_.size ())
+          {
+            yy_destroy_ (YY_NULLPTR, yystack_[0]);
+            yypop_ ();
+          }
+        throw;
+      }
+#endif // YY_EXCEPTIONS
+  }
+
+  void
+  parser::error (const syntax_error& yyexc)
+  {
+    error (yyexc.location, yyexc.what ());
+  }
+
+  /* Return YYSTR after stripping away unnecessary quotes and
+     backslashes, so that it's suitable for yyerror.  The heuristic is
+     that double-quoting is unnecessary unless the string contains an
+     apostrophe, a comma, or backslash (other than backslash-backslash).
+     YYSTR is taken from yytname.  */
+  std::string
+  parser::yytnamerr_ (const char *yystr)
+  {
+    if (*yystr == '"')
+      {
+        std::string yyr;
+        char const *yyp = yystr;
+
+        for (;;)
+          switch (*++yyp)
+            {
+            case '\'':
+            case ',':
+              goto do_not_strip_quotes;
+
+            case '\\':
+              if (*++yyp != '\\')
+                goto do_not_strip_quotes;
+              else
+                goto append;
+
+            append:
+            default:
+              yyr += *yyp;
+              break;
+
+            case '"':
+              return yyr;
+            }
+      do_not_strip_quotes: ;
+      }
+
+    return yystr;
+  }
+
+  std::string
+  parser::symbol_name (symbol_kind_type yysymbol)
+  {
+    return yytnamerr_ (yytname_[yysymbol]);
+  }
+
+
+
+  // parser::context.
+  parser::context::context (const parser& yyparser, const symbol_type& yyla)
+    : yyparser_ (yyparser)
+    , yyla_ (yyla)
+  {}
+
+  int
+  parser::context::expected_tokens (symbol_kind_type yyarg[], int yyargn) const
+  {
+    // Actual number of expected tokens
+    int yycount = 0;
+
+    const int yyn = yypact_[+yyparser_.yystack_[0].state];
+    if (!yy_pact_value_is_default_ (yyn))
+      {
+        /* Start YYX at -YYN if negative to avoid negative indexes in
+           YYCHECK.  In other words, skip the first -YYN actions for
+           this state because they are default actions.  */
+        const int yyxbegin = yyn < 0 ? -yyn : 0;
+        // Stay within bounds of both yycheck and yytname.
+        const int yychecklim = yylast_ - yyn + 1;
+        const int yyxend = yychecklim < YYNTOKENS ? yychecklim : YYNTOKENS;
+        for (int yyx = yyxbegin; yyx < yyxend; ++yyx)
+          if (yycheck_[yyx + yyn] == yyx && yyx != symbol_kind::S_YYerror
+              && !yy_table_value_is_error_ (yytable_[yyx + yyn]))
+            {
+              if (!yyarg)
+                ++yycount;
+              else if (yycount == yyargn)
+                return 0;
+              else
+                yyarg[yycount++] = YY_CAST (symbol_kind_type, yyx);
+            }
+      }
+
+    if (yyarg && yycount == 0 && 0 < yyargn)
+      yyarg[0] = symbol_kind::S_YYEMPTY;
+    return yycount;
+  }
+
+
+
+
+
+
+  int
+  parser::yy_syntax_error_arguments_ (const context& yyctx,
+                                                 symbol_kind_type yyarg[], int yyargn) const
+  {
+    /* There are many possibilities here to consider:
+       - If this state is a consistent state with a default action, then
+         the only way this function was invoked is if the default action
+         is an error action.  In that case, don't check for expected
+         tokens because there are none.
+       - The only way there can be no lookahead present (in yyla) is
+         if this state is a consistent state with a default action.
+         Thus, detecting the absence of a lookahead is sufficient to
+         determine that there is no unexpected or expected token to
+         report.  In that case, just report a simple "syntax error".
+       - Don't assume there isn't a lookahead just because this state is
+         a consistent state with a default action.  There might have
+         been a previous inconsistent state, consistent state with a
+         non-default action, or user semantic action that manipulated
+         yyla.  (However, yyla is currently not documented for users.)
+       - Of course, the expected token list depends on states to have
+         correct lookahead information, and it depends on the parser not
+         to perform extra reductions after fetching a lookahead from the
+         scanner and before detecting a syntax error.  Thus, state merging
+         (from LALR or IELR) and default reductions corrupt the expected
+         token list.  However, the list is correct for canonical LR with
+         one exception: it will still contain any token that will not be
+         accepted due to an error action in a later state.
+    */
+
+    if (!yyctx.lookahead ().empty ())
+      {
+        if (yyarg)
+          yyarg[0] = yyctx.token ();
+        int yyn = yyctx.expected_tokens (yyarg ? yyarg + 1 : yyarg, yyargn - 1);
+        return yyn + 1;
+      }
+    return 0;
+  }
+
+  // Generate an error message.
+  std::string
+  parser::yysyntax_error_ (const context& yyctx) const
+  {
+    // Its maximum.
+    enum { YYARGS_MAX = 5 };
+    // Arguments of yyformat.
+    symbol_kind_type yyarg[YYARGS_MAX];
+    int yycount = yy_syntax_error_arguments_ (yyctx, yyarg, YYARGS_MAX);
+
+    char const* yyformat = YY_NULLPTR;
+    switch (yycount)
+      {
+#define YYCASE_(N, S)                         \
+        case N:                               \
+          yyformat = S;                       \
+        break
+      default: // Avoid compiler warnings.
+        YYCASE_ (0, YY_("syntax error"));
+        YYCASE_ (1, YY_("syntax error, unexpected %s"));
+        YYCASE_ (2, YY_("syntax error, unexpected %s, expecting %s"));
+        YYCASE_ (3, YY_("syntax error, unexpected %s, expecting %s or %s"));
+        YYCASE_ (4, YY_("syntax error, unexpected %s, expecting %s or %s or %s"));
+        YYCASE_ (5, YY_("syntax error, unexpected %s, expecting %s or %s or %s or %s"));
+#undef YYCASE_
+      }
+
+    std::string yyres;
+    // Argument number.
+    std::ptrdiff_t yyi = 0;
+    for (char const* yyp = yyformat; *yyp; ++yyp)
+      if (yyp[0] == '%' && yyp[1] == 's' && yyi < yycount)
+        {
+          yyres += symbol_name (yyarg[yyi++]);
+          ++yyp;
+        }
+      else
+        yyres += *yyp;
+    return yyres;
+  }
+
+
+  const signed char parser::yypact_ninf_ = -69;
+
+  const signed char parser::yytable_ninf_ = -1;
+
+  const short
+  parser::yypact_[] =
+  {
+     -69,   159,   -69,    15,    26,    40,   -69,   -69,   -69,   -69,
+       0,    -3,    48,    86,   174,    49,   174,    25,   111,   -69,
+     -69,   -69,   -69,   -69,   -69,    86,   -69,    36,   -69,   144,
+      27,   111,   -69,   -69,   -15,   -69,   -69,   -69,   -69,    65,
+      31,    75,   -69,   -69,   -69,    38,    37,    41,   -69,   -69,
+      86,   -69,   -12,   -69,   -69,   -69,    86,   -69,   -69,   -69,
+     -69,   -69,   -69,   -69,   -69,   -69,    86,    86,   111,   -69,
+      86,    97,    65,   108,    86,    86,   -69,   181,    60,    49,
+      69,    70,    36,   -69,   -69,    64,    27,   -69,     6,   -69,
+      -5,   -69,   -69,   109,    36,   -69,   -69,   174,   117,   -69,
+     -69,    86,   -69,   174,   -69,   -69,    36,   -69,     3,   -69,
+      86,   115,    86,   102,   -69,   -69,   -69,   -69,   -69,   -69,
+     -69,   -69,    -7,    -9,   116,   171,   -69,    36,    86,   -69,
+     112,   121,   -69,    36,    20,   -69,    86,   -69,    51,   -69,
+      81,    74,   -69,   139,    86,   -69,    94,   -69,    36
+  };
+
+  const signed char
+  parser::yydefact_[] =
+  {
+       2,     0,     1,     0,     0,     0,     3,     5,     6,     4,
+       0,     0,     0,     0,     0,    15,     0,    90,     0,    80,
+      81,    84,    85,    86,    87,     0,    89,     8,    59,    63,
+      72,     0,    77,    82,    88,    24,    25,    26,    27,    30,
+       0,     9,    21,    23,    22,     0,     0,    16,    18,    11,
+      46,    79,     0,    60,    61,    62,     0,    65,    66,    67,
+      68,    69,    70,    73,    74,    75,     0,     0,     0,    78,
+       0,     0,    30,     0,     0,     0,     7,     0,    13,     0,
+       0,    47,    49,    83,    58,    64,    71,    76,     0,    90,
+      92,    29,    28,     0,    10,    19,    20,     0,     0,    17,
+      45,     0,    91,     0,    14,    32,    48,    31,     0,    12,
+       0,     0,     0,    42,    33,    34,    40,    35,    36,    37,
+      38,    39,     0,     0,     0,     0,    41,    43,     0,    32,
+      53,     0,    32,    44,     0,    54,     0,    32,    56,    50,
+       0,     0,    32,     0,     0,    51,    57,    55,    52
+  };
+
+  const short
+  parser::yypgoto_[] =
+  {
+     -69,   -69,   145,   -19,   -69,   -69,   -69,   -69,   -69,   -69,
+      68,   -14,    72,   -69,    83,   -69,    29,   -69,   -69,   -69,
+     -69,    22,   -69,   -69,   -69,   -69,   -69,   -69,   -69,   -69,
+     -25,   -69,   113,   -69,    99,   -69,   103,   -29,   -13,   -69,
+     -68
+  };
+
+  const unsigned char
+  parser::yydefgoto_[] =
+  {
+       0,     1,   114,     7,    76,     8,     9,    98,    46,    47,
+      48,    41,    42,    43,    73,    44,   108,   115,   116,   126,
+     117,    26,    80,    81,   119,   120,   131,   136,   121,   143,
+      27,    56,    28,    66,    29,    67,    30,    31,    32,    33,
+      34
+  };
+
+  const unsigned char
+  parser::yytable_[] =
+  {
+      52,    68,    49,    90,    13,    51,     3,   128,   129,   109,
+      17,     5,    53,    54,    55,    53,    54,    55,    69,   110,
+      72,   111,    10,     3,   112,    82,   139,    17,     5,    70,
+      53,    54,    55,    11,    71,    83,   110,    70,   111,    70,
+     122,   112,    71,    15,    71,    88,   113,    12,    14,    93,
+      94,   102,    16,    72,     3,    87,    45,    68,    17,     5,
+      53,    54,    55,   113,    19,    20,   122,   110,     3,   111,
+     122,    50,   112,   122,   142,    74,   106,     3,   122,    75,
+     145,    17,     5,   104,    78,   123,    77,   125,   127,   107,
+     110,    79,   111,    17,   113,   112,   144,     3,    63,    64,
+      65,    17,     5,   133,    89,    53,    54,    55,    97,    17,
+     110,   140,   111,    18,    92,   112,   100,   113,    17,   148,
+     101,   105,   124,    19,    20,    21,    22,    23,    24,    18,
+     118,   135,    25,    53,    54,    55,   130,   113,   137,    19,
+      20,    21,    22,    23,    24,   147,     6,    99,    25,    96,
+      21,    22,    23,    24,   103,    91,   118,    25,   134,     2,
+     118,   138,     3,   118,     4,    85,   141,     5,   118,    84,
+      86,   146,    57,    58,    59,    60,    61,    62,    63,    64,
+      65,    35,     0,    36,    37,    38,    39,    40,    95,     0,
+      36,    37,    38,   132,     0,    53,    54,    55
+  };
+
+  const short
+  parser::yycheck_[] =
+  {
+      25,    30,    16,    71,     4,    18,     3,    14,    17,     6,
+       7,     8,    24,    25,    26,    24,    25,    26,    31,    16,
+      39,    18,     7,     3,    21,    50,     6,     7,     8,    44,
+      24,    25,    26,     7,    49,    47,    16,    44,    18,    44,
+     108,    21,    49,    46,    49,    70,    43,     7,    48,    74,
+      75,    45,     4,    72,     3,    68,     7,    86,     7,     8,
+      24,    25,    26,    43,    37,    38,   134,    16,     3,    18,
+     138,    46,    21,   141,    23,    44,   101,     3,   146,     4,
+       6,     7,     8,    97,    47,   110,    48,   112,   113,   103,
+      16,    50,    18,     7,    43,    21,    15,     3,    34,    35,
+      36,     7,     8,   128,     7,    24,    25,    26,    48,     7,
+      16,   136,    18,    27,     6,    21,    47,    43,     7,   144,
+      50,     4,     7,    37,    38,    39,    40,    41,    42,    27,
+     108,    19,    46,    24,    25,    26,    20,    43,    17,    37,
+      38,    39,    40,    41,    42,     6,     1,    79,    46,    77,
+      39,    40,    41,    42,    45,    72,   134,    46,   129,     0,
+     138,   132,     3,   141,     5,    66,   137,     8,   146,    56,
+      67,   142,    28,    29,    30,    31,    32,    33,    34,    35,
+      36,     7,    -1,     9,    10,    11,    12,    13,     7,    -1,
+       9,    10,    11,    22,    -1,    24,    25,    26
+  };
+
+  const signed char
+  parser::yystos_[] =
+  {
+       0,    52,     0,     3,     5,     8,    53,    54,    56,    57,
+       7,     7,     7,     4,    48,    46,     4,     7,    27,    37,
+      38,    39,    40,    41,    42,    46,    72,    81,    83,    85,
+      87,    88,    89,    90,    91,     7,     9,    10,    11,    12,
+      13,    62,    63,    64,    66,     7,    59,    60,    61,    62,
+      46,    89,    81,    24,    25,    26,    82,    28,    29,    30,
+      31,    32,    33,    34,    35,    36,    84,    86,    88,    89,
+      44,    49,    54,    65,    44,     4,    55,    48,    47,    50,
+      73,    74,    81,    47,    83,    85,    87,    89,    81,     7,
+      91,    65,     6,    81,    81,     7,    63,    48,    58,    61,
+      47,    50,    45,    45,    62,     4,    81,    62,    67,     6,
+      16,    18,    21,    43,    53,    68,    69,    71,    72,    75,
+      76,    79,    91,    81,     7,    81,    70,    81,    14,    17,
+      20,    77,    22,    81,    67,    19,    78,    17,    67,     6,
+      81,    67,    23,    80,    15,     6,    67,     6,    81
+  };
+
+  const signed char
+  parser::yyr1_[] =
+  {
+       0,    51,    52,    52,    52,    53,    53,    54,    54,    55,
+      55,    56,    57,    58,    58,    59,    59,    60,    60,    61,
+      61,    62,    62,    62,    62,    63,    63,    63,    64,    65,
+      65,    66,    67,    67,    67,    68,    68,    68,    68,    68,
+      68,    69,    70,    70,    71,    72,    73,    73,    74,    74,
+      75,    76,    77,    78,    78,    79,    80,    80,    81,    81,
+      82,    82,    82,    83,    83,    84,    84,    84,    84,    84,
+      84,    85,    85,    86,    86,    86,    87,    87,    87,    87,
+      88,    88,    89,    89,    90,    90,    90,    90,    90,    90,
+      91,    91,    91
+  };
+
+  const signed char
+  parser::yyr2_[] =
+  {
+       0,     2,     0,     2,     2,     1,     1,     5,     4,     0,
+       2,     4,     9,     0,     2,     0,     1,     3,     1,     3,
+       3,     1,     1,     1,     1,     1,     1,     1,     3,     2,
+       0,     5,     0,     2,     2,     1,     1,     1,     1,     1,
+       1,     2,     0,     1,     3,     4,     0,     1,     3,     1,
+       5,     6,     5,     0,     1,     6,     0,     2,     3,     1,
+       1,     1,     1,     1,     3,     1,     1,     1,     1,     1,
+       1,     3,     1,     1,     1,     1,     3,     1,     2,     2,
+       1,     1,     1,     3,     1,     1,     1,     1,     1,     1,
+       1,     4,     3
+  };
+
+
+#if YYDEBUG || 1
+  // YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
+  // First, the terminals, then, starting at \a YYNTOKENS, nonterminals.
+  const char*
+  const parser::yytname_[] =
+  {
+  "\"end of file\"", "error", "\"invalid token\"", "VAR", "IS", "ROUTINE",
+  "END", "IDENTIFIER", "TYPE", "INTEGER", "REAL", "BOOLEAN", "RECORD",
+  "ARRAY", "ASSIGNMENT_SIGN", "RANGE_SIGN", "WHILE", "LOOP", "FOR",
+  "REVERSE", "IN", "IF", "THEN", "ELSE", "AND", "OR", "XOR", "NOT",
+  "LT_SIGN", "LET_SIGN", "GT_SIGN", "GET_SIGN", "EQ_SIGN", "NEQ_SIGN",
+  "MULT_SIGN", "DIV_SIGN", "MOD_SIGN", "PLUS_SIGN", "MINUS_SIGN", "TRUE",
+  "FALSE", "REAL_LITERAL", "INTEGER_LITERAL", "RETURN", "L_SQ_BR",
+  "R_SQ_BR", "L_BR", "R_BR", "COLON", "DOT", "COMMA", "$accept", "program",
+  "simple_declaration", "variable_declaration", "variable_expression",
+  "type_declaration", "routine_declaration", "routine_return_type",
+  "routine_parameters", "parameters", "parameter_declaration", "type",
+  "primitive_type", "record_type", "variables_declaration", "array_type",
+  "body", "statement", "return", "return_value", "assignment",
+  "routine_call", "arguments", "expressions", "while_loop", "for_loop",
+  "range", "reverse", "if_statement", "else_body", "expression",
+  "logic_operation", "relation", "compare_sign", "simple", "mult_sign_f",
+  "factor", "mult_sign_s", "summand", "primary", "modifiable_primary", YY_NULLPTR
+  };
+#endif
+
+
+#if YYDEBUG
+  const short
+  parser::yyrline_[] =
+  {
+       0,    58,    58,    59,    60,    64,    65,    69,    70,    74,
+      75,    79,    83,    87,    88,    92,    93,    97,    98,   103,
+     104,   108,   109,   110,   111,   115,   116,   117,   121,   125,
+     126,   130,   134,   135,   136,   140,   141,   142,   143,   144,
+     145,   149,   153,   154,   158,   162,   166,   167,   171,   172,
+     176,   180,   184,   188,   189,   193,   197,   198,   202,   203,
+     207,   208,   209,   213,   214,   218,   219,   220,   221,   222,
+     223,   227,   228,   232,   233,   234,   238,   239,   240,   241,
+     245,   246,   250,   251,   256,   257,   258,   259,   260,   261,
+     265,   266,   267
+  };
+
+  void
+  parser::yy_stack_print_ () const
+  {
+    *yycdebug_ << "Stack now";
+    for (stack_type::const_iterator
+           i = yystack_.begin (),
+           i_end = yystack_.end ();
+         i != i_end; ++i)
+      *yycdebug_ << ' ' << int (i->state);
+    *yycdebug_ << '\n';
+  }
+
+  void
+  parser::yy_reduce_print_ (int yyrule) const
+  {
+    int yylno = yyrline_[yyrule];
+    int yynrhs = yyr2_[yyrule];
+    // Print the symbols being reduced, and their result.
+    *yycdebug_ << "Reducing stack by rule " << yyrule - 1
+               << " (line " << yylno << "):\n";
+    // The symbols being reduced.
+    for (int yyi = 0; yyi < yynrhs; yyi++)
+      YY_SYMBOL_PRINT ("   $" << yyi + 1 << " =",
+                       yystack_[(yynrhs) - (yyi + 1)]);
+  }
+#endif // YYDEBUG
+
+  parser::symbol_kind_type
+  parser::yytranslate_ (int t) YY_NOEXCEPT
+  {
+    // YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to
+    // TOKEN-NUM as returned by yylex.
+    static
+    const signed char
+    translate_table[] =
+    {
+       0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
+       5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
+      15,    16,    17,    18,    19,    20,    21,    22,    23,    24,
+      25,    26,    27,    28,    29,    30,    31,    32,    33,    34,
+      35,    36,    37,    38,    39,    40,    41,    42,    43,    44,
+      45,    46,    47,    48,    49,    50
+    };
+    // Last valid token kind.
+    const int code_max = 305;
+
+    if (t <= 0)
+      return symbol_kind::S_YYEOF;
+    else if (t <= code_max)
+      return static_cast <symbol_kind_type> (translate_table[t]);
+    else
+      return symbol_kind::S_YYUNDEF;
+  }
+
+} // yy
+#line 1826 "Parser.cpp"
+
+#line 269 "/root/repo/grammar/grammar.ypp"
+
+
+void clear_node(CNode * node){
+	if (node == nullptr) return;
+
+	for (int i = 0; i < node->children.size(); i++) {
+        	clear_node(node->children[i]);
+        }
+
+	delete node;
+}
+
+void yy::parser::error (const location& loc, const std::string& msg){
+    clear_node((CNode*)(*root));
+    *root = nullptr;
+    fflush(stdout);
+    printf("\n%*s\n%*s\n", ((Lexer*)lexer)->column, "^", ((Lexer*)lexer)->column, msg.c_str());
+}
+int yy::yylex (YYSTYPE *lvalp, location *llocp, void* lexer){
+    if (lexer == nullptr) return 0;
+    Lexer* lexer1 = (Lexer*) lexer;
+    Token currentToken = lexer1->next();
+    int tokenType = currentToken.class_name;
+    if (tokenType == 0) {return 0;}
+    *lvalp = new CNode(currentToken.value);
+    return tokenType;
+}
+
+CNode* add_node(const std::string& name, int argc, ...) {
+	va_list argp;
+  CNode* newNode = new CNode(name);
+
+  va_start(argp, argc);
+  for (int i = 0; i < argc; i++)
+        newNode->children.push_back(va_arg(argp, CNode*));
+  va_end(argp);
+
+  return newNode;
+}
+
+void pick_up_children(CNode* parent, CNode* bad_parent){
+	if (parent == nullptr || bad_parent == nullptr) return;
+	for (int i = 0; i < bad_parent->children.size(); i++) {
+		parent->children.push_back(bad_parent->children[i]);
+	}
+	delete bad_parent;
+}
+
+void add_child(CNode* parent, CNode* child){
+    if (parent == nullptr || child == nullptr) return;
+    parent->children.push_back(child);
+}
@@ -0,0 +1,371 @@
+#include "ir/Passes.hpp"
+#include <cmath>
+#include <set>
+
+namespace {
+
+// value of an instruction as far as the propagation knows: not yet seen
+// to have any value, one constant, or possibly several values
+struct Cell {
+  enum State { Unknown, Constant, Varying };
+  State state = Unknown;
+  int64_t bits = 0;
+};
+
+double toReal(int64_t bits) {
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+int64_t toBits(double value) {
+  int64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+int64_t wrap(uint64_t value) { return (int64_t)value; }
+
+// the value the operation computes from constant operands, as the virtual
+// machines would; false when it fails or depends on more than its operands
+bool fold(SsaOpcode opcode, const std::vector<int64_t> &operands,
+          int64_t &result) {
+  int64_t l = operands.empty() ? 0 : operands[0];
+  int64_t r = operands.size() < 2 ? 0 : operands[1];
+  double x = toReal(l), y = toReal(r);
+  switch (opcode) {
+  case SsaOpcode::AddInt:
+    result = wrap((uint64_t)l + (uint64_t)r);
+    return true;
+  case SsaOpcode::SubInt:
+    result = wrap((uint64_t)l - (uint64_t)r);
+    return true;
+  case SsaOpcode::MulInt:
+    result = wrap((uint64_t)l * (uint64_t)r);
+    return true;
+  case SsaOpcode::DivInt:
+  case SsaOpcode::ModInt:
+    if (r == 0)
+      return false;
+    if (r == -1)
+      result = opcode == SsaOpcode::DivInt ? wrap(0 - (uint64_t)l) : 0;
+    else
+      result = opcode == SsaOpcode::DivInt ? l / r : l % r;
+    return true;
+  case SsaOpcode::AddReal:
+    result = toBits(x + y);
+    return true;
+  case SsaOpcode::SubReal:
+    result = toBits(x - y);
+    return true;
+  case SsaOpcode::MulReal:
+    result = toBits(x * y);
+    return true;
+  case SsaOpcode::DivReal:
+    if (y == 0)
+      return false;
+    result = toBits(x / y);
+    return true;
+  case SsaOpcode::NegInt:
+    result = wrap(0 - (uint64_t)l);
+    return true;
+  case SsaOpcode::NegReal:
+    result = toBits(-x);
+    return true;
+  case SsaOpcode::LessInt:
+    result = l < r;
+    return true;
+  case SsaOpcode::LessEqInt:
+    result = l <= r;
+    return true;
+  case SsaOpcode::GreaterInt:
+    result = l > r;
+    return true;
+  case SsaOpcode::GreaterEqInt:
+    result = l >= r;
+    return true;
+  case SsaOpcode::EqualInt:
+    result = l == r;
+    return true;
+  case SsaOpcode::NotEqualInt:
+    result = l != r;
+    return true;
+  case SsaOpcode::LessReal:
+    result = x < y;
+    return true;
+  case SsaOpcode::LessEqReal:
+    result = x <= y;
+    return true;
+  case SsaOpcode::GreaterReal:
+    result = x > y;
+    return true;
+  case SsaOpcode::GreaterEqReal:
+    result = x >= y;
+    return true;
+  case SsaOpcode::EqualReal:
+    result = x == y;
+    return true;
+  case SsaOpcode::NotEqualReal:
+    result = x != y;
+    return true;
+  case SsaOpcode::And:
+    result = l & r;
+    return true;
+  case SsaOpcode::Or:
+    result = l | r;
+    return true;
+  case SsaOpcode::Xor:
+    result = l ^ r;
+    return true;
+  case SsaOpcode::Not:
+    result = l ^ 1;
+    return true;
+  case SsaOpcode::IntToReal:
+    result = toBits((double)l);
+    return true;
+  case SsaOpcode::RealToInt:
+    if (!(std::fabs(x) < 9.2e18))
+      return false;
+    result = std::llround(x);
+    return true;
+  case SsaOpcode::IntToBool:
+    if (l != 0 && l != 1)
+      return false;
+    result = l;
+    return true;
+  default:
+    return false;
+  }
+}
+
+class Propagation {
+public:
+  explicit Propagation(SsaFunction &function)
+      : function_(function), cells_(function.valueIds()),
+        users_(function.valueIds()),
+        executable_(function.blockIds(), false) {}
+
+  int run();
+
+private:
+  bool drain();
+  Cell cell(const SsaInstruction *value) const;
+  void visit(SsaInstruction *instruction);
+  void visitPhi(SsaInstruction *phi);
+  void update(SsaInstruction *instruction, Cell value);
+  void reach(SsaBlock *from, SsaBlock *to);
+  int rewrite();
+
+  SsaFunction &function_;
+  std::vector<Cell> cells_;
+  std::vector<std::vector<SsaInstruction *>> users_;
+  std::vector<bool> executable_;
+  std::set<std::pair<int, int>> edges_;
+  std::vector<std::pair<SsaBlock *, SsaBlock *>> flow_work_;
+  std::vector<SsaInstruction *> value_work_;
+};
+
+int Propagation::run() {
+  for (const auto &block : function_.blocks) {
+    for (SsaInstruction *instruction : block->instructions) {
+      for (SsaInstruction *operand : instruction->operands) {
+        if (!operand->isConstant())
+          users_[operand->id].push_back(instruction);
+      }
+    }
+  }
+  flow_work_.push_back({nullptr, function_.entry()});
+  while (drain()) {
+    // phis that merge nothing but undefined values may be anything
+    for (const auto &block : function_.blocks) {
+      if (!executable_[block->id])
+        continue;
+      for (size_t i = 0; i < block->firstNonPhi(); i++) {
+        SsaInstruction *phi = block->instructions[i];
+        if (cells_[phi->id].state == Cell::Unknown)
+          update(phi, Cell{Cell::Varying, 0});
+      }
+    }
+    if (value_work_.empty())
+      break;
+  }
+  return rewrite();
+}
+
+// run the work lists until they are empty
+bool Propagation::drain() {
+  while (!flow_work_.empty() || !value_work_.empty()) {
+    while (!flow_work_.empty()) {
+      auto [from, to] = flow_work_.back();
+      flow_work_.pop_back();
+      if (from != nullptr && !edges_.insert({from->id, to->id}).second)
+        continue;
+      if (executable_[to->id]) {
+        // a new edge only changes what the phis merge
+        for (size_t i = 0; i < to->firstNonPhi(); i++)
+          visitPhi(to->instructions[i]);
+        continue;
+      }
+      executable_[to->id] = true;
+      for (SsaInstruction *instruction : to->instructions)
+        visit(instruction);
+    }
+    while (!value_work_.empty()) {
+      SsaInstruction *instruction = value_work_.back();
+      value_work_.pop_back();
+      if (instruction->block != nullptr &&
+          executable_[instruction->block->id])
+        visit(instruction);
+    }
+  }
+  return true;
+}
+
+Cell Propagation::cell(const SsaInstruction *value) const {
+  if (!value->isConstant())
+    return cells_[value->id];
+  Cell constant;
+  // undefined values may be taken to be anything
+  if (value->type != SsaType::None) {
+    constant.state = Cell::Constant;
+    constant.bits = value->a;
+  }
+  return constant;
+}
+
+void Propagation::visit(SsaInstruction *instruction) {
+  SsaBlock *block = instruction->block;
+  switch (instruction->opcode) {
+  case SsaOpcode::Phi:
+    visitPhi(instruction);
+    return;
+  case SsaOpcode::Jump:
+    reach(block, block->successors[0]);
+    return;
+  case SsaOpcode::Branch: {
+    Cell condition = cell(instruction->operands[0]);
+    if (condition.state == Cell::Varying) {
+      reach(block, block->successors[0]);
+      reach(block, block->successors[1]);
+    } else if (condition.state == Cell::Constant) {
+      reach(block, block->successors[condition.bits != 0 ? 0 : 1]);
+    }
+    return;
+  }
+  default:
+    break;
+  }
+  if (instruction->type == SsaType::None)
+    return;
+  Cell result;
+  std::vector<int64_t> operands;
+  for (SsaInstruction *operand : instruction->operands) {
+    Cell value = cell(operand);
+    // an undefined operand may be anything
+    if (value.state == Cell::Varying ||
+        (operand->isConstant() && operand->type == SsaType::None)) {
+      result.state = Cell::Varying;
+      break;
+    }
+    if (value.state == Cell::Unknown)
+      return;
+    operands.push_back(value.bits);
+  }
+  if (result.state != Cell::Varying) {
+    result.state = fold(instruction->opcode, operands, result.bits)
+                       ? Cell::Constant
+                       : Cell::Varying;
+  }
+  update(instruction, result);
+}
+
+void Propagation::visitPhi(SsaInstruction *phi) {
+  SsaBlock *block = phi->block;
+  Cell result;
+  for (size_t i = 0; i < phi->operands.size(); i++) {
+    if (edges_.count({block->predecessors[i]->id, block->id}) == 0)
+      continue;
+    Cell value = cell(phi->operands[i]);
+    if (value.state == Cell::Unknown)
+      continue;
+    if (value.state == Cell::Varying ||
+        (result.state == Cell::Constant && result.bits != value.bits)) {
+      result.state = Cell::Varying;
+      break;
+    }
+    result = value;
+  }
+  update(phi, result);
+}
+
+// values only move down from unknown to constant to varying
+void Propagation::update(SsaInstruction *instruction, Cell value) {
+  Cell &known = cells_[instruction->id];
+  if (known.state == value.state && known.bits == value.bits)
+    return;
+  if (known.state == Cell::Varying || value.state == Cell::Unknown)
+    return;
+  if (known.state == Cell::Constant && value.state == Cell::Constant)
+    value.state = Cell::Varying;
+  known = value;
+  for (SsaInstruction *user : users_[instruction->id])
+    value_work_.push_back(user);
+}
+
+void Propagation::reach(SsaBlock *from, SsaBlock *to) {
+  flow_work_.push_back({from, to});
+}
+
+int Propagation::rewrite() {
+  int changed = 0;
+  std::unordered_map<SsaInstruction *, SsaInstruction *> constants;
+  for (const auto &block : function_.blocks) {
+    if (!executable_[block->id])
+      continue;
+    for (SsaInstruction *instruction : block->instructions) {
+      const Cell &value = cells_[instruction->id];
+      if (value.state != Cell::Constant ||
+          instruction->type == SsaType::None)
+        continue;
+      constants[instruction] =
+          function_.constant(instruction->type, value.bits);
+      changed++;
+    }
+  }
+  function_.replaceUses(constants);
+  for (const auto &[instruction, constant] : constants) {
+    if (instruction->opcode == SsaOpcode::Phi || isPure(*instruction))
+      function_.remove(instruction);
+  }
+
+  // branches on constants
+  for (const auto &block : function_.blocks) {
+    if (!executable_[block->id])
+      continue;
+    SsaInstruction *branch = block->terminator();
+    if (branch->opcode != SsaOpcode::Branch ||
+        !branch->operands[0]->isConstant() ||
+        branch->operands[0]->type == SsaType::None ||
+        block->successors[0] == block->successors[1])
+      continue;
+    SsaBlock *taken = block->successors[branch->operands[0]->a != 0 ? 0 : 1];
+    SsaBlock *other = block->successors[branch->operands[0]->a != 0 ? 1 : 0];
+    function_.removeEdge(block.get(), other);
+    block->successors.assign(1, taken);
+    branch->opcode = SsaOpcode::Jump;
+    branch->operands.clear();
+    changed++;
+  }
+  for (const auto &block : function_.blocks) {
+    if (!executable_[block->id])
+      changed++;
+  }
+  function_.removeUnreachable();
+  return changed;
+}
+
+} // namespace
+
+int propagateConstants(SsaFunction &function) {
+  return Propagation(function).run();
+}
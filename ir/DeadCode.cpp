@@ -0,0 +1,165 @@
+#include "ir/Passes.hpp"
+#include <algorithm>
+
+namespace {
+
+// phis of blocks with one predecessor, and phis that merge one value
+int removeTrivialPhis(SsaFunction &function) {
+  std::unordered_map<SsaInstruction *, SsaInstruction *> replaced;
+  for (const auto &block : function.blocks) {
+    for (size_t i = 0; i < block->firstNonPhi();) {
+      SsaInstruction *phi = block->instructions[i];
+      SsaInstruction *same = nullptr;
+      bool trivial = true;
+      for (SsaInstruction *operand : phi->operands) {
+        if (operand == phi || operand == same)
+          continue;
+        if (same != nullptr) {
+          trivial = false;
+          break;
+        }
+        same = operand;
+      }
+      if (!trivial || same == nullptr) {
+        i++;
+        continue;
+      }
+      replaced[phi] = same;
+      function.remove(phi);
+    }
+  }
+  function.replaceUses(replaced);
+  return (int)replaced.size();
+}
+
+// append the only successor of block to it
+bool mergeSuccessor(SsaFunction &function, SsaBlock *block) {
+  if (block->successors.size() != 1)
+    return false;
+  SsaBlock *next = block->successors[0];
+  if (next == block || next == function.entry() ||
+      next->predecessors.size() != 1 || next->firstNonPhi() != 0)
+    return false;
+  block->instructions.pop_back();
+  for (SsaInstruction *instruction : next->instructions) {
+    instruction->block = block;
+    block->instructions.push_back(instruction);
+  }
+  next->instructions.clear();
+  block->successors = next->successors;
+  for (SsaBlock *successor : next->successors)
+    *std::find(successor->predecessors.begin(), successor->predecessors.end(),
+               next) = block;
+  next->successors.clear();
+  next->predecessors.clear();
+  function.blocks.erase(
+      std::find_if(function.blocks.begin(), function.blocks.end(),
+                   [next](const auto &owned) { return owned.get() == next; }));
+  return true;
+}
+
+// let the predecessors of a block that only jumps go to its target
+int bypass(SsaBlock *block) {
+  if (block->instructions.size() != 1 ||
+      block->terminator()->opcode != SsaOpcode::Jump)
+    return 0;
+  SsaBlock *target = block->successors[0];
+  if (target == block)
+    return 0;
+  int index = target->predecessorIndex(block);
+  int redirected = 0;
+  for (size_t i = 0; i < block->predecessors.size();) {
+    SsaBlock *predecessor = block->predecessors[i];
+    // an edge that exists already would need a second phi operand
+    if (std::count(predecessor->successors.begin(),
+                   predecessor->successors.end(), target) != 0 ||
+        std::count(predecessor->successors.begin(),
+                   predecessor->successors.end(), block) != 1) {
+      i++;
+      continue;
+    }
+    *std::find(predecessor->successors.begin(),
+               predecessor->successors.end(), block) = target;
+    target->predecessors.push_back(predecessor);
+    for (size_t p = 0; p < target->firstNonPhi(); p++) {
+      auto &operands = target->instructions[p]->operands;
+      operands.push_back(operands[index]);
+    }
+    block->predecessors.erase(block->predecessors.begin() + (long)i);
+    redirected++;
+  }
+  return redirected;
+}
+
+} // namespace
+
+int eliminateDeadCode(SsaFunction &function) {
+  std::vector<bool> live(function.valueIds(), false);
+  std::vector<SsaInstruction *> work;
+  for (const auto &block : function.blocks) {
+    for (SsaInstruction *instruction : block->instructions) {
+      if (hasSideEffects(*instruction) || canTrap(*instruction)) {
+        live[instruction->id] = true;
+        work.push_back(instruction);
+      }
+    }
+  }
+  while (!work.empty()) {
+    SsaInstruction *instruction = work.back();
+    work.pop_back();
+    for (SsaInstruction *operand : instruction->operands) {
+      if (operand->isConstant() || live[operand->id])
+        continue;
+      live[operand->id] = true;
+      work.push_back(operand);
+    }
+  }
+  int removed = 0;
+  for (const auto &block : function.blocks) {
+    auto &list = block->instructions;
+    for (SsaInstruction *instruction : list) {
+      if (!live[instruction->id])
+        instruction->block = nullptr;
+    }
+    auto end = std::remove_if(list.begin(), list.end(),
+                              [](SsaInstruction *instruction) {
+                                return instruction->block == nullptr;
+                              });
+    removed += (int)(list.end() - end);
+    list.erase(end, list.end());
+  }
+  return removed;
+}
+
+int simplifyControlFlow(SsaFunction &function) {
+  int changed = 0;
+  for (bool again = true; again;) {
+    again = false;
+    changed += removeTrivialPhis(function);
+    for (const auto &block : function.blocks) {
+      SsaInstruction *branch = block->terminator();
+      if (branch->opcode == SsaOpcode::Branch &&
+          block->successors[0] == block->successors[1]) {
+        function.removeEdge(block.get(), block->successors[1]);
+        branch->opcode = SsaOpcode::Jump;
+        branch->operands.clear();
+        changed++;
+      }
+    }
+    for (size_t i = 0; i < function.blocks.size(); i++) {
+      SsaBlock *block = function.blocks[i].get();
+      while (mergeSuccessor(function, block)) {
+        changed++;
+        again = true;
+      }
+    }
+    for (size_t i = 1; i < function.blocks.size(); i++) {
+      int redirected = bypass(function.blocks[i].get());
+      changed += redirected;
+      again = again || redirected != 0;
+    }
+    if (function.removeUnreachable())
+      again = true;
+  }
+  return changed;
+}
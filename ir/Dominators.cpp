@@ -0,0 +1,134 @@
+#include "ir/Dominators.hpp"
+#include <algorithm>
+
+DominatorTree::DominatorTree(const SsaFunction &function)
+    : order_(function.reversePostorder()),
+      number_(function.blockIds(), -1), idom_(function.blockIds(), nullptr),
+      children_(function.blockIds()), enter_(function.blockIds(), -1),
+      leave_(function.blockIds(), -1) {
+  for (size_t i = 0; i < order_.size(); i++)
+    number_[order_[i]->id] = (int)i;
+
+  // walk up from both blocks until the paths meet; positions in reverse
+  // postorder decrease towards the entry
+  auto intersect = [this](SsaBlock *a, SsaBlock *b) {
+    while (a != b) {
+      while (number_[a->id] > number_[b->id])
+        a = idom_[a->id];
+      while (number_[b->id] > number_[a->id])
+        b = idom_[b->id];
+    }
+    return a;
+  };
+  SsaBlock *entry = order_.front();
+  idom_[entry->id] = entry;
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t i = 1; i < order_.size(); i++) {
+      SsaBlock *block = order_[i];
+      SsaBlock *dominator = nullptr;
+      for (SsaBlock *predecessor : block->predecessors) {
+        if (number_[predecessor->id] == -1 ||
+            idom_[predecessor->id] == nullptr)
+          continue;
+        dominator = dominator == nullptr
+                        ? predecessor
+                        : intersect(predecessor, dominator);
+      }
+      if (idom_[block->id] != dominator) {
+        idom_[block->id] = dominator;
+        changed = true;
+      }
+    }
+  }
+  idom_[entry->id] = nullptr;
+  for (size_t i = 1; i < order_.size(); i++)
+    children_[idom_[order_[i]->id]->id].push_back(order_[i]);
+
+  int clock = 0;
+  std::vector<std::pair<SsaBlock *, size_t>> stack{{entry, 0}};
+  enter_[entry->id] = clock++;
+  while (!stack.empty()) {
+    auto &[block, next] = stack.back();
+    if (next == children_[block->id].size()) {
+      leave_[block->id] = clock++;
+      stack.pop_back();
+      continue;
+    }
+    SsaBlock *child = children_[block->id][next++];
+    enter_[child->id] = clock++;
+    stack.push_back({child, 0});
+  }
+}
+
+bool DominatorTree::reachable(const SsaBlock *block) const {
+  return block->id < (int)number_.size() && number_[block->id] != -1;
+}
+
+SsaBlock *DominatorTree::idom(const SsaBlock *block) const {
+  return reachable(block) ? idom_[block->id] : nullptr;
+}
+
+bool DominatorTree::dominates(const SsaBlock *a, const SsaBlock *b) const {
+  if (!reachable(a) || !reachable(b))
+    return false;
+  return enter_[a->id] <= enter_[b->id] && leave_[b->id] <= leave_[a->id];
+}
+
+const std::vector<SsaBlock *> &
+DominatorTree::children(const SsaBlock *block) const {
+  return children_[block->id];
+}
+
+std::vector<SsaLoop> findLoops(const SsaFunction &function,
+                               const DominatorTree &tree) {
+  std::vector<SsaLoop> loops;
+  std::vector<int> loop_of_header(function.blockIds(), -1);
+  for (SsaBlock *header : tree.order()) {
+    for (SsaBlock *latch : header->predecessors) {
+      if (!tree.dominates(header, latch))
+        continue;
+      // a back edge: the loop holds the blocks that reach the latch
+      // without passing the header
+      if (loop_of_header[header->id] == -1) {
+        loop_of_header[header->id] = (int)loops.size();
+        loops.emplace_back();
+        loops.back().header = header;
+        loops.back().contains.assign(function.blockIds(), false);
+        loops.back().contains[header->id] = true;
+        loops.back().blocks.push_back(header);
+      }
+      SsaLoop &loop = loops[loop_of_header[header->id]];
+      std::vector<SsaBlock *> work{latch};
+      while (!work.empty()) {
+        SsaBlock *block = work.back();
+        work.pop_back();
+        if (loop.contains[block->id] || !tree.reachable(block))
+          continue;
+        loop.contains[block->id] = true;
+        loop.blocks.push_back(block);
+        for (SsaBlock *predecessor : block->predecessors)
+          work.push_back(predecessor);
+      }
+    }
+  }
+
+  // nested loops are smaller than the loops around them
+  std::stable_sort(loops.begin(), loops.end(),
+                   [](const SsaLoop &a, const SsaLoop &b) {
+                     return a.blocks.size() < b.blocks.size();
+                   });
+  for (size_t i = 0; i < loops.size(); i++) {
+    for (size_t j = i + 1; j < loops.size(); j++) {
+      if (loops[j].has(loops[i].header) &&
+          loops[j].header != loops[i].header) {
+        loops[i].parent = (int)j;
+        break;
+      }
+    }
+  }
+  for (size_t i = loops.size(); i-- > 0;)
+    loops[i].depth =
+        loops[i].parent == -1 ? 1 : loops[loops[i].parent].depth + 1;
+  return loops;
+}
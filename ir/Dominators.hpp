@@ -0,0 +1,52 @@
+#ifndef CC_PROJECT_DOMINATORS_HPP
+#define CC_PROJECT_DOMINATORS_HPP
+
+#include "ir/Ssa.hpp"
+
+// Dominators of the blocks the entry reaches, computed with the iterative
+// algorithm of Cooper, Harvey and Kennedy. The tree is a snapshot: it must
+// be rebuilt after blocks or edges change
+class DominatorTree {
+public:
+  explicit DominatorTree(const SsaFunction &function);
+
+  bool reachable(const SsaBlock *block) const;
+  // nullptr for the entry and for unreachable blocks
+  SsaBlock *idom(const SsaBlock *block) const;
+  // every path from the entry to b passes through a; a block dominates
+  // itself
+  bool dominates(const SsaBlock *a, const SsaBlock *b) const;
+  const std::vector<SsaBlock *> &children(const SsaBlock *block) const;
+  // reachable blocks in reverse postorder
+  const std::vector<SsaBlock *> &order() const { return order_; }
+
+private:
+  std::vector<SsaBlock *> order_;
+  // position in order_ by block id, -1 for unreachable blocks
+  std::vector<int> number_;
+  std::vector<SsaBlock *> idom_;
+  std::vector<std::vector<SsaBlock *>> children_;
+  // preorder interval of each subtree, for constant time queries
+  std::vector<int> enter_;
+  std::vector<int> leave_;
+};
+
+// Natural loop of the back edges to one header
+struct SsaLoop {
+  SsaBlock *header = nullptr;
+  // the header first
+  std::vector<SsaBlock *> blocks;
+  // membership by block id
+  std::vector<bool> contains;
+  // position of the innermost enclosing loop, -1 for outermost loops
+  int parent = -1;
+  int depth = 1;
+
+  bool has(const SsaBlock *block) const { return contains[block->id]; }
+};
+
+// loops of the function, each after the loops nested in it
+std::vector<SsaLoop> findLoops(const SsaFunction &function,
+                               const DominatorTree &tree);
+
+#endif // CC_PROJECT_DOMINATORS_HPP
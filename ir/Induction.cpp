@@ -0,0 +1,231 @@
+#include "ir/Induction.hpp"
+#include <limits>
+
+namespace {
+
+bool holds(SsaOpcode compare, int64_t left, int64_t right) {
+  switch (compare) {
+  case SsaOpcode::LessInt:
+    return left < right;
+  case SsaOpcode::LessEqInt:
+    return left <= right;
+  case SsaOpcode::GreaterInt:
+    return left > right;
+  case SsaOpcode::GreaterEqInt:
+    return left >= right;
+  case SsaOpcode::EqualInt:
+    return left == right;
+  default:
+    return left != right;
+  }
+}
+
+// the step of a value computed from phi by adding a constant
+bool stepOf(const SsaInstruction *phi, const SsaInstruction *next,
+            int64_t &step) {
+  if (next->operands.size() != 2)
+    return false;
+  const SsaInstruction *left = next->operands[0];
+  const SsaInstruction *right = next->operands[1];
+  if (next->opcode == SsaOpcode::AddInt && right == phi)
+    std::swap(left, right);
+  if (left != phi || !right->isConstant())
+    return false;
+  if (next->opcode == SsaOpcode::AddInt)
+    step = right->a;
+  else if (next->opcode == SsaOpcode::SubInt)
+    step = (int64_t)(0 - (uint64_t)right->a);
+  else
+    return false;
+  return true;
+}
+
+// the blocks the header test leads to, and the counter it tests
+void analyzeTest(const SsaLoop &loop, LoopShape &shape) {
+  SsaBlock *header = loop.header;
+  SsaInstruction *branch = header->terminator();
+  if (branch->opcode != SsaOpcode::Branch ||
+      loop.has(header->successors[0]) == loop.has(header->successors[1]))
+    return;
+  bool stays = loop.has(header->successors[0]);
+  shape.body = header->successors[stays ? 0 : 1];
+  shape.exit = header->successors[stays ? 1 : 0];
+  SsaInstruction *condition = branch->operands[0];
+  if (!isIntCompare(condition->opcode))
+    return;
+  auto invariant = [&loop](const SsaInstruction *value) {
+    return value->isConstant() || !loop.has(value->block);
+  };
+  for (size_t i = 0; i < shape.inductions.size(); i++) {
+    SsaInstruction *phi = shape.inductions[i].phi;
+    SsaOpcode compare = condition->opcode;
+    SsaInstruction *bound = condition->operands[1];
+    if (condition->operands[1] == phi) {
+      compare = swappedCompare(compare);
+      bound = condition->operands[0];
+    } else if (condition->operands[0] != phi) {
+      continue;
+    }
+    if (!invariant(bound))
+      continue;
+    shape.counter = (int)i;
+    shape.compare = stays ? compare : negatedCompare(compare);
+    shape.bound = bound;
+    const InductionVariable &counter = shape.inductions[i];
+    if (counter.initial->isConstant() && bound->isConstant())
+      shape.trips = tripCount(shape.compare, counter.initial->a,
+                              counter.step, bound->a);
+    break;
+  }
+}
+
+// block leaves the loop exactly when the counter of shape is at its
+// bound, right before the latch, which does nothing the test would skip
+bool testsLast(const LoopShape &shape, const SsaBlock *block) {
+  SsaInstruction *branch = block->terminator();
+  if (branch->opcode != SsaOpcode::Branch || block->successors.size() != 2)
+    return false;
+  bool stays = block->successors[0] == shape.latch;
+  if (block->successors[stays ? 0 : 1] != shape.latch ||
+      block->successors[stays ? 1 : 0] != shape.exit)
+    return false;
+  for (SsaInstruction *instruction : shape.latch->instructions) {
+    if (instruction != shape.latch->terminator() &&
+        (hasSideEffects(*instruction) || canTrap(*instruction)))
+      return false;
+  }
+  const SsaInstruction *condition = branch->operands[0];
+  if (condition->opcode !=
+      (stays ? SsaOpcode::NotEqualInt : SsaOpcode::EqualInt))
+    return false;
+  const SsaInstruction *phi = shape.inductions[shape.counter].phi;
+  const auto &operands = condition->operands;
+  if (!(operands[0] == phi && operands[1] == shape.bound) &&
+      !(operands[1] == phi && operands[0] == shape.bound))
+    return false;
+  // without the test the values leave through the header one step later,
+  // which has to leave them as they were
+  const SsaBlock *header = shape.loop->header;
+  int repeating = header->predecessorIndex(shape.latch);
+  int through = shape.exit->predecessorIndex(header);
+  int early = shape.exit->predecessorIndex(block);
+  for (size_t p = 0; p < shape.exit->firstNonPhi(); p++) {
+    const SsaInstruction *merge = shape.exit->instructions[p];
+    const SsaInstruction *later = merge->operands[through];
+    if (later == merge->operands[early])
+      continue;
+    if (later->block == header && later->opcode == SsaOpcode::Phi)
+      later = later->operands[repeating];
+    if (later != merge->operands[early])
+      return false;
+  }
+  return true;
+}
+
+} // namespace
+
+bool analyzeLoop(const SsaLoop &loop, LoopShape &shape) {
+  shape = LoopShape();
+  shape.loop = &loop;
+  SsaBlock *header = loop.header;
+  for (SsaBlock *predecessor : header->predecessors) {
+    SsaBlock *&edge = loop.has(predecessor) ? shape.latch : shape.preheader;
+    if (edge != nullptr)
+      return false;
+    edge = predecessor;
+  }
+  if (shape.preheader == nullptr || shape.latch == nullptr ||
+      shape.preheader->successors.size() != 1)
+    return false;
+
+  int entering = header->predecessorIndex(shape.preheader);
+  int repeating = header->predecessorIndex(shape.latch);
+  for (size_t p = 0; p < header->firstNonPhi(); p++) {
+    InductionVariable variable;
+    variable.phi = header->instructions[p];
+    variable.initial = variable.phi->operands[entering];
+    variable.next = variable.phi->operands[repeating];
+    if (variable.phi->type == SsaType::Integer &&
+        variable.next->block != nullptr && loop.has(variable.next->block) &&
+        stepOf(variable.phi, variable.next, variable.step))
+      shape.inductions.push_back(variable);
+  }
+
+  // the exit test, and perhaps one more at the end of the body
+  SsaBlock *last = nullptr;
+  for (SsaBlock *block : loop.blocks) {
+    for (SsaBlock *successor : block->successors) {
+      if (block == header || loop.has(successor))
+        continue;
+      if (last != nullptr && last != block)
+        return true;
+      last = block;
+    }
+  }
+  analyzeTest(loop, shape);
+  if (last == nullptr)
+    return true;
+  if (shape.counter != -1 && testsLast(shape, last)) {
+    shape.last = last;
+  } else {
+    // the loop may end anywhere
+    shape.body = shape.exit = nullptr;
+    shape.counter = -1;
+    shape.bound = nullptr;
+    shape.trips = -1;
+  }
+  return true;
+}
+
+void removeLastTest(SsaFunction &function, LoopShape &shape) {
+  SsaBlock *block = shape.last;
+  function.removeEdge(block, shape.exit);
+  function.remove(block->terminator());
+  function.append(block, SsaOpcode::Jump, SsaType::None);
+  shape.last = nullptr;
+}
+
+int64_t tripCount(SsaOpcode compare, int64_t start, int64_t step,
+                  int64_t bound) {
+  if (!holds(compare, start, bound))
+    return 0;
+  if (step == 0)
+    return -1;
+  bool increasing = step > 0;
+  uint64_t magnitude = increasing ? (uint64_t)step : 0 - (uint64_t)step;
+  // how far the counter moves while the test holds
+  uint64_t up = (uint64_t)bound - (uint64_t)start;
+  uint64_t down = (uint64_t)start - (uint64_t)bound;
+  uint64_t trips = 0;
+  switch (compare) {
+  case SsaOpcode::LessInt:
+  case SsaOpcode::LessEqInt:
+    if (!increasing)
+      return -1;
+    trips = (up - (compare == SsaOpcode::LessInt)) / magnitude + 1;
+    break;
+  case SsaOpcode::GreaterInt:
+  case SsaOpcode::GreaterEqInt:
+    if (increasing)
+      return -1;
+    trips = (down - (compare == SsaOpcode::GreaterInt)) / magnitude + 1;
+    break;
+  case SsaOpcode::NotEqualInt: {
+    uint64_t distance = increasing ? up : down;
+    if (distance % magnitude != 0)
+      return -1;
+    trips = distance / magnitude;
+    break;
+  }
+  default:
+    return -1;
+  }
+  // the counter has to get past the bound without wrapping around
+  const int64_t max = std::numeric_limits<int64_t>::max();
+  const int64_t min = std::numeric_limits<int64_t>::min();
+  uint64_t room = increasing ? (uint64_t)max - (uint64_t)start
+                             : (uint64_t)start - (uint64_t)min;
+  if (trips > room / magnitude || trips > (uint64_t)max)
+    return -1;
+  return (int64_t)trips;
+}
@@ -0,0 +1,56 @@
+#ifndef CC_PROJECT_INDUCTION_HPP
+#define CC_PROJECT_INDUCTION_HPP
+
+#include "ir/Dominators.hpp"
+
+// Basic induction variable: a phi of the loop header that every iteration
+// steps by the same constant
+struct InductionVariable {
+  SsaInstruction *phi = nullptr;
+  // the values on entry and for the next iteration
+  SsaInstruction *initial = nullptr;
+  SsaInstruction *next = nullptr;
+  int64_t step = 0;
+};
+
+// The shape for and while loops take: one block enters the loop and one
+// jumps back to the header
+struct LoopShape {
+  const SsaLoop *loop = nullptr;
+  SsaBlock *preheader = nullptr;
+  SsaBlock *latch = nullptr;
+  std::vector<InductionVariable> inductions;
+
+  // when the header is the only block that leaves the loop: where it
+  // goes inside and outside of the loop
+  SsaBlock *body = nullptr;
+  SsaBlock *exit = nullptr;
+  // when the loop runs while counter compare bound holds, with a bound
+  // the loop does not change: the position of the counter among the
+  // inductions, -1 otherwise
+  int counter = -1;
+  SsaOpcode compare = SsaOpcode::EqualInt;
+  SsaInstruction *bound = nullptr;
+  // iterations, when they are known; -1 otherwise
+  int64_t trips = -1;
+  // the block that also leaves the loop, after the body of the iteration
+  // with the counter at the bound, so that the counter does not step past
+  // the end of the integers; nullptr if there is none. Where stepping from
+  // the bound cannot wrap around, the header ends the loop just the same
+  SsaBlock *last = nullptr;
+};
+
+// false if the loop has no preheader or more than one back edge
+bool analyzeLoop(const SsaLoop &loop, LoopShape &shape);
+
+// turn the test of shape.last into a jump back into the loop, for when
+// the counter cannot step past the bound without leaving the loop anyway
+void removeLastTest(SsaFunction &function, LoopShape &shape);
+
+// iterations of a loop counting from start by step while the counter
+// compare bound holds; -1 if it does not stop before the counter wraps
+// around
+int64_t tripCount(SsaOpcode compare, int64_t start, int64_t step,
+                  int64_t bound);
+
+#endif // CC_PROJECT_INDUCTION_HPP
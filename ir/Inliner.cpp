@@ -0,0 +1,207 @@
+#include "ir/Inliner.hpp"
+#include <algorithm>
+
+namespace {
+
+// callees this small are inlined wherever they are called
+const int kSmallCost = 12;
+// a callee called from one place is inlined up to this size
+const int kSingleSiteCost = 60;
+// a caller may grow to this many times its size, or to the minimum
+const int kGrowthFactor = 2;
+const int kMinimumBudget = 100;
+
+} // namespace
+
+int inlineCost(const SsaFunction &function) {
+  int cost = 0;
+  for (const auto &block : function.blocks) {
+    for (const SsaInstruction *instruction : block->instructions) {
+      if (instruction->opcode != SsaOpcode::Parameter &&
+          instruction->opcode != SsaOpcode::Phi &&
+          instruction->opcode != SsaOpcode::Jump)
+        cost++;
+    }
+  }
+  return cost;
+}
+
+Inliner::Inliner(SsaProgram &program)
+    : program_(program), sites_(program.routines.size(), 0) {
+  // ids of the call graph are the positions of the routines
+  for (const auto &routine : program.routines)
+    calls_.addRoutine(routine->header.name);
+  auto record = [this](const SsaFunction &function, bool routine) {
+    for (const auto &block : function.blocks) {
+      for (const SsaInstruction *instruction : block->instructions) {
+        if (instruction->opcode != SsaOpcode::Call)
+          continue;
+        sites_[instruction->a]++;
+        if (routine)
+          calls_.addCall(function.header.name,
+                         program_.routines[instruction->a]->header.name);
+      }
+    }
+  };
+  record(*program.initializer, false);
+  for (const auto &routine : program.routines)
+    record(*routine, true);
+  calls_.build();
+}
+
+int Inliner::run(SsaFunction &function) {
+  int budget = std::max(kMinimumBudget, kGrowthFactor * inlineCost(function));
+  std::vector<SsaInstruction *> calls;
+  for (SsaBlock *block : function.reversePostorder()) {
+    for (SsaInstruction *instruction : block->instructions) {
+      if (instruction->opcode == SsaOpcode::Call)
+        calls.push_back(instruction);
+    }
+  }
+  int inlined = 0;
+  for (SsaInstruction *call : calls) {
+    const SsaFunction &callee = *program_.routines[call->a];
+    Decision decision;
+    decision.caller = function.header.name;
+    decision.callee = callee.header.name;
+    decision.cost = inlineCost(callee);
+    decision.reason = refusal(function, callee, budget);
+    if (decision.reason == nullptr) {
+      decision.inlined = true;
+      decision.reason = decision.cost <= kSmallCost ? "small"
+                                                    : "single call site";
+      inlineCall(function, call, callee);
+      inlined++;
+    }
+    decisions_.push_back(decision);
+  }
+  if (inlined != 0)
+    function.removeUnreachable();
+  return inlined;
+}
+
+const CallGraph &Inliner::callGraph() const { return calls_; }
+
+const std::vector<Inliner::Decision> &Inliner::decisions() const {
+  return decisions_;
+}
+
+const char *Inliner::refusal(const SsaFunction &caller,
+                             const SsaFunction &callee, int budget) const {
+  const Routine &header = callee.header;
+  if (header.result_shape != -1 ||
+      std::any_of(header.parameter_shapes.begin(),
+                  header.parameter_shapes.end(),
+                  [](int shape) { return shape != -1; }))
+    return "aggregate parameters or result";
+  int id = calls_.find(header.name);
+  if (calls_.isRecursive(id))
+    return "recursive";
+  int cost = inlineCost(callee);
+  if (cost > kSmallCost && (sites_[id] != 1 || cost > kSingleSiteCost))
+    return "too large";
+  if (inlineCost(caller) + cost > budget)
+    return "over budget";
+  return nullptr;
+}
+
+void Inliner::inlineCall(SsaFunction &caller, SsaInstruction *call,
+                         const SsaFunction &callee) {
+  // the instructions after the call go to a block the callee returns to
+  SsaBlock *block = call->block;
+  SsaBlock *rest = caller.addBlock();
+  auto &list = block->instructions;
+  auto position = std::find(list.begin(), list.end(), call);
+  for (auto moved = position + 1; moved != list.end(); moved++) {
+    (*moved)->block = rest;
+    rest->instructions.push_back(*moved);
+  }
+  list.erase(position, list.end());
+  call->block = nullptr;
+  rest->successors = block->successors;
+  for (SsaBlock *successor : rest->successors)
+    std::replace(successor->predecessors.begin(),
+                 successor->predecessors.end(), block, rest);
+  block->successors.clear();
+
+  // blocks and values of the callee, the arguments for its parameters
+  std::unordered_map<const SsaBlock *, SsaBlock *> blocks;
+  std::unordered_map<const SsaInstruction *, SsaInstruction *> values;
+  // frame slots with buffers get fresh slots of the caller
+  std::unordered_map<int64_t, int> slots;
+  auto slot = [&caller, &slots](int64_t original) {
+    auto [known, added] = slots.emplace(original, caller.header.frame_size);
+    if (added)
+      caller.header.frame_size++;
+    caller.header.aggregates = true;
+    return known->second;
+  };
+  for (const auto &original : callee.blocks)
+    blocks[original.get()] = caller.addBlock();
+  for (const auto &original : callee.blocks) {
+    SsaBlock *copy = blocks[original.get()];
+    for (SsaInstruction *instruction : original->instructions) {
+      if (instruction->opcode == SsaOpcode::Parameter) {
+        values[instruction] = call->operands[instruction->a];
+        continue;
+      }
+      SsaInstruction *clone =
+          caller.append(copy, instruction->opcode, instruction->type, {},
+                        instruction->a, instruction->b);
+      // runtime errors name the routine the code came from
+      clone->origin =
+          instruction->origin != -1 ? instruction->origin : (int)call->a;
+      if (clone->opcode == SsaOpcode::Allocate)
+        clone->a = slot(clone->a);
+      else if (clone->opcode == SsaOpcode::Call && clone->b != -1)
+        clone->b = slot(clone->b);
+      values[instruction] = clone;
+    }
+    for (SsaBlock *predecessor : original->predecessors)
+      copy->predecessors.push_back(blocks[predecessor]);
+    for (SsaBlock *successor : original->successors)
+      copy->successors.push_back(blocks[successor]);
+  }
+  for (const auto &original : callee.blocks) {
+    for (SsaInstruction *instruction : original->instructions) {
+      if (instruction->opcode == SsaOpcode::Parameter)
+        continue;
+      SsaInstruction *clone = values[instruction];
+      for (SsaInstruction *operand : instruction->operands)
+        clone->operands.push_back(
+            operand->isConstant() ? caller.constant(operand->type, operand->a)
+                                  : values[operand]);
+    }
+  }
+
+  // returns jump to the rest of the caller, their values meet in a phi
+  std::vector<SsaInstruction *> results;
+  for (const auto &original : callee.blocks) {
+    SsaBlock *copy = blocks[original.get()];
+    SsaInstruction *terminator = copy->terminator();
+    if (terminator->opcode != SsaOpcode::Return &&
+        terminator->opcode != SsaOpcode::ReturnVoid)
+      continue;
+    if (terminator->opcode == SsaOpcode::Return)
+      results.push_back(terminator->operands[0]);
+    terminator->opcode = SsaOpcode::Jump;
+    terminator->operands.clear();
+    copy->successors.push_back(rest);
+    rest->predecessors.push_back(copy);
+  }
+  SsaBlock *entry = blocks[callee.entry()];
+  caller.append(block, SsaOpcode::Jump, SsaType::None);
+  block->successors.push_back(entry);
+  entry->predecessors.push_back(block);
+  if (call->type == SsaType::None)
+    return;
+  SsaInstruction *result = caller.constant(SsaType::None, 0);
+  if (results.size() == 1) {
+    result = results[0];
+  } else if (results.size() > 1) {
+    result = caller.create(SsaOpcode::Phi, call->type, results);
+    result->block = rest;
+    rest->instructions.insert(rest->instructions.begin(), result);
+  }
+  caller.replaceUses({{call, result}});
+}
@@ -0,0 +1,54 @@
+#ifndef CC_PROJECT_INLINER_HPP
+#define CC_PROJECT_INLINER_HPP
+
+#include "ir/Ssa.hpp"
+#include "semantic_analyzer/CallGraph.hpp"
+#include <string>
+#include <vector>
+
+// Replaces calls by the bodies of their callees, with the arguments in
+// place of the parameters. A callee is inlined when it is small, or when
+// the call is its only call site and it is not too large, as long as the
+// caller stays within its growth budget. Routines of recursive components
+// of the call graph and routines taking or returning aggregates, whose
+// copies the calling convention makes, are never inlined.
+// Runtime errors of inlined code are reported as errors of the caller.
+class Inliner {
+public:
+  struct Decision {
+    std::string caller;
+    std::string callee;
+    // instructions of the callee
+    int cost = 0;
+    bool inlined = false;
+    const char *reason = "";
+  };
+
+  explicit Inliner(SsaProgram &program);
+  ~Inliner() = default;
+
+  // inline calls of function; its callees must be done first, which the
+  // components of the call graph give, callees first
+  int run(SsaFunction &function);
+
+  const CallGraph &callGraph() const;
+  const std::vector<Decision> &decisions() const;
+
+private:
+  // why the call may not be inlined, nullptr if it may
+  const char *refusal(const SsaFunction &caller, const SsaFunction &callee,
+                      int budget) const;
+  void inlineCall(SsaFunction &caller, SsaInstruction *call,
+                  const SsaFunction &callee);
+
+  SsaProgram &program_;
+  CallGraph calls_;
+  // call instructions naming each routine
+  std::vector<int> sites_;
+  std::vector<Decision> decisions_;
+};
+
+// instructions that cost code when the function is inlined
+int inlineCost(const SsaFunction &function);
+
+#endif // CC_PROJECT_INLINER_HPP
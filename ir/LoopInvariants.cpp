@@ -0,0 +1,154 @@
+#include "ir/Dominators.hpp"
+#include "ir/Passes.hpp"
+#include <algorithm>
+#include <set>
+
+namespace {
+
+// give the loop a block that all edges from outside go through; phis
+// merging several outside values get a phi of their own there
+void addPreheader(SsaFunction &function, SsaBlock *header,
+                  const SsaLoop &loop) {
+  std::vector<int> outside;
+  for (size_t i = 0; i < header->predecessors.size(); i++) {
+    if (!loop.has(header->predecessors[i]))
+      outside.push_back((int)i);
+  }
+  if (outside.size() == 1 &&
+      header->predecessors[outside[0]]->successors.size() == 1)
+    return;
+  SsaBlock *preheader = function.addBlock();
+  std::vector<SsaInstruction *> entering;
+  for (size_t p = 0; p < header->firstNonPhi(); p++) {
+    SsaInstruction *phi = header->instructions[p];
+    SsaInstruction *value = phi->operands[outside[0]];
+    if (outside.size() > 1) {
+      value = function.create(SsaOpcode::Phi, phi->type);
+      value->block = preheader;
+      preheader->instructions.push_back(value);
+      for (int i : outside)
+        value->operands.push_back(phi->operands[i]);
+    }
+    entering.push_back(value);
+  }
+  function.append(preheader, SsaOpcode::Jump, SsaType::None);
+  for (int i : outside) {
+    SsaBlock *predecessor = header->predecessors[i];
+    *std::find(predecessor->successors.begin(),
+               predecessor->successors.end(), header) = preheader;
+    preheader->predecessors.push_back(predecessor);
+  }
+  for (size_t i = outside.size(); i-- > 0;) {
+    header->predecessors.erase(header->predecessors.begin() + outside[i]);
+    for (size_t p = 0; p < header->firstNonPhi(); p++) {
+      auto &operands = header->instructions[p]->operands;
+      operands.erase(operands.begin() + outside[i]);
+    }
+  }
+  header->predecessors.push_back(preheader);
+  preheader->successors.push_back(header);
+  for (size_t p = 0; p < header->firstNonPhi(); p++)
+    header->instructions[p]->operands.push_back(entering[p]);
+}
+
+// what the instructions of a loop may change
+struct Writes {
+  bool calls = false;
+  bool buffers = false;
+  std::set<int64_t> globals;
+
+  // the loop leaves the memory the load reads alone
+  bool keep(const SsaInstruction &load) const {
+    if (calls)
+      return false;
+    if (load.opcode == SsaOpcode::LoadGlobal)
+      return globals.count(load.a) == 0;
+    return !buffers;
+  }
+};
+
+Writes writesOf(const SsaLoop &loop) {
+  Writes writes;
+  for (SsaBlock *block : loop.blocks) {
+    for (SsaInstruction *instruction : block->instructions) {
+      switch (instruction->opcode) {
+      case SsaOpcode::Call:
+        writes.calls = true;
+        break;
+      case SsaOpcode::StoreGlobal:
+        writes.globals.insert(instruction->a);
+        break;
+      case SsaOpcode::AllocateGlobal:
+        writes.globals.insert(instruction->a);
+        writes.buffers = true;
+        break;
+      case SsaOpcode::Allocate:
+      case SsaOpcode::StoreInt:
+      case SsaOpcode::StoreReal:
+      case SsaOpcode::StoreBool:
+      case SsaOpcode::Copy:
+        writes.buffers = true;
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  return writes;
+}
+
+} // namespace
+
+int hoistInvariants(SsaFunction &function) {
+  {
+    DominatorTree tree(function);
+    for (const SsaLoop &loop : findLoops(function, tree))
+      addPreheader(function, loop.header, loop);
+  }
+  DominatorTree tree(function);
+  std::vector<SsaLoop> loops = findLoops(function, tree);
+  int hoisted = 0;
+  for (const SsaLoop &loop : loops) {
+    SsaBlock *preheader = nullptr;
+    for (SsaBlock *predecessor : loop.header->predecessors) {
+      if (!loop.has(predecessor))
+        preheader = predecessor;
+    }
+    Writes writes = writesOf(loop);
+    auto invariant = [&loop](const SsaInstruction *value) {
+      return value->isConstant() || !loop.has(value->block);
+    };
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (SsaBlock *block : tree.order()) {
+        if (!loop.has(block))
+          continue;
+        for (size_t i = block->firstNonPhi();
+             i < block->instructions.size();) {
+          SsaInstruction *instruction = block->instructions[i];
+          bool movable = isPure(*instruction);
+          // loads of memory the loop leaves alone, from addresses that
+          // are defined wherever the loop is entered
+          if (instruction->opcode != SsaOpcode::Call &&
+              readsMemory(instruction->opcode) && writes.keep(*instruction))
+            movable = std::none_of(
+                instruction->operands.begin(), instruction->operands.end(),
+                [](const SsaInstruction *operand) {
+                  return operand->isConstant();
+                });
+          if (!movable || !std::all_of(instruction->operands.begin(),
+                                       instruction->operands.end(),
+                                       invariant)) {
+            i++;
+            continue;
+          }
+          block->instructions.erase(block->instructions.begin() + (long)i);
+          function.insertBeforeTerminator(preheader, instruction);
+          hoisted++;
+          changed = true;
+        }
+      }
+    }
+  }
+  return hoisted;
+}
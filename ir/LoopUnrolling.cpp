@@ -0,0 +1,347 @@
+#include "ir/Induction.hpp"
+#include "ir/Passes.hpp"
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+namespace {
+
+// instructions a loop may grow by
+const int kUnrollBudget = 96;
+// copies of the body in a partially unrolled loop, at most
+const int kUnrollFactor = 4;
+
+using ValueMap = std::unordered_map<SsaInstruction *, SsaInstruction *>;
+
+// instructions of one iteration, -1 if the loop cannot be copied: slots of
+// allocations and call results would be shared by the copies
+int iterationCost(const SsaLoop &loop) {
+  int cost = 0;
+  for (SsaBlock *block : loop.blocks) {
+    for (SsaInstruction *instruction : block->instructions) {
+      switch (instruction->opcode) {
+      case SsaOpcode::Allocate:
+      case SsaOpcode::AllocateGlobal:
+        return -1;
+      case SsaOpcode::Call:
+        if (instruction->b != -1)
+          return -1;
+        cost++;
+        break;
+      case SsaOpcode::Phi:
+      case SsaOpcode::Jump:
+        break;
+      default:
+        cost++;
+        break;
+      }
+    }
+  }
+  return cost;
+}
+
+SsaInstruction *lookup(const ValueMap &values, SsaInstruction *value) {
+  auto known = values.find(value);
+  return known == values.end() ? value : known->second;
+}
+
+// the instructions of the header after its phis, up to its terminator, at
+// the end of block
+void copyHeader(SsaFunction &function, const SsaLoop &loop, SsaBlock *block,
+                ValueMap &values) {
+  SsaBlock *header = loop.header;
+  for (size_t i = header->firstNonPhi(); i + 1 < header->instructions.size();
+       i++) {
+    SsaInstruction *instruction = header->instructions[i];
+    SsaInstruction *copy = function.append(block, instruction->opcode,
+                                           instruction->type, {},
+                                           instruction->a, instruction->b);
+    copy->origin = instruction->origin;
+    for (SsaInstruction *operand : instruction->operands)
+      copy->operands.push_back(lookup(values, operand));
+    values[instruction] = copy;
+  }
+}
+
+struct Iteration {
+  SsaBlock *first = nullptr;
+  // the copy of the latch, which jumps nowhere yet
+  SsaBlock *last = nullptr;
+};
+
+// a copy of one iteration of the loop; values maps the phis of the header
+// to their values in this iteration and gets the copies of the rest. The
+// copies run where the counter cannot step past the bound, so the test of
+// shape.last becomes a jump
+Iteration copyIteration(SsaFunction &function, const LoopShape &shape,
+                        ValueMap &values) {
+  const SsaLoop &loop = *shape.loop;
+  Iteration iteration;
+  iteration.first = function.addBlock();
+  copyHeader(function, loop, iteration.first, values);
+  function.append(iteration.first, SsaOpcode::Jump, SsaType::None);
+
+  std::unordered_map<const SsaBlock *, SsaBlock *> blocks;
+  blocks[loop.header] = iteration.first;
+  for (SsaBlock *block : loop.blocks) {
+    if (block != loop.header)
+      blocks[block] = function.addBlock();
+  }
+  for (SsaBlock *block : loop.blocks) {
+    if (block == loop.header)
+      continue;
+    SsaBlock *copy = blocks[block];
+    for (SsaInstruction *instruction : block->instructions) {
+      if (block == shape.last && instruction == block->terminator())
+        function.append(copy, SsaOpcode::Jump, SsaType::None);
+      else {
+        values[instruction] =
+            function.append(copy, instruction->opcode, instruction->type, {},
+                            instruction->a, instruction->b);
+        values[instruction]->origin = instruction->origin;
+      }
+    }
+    for (SsaBlock *predecessor : block->predecessors)
+      copy->predecessors.push_back(blocks[predecessor]);
+    for (SsaBlock *successor : block->successors) {
+      if (successor != loop.header && loop.has(successor))
+        copy->successors.push_back(blocks[successor]);
+    }
+  }
+  for (SsaBlock *block : loop.blocks) {
+    if (block == loop.header)
+      continue;
+    for (SsaInstruction *instruction : block->instructions) {
+      if (block == shape.last && instruction == block->terminator())
+        continue;
+      SsaInstruction *copy = values[instruction];
+      for (SsaInstruction *operand : instruction->operands)
+        copy->operands.push_back(lookup(values, operand));
+    }
+  }
+  iteration.first->successors.push_back(blocks[shape.body]);
+  iteration.last = blocks[shape.latch];
+  return iteration;
+}
+
+// the values of the header phis in the iteration after the one of values
+ValueMap nextIteration(const LoopShape &shape, const ValueMap &values) {
+  SsaBlock *header = shape.loop->header;
+  int repeating = header->predecessorIndex(shape.latch);
+  ValueMap next;
+  for (size_t p = 0; p < header->firstNonPhi(); p++) {
+    SsaInstruction *phi = header->instructions[p];
+    next[phi] = lookup(values, phi->operands[repeating]);
+  }
+  return next;
+}
+
+// the counter leaves the loop at the header after the iteration at the
+// bound, without wrapping around
+bool stopsAtBound(const LoopShape &shape) {
+  if (shape.trips >= 0)
+    return true;
+  if (!shape.bound->isConstant())
+    return false;
+  int64_t step = shape.inductions[shape.counter].step;
+  int64_t bound = shape.bound->a;
+  bool increasing = shape.compare == SsaOpcode::LessInt ||
+                    shape.compare == SsaOpcode::LessEqInt;
+  bool decreasing = shape.compare == SsaOpcode::GreaterInt ||
+                    shape.compare == SsaOpcode::GreaterEqInt;
+  if (step > 0 ? !increasing : step == 0 || !decreasing)
+    return false;
+  return step > 0 ? bound <= std::numeric_limits<int64_t>::max() - step
+                  : bound >= std::numeric_limits<int64_t>::min() - step;
+}
+
+void link(SsaBlock *from, SsaBlock *to) {
+  from->successors.push_back(to);
+  to->predecessors.push_back(from);
+}
+
+// replace the loop by trips copies of its body and a last test
+void unrollFully(SsaFunction &function, const LoopShape &shape) {
+  SsaBlock *header = shape.loop->header;
+  int entering = header->predecessorIndex(shape.preheader);
+  ValueMap values;
+  for (size_t p = 0; p < header->firstNonPhi(); p++) {
+    SsaInstruction *phi = header->instructions[p];
+    values[phi] = phi->operands[entering];
+  }
+  shape.preheader->successors.clear();
+  SsaBlock *previous = shape.preheader;
+  for (int64_t trip = 0; trip < shape.trips; trip++) {
+    Iteration iteration = copyIteration(function, shape, values);
+    link(previous, iteration.first);
+    previous = iteration.last;
+    values = nextIteration(shape, values);
+  }
+  // the header runs once more before the loop ends
+  SsaBlock *last = function.addBlock();
+  copyHeader(function, *shape.loop, last, values);
+  function.append(last, SsaOpcode::Jump, SsaType::None);
+  link(previous, last);
+  last->successors.push_back(shape.exit);
+  // the loop itself is left unreachable
+  shape.exit->predecessors[shape.exit->predecessorIndex(header)] = last;
+  header->successors.erase(std::find(header->successors.begin(),
+                                     header->successors.end(), shape.exit));
+  function.replaceUses(values);
+}
+
+// run factor copies of the body while the counter stays in range for all
+// of them, then the loop itself for the iterations that remain
+bool unrollPartially(SsaFunction &function, const LoopShape &shape,
+                     int factor) {
+  const InductionVariable &counter = shape.inductions[shape.counter];
+  bool increasing;
+  switch (shape.compare) {
+  case SsaOpcode::LessInt:
+  case SsaOpcode::LessEqInt:
+    increasing = true;
+    break;
+  case SsaOpcode::GreaterInt:
+  case SsaOpcode::GreaterEqInt:
+    increasing = false;
+    break;
+  default:
+    return false;
+  }
+  if (counter.step == 0 || (counter.step > 0) != increasing ||
+      counter.step > (1 << 20) || counter.step < -(1 << 20))
+    return false;
+  // the last copy runs with the counter ahead by distance, so the first
+  // one has to pass the test with the bound moved back by distance; where
+  // that would wrap around, the unrolled loop is skipped
+  int64_t distance = (factor - 1) * counter.step;
+  const int64_t max = std::numeric_limits<int64_t>::max();
+  const int64_t min = std::numeric_limits<int64_t>::min();
+  SsaBlock *header = shape.loop->header;
+  SsaBlock *preheader = shape.preheader;
+  SsaInstruction *limit = nullptr;
+  SsaInstruction *guard = nullptr;
+  if (shape.bound->isConstant()) {
+    int64_t bound = shape.bound->a;
+    if (increasing ? bound < min + distance : bound > max + distance)
+      return false;
+    limit = function.constant(SsaType::Integer, bound - distance);
+  } else {
+    limit = function.create(SsaOpcode::SubInt, SsaType::Integer,
+                            {shape.bound, function.constant(
+                                              SsaType::Integer, distance)});
+    function.insertBeforeTerminator(preheader, limit);
+    guard = function.create(
+        increasing ? SsaOpcode::GreaterEqInt : SsaOpcode::LessEqInt,
+        SsaType::Boolean,
+        {shape.bound, function.constant(SsaType::Integer,
+                                        increasing ? min + distance
+                                                   : max + distance)});
+    function.insertBeforeTerminator(preheader, guard);
+  }
+  // the copies leave out the test of shape.last, so the counter has to
+  // be able to step past the bound
+  if (shape.last != nullptr) {
+    if (shape.bound->isConstant())
+      return false;
+    SsaInstruction *room = function.create(
+        increasing ? SsaOpcode::LessEqInt : SsaOpcode::GreaterEqInt,
+        SsaType::Boolean,
+        {shape.bound, function.constant(SsaType::Integer,
+                                        increasing ? max - counter.step
+                                                   : min - counter.step)});
+    function.insertBeforeTerminator(preheader, room);
+    guard = function.create(SsaOpcode::And, SsaType::Boolean, {guard, room});
+    function.insertBeforeTerminator(preheader, guard);
+  }
+
+  // the header of the unrolled loop
+  SsaBlock *unrolled = function.addBlock();
+  int entering = header->predecessorIndex(preheader);
+  ValueMap values;
+  std::vector<SsaInstruction *> phis;
+  for (size_t p = 0; p < header->firstNonPhi(); p++) {
+    SsaInstruction *phi = header->instructions[p];
+    SsaInstruction *copy =
+        function.append(unrolled, SsaOpcode::Phi, phi->type,
+                        {phi->operands[entering]});
+    values[phi] = copy;
+    phis.push_back(copy);
+  }
+  SsaInstruction *test =
+      function.append(unrolled, shape.compare, SsaType::Boolean,
+                      {values[counter.phi], limit});
+  if (guard != nullptr)
+    test = function.append(unrolled, SsaOpcode::And, SsaType::Boolean,
+                           {guard, test});
+  function.append(unrolled, SsaOpcode::Branch, SsaType::None, {test});
+
+  *std::find(preheader->successors.begin(), preheader->successors.end(),
+             header) = unrolled;
+  unrolled->predecessors.push_back(preheader);
+  SsaBlock *previous = unrolled;
+  for (int copy = 0; copy < factor; copy++) {
+    Iteration iteration = copyIteration(function, shape, values);
+    link(previous, iteration.first);
+    previous = iteration.last;
+    values = nextIteration(shape, values);
+  }
+  link(previous, unrolled);
+  for (size_t p = 0; p < phis.size(); p++)
+    phis[p]->operands.push_back(values[header->instructions[p]]);
+
+  // the remaining iterations start where the unrolled loop stops
+  unrolled->successors.push_back(header);
+  header->predecessors[entering] = unrolled;
+  for (size_t p = 0; p < phis.size(); p++)
+    header->instructions[p]->operands[entering] = phis[p];
+  return true;
+}
+
+} // namespace
+
+int unrollLoops(SsaFunction &function) {
+  DominatorTree tree(function);
+  std::vector<SsaLoop> loops = findLoops(function, tree);
+  std::vector<bool> outer(loops.size(), false);
+  for (const SsaLoop &loop : loops) {
+    if (loop.parent != -1)
+      outer[loop.parent] = true;
+  }
+  // the loops do not share blocks, so each can change without affecting
+  // the shapes of the others
+  std::vector<LoopShape> shapes;
+  std::vector<int> costs;
+  for (size_t i = 0; i < loops.size(); i++) {
+    LoopShape shape;
+    if (outer[i] || !analyzeLoop(loops[i], shape) || shape.counter == -1 ||
+        shape.latch == loops[i].header)
+      continue;
+    int cost = iterationCost(loops[i]);
+    if (cost < 0)
+      continue;
+    shapes.push_back(shape);
+    costs.push_back(cost);
+  }
+  int unrolled = 0;
+  for (size_t i = 0; i < shapes.size(); i++) {
+    LoopShape &shape = shapes[i];
+    if (shape.last != nullptr && stopsAtBound(shape))
+      removeLastTest(function, shape);
+    if (shape.trips >= 0 && shape.trips <= kUnrollBudget / costs[i]) {
+      unrollFully(function, shape);
+      unrolled++;
+      continue;
+    }
+    if (shape.trips >= 0 && shape.trips < kUnrollFactor)
+      continue;
+    int factor = kUnrollFactor;
+    while (factor > 1 && factor * costs[i] > kUnrollBudget)
+      factor /= 2;
+    if (factor > 1 && unrollPartially(function, shape, factor))
+      unrolled++;
+  }
+  if (unrolled != 0)
+    function.removeUnreachable();
+  return unrolled;
+}
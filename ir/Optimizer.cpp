@@ -0,0 +1,115 @@
+#include "ir/Optimizer.hpp"
+#include "ir/Passes.hpp"
+
+namespace {
+
+const char *const kPassNames[] = {
+    "inlining",
+    "constant propagation", "control flow simplification",
+    "value numbering",      "loop invariant motion",
+    "strength reduction",   "loop unrolling",
+    "dead code elimination",
+    "range analysis",
+};
+
+} // namespace
+
+SsaOptimizer::SsaOptimizer(std::ostream &err)
+    : err_(&err), changes_(PassCount, 0) {}
+
+bool SsaOptimizer::run(SsaProgram &program) {
+  Inliner inliner(program);
+  bool correct = true;
+  for (const auto &component : inliner.callGraph().components()) {
+    for (int routine : component)
+      correct = correct && optimize(*program.routines[routine], inliner);
+  }
+  correct = correct && optimize(*program.initializer, inliner);
+  inlining_ = inliner.decisions();
+  if (!correct)
+    return false;
+  std::vector<SsaFunction *> functions;
+  for (const auto &routine : program.routines)
+    functions.push_back(routine.get());
+  functions.push_back(program.initializer.get());
+  for (SsaFunction *function : functions) {
+    checks_ += countChecks(*function);
+    changes_[Ranges] += proveChecks(*function, program.shapes);
+    if (!verify(*function, Ranges))
+      return false;
+  }
+  return true;
+}
+
+const std::vector<size_t> &SsaOptimizer::changes() const {
+  return changes_;
+}
+
+const std::vector<Inliner::Decision> &SsaOptimizer::inlining() const {
+  return inlining_;
+}
+
+size_t SsaOptimizer::checks() const { return checks_; }
+
+const char *SsaOptimizer::passName(int pass) { return kPassNames[pass]; }
+
+bool SsaOptimizer::optimize(SsaFunction &function, Inliner &inliner) {
+  std::string problem = function.verify();
+  if (!problem.empty()) {
+    *err_ << "Broken SSA form: " << problem << std::endl;
+    return false;
+  }
+  // value numbering and hoisting expose constants and dead code, so the
+  // cleanup passes come last; unrolled loops get a second round of
+  // constant propagation and value numbering
+  for (Pass pass : {Inlining, Constants, ControlFlow, ValueNumbering,
+                    LoopInvariants, StrengthReduction, Unrolling, Constants,
+                    ValueNumbering, DeadCode, ControlFlow}) {
+    if (!apply(function, pass, inliner))
+      return false;
+  }
+  return true;
+}
+
+bool SsaOptimizer::apply(SsaFunction &function, Pass pass,
+                         Inliner &inliner) {
+  int changed = 0;
+  switch (pass) {
+  case Inlining:
+    changed = inliner.run(function);
+    break;
+  case Constants:
+    changed = propagateConstants(function);
+    break;
+  case ControlFlow:
+    changed = simplifyControlFlow(function);
+    break;
+  case ValueNumbering:
+    changed = numberValues(function);
+    break;
+  case LoopInvariants:
+    changed = hoistInvariants(function);
+    break;
+  case StrengthReduction:
+    changed = reduceStrength(function);
+    break;
+  case Unrolling:
+    changed = unrollLoops(function);
+    break;
+  default:
+    changed = eliminateDeadCode(function);
+    break;
+  }
+  changes_[pass] += changed;
+  return verify(function, pass);
+}
+
+bool SsaOptimizer::verify(const SsaFunction &function, Pass pass) {
+  std::string problem = function.verify();
+  if (!problem.empty()) {
+    *err_ << "Broken SSA form after " << passName(pass) << ": " << problem
+          << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,58 @@
+#ifndef CC_PROJECT_OPTIMIZER_HPP
+#define CC_PROJECT_OPTIMIZER_HPP
+
+#include "ir/Inliner.hpp"
+#include "ir/Ssa.hpp"
+#include <ostream>
+#include <vector>
+
+// Runs the SSA passes over every function of a program: inlining,
+// constant propagation, control flow simplification, value numbering, loop
+// invariant motion, strength reduction, loop unrolling and dead code
+// elimination. Routines are optimized
+// callees first, so that inlined bodies are optimized already. Range
+// analysis runs last, over the finished functions, so that no code moves
+// across the branches its proofs rely on. The form is
+// verified after each pass; a broken invariant is reported to err and
+// stops the run.
+class SsaOptimizer {
+public:
+  enum Pass {
+    Inlining,
+    Constants,
+    ControlFlow,
+    ValueNumbering,
+    LoopInvariants,
+    StrengthReduction,
+    Unrolling,
+    DeadCode,
+    Ranges,
+    PassCount
+  };
+
+  explicit SsaOptimizer(std::ostream &err);
+  ~SsaOptimizer() = default;
+
+  bool run(SsaProgram &program);
+
+  // instructions or blocks each pass changed
+  const std::vector<size_t> &changes() const;
+  // what the inliner did with each call
+  const std::vector<Inliner::Decision> &inlining() const;
+  // runtime checks left before range analysis
+  size_t checks() const;
+
+  static const char *passName(int pass);
+
+private:
+  bool optimize(SsaFunction &function, Inliner &inliner);
+  bool apply(SsaFunction &function, Pass pass, Inliner &inliner);
+  bool verify(const SsaFunction &function, Pass pass);
+
+  std::ostream *err_;
+  std::vector<size_t> changes_;
+  std::vector<Inliner::Decision> inlining_;
+  size_t checks_ = 0;
+};
+
+#endif // CC_PROJECT_OPTIMIZER_HPP
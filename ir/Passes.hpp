@@ -0,0 +1,50 @@
+#ifndef CC_PROJECT_PASSES_HPP
+#define CC_PROJECT_PASSES_HPP
+
+#include "ir/Ssa.hpp"
+
+// Optimizations of one function in SSA form. Each returns how many
+// instructions or blocks it changed, 0 when there was nothing to do
+
+// Sparse conditional constant propagation of Wegman and Zadeck: values
+// that are constant on every executable path are replaced by constants,
+// branches on constants become jumps and blocks no path reaches go away
+int propagateConstants(SsaFunction &function);
+
+// Remove instructions whose values nothing needs and that have no effect;
+// a runtime error counts as an effect, so checks stay
+int eliminateDeadCode(SsaFunction &function);
+
+// Merge blocks with their only predecessor, bypass blocks that only jump
+// and turn branches to one block into jumps
+int simplifyControlFlow(SsaFunction &function);
+
+// Dominator based global value numbering: an instruction that computes
+// what a dominating one computed is replaced by it. Loads and calls are
+// left alone, since stores between them may change memory
+int numberValues(SsaFunction &function);
+
+// Move instructions whose operands do not change in a loop to a
+// preheader in front of it. Only instructions that cannot fail are moved,
+// and loads only out of loops that cannot change what they read
+int hoistInvariants(SsaFunction &function);
+
+// Replace products of a basic induction variable and a loop invariant by
+// a phi that the loop steps by their increment
+int reduceStrength(SsaFunction &function);
+
+// Copy the bodies of innermost counted loops: loops with a known trip
+// count and a small body disappear, others run several iterations per
+// test and finish the remaining ones in the original loop
+int unrollLoops(SsaFunction &function);
+
+// Index operations and integer divisions that check at run time
+int countChecks(const SsaFunction &function);
+
+// Bound every integer value by an interval, from constants, constant array
+// lengths and the conditions of the branches that lead to it, and mark the
+// index operations proven in bounds and the divisions by values proven not
+// to be 0 or -1 as unchecked
+int proveChecks(SsaFunction &function, const std::vector<Shape> &shapes);
+
+#endif // CC_PROJECT_PASSES_HPP
@@ -0,0 +1,410 @@
+#include "ir/Dominators.hpp"
+#include "ir/Passes.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+const int64_t kMin = std::numeric_limits<int64_t>::min();
+const int64_t kMax = std::numeric_limits<int64_t>::max();
+// products of bounds this small cannot overflow
+const int64_t kSmall = 3037000499;
+// times a phi may grow before its range is widened to the limits
+const int kWideningDelay = 2;
+// passes that take back some of the widening
+const int kNarrowingPasses = 2;
+
+// the integers a value may take, empty while no execution reaches it
+struct Range {
+  int64_t lo = kMax;
+  int64_t hi = kMin;
+
+  bool empty() const { return lo > hi; }
+  bool operator==(const Range &other) const {
+    return lo == other.lo && hi == other.hi;
+  }
+  bool operator!=(const Range &other) const { return !(*this == other); }
+};
+
+const Range kFull = {kMin, kMax};
+
+Range join(const Range &a, const Range &b) {
+  if (a.empty())
+    return b;
+  if (b.empty())
+    return a;
+  return {std::min(a.lo, b.lo), std::max(a.hi, b.hi)};
+}
+
+Range meet(const Range &a, const Range &b) {
+  return {std::max(a.lo, b.lo), std::min(a.hi, b.hi)};
+}
+
+bool overflows(int64_t a, int64_t b) {
+  return (b > 0 && a > kMax - b) || (b < 0 && a < kMin - b);
+}
+
+// operations on values no execution reaches yet are not reached either
+
+Range add(const Range &a, const Range &b) {
+  if (a.empty() || b.empty())
+    return Range();
+  if (overflows(a.lo, b.lo) || overflows(a.hi, b.hi))
+    return kFull;
+  return {a.lo + b.lo, a.hi + b.hi};
+}
+
+Range negate(const Range &a) {
+  if (a.empty())
+    return a;
+  if (a.lo == kMin)
+    return kFull;
+  return {-a.hi, -a.lo};
+}
+
+bool small(const Range &a) { return a.lo >= -kSmall && a.hi <= kSmall; }
+
+Range multiply(const Range &a, const Range &b) {
+  if (a.empty() || b.empty())
+    return Range();
+  if (!small(a) || !small(b))
+    return kFull;
+  int64_t corners[] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+  return {*std::min_element(corners, corners + 4),
+          *std::max_element(corners, corners + 4)};
+}
+
+// divisors on one side of zero, other than -1
+bool safeDivisor(const Range &divisor) {
+  return !divisor.empty() && (divisor.lo >= 1 || divisor.hi <= -2);
+}
+
+Range divide(const Range &a, const Range &b) {
+  if (a.empty())
+    return a;
+  if (!safeDivisor(b))
+    return kFull;
+  // truncating division is monotonic in each operand on one side of zero
+  int64_t corners[] = {a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi};
+  return {*std::min_element(corners, corners + 4),
+          *std::max_element(corners, corners + 4)};
+}
+
+Range remainder(const Range &a, const Range &b) {
+  if (a.empty())
+    return a;
+  if (!safeDivisor(b))
+    return kFull;
+  // the remainder is smaller than the divisor and has the dividend's sign
+  int64_t largest = std::max(b.hi, b.lo == kMin ? kMax : -b.lo) - 1;
+  Range result = {a.lo < 0 ? -largest : 0, a.hi > 0 ? largest : 0};
+  if (a.lo >= 0)
+    result.hi = std::min(result.hi, a.hi);
+  if (a.hi <= 0)
+    result.lo = std::max(result.lo, a.lo);
+  return result;
+}
+
+// the part of value that can satisfy value compare other
+Range restrict(const Range &value, SsaOpcode compare, const Range &other) {
+  if (other.empty())
+    return other;
+  Range result = value;
+  switch (compare) {
+  case SsaOpcode::LessInt:
+    if (other.hi == kMin)
+      return Range();
+    result.hi = std::min(result.hi, other.hi - 1);
+    break;
+  case SsaOpcode::LessEqInt:
+    result.hi = std::min(result.hi, other.hi);
+    break;
+  case SsaOpcode::GreaterInt:
+    if (other.lo == kMax)
+      return Range();
+    result.lo = std::max(result.lo, other.lo + 1);
+    break;
+  case SsaOpcode::GreaterEqInt:
+    result.lo = std::max(result.lo, other.lo);
+    break;
+  case SsaOpcode::EqualInt:
+    result = meet(result, other);
+    break;
+  default:
+    if (other.lo == other.hi && result.lo == other.lo && result.lo < kMax)
+      result.lo++;
+    else if (other.lo == other.hi && result.hi == other.lo &&
+             result.hi > kMin)
+      result.hi--;
+    break;
+  }
+  return result;
+}
+
+// value compare other holds where a branch leads
+struct Fact {
+  const SsaInstruction *value;
+  SsaOpcode compare;
+  const SsaInstruction *other;
+};
+
+void collectFacts(const SsaInstruction *condition, bool holds,
+                  std::vector<Fact> &facts) {
+  switch (condition->opcode) {
+  case SsaOpcode::Not:
+    collectFacts(condition->operands[0], !holds, facts);
+    return;
+  case SsaOpcode::And:
+  case SsaOpcode::Or:
+    // both operands are known only when and holds or or does not
+    if (holds == (condition->opcode == SsaOpcode::And)) {
+      collectFacts(condition->operands[0], holds, facts);
+      collectFacts(condition->operands[1], holds, facts);
+    }
+    return;
+  default:
+    if (!isIntCompare(condition->opcode))
+      return;
+    SsaOpcode compare =
+        holds ? condition->opcode : negatedCompare(condition->opcode);
+    const SsaInstruction *left = condition->operands[0];
+    const SsaInstruction *right = condition->operands[1];
+    facts.push_back({left, compare, right});
+    facts.push_back({right, swappedCompare(compare), left});
+    return;
+  }
+}
+
+// facts on the edge from a branch to one of its two successors
+std::vector<Fact> edgeFacts(const SsaBlock *from, const SsaBlock *to) {
+  std::vector<Fact> facts;
+  const SsaInstruction *branch = from->terminator();
+  if (branch->opcode == SsaOpcode::Branch &&
+      from->successors[0] != from->successors[1])
+    collectFacts(branch->operands[0], from->successors[0] == to, facts);
+  return facts;
+}
+
+class RangeAnalysis {
+public:
+  RangeAnalysis(SsaFunction &function, const std::vector<Shape> &shapes)
+      : function_(function), shapes_(shapes), tree_(function),
+        ranges_(function.valueIds()), grown_(function.valueIds(), 0),
+        facts_(function.blockIds()) {
+    // a block with one predecessor learns what the branch to it decided
+    for (SsaBlock *block : tree_.order()) {
+      if (block->predecessors.size() == 1)
+        facts_[block->id] = edgeFacts(block->predecessors[0], block);
+    }
+  }
+
+  void solve();
+  int prove();
+
+private:
+  Range rangeOf(const SsaInstruction *value) const;
+  // the range of value where block runs, narrowed by the facts of the
+  // branches that lead there
+  Range rangeAt(const SsaInstruction *value, const SsaBlock *block) const;
+  Range applyFacts(Range range, const SsaInstruction *value,
+                   const std::vector<Fact> &facts) const;
+  Range evaluate(const SsaInstruction *instruction) const;
+  bool provenInBounds(const SsaInstruction *index) const;
+  bool boundedByLength(const SsaInstruction *value,
+                       const SsaInstruction *base,
+                       const SsaBlock *block) const;
+
+  SsaFunction &function_;
+  const std::vector<Shape> &shapes_;
+  DominatorTree tree_;
+  // by value id
+  std::vector<Range> ranges_;
+  std::vector<int> grown_;
+  // by block id
+  std::vector<std::vector<Fact>> facts_;
+};
+
+Range RangeAnalysis::rangeOf(const SsaInstruction *value) const {
+  if (value->isConstant())
+    return {value->a, value->a};
+  return ranges_[value->id];
+}
+
+Range RangeAnalysis::applyFacts(Range range, const SsaInstruction *value,
+                                const std::vector<Fact> &facts) const {
+  for (const Fact &fact : facts) {
+    if (fact.value == value)
+      range = restrict(range, fact.compare, rangeOf(fact.other));
+  }
+  return range;
+}
+
+Range RangeAnalysis::rangeAt(const SsaInstruction *value,
+                             const SsaBlock *block) const {
+  Range range = rangeOf(value);
+  if (value->isConstant())
+    return range;
+  for (; block != nullptr; block = tree_.idom(block))
+    range = applyFacts(range, value, facts_[block->id]);
+  return range;
+}
+
+Range RangeAnalysis::evaluate(const SsaInstruction *instruction) const {
+  const SsaBlock *block = instruction->block;
+  auto operand = [&](size_t i) {
+    return rangeAt(instruction->operands[i], block);
+  };
+  switch (instruction->opcode) {
+  case SsaOpcode::Phi: {
+    Range range;
+    for (size_t i = 0; i < instruction->operands.size(); i++) {
+      const SsaBlock *predecessor = block->predecessors[i];
+      if (!tree_.reachable(predecessor))
+        continue;
+      const SsaInstruction *value = instruction->operands[i];
+      range = join(range, applyFacts(rangeAt(value, predecessor), value,
+                                     edgeFacts(predecessor, block)));
+    }
+    return range;
+  }
+  case SsaOpcode::AddInt:
+    return add(operand(0), operand(1));
+  case SsaOpcode::SubInt:
+    return add(operand(0), negate(operand(1)));
+  case SsaOpcode::MulInt:
+    return multiply(operand(0), operand(1));
+  case SsaOpcode::DivInt:
+    return divide(operand(0), operand(1));
+  case SsaOpcode::ModInt:
+    return remainder(operand(0), operand(1));
+  case SsaOpcode::NegInt:
+    return negate(operand(0));
+  case SsaOpcode::Length: {
+    int64_t length = shapes_[instruction->a].length;
+    return length >= 0 ? Range{length, length} : Range{0, kMax};
+  }
+  default:
+    return instruction->type == SsaType::Boolean ? Range{0, 1} : kFull;
+  }
+}
+
+void RangeAnalysis::solve() {
+  // values start out empty and grow until nothing changes; phis that keep
+  // growing are widened to the limits so that loops settle
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (SsaBlock *block : tree_.order()) {
+      for (SsaInstruction *instruction : block->instructions) {
+        if (instruction->type == SsaType::None ||
+            instruction->type == SsaType::Real ||
+            instruction->type == SsaType::Address)
+          continue;
+        Range &range = ranges_[instruction->id];
+        Range next = join(range, evaluate(instruction));
+        if (next == range)
+          continue;
+        if (instruction->opcode == SsaOpcode::Phi && !range.empty() &&
+            ++grown_[instruction->id] > kWideningDelay) {
+          if (next.lo < range.lo)
+            next.lo = kMin;
+          if (next.hi > range.hi)
+            next.hi = kMax;
+        }
+        range = next;
+        changed = true;
+      }
+    }
+  }
+  // the exit tests of loops bound the widened phis again
+  for (int pass = 0; pass < kNarrowingPasses; pass++) {
+    for (SsaBlock *block : tree_.order()) {
+      for (SsaInstruction *instruction : block->instructions) {
+        Range &range = ranges_[instruction->id];
+        if (!range.empty())
+          range = meet(range, evaluate(instruction));
+      }
+    }
+  }
+}
+
+bool RangeAnalysis::boundedByLength(const SsaInstruction *value,
+                                    const SsaInstruction *base,
+                                    const SsaBlock *block) const {
+  // the length of an array of runtime length: what it was allocated
+  // with, or what length reads from it
+  auto isLength = [base](const SsaInstruction *length) {
+    if (length->opcode == SsaOpcode::Length)
+      return length->operands[0] == base;
+    return base->opcode == SsaOpcode::Allocate &&
+           !base->operands.empty() && base->operands[0] == length;
+  };
+  for (; block != nullptr; block = tree_.idom(block)) {
+    for (const Fact &fact : facts_[block->id]) {
+      if (fact.value == value && fact.compare == SsaOpcode::LessEqInt &&
+          isLength(fact.other))
+        return true;
+    }
+  }
+  return false;
+}
+
+bool RangeAnalysis::provenInBounds(const SsaInstruction *index) const {
+  const SsaInstruction *base = index->operands[0];
+  const SsaInstruction *value = index->operands[1];
+  Range range = rangeAt(value, index->block);
+  if (range.empty() || range.lo < 1)
+    return false;
+  int64_t length = shapes_[index->a].length;
+  if (length >= 0)
+    return range.hi <= length;
+  return boundedByLength(value, base, index->block);
+}
+
+int RangeAnalysis::prove() {
+  int proven = 0;
+  for (SsaBlock *block : tree_.order()) {
+    for (SsaInstruction *instruction : block->instructions) {
+      switch (instruction->opcode) {
+      case SsaOpcode::Index:
+        if (provenInBounds(instruction)) {
+          instruction->opcode = SsaOpcode::IndexUnchecked;
+          proven++;
+        }
+        break;
+      case SsaOpcode::DivInt:
+      case SsaOpcode::ModInt:
+        if (instruction->a == 0 &&
+            safeDivisor(rangeAt(instruction->operands[1], block))) {
+          instruction->a = 1;
+          proven++;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  return proven;
+}
+
+} // namespace
+
+int countChecks(const SsaFunction &function) {
+  int checks = 0;
+  for (const auto &block : function.blocks) {
+    for (const SsaInstruction *instruction : block->instructions) {
+      if (instruction->opcode == SsaOpcode::Index ||
+          ((instruction->opcode == SsaOpcode::DivInt ||
+            instruction->opcode == SsaOpcode::ModInt) &&
+           instruction->a == 0))
+        checks++;
+    }
+  }
+  return checks;
+}
+
+int proveChecks(SsaFunction &function, const std::vector<Shape> &shapes) {
+  RangeAnalysis analysis(function, shapes);
+  analysis.solve();
+  return analysis.prove();
+}
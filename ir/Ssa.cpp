@@ -0,0 +1,517 @@
+#include "ir/Ssa.hpp"
+#include "ir/Dominators.hpp"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <unordered_set>
+
+namespace {
+
+const char *const kSsaOpcodeNames[] = {
+#define CC_PROJECT_OPCODE(opcode, name) name,
+    CC_PROJECT_SSA_OPCODES(CC_PROJECT_OPCODE)
+#undef CC_PROJECT_OPCODE
+};
+
+const char *const kSsaTypeNames[] = {"none", "integer", "real", "boolean",
+                                     "address"};
+
+// number of the fields a and b the opcode uses
+int fieldCount(SsaOpcode opcode) {
+  switch (opcode) {
+  case SsaOpcode::Parameter:
+  case SsaOpcode::LoadGlobal:
+  case SsaOpcode::StoreGlobal:
+  case SsaOpcode::Field:
+  case SsaOpcode::Index:
+  case SsaOpcode::IndexUnchecked:
+  case SsaOpcode::Length:
+  case SsaOpcode::Copy:
+  case SsaOpcode::DivInt:
+  case SsaOpcode::ModInt:
+    return 1;
+  case SsaOpcode::Allocate:
+  case SsaOpcode::AllocateGlobal:
+  case SsaOpcode::Call:
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+std::string operandName(const SsaInstruction *value) {
+  if (value == nullptr)
+    return "null";
+  if (!value->isConstant())
+    return "%" + std::to_string(value->id);
+  ConstantValue constant;
+  switch (value->type) {
+  case SsaType::Real:
+    constant.kind = ConstantValue::Real;
+    constant.real = value->real();
+    break;
+  case SsaType::Boolean:
+    constant.kind = ConstantValue::Boolean;
+    constant.boolean = value->a != 0;
+    break;
+  case SsaType::None:
+    return "undefined";
+  default:
+    constant.kind = ConstantValue::Integer;
+    constant.integer = value->a;
+    break;
+  }
+  return constant.toString();
+}
+
+} // namespace
+
+const char *ssaOpcodeName(SsaOpcode opcode) {
+  return kSsaOpcodeNames[(int)opcode];
+}
+
+const char *ssaTypeName(SsaType type) { return kSsaTypeNames[(int)type]; }
+
+double SsaInstruction::real() const {
+  double value;
+  std::memcpy(&value, &a, sizeof(value));
+  return value;
+}
+
+size_t SsaBlock::firstNonPhi() const {
+  size_t position = 0;
+  while (position < instructions.size() &&
+         instructions[position]->opcode == SsaOpcode::Phi)
+    position++;
+  return position;
+}
+
+int SsaBlock::predecessorIndex(const SsaBlock *block) const {
+  for (size_t i = 0; i < predecessors.size(); i++) {
+    if (predecessors[i] == block)
+      return (int)i;
+  }
+  return -1;
+}
+
+SsaBlock *SsaFunction::addBlock() {
+  blocks.push_back(std::make_unique<SsaBlock>());
+  blocks.back()->id = next_block_++;
+  return blocks.back().get();
+}
+
+SsaInstruction *SsaFunction::create(SsaOpcode opcode, SsaType type,
+                                    std::vector<SsaInstruction *> operands,
+                                    int64_t a, int64_t b) {
+  values_.push_back(std::make_unique<SsaInstruction>());
+  SsaInstruction *instruction = values_.back().get();
+  instruction->opcode = opcode;
+  instruction->type = type;
+  instruction->id = (int)values_.size() - 1;
+  instruction->operands = std::move(operands);
+  instruction->a = a;
+  instruction->b = b;
+  return instruction;
+}
+
+SsaInstruction *SsaFunction::append(SsaBlock *block, SsaOpcode opcode,
+                                    SsaType type,
+                                    std::vector<SsaInstruction *> operands,
+                                    int64_t a, int64_t b) {
+  SsaInstruction *instruction =
+      create(opcode, type, std::move(operands), a, b);
+  instruction->block = block;
+  block->instructions.push_back(instruction);
+  return instruction;
+}
+
+void SsaFunction::insertBeforeTerminator(SsaBlock *block,
+                                         SsaInstruction *instruction) {
+  instruction->block = block;
+  block->instructions.insert(block->instructions.end() - 1, instruction);
+}
+
+SsaInstruction *SsaFunction::constant(SsaType type, int64_t bits) {
+  auto known = constants_.find({type, bits});
+  if (known != constants_.end())
+    return known->second;
+  SsaInstruction *instruction = create(SsaOpcode::Constant, type, {}, bits);
+  constants_[{type, bits}] = instruction;
+  return instruction;
+}
+
+SsaInstruction *SsaFunction::realConstant(double value) {
+  int64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return constant(SsaType::Real, bits);
+}
+
+void SsaFunction::replaceUses(
+    const std::unordered_map<SsaInstruction *, SsaInstruction *> &map) {
+  if (map.empty())
+    return;
+  auto resolve = [&map](SsaInstruction *value) {
+    // chains are short, and a cycle would be a bug of the caller
+    for (size_t steps = 0; steps <= map.size(); steps++) {
+      auto next = map.find(value);
+      if (next == map.end())
+        break;
+      value = next->second;
+    }
+    return value;
+  };
+  for (const auto &block : blocks) {
+    for (SsaInstruction *instruction : block->instructions) {
+      for (SsaInstruction *&operand : instruction->operands)
+        operand = resolve(operand);
+    }
+  }
+}
+
+void SsaFunction::remove(SsaInstruction *instruction) {
+  SsaBlock *block = instruction->block;
+  if (block == nullptr)
+    return;
+  auto &list = block->instructions;
+  list.erase(std::find(list.begin(), list.end(), instruction));
+  instruction->block = nullptr;
+}
+
+void SsaFunction::removeEdge(SsaBlock *from, SsaBlock *to) {
+  int index = to->predecessorIndex(from);
+  if (index == -1)
+    return;
+  to->predecessors.erase(to->predecessors.begin() + index);
+  for (size_t i = 0; i < to->firstNonPhi(); i++) {
+    auto &operands = to->instructions[i]->operands;
+    operands.erase(operands.begin() + index);
+  }
+  auto &successors = from->successors;
+  successors.erase(std::find(successors.begin(), successors.end(), to));
+}
+
+SsaBlock *SsaFunction::splitEdge(SsaBlock *from, SsaBlock *to) {
+  SsaBlock *middle = addBlock();
+  *std::find(from->successors.begin(), from->successors.end(), to) = middle;
+  to->predecessors[to->predecessorIndex(from)] = middle;
+  middle->predecessors.push_back(from);
+  middle->successors.push_back(to);
+  append(middle, SsaOpcode::Jump, SsaType::None);
+  return middle;
+}
+
+bool SsaFunction::removeUnreachable() {
+  std::vector<bool> reached(blockIds(), false);
+  for (SsaBlock *block : reversePostorder())
+    reached[block->id] = true;
+  bool removed = false;
+  for (const auto &block : blocks) {
+    if (reached[block->id])
+      continue;
+    removed = true;
+    while (!block->successors.empty())
+      removeEdge(block.get(), block->successors.front());
+    for (SsaInstruction *instruction : block->instructions)
+      instruction->block = nullptr;
+  }
+  if (removed)
+    blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                                [&reached](const auto &block) {
+                                  return !reached[block->id];
+                                }),
+                 blocks.end());
+  return removed;
+}
+
+std::vector<SsaBlock *> SsaFunction::reversePostorder() const {
+  std::vector<SsaBlock *> order;
+  std::vector<bool> visited(blockIds(), false);
+  // the last successor is visited first, so the first one ends up right
+  // after its predecessor
+  std::vector<std::pair<SsaBlock *, size_t>> stack;
+  stack.push_back({entry(), entry()->successors.size()});
+  visited[entry()->id] = true;
+  while (!stack.empty()) {
+    auto &[block, next] = stack.back();
+    if (next == 0) {
+      order.push_back(block);
+      stack.pop_back();
+      continue;
+    }
+    SsaBlock *successor = block->successors[--next];
+    if (visited[successor->id])
+      continue;
+    visited[successor->id] = true;
+    stack.push_back({successor, successor->successors.size()});
+  }
+  std::reverse(order.begin(), order.end());
+  return order;
+}
+
+std::string SsaFunction::verify() const {
+  std::ostringstream problem;
+  std::unordered_set<const SsaBlock *> present;
+  for (const auto &block : blocks)
+    present.insert(block.get());
+  for (const auto &block : blocks) {
+    const std::string where = header.name + " b" + std::to_string(block->id);
+    if (block->instructions.empty() ||
+        !isTerminator(block->terminator()->opcode))
+      return where + " does not end with a terminator";
+    size_t phis = block->firstNonPhi();
+    for (size_t i = 0; i < block->instructions.size(); i++) {
+      const SsaInstruction *instruction = block->instructions[i];
+      if (instruction->block != block.get())
+        return where + " holds %" + std::to_string(instruction->id) +
+               " of another block";
+      if (i + 1 < block->instructions.size() &&
+          isTerminator(instruction->opcode))
+        return where + " has a terminator before its end";
+      if (i >= phis && instruction->opcode == SsaOpcode::Phi)
+        return where + " has a phi after other instructions";
+      if (instruction->opcode == SsaOpcode::Phi &&
+          instruction->operands.size() != block->predecessors.size())
+        return where + " has a phi without one value per predecessor";
+      for (const SsaInstruction *operand : instruction->operands) {
+        if (operand == nullptr ||
+            (!operand->isConstant() && operand->block == nullptr))
+          return where + " uses a removed value in %" +
+                 std::to_string(instruction->id);
+      }
+    }
+    size_t expected = 0;
+    if (block->terminator()->opcode == SsaOpcode::Jump)
+      expected = 1;
+    else if (block->terminator()->opcode == SsaOpcode::Branch)
+      expected = 2;
+    if (block->successors.size() != expected)
+      return where + " has the wrong number of successors";
+    for (const SsaBlock *successor : block->successors) {
+      if (present.count(successor) == 0 ||
+          std::count(block->successors.begin(), block->successors.end(),
+                     successor) !=
+              std::count(successor->predecessors.begin(),
+                         successor->predecessors.end(), block.get()))
+        return where + " and its successors disagree on their edges";
+    }
+    for (const SsaBlock *predecessor : block->predecessors) {
+      if (present.count(predecessor) == 0)
+        return where + " has a removed predecessor";
+    }
+  }
+
+  // every value is defined before its uses
+  DominatorTree tree(*this);
+  std::vector<int> position(valueIds(), -1);
+  for (const auto &block : blocks) {
+    for (size_t i = 0; i < block->instructions.size(); i++)
+      position[block->instructions[i]->id] = (int)i;
+  }
+  for (const auto &block : blocks) {
+    if (!tree.reachable(block.get()))
+      continue;
+    for (size_t i = 0; i < block->instructions.size(); i++) {
+      const SsaInstruction *instruction = block->instructions[i];
+      for (size_t j = 0; j < instruction->operands.size(); j++) {
+        const SsaInstruction *operand = instruction->operands[j];
+        if (operand->isConstant())
+          continue;
+        const SsaBlock *use = block.get();
+        int at = (int)i;
+        if (instruction->opcode == SsaOpcode::Phi) {
+          use = block->predecessors[j];
+          at = (int)use->instructions.size();
+        }
+        bool defined = operand->block == use
+                           ? position[operand->id] < at
+                           : tree.dominates(operand->block, use);
+        if (!defined)
+          return header.name + " uses %" + std::to_string(operand->id) +
+                 " in %" + std::to_string(instruction->id) +
+                 " where it is not defined";
+      }
+    }
+  }
+  return "";
+}
+
+void SsaFunction::print(std::ostream &out) const {
+  out << "routine " << header.name << " (" << header.parameters
+      << " parameters)\n";
+  for (const auto &block : blocks) {
+    out << "  b" << block->id << ":";
+    if (!block->predecessors.empty()) {
+      out << " from";
+      for (const SsaBlock *predecessor : block->predecessors)
+        out << " b" << predecessor->id;
+    }
+    out << "\n";
+    for (const SsaInstruction *instruction : block->instructions) {
+      out << "    ";
+      if (instruction->type != SsaType::None)
+        out << "%" << instruction->id << " = ";
+      out << ssaOpcodeName(instruction->opcode);
+      if (instruction->type != SsaType::None)
+        out << " " << ssaTypeName(instruction->type);
+      for (size_t i = 0; i < instruction->operands.size(); i++)
+        out << (i == 0 ? " " : ", ")
+            << operandName(instruction->operands[i]);
+      int fields = fieldCount(instruction->opcode);
+      if (fields > 0)
+        out << " ; " << instruction->a;
+      if (fields > 1)
+        out << ", " << instruction->b;
+      if (!block->successors.empty() && instruction == block->terminator()) {
+        out << " ->";
+        for (const SsaBlock *successor : block->successors)
+          out << " b" << successor->id;
+      }
+      out << "\n";
+    }
+  }
+}
+
+int SsaProgram::find(const std::string &name) const {
+  auto routine = routine_index.find(name);
+  return routine == routine_index.end() ? -1 : routine->second;
+}
+
+void SsaProgram::print(std::ostream &out) const {
+  initializer->print(out);
+  for (const auto &routine : routines)
+    routine->print(out);
+}
+
+bool isTerminator(SsaOpcode opcode) {
+  switch (opcode) {
+  case SsaOpcode::Jump:
+  case SsaOpcode::Branch:
+  case SsaOpcode::Return:
+  case SsaOpcode::ReturnVoid:
+  case SsaOpcode::MissingReturn:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool hasSideEffects(const SsaInstruction &instruction) {
+  switch (instruction.opcode) {
+  case SsaOpcode::StoreGlobal:
+  case SsaOpcode::Allocate:
+  case SsaOpcode::AllocateGlobal:
+  case SsaOpcode::StoreInt:
+  case SsaOpcode::StoreReal:
+  case SsaOpcode::StoreBool:
+  case SsaOpcode::Copy:
+  case SsaOpcode::Call:
+    return true;
+  default:
+    return isTerminator(instruction.opcode);
+  }
+}
+
+bool canTrap(const SsaInstruction &instruction) {
+  const SsaInstruction *first =
+      instruction.operands.empty() ? nullptr : instruction.operands[0];
+  switch (instruction.opcode) {
+  case SsaOpcode::DivInt:
+  case SsaOpcode::ModInt:
+    return instruction.a == 0 && (!instruction.operands[1]->isConstant() ||
+                                  instruction.operands[1]->a == 0);
+  case SsaOpcode::DivReal:
+    return !instruction.operands[1]->isConstant() ||
+           instruction.operands[1]->real() == 0;
+  case SsaOpcode::RealToInt:
+    return !first->isConstant() || !(std::fabs(first->real()) < 9.2e18);
+  case SsaOpcode::IntToBool:
+    return first->type != SsaType::Boolean &&
+           (!first->isConstant() || (first->a != 0 && first->a != 1));
+  case SsaOpcode::Allocate:
+  case SsaOpcode::AllocateGlobal:
+    return !instruction.operands.empty();
+  case SsaOpcode::Index:
+  case SsaOpcode::Copy:
+  case SsaOpcode::Call:
+  case SsaOpcode::MissingReturn:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool readsMemory(SsaOpcode opcode) {
+  switch (opcode) {
+  case SsaOpcode::LoadGlobal:
+  case SsaOpcode::Length:
+  case SsaOpcode::LoadInt:
+  case SsaOpcode::LoadReal:
+  case SsaOpcode::LoadBool:
+  case SsaOpcode::Call:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool isPure(const SsaInstruction &instruction) {
+  return instruction.opcode != SsaOpcode::Phi &&
+         instruction.opcode != SsaOpcode::Parameter &&
+         !hasSideEffects(instruction) && !canTrap(instruction) &&
+         !readsMemory(instruction.opcode);
+}
+
+bool isCommutative(SsaOpcode opcode) {
+  switch (opcode) {
+  case SsaOpcode::AddInt:
+  case SsaOpcode::MulInt:
+  case SsaOpcode::AddReal:
+  case SsaOpcode::MulReal:
+  case SsaOpcode::EqualInt:
+  case SsaOpcode::NotEqualInt:
+  case SsaOpcode::EqualReal:
+  case SsaOpcode::NotEqualReal:
+  case SsaOpcode::And:
+  case SsaOpcode::Or:
+  case SsaOpcode::Xor:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool isIntCompare(SsaOpcode opcode) {
+  return opcode >= SsaOpcode::LessInt && opcode <= SsaOpcode::NotEqualInt;
+}
+
+SsaOpcode swappedCompare(SsaOpcode compare) {
+  switch (compare) {
+  case SsaOpcode::LessInt:
+    return SsaOpcode::GreaterInt;
+  case SsaOpcode::LessEqInt:
+    return SsaOpcode::GreaterEqInt;
+  case SsaOpcode::GreaterInt:
+    return SsaOpcode::LessInt;
+  case SsaOpcode::GreaterEqInt:
+    return SsaOpcode::LessEqInt;
+  default:
+    return compare;
+  }
+}
+
+SsaOpcode negatedCompare(SsaOpcode compare) {
+  switch (compare) {
+  case SsaOpcode::LessInt:
+    return SsaOpcode::GreaterEqInt;
+  case SsaOpcode::LessEqInt:
+    return SsaOpcode::GreaterInt;
+  case SsaOpcode::GreaterInt:
+    return SsaOpcode::LessEqInt;
+  case SsaOpcode::GreaterEqInt:
+    return SsaOpcode::LessInt;
+  case SsaOpcode::EqualInt:
+    return SsaOpcode::NotEqualInt;
+  default:
+    return SsaOpcode::EqualInt;
+  }
+}
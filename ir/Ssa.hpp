@@ -0,0 +1,215 @@
+#ifndef CC_PROJECT_SSA_HPP
+#define CC_PROJECT_SSA_HPP
+
+#include "vm/Bytecode.hpp"
+#include <map>
+#include <memory>
+
+// Static single assignment form of the bytecode. Every instruction defines
+// at most one value and names the instructions whose values it uses as
+// operands, in the order the stack code pushed them. Frame slots and
+// operand stack positions become values, merged by phi instructions at the
+// start of blocks; globals, aggregates and the buffers behind them stay in
+// memory. Constants belong to the function, not to a block.
+
+// X(opcode, printed name) for every opcode; the comments give the operands
+// and then the fields a and b
+#define CC_PROJECT_SSA_OPCODES(X)                                             \
+  X(Constant, "constant")             /* ; bits of the value */               \
+  X(Parameter, "parameter")           /* ; index */                           \
+  X(Phi, "phi")                       /* one value per predecessor */         \
+  X(LoadGlobal, "load_global")        /* ; slot */                            \
+  X(StoreGlobal, "store_global")      /* value ; slot */                      \
+  X(Allocate, "allocate")             /* (length) ; slot, shape */            \
+  X(AllocateGlobal, "allocate_global") /* (length) ; slot, shape */           \
+  X(Field, "field")                   /* address ; offset */                  \
+  X(Index, "index")                   /* address index ; shape */             \
+  X(IndexUnchecked, "index_unchecked") /* proven in bounds */                 \
+  X(Length, "length")                 /* address ; shape */                   \
+  X(LoadInt, "load_int")              /* address */                           \
+  X(LoadReal, "load_real")                                                    \
+  X(LoadBool, "load_bool")                                                    \
+  X(StoreInt, "store_int")            /* value address */                     \
+  X(StoreReal, "store_real")                                                  \
+  X(StoreBool, "store_bool")                                                  \
+  X(Copy, "copy")                     /* source target ; shape */             \
+  X(AddInt, "add_int")                /* left right */                        \
+  X(SubInt, "sub_int")                                                        \
+  X(MulInt, "mul_int")                                                        \
+  X(DivInt, "div_int")                /* left right ; 1 if the divisor */     \
+  X(ModInt, "mod_int")                /* is proven not 0 or -1 */             \
+  X(AddReal, "add_real")                                                      \
+  X(SubReal, "sub_real")                                                      \
+  X(MulReal, "mul_real")                                                      \
+  X(DivReal, "div_real")                                                      \
+  X(NegInt, "neg_int")                /* operand */                           \
+  X(NegReal, "neg_real")                                                      \
+  X(LessInt, "less_int")              /* left right */                        \
+  X(LessEqInt, "less_eq_int")                                                 \
+  X(GreaterInt, "greater_int")                                                \
+  X(GreaterEqInt, "greater_eq_int")                                           \
+  X(EqualInt, "equal_int")                                                    \
+  X(NotEqualInt, "not_equal_int")                                             \
+  X(LessReal, "less_real")                                                    \
+  X(LessEqReal, "less_eq_real")                                               \
+  X(GreaterReal, "greater_real")                                              \
+  X(GreaterEqReal, "greater_eq_real")                                         \
+  X(EqualReal, "equal_real")                                                  \
+  X(NotEqualReal, "not_equal_real")                                           \
+  X(And, "and")                                                               \
+  X(Or, "or")                                                                 \
+  X(Xor, "xor")                                                               \
+  X(Not, "not")                       /* operand */                           \
+  X(IntToReal, "int_to_real")                                                 \
+  X(RealToInt, "real_to_int")                                                 \
+  X(IntToBool, "int_to_bool")                                                 \
+  X(Call, "call")                     /* arguments ; routine, result slot */  \
+  X(Jump, "jump")                     /* to the only successor */             \
+  X(Branch, "branch")                 /* condition ; to successor 0 if true */ \
+  X(Return, "return")                 /* value */                             \
+  X(ReturnVoid, "return_void")                                                \
+  X(MissingReturn, "missing_return")
+
+enum class SsaOpcode : uint8_t {
+#define CC_PROJECT_OPCODE(opcode, name) opcode,
+  CC_PROJECT_SSA_OPCODES(CC_PROJECT_OPCODE)
+#undef CC_PROJECT_OPCODE
+  OpcodeCount
+};
+
+const char *ssaOpcodeName(SsaOpcode opcode);
+
+// Booleans are the integers 0 and 1; addresses point into the buffers of
+// aggregates
+enum class SsaType : uint8_t { None, Integer, Real, Boolean, Address };
+
+const char *ssaTypeName(SsaType type);
+
+struct SsaBlock;
+
+struct SsaInstruction {
+  SsaOpcode opcode;
+  SsaType type = SsaType::None;
+  // unique within the function
+  int id = -1;
+  std::vector<SsaInstruction *> operands;
+  int64_t a = 0;
+  int64_t b = 0;
+  // routine the instruction was inlined from, -1 for the function's own
+  int origin = -1;
+  // nullptr for constants and removed instructions
+  SsaBlock *block = nullptr;
+
+  bool isConstant() const { return opcode == SsaOpcode::Constant; }
+  double real() const;
+};
+
+struct SsaBlock {
+  int id = -1;
+  // phis first, then the body, then one terminator
+  std::vector<SsaInstruction *> instructions;
+  std::vector<SsaBlock *> predecessors;
+  // a branch goes to the first successor when its condition holds
+  std::vector<SsaBlock *> successors;
+
+  SsaInstruction *terminator() const { return instructions.back(); }
+  // position of the first instruction that is not a phi
+  size_t firstNonPhi() const;
+  // position of block among the predecessors, -1 if it is none
+  int predecessorIndex(const SsaBlock *block) const;
+};
+
+class SsaFunction {
+public:
+  SsaFunction() = default;
+  SsaFunction(const SsaFunction &) = delete;
+  SsaFunction &operator=(const SsaFunction &) = delete;
+
+  // the bytecode routine without its code, so that the function can be
+  // lowered back with the same calling convention
+  Routine header;
+  // the entry first, then in layout order
+  std::vector<std::unique_ptr<SsaBlock>> blocks;
+
+  SsaBlock *entry() const { return blocks.front().get(); }
+  SsaBlock *addBlock();
+  // a new instruction that belongs to no block yet
+  SsaInstruction *create(SsaOpcode opcode, SsaType type,
+                         std::vector<SsaInstruction *> operands = {},
+                         int64_t a = 0, int64_t b = 0);
+  SsaInstruction *append(SsaBlock *block, SsaOpcode opcode, SsaType type,
+                         std::vector<SsaInstruction *> operands = {},
+                         int64_t a = 0, int64_t b = 0);
+  // place instruction in block right before its terminator
+  void insertBeforeTerminator(SsaBlock *block, SsaInstruction *instruction);
+  // shared constants of the function
+  SsaInstruction *constant(SsaType type, int64_t bits);
+  SsaInstruction *realConstant(double value);
+
+  // make every use of a key use its value instead; values may themselves
+  // be keys
+  void replaceUses(
+      const std::unordered_map<SsaInstruction *, SsaInstruction *> &map);
+  // take instruction out of its block
+  void remove(SsaInstruction *instruction);
+  // drop the edge and the phi operands that came along it
+  void removeEdge(SsaBlock *from, SsaBlock *to);
+  // put a new block on the edge and return it
+  SsaBlock *splitEdge(SsaBlock *from, SsaBlock *to);
+  // delete the blocks the entry cannot reach; true if there were any
+  bool removeUnreachable();
+  // reachable blocks in reverse postorder, the first successor of a branch
+  // right after it where possible
+  std::vector<SsaBlock *> reversePostorder() const;
+
+  // upper bounds of the ids, for tables indexed by them
+  int blockIds() const { return next_block_; }
+  int valueIds() const { return (int)values_.size(); }
+  // instructions, including removed ones, indexed by id
+  SsaInstruction *value(int id) const { return values_[id].get(); }
+
+  // description of the first broken invariant, empty if there is none
+  std::string verify() const;
+  void print(std::ostream &out) const;
+
+private:
+  std::vector<std::unique_ptr<SsaInstruction>> values_;
+  std::map<std::pair<SsaType, int64_t>, SsaInstruction *> constants_;
+  int next_block_ = 0;
+};
+
+struct SsaProgram {
+  std::vector<Shape> shapes;
+  std::vector<std::unique_ptr<SsaFunction>> routines;
+  std::unique_ptr<SsaFunction> initializer;
+  int global_frame_size = 0;
+  std::vector<SsaType> global_types;
+  std::unordered_map<std::string, int> routine_index;
+
+  // -1 when there is no such routine
+  int find(const std::string &name) const;
+
+  void print(std::ostream &out) const;
+};
+
+bool isTerminator(SsaOpcode opcode);
+// stores, calls, allocation and control flow
+bool hasSideEffects(const SsaInstruction &instruction);
+// may end the program with a runtime error; division by a constant other
+// than zero and conversions of constants that fit cannot
+bool canTrap(const SsaInstruction &instruction);
+// reads globals or aggregates, which stores and calls may change
+bool readsMemory(SsaOpcode opcode);
+// depends on nothing but its operands, and can be moved and repeated
+// freely
+bool isPure(const SsaInstruction &instruction);
+// the operands may be swapped
+bool isCommutative(SsaOpcode opcode);
+// comparisons of integers, less_int to not_equal_int
+bool isIntCompare(SsaOpcode opcode);
+// the comparison of integers with its operands the other way around
+SsaOpcode swappedCompare(SsaOpcode compare);
+// the comparison of integers that holds exactly when compare does not
+SsaOpcode negatedCompare(SsaOpcode compare);
+
+#endif // CC_PROJECT_SSA_HPP
@@ -0,0 +1,580 @@
+#include "ir/SsaBuilder.hpp"
+
+namespace {
+
+// stack and SSA opcodes of the memory, arithmetic, comparison and logic
+// groups come in the same order
+static_assert((int)Opcode::StoreBool - (int)Opcode::LoadInt ==
+                  (int)SsaOpcode::StoreBool - (int)SsaOpcode::LoadInt,
+              "memory opcodes must line up");
+static_assert((int)Opcode::Xor - (int)Opcode::AddInt ==
+                  (int)SsaOpcode::Xor - (int)SsaOpcode::AddInt,
+              "operator opcodes must line up");
+static_assert((int)Opcode::IntToBool - (int)Opcode::Not ==
+                  (int)SsaOpcode::IntToBool - (int)SsaOpcode::Not,
+              "unary opcodes must line up");
+
+SsaOpcode ssaOpcode(Opcode opcode, Opcode first, SsaOpcode first_ssa) {
+  return (SsaOpcode)((int)first_ssa + (int)opcode - (int)first);
+}
+
+SsaType typeOf(ConstantValue::Kind kind) {
+  switch (kind) {
+  case ConstantValue::Integer:
+    return SsaType::Integer;
+  case ConstantValue::Real:
+    return SsaType::Real;
+  case ConstantValue::Boolean:
+    return SsaType::Boolean;
+  default:
+    return SsaType::None;
+  }
+}
+
+// type of the value an operation computes
+SsaType resultType(SsaOpcode opcode) {
+  if (opcode >= SsaOpcode::AddInt && opcode <= SsaOpcode::ModInt)
+    return SsaType::Integer;
+  if (opcode >= SsaOpcode::AddReal && opcode <= SsaOpcode::DivReal)
+    return SsaType::Real;
+  if (opcode >= SsaOpcode::LessInt && opcode <= SsaOpcode::Not)
+    return SsaType::Boolean;
+  switch (opcode) {
+  case SsaOpcode::NegInt:
+  case SsaOpcode::RealToInt:
+  case SsaOpcode::LoadInt:
+    return SsaType::Integer;
+  case SsaOpcode::NegReal:
+  case SsaOpcode::IntToReal:
+  case SsaOpcode::LoadReal:
+    return SsaType::Real;
+  case SsaOpcode::IntToBool:
+  case SsaOpcode::LoadBool:
+    return SsaType::Boolean;
+  default:
+    return SsaType::None;
+  }
+}
+
+class Builder {
+public:
+  Builder(const Program &program, SsaProgram &result)
+      : program_(program), result_(result) {}
+
+  std::unique_ptr<SsaFunction> build(const Routine &routine);
+
+private:
+  struct Step {
+    Opcode opcode;
+    int32_t first = 0;
+    int32_t second = 0;
+  };
+
+  void fill(SsaBlock *block, size_t start, size_t end);
+  void translate(const Step &step, SsaBlock *block);
+  // the operand stack is left in variables for the successors
+  void flush(SsaBlock *block);
+  void sealReady();
+
+  void write(int variable, SsaBlock *block, SsaInstruction *value);
+  SsaInstruction *read(int variable, SsaBlock *block);
+  SsaInstruction *readRecursive(int variable, SsaBlock *block);
+  SsaInstruction *phi(SsaBlock *block);
+  void addOperands(int variable, SsaInstruction *phi);
+  void seal(SsaBlock *block);
+  // phis that merge one value, or only themselves, are that value
+  void removeTrivialPhis();
+  void inferTypes();
+
+  SsaInstruction *pop();
+  void push(SsaInstruction *value) { stack_.push_back(value); }
+  SsaInstruction *append(SsaBlock *block, SsaOpcode opcode, SsaType type,
+                         std::vector<SsaInstruction *> operands = {},
+                         int64_t a = 0, int64_t b = 0) {
+    return function_->append(block, opcode, type, std::move(operands), a, b);
+  }
+
+  const Program &program_;
+  SsaProgram &result_;
+  SsaFunction *function_ = nullptr;
+  std::vector<Step> steps_;
+  // operand stack position p is variable frame_size_ + p
+  int frame_size_ = 0;
+  std::vector<SsaInstruction *> stack_;
+  // by block id
+  std::vector<std::unordered_map<int, SsaInstruction *>> definitions_;
+  std::vector<std::vector<std::pair<int, SsaInstruction *>>> incomplete_;
+  std::vector<bool> sealed_;
+  std::vector<bool> filled_;
+  std::vector<int> depth_;
+};
+
+std::unique_ptr<SsaFunction> Builder::build(const Routine &routine) {
+  auto function = std::make_unique<SsaFunction>();
+  function_ = function.get();
+  function->header = routine;
+  function->header.code.clear();
+  frame_size_ = routine.frame_size;
+
+  // blocks start at jump targets and after jumps and returns
+  steps_.clear();
+  std::unordered_map<size_t, size_t> step_at;
+  const uint8_t *code = routine.code.data();
+  for (size_t pc = 0; pc < routine.code.size();) {
+    Step step;
+    step.opcode = (Opcode)code[pc];
+    int operands = operandCount(step.opcode);
+    if (operands > 0)
+      step.first = readOperand(code + pc + 1);
+    if (operands > 1)
+      step.second = readOperand(code + pc + 5);
+    step_at[pc] = steps_.size();
+    steps_.push_back(step);
+    pc += 1 + 4 * operands;
+  }
+  std::vector<bool> leader(steps_.size() + 1, false);
+  leader[0] = true;
+  for (size_t i = 0; i < steps_.size(); i++) {
+    switch (steps_[i].opcode) {
+    case Opcode::Jump:
+    case Opcode::JumpIfFalse:
+      leader[step_at[(size_t)steps_[i].first]] = true;
+      leader[i + 1] = true;
+      break;
+    case Opcode::Return:
+    case Opcode::ReturnVoid:
+    case Opcode::MissingReturn:
+      leader[i + 1] = true;
+      break;
+    default:
+      break;
+    }
+  }
+  std::vector<size_t> starts;
+  std::vector<int> range_of(steps_.size(), -1);
+  for (size_t i = 0; i < steps_.size(); i++) {
+    if (leader[i])
+      starts.push_back(i);
+    range_of[i] = (int)starts.size() - 1;
+  }
+  starts.push_back(steps_.size());
+
+  // successors of each range: a conditional jump falls through when its
+  // condition holds
+  size_t ranges = starts.size() - 1;
+  std::vector<std::vector<int>> successors(ranges);
+  for (size_t r = 0; r < ranges; r++) {
+    const Step &last = steps_[starts[r + 1] - 1];
+    int target = -1;
+    if (last.opcode == Opcode::Jump || last.opcode == Opcode::JumpIfFalse)
+      target = range_of[step_at[(size_t)last.first]];
+    if (last.opcode == Opcode::Jump) {
+      successors[r].push_back(target);
+    } else if (last.opcode == Opcode::JumpIfFalse) {
+      successors[r].push_back((int)r + 1);
+      if (target != (int)r + 1)
+        successors[r].push_back(target);
+    } else if (last.opcode != Opcode::Return &&
+               last.opcode != Opcode::ReturnVoid &&
+               last.opcode != Opcode::MissingReturn) {
+      successors[r].push_back((int)r + 1);
+    }
+  }
+  std::vector<bool> reached(ranges, false);
+  std::vector<int> work{0};
+  reached[0] = true;
+  while (!work.empty()) {
+    int range = work.back();
+    work.pop_back();
+    for (int successor : successors[range]) {
+      if (!reached[successor]) {
+        reached[successor] = true;
+        work.push_back(successor);
+      }
+    }
+  }
+
+  SsaBlock *entry = function->addBlock();
+  std::vector<SsaBlock *> blocks(ranges, nullptr);
+  for (size_t r = 0; r < ranges; r++) {
+    if (reached[r])
+      blocks[r] = function->addBlock();
+  }
+  entry->successors.push_back(blocks[0]);
+  blocks[0]->predecessors.push_back(entry);
+  for (size_t r = 0; r < ranges; r++) {
+    if (!reached[r])
+      continue;
+    for (int successor : successors[r]) {
+      blocks[r]->successors.push_back(blocks[successor]);
+      blocks[successor]->predecessors.push_back(blocks[r]);
+    }
+  }
+
+  int ids = function->blockIds();
+  definitions_.assign(ids, {});
+  incomplete_.assign(ids, {});
+  sealed_.assign(ids, false);
+  filled_.assign(ids, false);
+  depth_.assign(ids, -1);
+  for (int i = 0; i < routine.parameters; i++) {
+    SsaType type = routine.parameter_shapes[i] != -1
+                       ? SsaType::Address
+                       : typeOf(routine.parameter_kinds[i]);
+    write(i, entry, append(entry, SsaOpcode::Parameter, type, {}, i));
+  }
+  append(entry, SsaOpcode::Jump, SsaType::None);
+  sealed_[entry->id] = filled_[entry->id] = true;
+  depth_[blocks[0]->id] = 0;
+  sealReady();
+  for (size_t r = 0; r < ranges; r++) {
+    if (blocks[r] == nullptr)
+      continue;
+    fill(blocks[r], starts[r], starts[r + 1]);
+    sealReady();
+  }
+  removeTrivialPhis();
+  inferTypes();
+  return function;
+}
+
+void Builder::fill(SsaBlock *block, size_t start, size_t end) {
+  stack_.clear();
+  for (int p = 0; p < depth_[block->id]; p++)
+    push(read(frame_size_ + p, block));
+  for (size_t i = start; i < end; i++)
+    translate(steps_[i], block);
+  if (block->instructions.empty() ||
+      !isTerminator(block->terminator()->opcode)) {
+    flush(block);
+    append(block, SsaOpcode::Jump, SsaType::None);
+  }
+  filled_[block->id] = true;
+}
+
+void Builder::translate(const Step &step, SsaBlock *block) {
+  switch (step.opcode) {
+  case Opcode::PushInt:
+    push(function_->constant(SsaType::Integer, step.first));
+    return;
+  case Opcode::PushConst: {
+    const ConstantValue &constant = program_.constants[step.first];
+    if (constant.kind == ConstantValue::Real)
+      push(function_->realConstant(constant.real));
+    else if (constant.kind == ConstantValue::Boolean)
+      push(function_->constant(SsaType::Boolean, constant.boolean));
+    else
+      push(function_->constant(SsaType::Integer, constant.integer));
+    return;
+  }
+  case Opcode::Pop:
+    pop();
+    return;
+  case Opcode::LoadLocal:
+    push(read(step.first, block));
+    return;
+  case Opcode::StoreLocal:
+    write(step.first, block, pop());
+    return;
+  case Opcode::LoadGlobal: {
+    SsaType type = result_.global_types[step.first];
+    push(append(block, SsaOpcode::LoadGlobal,
+                type == SsaType::None ? SsaType::Integer : type, {},
+                step.first));
+    return;
+  }
+  case Opcode::StoreGlobal: {
+    SsaInstruction *value = pop();
+    if (result_.global_types[step.first] == SsaType::None)
+      result_.global_types[step.first] = value->type;
+    append(block, SsaOpcode::StoreGlobal, SsaType::None, {value},
+           step.first);
+    return;
+  }
+  case Opcode::Allocate:
+  case Opcode::AllocateGlobal: {
+    std::vector<SsaInstruction *> length;
+    if (program_.shapes[step.second].length < 0)
+      length.push_back(pop());
+    if (step.opcode == Opcode::AllocateGlobal) {
+      result_.global_types[step.first] = SsaType::Address;
+      append(block, SsaOpcode::AllocateGlobal, SsaType::None, length,
+             step.first, step.second);
+      return;
+    }
+    write(step.first, block,
+          append(block, SsaOpcode::Allocate, SsaType::Address, length,
+                 step.first, step.second));
+    return;
+  }
+  case Opcode::Field:
+    push(append(block, SsaOpcode::Field, SsaType::Address, {pop()},
+                step.first));
+    return;
+  case Opcode::Index: {
+    SsaInstruction *index = pop();
+    SsaInstruction *base = pop();
+    push(append(block,
+                step.second != 0 ? SsaOpcode::Index
+                                 : SsaOpcode::IndexUnchecked,
+                SsaType::Address, {base, index}, step.first));
+    return;
+  }
+  case Opcode::Length:
+    push(append(block, SsaOpcode::Length, SsaType::Integer, {pop()},
+                step.first));
+    return;
+  case Opcode::LoadInt:
+  case Opcode::LoadReal:
+  case Opcode::LoadBool: {
+    SsaOpcode opcode =
+        ssaOpcode(step.opcode, Opcode::LoadInt, SsaOpcode::LoadInt);
+    push(append(block, opcode, resultType(opcode), {pop()}));
+    return;
+  }
+  case Opcode::StoreInt:
+  case Opcode::StoreReal:
+  case Opcode::StoreBool: {
+    SsaInstruction *address = pop();
+    SsaInstruction *value = pop();
+    append(block, ssaOpcode(step.opcode, Opcode::LoadInt, SsaOpcode::LoadInt),
+           SsaType::None, {value, address});
+    return;
+  }
+  case Opcode::Copy: {
+    SsaInstruction *target = pop();
+    SsaInstruction *source = pop();
+    append(block, SsaOpcode::Copy, SsaType::None, {source, target},
+           step.first);
+    return;
+  }
+  case Opcode::NegInt:
+  case Opcode::NegReal:
+  case Opcode::Not:
+  case Opcode::IntToReal:
+  case Opcode::RealToInt:
+  case Opcode::IntToBool: {
+    SsaOpcode opcode =
+        step.opcode == Opcode::NegInt || step.opcode == Opcode::NegReal
+            ? ssaOpcode(step.opcode, Opcode::NegInt, SsaOpcode::NegInt)
+            : ssaOpcode(step.opcode, Opcode::Not, SsaOpcode::Not);
+    push(append(block, opcode, resultType(opcode), {pop()}));
+    return;
+  }
+  case Opcode::Jump:
+    flush(block);
+    append(block, SsaOpcode::Jump, SsaType::None);
+    return;
+  case Opcode::JumpIfFalse: {
+    SsaInstruction *condition = pop();
+    flush(block);
+    if (block->successors.size() == 2)
+      append(block, SsaOpcode::Branch, SsaType::None, {condition});
+    else
+      append(block, SsaOpcode::Jump, SsaType::None);
+    return;
+  }
+  case Opcode::DivInt:
+  case Opcode::ModInt: {
+    SsaInstruction *right = pop();
+    SsaInstruction *left = pop();
+    push(append(block,
+                step.opcode == Opcode::DivInt ? SsaOpcode::DivInt
+                                              : SsaOpcode::ModInt,
+                SsaType::Integer, {left, right}, step.first == 0 ? 1 : 0));
+    return;
+  }
+  case Opcode::Call: {
+    const Routine &callee = program_.routines[step.first];
+    std::vector<SsaInstruction *> arguments(stack_.end() - callee.parameters,
+                                            stack_.end());
+    stack_.resize(stack_.size() - callee.parameters);
+    SsaType type = SsaType::None;
+    if (callee.returns)
+      type = callee.result_shape != -1 ? SsaType::Address
+                                       : typeOf(callee.result_kind);
+    SsaInstruction *call = append(block, SsaOpcode::Call, type, arguments,
+                                  step.first, step.second);
+    if (callee.returns)
+      push(call);
+    return;
+  }
+  case Opcode::Return:
+    append(block, SsaOpcode::Return, SsaType::None, {pop()});
+    return;
+  case Opcode::ReturnVoid:
+    append(block, SsaOpcode::ReturnVoid, SsaType::None);
+    return;
+  case Opcode::MissingReturn:
+    append(block, SsaOpcode::MissingReturn, SsaType::None);
+    return;
+  default: {
+    SsaInstruction *right = pop();
+    SsaInstruction *left = pop();
+    SsaOpcode opcode =
+        ssaOpcode(step.opcode, Opcode::AddInt, SsaOpcode::AddInt);
+    push(append(block, opcode, resultType(opcode), {left, right}));
+    return;
+  }
+  }
+}
+
+void Builder::flush(SsaBlock *block) {
+  for (size_t p = 0; p < stack_.size(); p++)
+    write(frame_size_ + (int)p, block, stack_[p]);
+  for (SsaBlock *successor : block->successors) {
+    if (depth_[successor->id] == -1)
+      depth_[successor->id] = (int)stack_.size();
+  }
+}
+
+// blocks whose predecessors are all filled get no more phi operands
+void Builder::sealReady() {
+  for (const auto &block : function_->blocks) {
+    if (sealed_[block->id])
+      continue;
+    bool ready = true;
+    for (SsaBlock *predecessor : block->predecessors)
+      ready = ready && filled_[predecessor->id];
+    if (ready)
+      seal(block.get());
+  }
+}
+
+void Builder::write(int variable, SsaBlock *block, SsaInstruction *value) {
+  definitions_[block->id][variable] = value;
+}
+
+SsaInstruction *Builder::read(int variable, SsaBlock *block) {
+  auto known = definitions_[block->id].find(variable);
+  if (known != definitions_[block->id].end())
+    return known->second;
+  return readRecursive(variable, block);
+}
+
+SsaInstruction *Builder::readRecursive(int variable, SsaBlock *block) {
+  SsaInstruction *value;
+  if (!sealed_[block->id]) {
+    // the operands come when the last predecessor is filled
+    value = phi(block);
+    incomplete_[block->id].push_back({variable, value});
+  } else if (block->predecessors.empty()) {
+    value = function_->constant(SsaType::None, 0);
+  } else if (block->predecessors.size() == 1) {
+    value = read(variable, block->predecessors[0]);
+  } else {
+    // written first, so that loops through block find the phi
+    value = phi(block);
+    write(variable, block, value);
+    addOperands(variable, value);
+  }
+  write(variable, block, value);
+  return value;
+}
+
+SsaInstruction *Builder::phi(SsaBlock *block) {
+  SsaInstruction *phi = function_->create(SsaOpcode::Phi, SsaType::None);
+  phi->block = block;
+  block->instructions.insert(
+      block->instructions.begin() + (long)block->firstNonPhi(), phi);
+  return phi;
+}
+
+void Builder::addOperands(int variable, SsaInstruction *phi) {
+  for (SsaBlock *predecessor : phi->block->predecessors)
+    phi->operands.push_back(read(variable, predecessor));
+}
+
+void Builder::seal(SsaBlock *block) {
+  for (auto &[variable, phi] : incomplete_[block->id])
+    addOperands(variable, phi);
+  incomplete_[block->id].clear();
+  sealed_[block->id] = true;
+}
+
+void Builder::removeTrivialPhis() {
+  std::unordered_map<SsaInstruction *, SsaInstruction *> replaced;
+  auto resolve = [&replaced](SsaInstruction *value) {
+    for (auto next = replaced.find(value); next != replaced.end();
+         next = replaced.find(value))
+      value = next->second;
+    return value;
+  };
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (const auto &block : function_->blocks) {
+      for (size_t i = 0; i < block->firstNonPhi();) {
+        SsaInstruction *phi = block->instructions[i];
+        SsaInstruction *same = nullptr;
+        bool trivial = true;
+        for (SsaInstruction *operand : phi->operands) {
+          operand = resolve(operand);
+          if (operand == phi || operand == same)
+            continue;
+          if (same != nullptr) {
+            trivial = false;
+            break;
+          }
+          same = operand;
+        }
+        if (!trivial) {
+          i++;
+          continue;
+        }
+        replaced[phi] =
+            same != nullptr ? same : function_->constant(SsaType::None, 0);
+        function_->remove(phi);
+        changed = true;
+      }
+    }
+  }
+  function_->replaceUses(replaced);
+}
+
+void Builder::inferTypes() {
+  std::vector<SsaInstruction *> phis;
+  for (const auto &block : function_->blocks) {
+    for (size_t i = 0; i < block->firstNonPhi(); i++)
+      phis.push_back(block->instructions[i]);
+  }
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (SsaInstruction *phi : phis) {
+      if (phi->type != SsaType::None)
+        continue;
+      for (SsaInstruction *operand : phi->operands) {
+        if (operand->type != SsaType::None) {
+          phi->type = operand->type;
+          changed = true;
+          break;
+        }
+      }
+    }
+  }
+  // phis of nothing but undefined values
+  for (SsaInstruction *phi : phis) {
+    if (phi->type == SsaType::None)
+      phi->type = SsaType::Integer;
+  }
+}
+
+SsaInstruction *Builder::pop() {
+  SsaInstruction *value = stack_.back();
+  stack_.pop_back();
+  return value;
+}
+
+} // namespace
+
+SsaProgram toSsa(const Program &program) {
+  SsaProgram result;
+  result.shapes = program.shapes;
+  result.global_frame_size = program.global_frame_size;
+  result.global_types.assign(program.global_frame_size, SsaType::None);
+  result.routine_index = program.routine_index;
+  Builder builder(program, result);
+  result.initializer = builder.build(program.initializer);
+  for (const Routine &routine : program.routines)
+    result.routines.push_back(builder.build(routine));
+  return result;
+}
@@ -0,0 +1,13 @@
+#ifndef CC_PROJECT_SSABUILDER_HPP
+#define CC_PROJECT_SSABUILDER_HPP
+
+#include "ir/Ssa.hpp"
+
+// Build the SSA form of every routine of a compiled program with the
+// algorithm of Braun et al.: the stack code is read block by block, frame
+// slots and the operand stack positions live across blocks are variables,
+// and phis are placed where their definitions meet. Each function gets an
+// entry block of its own that defines the parameters
+SsaProgram toSsa(const Program &program);
+
+#endif // CC_PROJECT_SSABUILDER_HPP
@@ -0,0 +1,808 @@
+#include "ir/SsaLowering.hpp"
+#include "ir/Dominators.hpp"
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace {
+
+// the two may not trade places: reads of memory commute with each other
+// and with checks, not with writes
+bool conflict(const SsaInstruction &a, const SsaInstruction &b) {
+  bool reads_a = readsMemory(a.opcode) && a.opcode != SsaOpcode::Call;
+  bool reads_b = readsMemory(b.opcode) && b.opcode != SsaOpcode::Call;
+  if (reads_a && reads_b)
+    return false;
+  if (reads_a || reads_b)
+    return hasSideEffects(reads_a ? b : a);
+  return true;
+}
+
+Opcode stackOpcode(SsaOpcode opcode) {
+  if (opcode >= SsaOpcode::LoadInt && opcode <= SsaOpcode::StoreBool)
+    return (Opcode)((int)Opcode::LoadInt + (int)opcode -
+                    (int)SsaOpcode::LoadInt);
+  if (opcode >= SsaOpcode::AddInt && opcode <= SsaOpcode::Xor)
+    return (Opcode)((int)Opcode::AddInt + (int)opcode -
+                    (int)SsaOpcode::AddInt);
+  return (Opcode)((int)Opcode::Not + (int)opcode - (int)SsaOpcode::Not);
+}
+
+// the comparison of integers that holds exactly when opcode does not
+SsaOpcode inverse(SsaOpcode opcode) {
+  switch (opcode) {
+  case SsaOpcode::LessInt:
+    return SsaOpcode::GreaterEqInt;
+  case SsaOpcode::LessEqInt:
+    return SsaOpcode::GreaterInt;
+  case SsaOpcode::GreaterInt:
+    return SsaOpcode::LessEqInt;
+  case SsaOpcode::GreaterEqInt:
+    return SsaOpcode::LessInt;
+  case SsaOpcode::EqualInt:
+    return SsaOpcode::NotEqualInt;
+  case SsaOpcode::NotEqualInt:
+    return SsaOpcode::EqualInt;
+  default:
+    return SsaOpcode::OpcodeCount;
+  }
+}
+
+class Lowering {
+public:
+  Lowering(const SsaProgram &source, Program &program)
+      : source_(source), program_(program) {}
+
+  Routine lower(SsaFunction &function);
+
+private:
+  // frame slot uses and the definition of one root in the schedule
+  struct Step {
+    std::vector<int> uses;
+    int def = -1;
+  };
+
+  void splitEdges();
+  void countUses();
+  void chooseDeferred();
+  // values cheaper to compute again than to keep in a slot are deferred
+  // to each of their uses
+  void rematerialize();
+  // blocks where value is emitted, once for each time it is
+  void sites(const SsaInstruction *value,
+             const std::vector<std::vector<SsaInstruction *>> &users,
+             std::vector<const SsaBlock *> &result) const;
+  // every way from block out of the routine passes through site
+  bool follows(const SsaBlock *site, const SsaBlock *block) const;
+  // a deferred instruction that would fail or touch memory out of its
+  // order, nullptr if there is none
+  SsaInstruction *unordered(const SsaBlock *block) const;
+  std::vector<SsaInstruction *> roots(const SsaBlock *block) const;
+  // phi operands copied at the end of block
+  std::vector<SsaInstruction *> copies(const SsaBlock *block) const;
+  // the copies that write another slot, with that slot
+  std::vector<std::pair<SsaInstruction *, int>>
+  moves(const SsaBlock *block) const;
+  void postorder(SsaInstruction *root,
+                 std::vector<SsaInstruction *> &order) const;
+  void leaves(const SsaInstruction *root, std::vector<int> &uses) const;
+  std::vector<Step> steps(const SsaBlock *block) const;
+  bool slotted(const SsaInstruction *value) const;
+  void assignSlots();
+  // jumps to blocks that only jump on go to the end of the chain
+  void threadJumps();
+
+  void emitBlock(size_t position);
+  void emitValue(SsaInstruction *value);
+  void emitTree(SsaInstruction *root);
+  void emitOperation(const SsaInstruction *instruction, SsaOpcode opcode);
+  void emitBranch(SsaBlock *block, SsaBlock *next);
+  void emitJump(Opcode opcode, const SsaBlock *target);
+  void emit(Opcode opcode, int effect);
+  void emit(Opcode opcode, int effect, int32_t first);
+  void emit(Opcode opcode, int effect, int32_t first, int32_t second);
+  void operand(int32_t value);
+  int constant(const ConstantValue &value);
+
+  const SsaProgram &source_;
+  Program &program_;
+  std::map<std::pair<int, int64_t>, int> constants_;
+  SsaFunction *function_ = nullptr;
+  Routine routine_;
+  std::vector<SsaBlock *> layout_;
+  // by value id
+  std::vector<int> uses_;
+  std::vector<SsaInstruction *> user_;
+  std::vector<bool> deferred_;
+  std::vector<int> slot_;
+  // by block id
+  std::vector<size_t> start_;
+  std::vector<SsaBlock *> target_;
+  std::vector<std::pair<size_t, const SsaBlock *>> jumps_;
+  int depth_ = 0;
+};
+
+Routine Lowering::lower(SsaFunction &function) {
+  function_ = &function;
+  routine_ = function.header;
+  routine_.code.clear();
+  routine_.origins.clear();
+  routine_.max_stack = 0;
+  depth_ = 0;
+  jumps_.clear();
+  splitEdges();
+  layout_ = function.reversePostorder();
+  countUses();
+  chooseDeferred();
+  rematerialize();
+  assignSlots();
+  threadJumps();
+  start_.assign(function.blockIds(), 0);
+  for (size_t i = 0; i < layout_.size(); i++)
+    emitBlock(i);
+  for (const auto &[position, target] : jumps_) {
+    int32_t address = (int32_t)start_[target_[target->id]->id];
+    std::memcpy(&routine_.code[position], &address, sizeof(address));
+  }
+  return routine_;
+}
+
+// phi copies need a block of their own on edges from branches
+void Lowering::splitEdges() {
+  std::vector<SsaBlock *> blocks;
+  for (const auto &block : function_->blocks)
+    blocks.push_back(block.get());
+  for (SsaBlock *block : blocks) {
+    if (block->successors.size() < 2)
+      continue;
+    for (size_t i = 0; i < block->successors.size(); i++) {
+      SsaBlock *successor = block->successors[i];
+      if (successor->firstNonPhi() != 0)
+        function_->splitEdge(block, successor);
+    }
+  }
+}
+
+void Lowering::countUses() {
+  uses_.assign(function_->valueIds(), 0);
+  user_.assign(function_->valueIds(), nullptr);
+  for (SsaBlock *block : layout_) {
+    for (SsaInstruction *instruction : block->instructions) {
+      for (SsaInstruction *operand : instruction->operands) {
+        if (operand->isConstant())
+          continue;
+        uses_[operand->id]++;
+        user_[operand->id] = instruction;
+      }
+    }
+  }
+}
+
+void Lowering::chooseDeferred() {
+  deferred_.assign(function_->valueIds(), false);
+  for (SsaBlock *block : layout_) {
+    for (SsaInstruction *value : block->instructions) {
+      if (value->type == SsaType::None || uses_[value->id] != 1 ||
+          value->opcode == SsaOpcode::Phi ||
+          value->opcode == SsaOpcode::Parameter ||
+          value->opcode == SsaOpcode::Allocate)
+        continue;
+      const SsaInstruction *user = user_[value->id];
+      if (user->opcode != SsaOpcode::Phi)
+        deferred_[value->id] = user->block == block;
+      else
+        deferred_[value->id] = isPure(*value) &&
+                               block->successors.size() == 1 &&
+                               block->successors[0] == user->block;
+    }
+    for (SsaInstruction *late = unordered(block); late != nullptr;
+         late = unordered(block))
+      deferred_[late->id] = false;
+  }
+}
+
+// a value in a slot costs its instruction, a store and a load per use,
+// where computing it again costs the instruction per use. Blocks that do
+// not always run after the one of the value are taken to be rare, so
+// computing a value again moves work off the common path. Only values of
+// one instruction on operands in slots are computed again
+void Lowering::rematerialize() {
+  std::vector<std::vector<SsaInstruction *>> users(function_->valueIds());
+  for (SsaBlock *block : layout_) {
+    for (SsaInstruction *instruction : block->instructions) {
+      for (SsaInstruction *operand : instruction->operands) {
+        if (!operand->isConstant())
+          users[operand->id].push_back(instruction);
+      }
+    }
+  }
+  // repeating a value in a loop its block is not in costs more than it saves
+  DominatorTree tree(*function_);
+  std::vector<int> depth(function_->blockIds(), 0);
+  for (const SsaLoop &loop : findLoops(*function_, tree)) {
+    for (const SsaBlock *block : loop.blocks)
+      depth[block->id] = std::max(depth[block->id], loop.depth);
+  }
+  for (const SsaBlock *block : layout_) {
+    for (SsaInstruction *value : block->instructions) {
+      // a value a phi takes usually shares the slot of the phi, which
+      // makes its copy free
+      if (deferred_[value->id] || uses_[value->id] == 0 || !isPure(*value) ||
+          std::any_of(users[value->id].begin(), users[value->id].end(),
+                      [](const SsaInstruction *user) {
+                        return user->opcode == SsaOpcode::Phi;
+                      }) ||
+          std::any_of(value->operands.begin(), value->operands.end(),
+                      [this](const SsaInstruction *operand) {
+                        return !operand->isConstant() &&
+                               deferred_[operand->id];
+                      }))
+        continue;
+      std::vector<const SsaBlock *> at;
+      sites(value, users, at);
+      int cost = 1 + (int)value->operands.size(), common = 0;
+      bool deeper = false;
+      for (const SsaBlock *site : at) {
+        deeper = deeper || depth[site->id] > depth[block->id];
+        if (follows(site, block))
+          common++;
+      }
+      if (!deeper && common * cost < cost + 1 + common)
+        deferred_[value->id] = true;
+    }
+  }
+}
+
+void Lowering::sites(const SsaInstruction *value,
+                     const std::vector<std::vector<SsaInstruction *>> &users,
+                     std::vector<const SsaBlock *> &result) const {
+  const SsaInstruction *last = nullptr;
+  for (const SsaInstruction *user : users[value->id]) {
+    if (user->opcode == SsaOpcode::Phi) {
+      // copied at the end of each predecessor it comes from
+      for (size_t k = 0; k < user->operands.size() && user != last; k++) {
+        if (user->operands[k] == value)
+          result.push_back(user->block->predecessors[k]);
+      }
+    } else if (deferred_[user->id]) {
+      sites(user, users, result);
+    } else {
+      result.push_back(user->block);
+    }
+    last = user;
+  }
+}
+
+bool Lowering::follows(const SsaBlock *site, const SsaBlock *block) const {
+  if (site == block)
+    return true;
+  // look for a way out of the routine that avoids site
+  std::vector<bool> seen(function_->blockIds(), false);
+  std::vector<const SsaBlock *> work = {block};
+  seen[block->id] = true;
+  seen[site->id] = true;
+  while (!work.empty()) {
+    const SsaBlock *current = work.back();
+    work.pop_back();
+    if (current->successors.empty())
+      return false;
+    for (const SsaBlock *successor : current->successors) {
+      if (!seen[successor->id]) {
+        seen[successor->id] = true;
+        work.push_back(successor);
+      }
+    }
+  }
+  return true;
+}
+
+SsaInstruction *Lowering::unordered(const SsaBlock *block) const {
+  std::vector<SsaInstruction *> order;
+  for (SsaInstruction *root : roots(block))
+    postorder(root, order);
+  for (SsaInstruction *value : copies(block)) {
+    if (!value->isConstant() && deferred_[value->id])
+      postorder(value, order);
+  }
+  postorder(block->terminator(), order);
+  std::unordered_map<const SsaInstruction *, size_t> position;
+  for (size_t i = 0; i < block->instructions.size(); i++)
+    position[block->instructions[i]] = i;
+  std::vector<SsaInstruction *> seen;
+  for (SsaInstruction *instruction : order) {
+    if (isPure(*instruction) || instruction->block != block)
+      continue;
+    // only deferred instructions can come after later ones
+    for (SsaInstruction *earlier : seen) {
+      if (position[earlier] > position[instruction] &&
+          conflict(*earlier, *instruction))
+        return instruction;
+    }
+    seen.push_back(instruction);
+  }
+  return nullptr;
+}
+
+std::vector<SsaInstruction *> Lowering::roots(const SsaBlock *block) const {
+  std::vector<SsaInstruction *> result;
+  for (SsaInstruction *instruction : block->instructions) {
+    if (instruction->opcode != SsaOpcode::Phi &&
+        instruction != block->terminator() && !deferred_[instruction->id])
+      result.push_back(instruction);
+  }
+  return result;
+}
+
+std::vector<SsaInstruction *> Lowering::copies(const SsaBlock *block) const {
+  std::vector<SsaInstruction *> sources;
+  if (block->successors.size() != 1)
+    return sources;
+  const SsaBlock *successor = block->successors[0];
+  int index = successor->predecessorIndex(block);
+  for (size_t i = 0; i < successor->firstNonPhi(); i++)
+    sources.push_back(successor->instructions[i]->operands[index]);
+  return sources;
+}
+
+std::vector<std::pair<SsaInstruction *, int>>
+Lowering::moves(const SsaBlock *block) const {
+  std::vector<std::pair<SsaInstruction *, int>> result;
+  std::vector<SsaInstruction *> sources = copies(block);
+  for (size_t i = 0; i < sources.size(); i++) {
+    const SsaInstruction *phi = block->successors[0]->instructions[i];
+    SsaInstruction *source = sources[i];
+    if (!slotted(phi) || (!source->isConstant() && !deferred_[source->id] &&
+                          slot_[source->id] == slot_[phi->id]))
+      continue;
+    result.push_back({source, slot_[phi->id]});
+  }
+  return result;
+}
+
+void Lowering::postorder(SsaInstruction *root,
+                         std::vector<SsaInstruction *> &order) const {
+  for (SsaInstruction *operand : root->operands) {
+    if (!operand->isConstant() && deferred_[operand->id])
+      postorder(operand, order);
+  }
+  if (!root->isConstant())
+    order.push_back(root);
+}
+
+void Lowering::leaves(const SsaInstruction *root,
+                      std::vector<int> &uses) const {
+  for (const SsaInstruction *operand : root->operands) {
+    if (operand->isConstant())
+      continue;
+    if (deferred_[operand->id])
+      leaves(operand, uses);
+    else
+      uses.push_back(operand->id);
+  }
+}
+
+std::vector<Lowering::Step> Lowering::steps(const SsaBlock *block) const {
+  std::vector<Step> result;
+  for (SsaInstruction *root : roots(block)) {
+    Step step;
+    leaves(root, step.uses);
+    if (slotted(root))
+      step.def = root->id;
+    result.push_back(std::move(step));
+  }
+  Step end;
+  for (SsaInstruction *value : copies(block)) {
+    if (value->isConstant())
+      continue;
+    if (deferred_[value->id])
+      leaves(value, end.uses);
+    else
+      end.uses.push_back(value->id);
+  }
+  leaves(block->terminator(), end.uses);
+  result.push_back(std::move(end));
+  return result;
+}
+
+bool Lowering::slotted(const SsaInstruction *value) const {
+  return !value->isConstant() && value->type != SsaType::None &&
+         !deferred_[value->id] &&
+         (uses_[value->id] > 0 || value->opcode == SsaOpcode::Allocate);
+}
+
+// greedy coloring of the interference graph; parameters and allocations
+// keep the slots the calls and the frame buffers expect
+void Lowering::assignSlots() {
+  int values = function_->valueIds();
+  std::vector<std::vector<Step>> schedule(function_->blockIds());
+  for (SsaBlock *block : layout_)
+    schedule[block->id] = steps(block);
+
+  std::vector<std::vector<bool>> live_in(function_->blockIds(),
+                                         std::vector<bool>(values, false));
+  auto liveOut = [&](const SsaBlock *block) {
+    std::vector<bool> live(values, false);
+    for (const SsaBlock *successor : block->successors) {
+      for (int v = 0; v < values; v++)
+        live[v] = live[v] || live_in[successor->id][v];
+    }
+    return live;
+  };
+  std::vector<std::set<int>> interferes(values);
+  // walk the block backwards; with edges the interference is recorded
+  auto walk = [&](const SsaBlock *block, bool edges) {
+    std::vector<bool> live = liveOut(block);
+    const std::vector<Step> &list = schedule[block->id];
+    for (size_t i = list.size(); i-- > 0;) {
+      int def = list[i].def;
+      if (def != -1) {
+        if (edges) {
+          for (int v = 0; v < values; v++) {
+            if (live[v] && v != def) {
+              interferes[def].insert(v);
+              interferes[v].insert(def);
+            }
+          }
+        }
+        live[def] = false;
+      }
+      for (int use : list[i].uses)
+        live[use] = true;
+    }
+    // phis are defined together on entry
+    std::vector<int> phis;
+    for (size_t i = 0; i < block->firstNonPhi(); i++) {
+      if (slotted(block->instructions[i]))
+        phis.push_back(block->instructions[i]->id);
+    }
+    for (int phi : phis)
+      live[phi] = true;
+    if (edges) {
+      for (int phi : phis) {
+        for (int v = 0; v < values; v++) {
+          if (live[v] && v != phi) {
+            interferes[phi].insert(v);
+            interferes[v].insert(phi);
+          }
+        }
+      }
+    }
+    for (int phi : phis)
+      live[phi] = false;
+    return live;
+  };
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t i = layout_.size(); i-- > 0;) {
+      std::vector<bool> live = walk(layout_[i], false);
+      if (live != live_in[layout_[i]->id]) {
+        live_in[layout_[i]->id] = std::move(live);
+        changed = true;
+      }
+    }
+  }
+  for (SsaBlock *block : layout_)
+    walk(block, true);
+
+  slot_.assign(values, -1);
+  std::vector<SsaInstruction *> order;
+  int frame_size = routine_.parameters;
+  for (SsaBlock *block : layout_) {
+    for (SsaInstruction *instruction : block->instructions) {
+      if (instruction->opcode == SsaOpcode::Parameter ||
+          instruction->opcode == SsaOpcode::Allocate) {
+        slot_[instruction->id] = (int)instruction->a;
+        frame_size = std::max(frame_size, (int)instruction->a + 1);
+      } else if (instruction->opcode == SsaOpcode::Call &&
+                 instruction->b != -1) {
+        frame_size = std::max(frame_size, (int)instruction->b + 1);
+      }
+      if (slotted(instruction) && slot_[instruction->id] == -1)
+        order.push_back(instruction);
+    }
+  }
+  for (SsaInstruction *value : order) {
+    std::vector<int> preferred;
+    if (value->opcode == SsaOpcode::Phi) {
+      for (const SsaInstruction *operand : value->operands) {
+        if (!operand->isConstant() && slot_[operand->id] != -1)
+          preferred.push_back(slot_[operand->id]);
+      }
+    }
+    const SsaInstruction *user = user_[value->id];
+    if (user != nullptr && user->opcode == SsaOpcode::Phi &&
+        slot_[user->id] != -1)
+      preferred.push_back(slot_[user->id]);
+    std::set<int> taken;
+    for (int other : interferes[value->id]) {
+      if (slot_[other] != -1)
+        taken.insert(slot_[other]);
+    }
+    int chosen = -1;
+    for (int slot : preferred) {
+      if (taken.count(slot) == 0) {
+        chosen = slot;
+        break;
+      }
+    }
+    for (int slot = 0; chosen == -1; slot++) {
+      if (taken.count(slot) == 0)
+        chosen = slot;
+    }
+    slot_[value->id] = chosen;
+    frame_size = std::max(frame_size, chosen + 1);
+  }
+  routine_.frame_size = frame_size;
+}
+
+void Lowering::threadJumps() {
+  auto forwards = [this](const SsaBlock *block) {
+    return block != function_->entry() && block->instructions.size() == 1 &&
+           block->terminator()->opcode == SsaOpcode::Jump &&
+           moves(block).empty();
+  };
+  target_.assign(function_->blockIds(), nullptr);
+  for (SsaBlock *block : layout_) {
+    SsaBlock *end = block;
+    // a loop of empty blocks keeps its jumps
+    for (size_t steps = 0; steps < layout_.size() && forwards(end); steps++)
+      end = end->successors[0];
+    target_[block->id] = forwards(end) ? block : end;
+  }
+  layout_.erase(std::remove_if(layout_.begin(), layout_.end(),
+                               [this](const SsaBlock *block) {
+                                 return target_[block->id] != block;
+                               }),
+                layout_.end());
+}
+
+void Lowering::emitBlock(size_t position) {
+  SsaBlock *block = layout_[position];
+  SsaBlock *next =
+      position + 1 < layout_.size() ? layout_[position + 1] : nullptr;
+  start_[block->id] = routine_.code.size();
+  for (SsaInstruction *root : roots(block)) {
+    if (root->opcode == SsaOpcode::Parameter)
+      continue;
+    emitTree(root);
+    if (root->type == SsaType::None || root->opcode == SsaOpcode::Allocate)
+      continue;
+    if (slotted(root))
+      emit(Opcode::StoreLocal, -1, slot_[root->id]);
+    else
+      emit(Opcode::Pop, -1);
+  }
+
+  // a phi is written as soon as no other copy still reads its slot; the
+  // values of a cycle are all read before any of them is written
+  std::vector<std::pair<SsaInstruction *, int>> list = moves(block);
+  std::vector<std::vector<int>> reads(list.size());
+  for (size_t i = 0; i < list.size(); i++) {
+    std::vector<int> values;
+    if (!list[i].first->isConstant() && !deferred_[list[i].first->id])
+      values.push_back(list[i].first->id);
+    else
+      leaves(list[i].first, values);
+    for (int value : values)
+      reads[i].push_back(slot_[value]);
+  }
+  std::vector<bool> done(list.size(), false);
+  for (size_t left = list.size(); left > 0;) {
+    size_t ready = list.size();
+    for (size_t i = 0; i < list.size() && ready == list.size(); i++) {
+      bool free = !done[i];
+      for (size_t j = 0; j < list.size() && free; j++) {
+        free = done[j] || j == i ||
+               std::count(reads[j].begin(), reads[j].end(),
+                          list[i].second) == 0;
+      }
+      if (free)
+        ready = i;
+    }
+    if (ready != list.size()) {
+      emitValue(list[ready].first);
+      emit(Opcode::StoreLocal, -1, list[ready].second);
+      done[ready] = true;
+      left--;
+      continue;
+    }
+    std::vector<size_t> cycle;
+    for (size_t i = 0; i < list.size(); i++) {
+      if (!done[i]) {
+        emitValue(list[i].first);
+        cycle.push_back(i);
+        done[i] = true;
+      }
+    }
+    for (size_t i = cycle.size(); i-- > 0;)
+      emit(Opcode::StoreLocal, -1, list[cycle[i]].second);
+    left = 0;
+  }
+
+  SsaInstruction *terminator = block->terminator();
+  switch (terminator->opcode) {
+  case SsaOpcode::Jump:
+    if (target_[block->successors[0]->id] != next)
+      emitJump(Opcode::Jump, block->successors[0]);
+    return;
+  case SsaOpcode::Branch:
+    emitBranch(block, next);
+    return;
+  case SsaOpcode::Return:
+    emitValue(terminator->operands[0]);
+    emit(Opcode::Return, -1);
+    return;
+  case SsaOpcode::ReturnVoid:
+    emit(Opcode::ReturnVoid, 0);
+    return;
+  default:
+    emit(Opcode::MissingReturn, 0);
+    return;
+  }
+}
+
+void Lowering::emitBranch(SsaBlock *block, SsaBlock *next) {
+  SsaInstruction *condition = block->terminator()->operands[0];
+  SsaBlock *taken = target_[block->successors[0]->id];
+  SsaBlock *other = target_[block->successors[1]->id];
+  // a negated condition swaps the successors
+  while (!condition->isConstant() && deferred_[condition->id] &&
+         condition->opcode == SsaOpcode::Not) {
+    condition = condition->operands[0];
+    std::swap(taken, other);
+  }
+  if (other != next || taken == next) {
+    emitValue(condition);
+    emitJump(Opcode::JumpIfFalse, other);
+    if (taken != next)
+      emitJump(Opcode::Jump, taken);
+    return;
+  }
+  // fall through to the false successor
+  SsaOpcode inverted = inverse(condition->opcode);
+  if (!condition->isConstant() && deferred_[condition->id] &&
+      inverted != SsaOpcode::OpcodeCount) {
+    for (SsaInstruction *operand : condition->operands)
+      emitValue(operand);
+    emitOperation(condition, inverted);
+  } else {
+    emitValue(condition);
+    emit(Opcode::Not, 0);
+  }
+  emitJump(Opcode::JumpIfFalse, taken);
+}
+
+void Lowering::emitValue(SsaInstruction *value) {
+  if (!value->isConstant()) {
+    if (deferred_[value->id])
+      emitTree(value);
+    else
+      emit(Opcode::LoadLocal, 1, slot_[value->id]);
+    return;
+  }
+  if (value->type == SsaType::Real) {
+    emit(Opcode::PushConst, 1, constant(ConstantValue::ofReal(value->real())));
+    return;
+  }
+  if (value->a == (int32_t)value->a) {
+    emit(Opcode::PushInt, 1, (int32_t)value->a);
+    return;
+  }
+  emit(Opcode::PushConst, 1, constant(ConstantValue::ofInteger(value->a)));
+}
+
+void Lowering::emitTree(SsaInstruction *root) {
+  for (SsaInstruction *operand : root->operands)
+    emitValue(operand);
+  emitOperation(root, root->opcode);
+}
+
+void Lowering::emitOperation(const SsaInstruction *instruction,
+                             SsaOpcode opcode) {
+  int origin = routine_.origins.empty() ? -1 : routine_.origins.back().second;
+  if (instruction->origin != origin)
+    routine_.origins.push_back(
+        {(uint32_t)routine_.code.size(), instruction->origin});
+  int operands = (int)instruction->operands.size();
+  int32_t a = (int32_t)instruction->a, b = (int32_t)instruction->b;
+  switch (opcode) {
+  case SsaOpcode::LoadGlobal:
+    emit(Opcode::LoadGlobal, 1, a);
+    return;
+  case SsaOpcode::StoreGlobal:
+    emit(Opcode::StoreGlobal, -1, a);
+    return;
+  case SsaOpcode::Allocate:
+    emit(Opcode::Allocate, -operands, a, b);
+    return;
+  case SsaOpcode::AllocateGlobal:
+    emit(Opcode::AllocateGlobal, -operands, a, b);
+    return;
+  case SsaOpcode::Field:
+    emit(Opcode::Field, 0, a);
+    return;
+  case SsaOpcode::Index:
+  case SsaOpcode::IndexUnchecked:
+    emit(Opcode::Index, -1, a, opcode == SsaOpcode::Index ? 1 : 0);
+    return;
+  case SsaOpcode::Length:
+    emit(Opcode::Length, 0, a);
+    return;
+  case SsaOpcode::DivInt:
+  case SsaOpcode::ModInt:
+    emit(stackOpcode(opcode), -1, a == 0 ? 1 : 0);
+    return;
+  case SsaOpcode::Copy:
+    emit(Opcode::Copy, -2, a);
+    return;
+  case SsaOpcode::Call: {
+    const Routine &callee = source_.routines[a]->header;
+    emit(Opcode::Call, (callee.returns ? 1 : 0) - callee.parameters, a, b);
+    return;
+  }
+  default:
+    // loads, stores and operators
+    emit(stackOpcode(opcode), 1 - operands -
+                                  (opcode >= SsaOpcode::StoreInt &&
+                                           opcode <= SsaOpcode::StoreBool
+                                       ? 1
+                                       : 0));
+    return;
+  }
+}
+
+void Lowering::emitJump(Opcode opcode, const SsaBlock *target) {
+  emit(opcode, opcode == Opcode::JumpIfFalse ? -1 : 0);
+  jumps_.push_back({routine_.code.size(), target});
+  operand(0);
+}
+
+void Lowering::emit(Opcode opcode, int effect) {
+  routine_.code.push_back((uint8_t)opcode);
+  depth_ += effect;
+  if (depth_ > routine_.max_stack)
+    routine_.max_stack = depth_;
+}
+
+void Lowering::emit(Opcode opcode, int effect, int32_t first) {
+  emit(opcode, effect);
+  operand(first);
+}
+
+void Lowering::emit(Opcode opcode, int effect, int32_t first,
+                    int32_t second) {
+  emit(opcode, effect);
+  operand(first);
+  operand(second);
+}
+
+void Lowering::operand(int32_t value) {
+  uint8_t bytes[sizeof(value)];
+  std::memcpy(bytes, &value, sizeof(value));
+  routine_.code.insert(routine_.code.end(), bytes, bytes + sizeof(value));
+}
+
+int Lowering::constant(const ConstantValue &value) {
+  auto key = std::make_pair((int)value.kind, value.integer);
+  auto known = constants_.find(key);
+  if (known != constants_.end())
+    return known->second;
+  int index = (int)program_.constants.size();
+  program_.constants.push_back(value);
+  constants_[key] = index;
+  return index;
+}
+
+} // namespace
+
+Program toBytecode(SsaProgram &program) {
+  Program result;
+  result.shapes = program.shapes;
+  result.global_frame_size = program.global_frame_size;
+  result.routine_index = program.routine_index;
+  Lowering lowering(program, result);
+  result.initializer = lowering.lower(*program.initializer);
+  for (const auto &routine : program.routines)
+    result.routines.push_back(lowering.lower(*routine));
+  return result;
+}
@@ -0,0 +1,14 @@
+#ifndef CC_PROJECT_SSALOWERING_HPP
+#define CC_PROJECT_SSALOWERING_HPP
+
+#include "ir/Ssa.hpp"
+
+// Stack code of a program in SSA form, with the calling convention of the
+// bytecode it was built from. Values used once in their block are left on
+// the operand stack for their user, and pure values cheaper to compute
+// again than to load are computed at each use; the others get frame slots,
+// shared by values that are never live at the same time. Phis become copies at the
+// end of their predecessors, after critical edges are split.
+Program toBytecode(SsaProgram &program);
+
+#endif // CC_PROJECT_SSALOWERING_HPP
@@ -0,0 +1,90 @@
+#include "ir/Induction.hpp"
+#include "ir/Passes.hpp"
+#include <map>
+
+namespace {
+
+// left * right at the end of block, folded if both are constants
+SsaInstruction *product(SsaFunction &function, SsaBlock *block,
+                        SsaInstruction *left, SsaInstruction *right) {
+  if (left->isConstant() && left->a == 1)
+    return right;
+  if (right->isConstant() && right->a == 1)
+    return left;
+  if (left->isConstant() && right->isConstant())
+    return function.constant(SsaType::Integer,
+                             (int64_t)((uint64_t)left->a * (uint64_t)right->a));
+  SsaInstruction *result =
+      function.create(SsaOpcode::MulInt, SsaType::Integer, {left, right});
+  function.insertBeforeTerminator(block, result);
+  return result;
+}
+
+} // namespace
+
+int reduceStrength(SsaFunction &function) {
+  DominatorTree tree(function);
+  std::vector<SsaLoop> loops = findLoops(function, tree);
+  int reduced = 0;
+  for (const SsaLoop &loop : loops) {
+    LoopShape shape;
+    if (!analyzeLoop(loop, shape) || shape.inductions.empty())
+      continue;
+    SsaBlock *header = loop.header;
+    int entering = header->predecessorIndex(shape.preheader);
+    int repeating = header->predecessorIndex(shape.latch);
+    auto invariant = [&loop](const SsaInstruction *value) {
+      return value->isConstant() || !loop.has(value->block);
+    };
+    // phis holding the product of an induction variable and a factor, by
+    // the ids of both
+    std::map<std::pair<int, int>, SsaInstruction *> products;
+    for (SsaBlock *block : loop.blocks) {
+      for (size_t i = 0; i < block->instructions.size();) {
+        SsaInstruction *multiply = block->instructions[i];
+        const InductionVariable *variable = nullptr;
+        SsaInstruction *factor = nullptr;
+        if (multiply->opcode == SsaOpcode::MulInt) {
+          for (const InductionVariable &candidate : shape.inductions) {
+            for (int side = 0; side < 2; side++) {
+              if (multiply->operands[side] == candidate.phi &&
+                  invariant(multiply->operands[1 - side])) {
+                variable = &candidate;
+                factor = multiply->operands[1 - side];
+              }
+            }
+          }
+        }
+        if (variable == nullptr) {
+          i++;
+          continue;
+        }
+        // the phi starts at initial * factor and grows by step * factor
+        // each iteration, so it is the product throughout the body
+        SsaInstruction *&phi = products[{variable->phi->id, factor->id}];
+        if (phi == nullptr) {
+          SsaInstruction *start =
+              product(function, shape.preheader, variable->initial, factor);
+          SsaInstruction *step = product(
+              function, shape.preheader,
+              function.constant(SsaType::Integer, variable->step), factor);
+          phi = function.create(SsaOpcode::Phi, SsaType::Integer);
+          phi->block = header;
+          header->instructions.insert(header->instructions.begin(), phi);
+          phi->operands.resize(header->predecessors.size());
+          SsaInstruction *next = function.create(
+              SsaOpcode::AddInt, SsaType::Integer, {phi, step});
+          function.insertBeforeTerminator(shape.latch, next);
+          phi->operands[entering] = start;
+          phi->operands[repeating] = next;
+          if (block == header)
+            i++;
+        }
+        function.replaceUses({{multiply, phi}});
+        function.remove(multiply);
+        reduced++;
+      }
+    }
+  }
+  return reduced;
+}
@@ -0,0 +1,82 @@
+#include "ir/Dominators.hpp"
+#include "ir/Passes.hpp"
+#include <algorithm>
+#include <tuple>
+
+namespace {
+
+// what an instruction computes: equal keys mean equal values wherever
+// the first one dominates the second
+using Key = std::tuple<SsaOpcode, SsaType, int64_t, int64_t, int,
+                       std::vector<const SsaInstruction *>>;
+
+bool numbered(const SsaInstruction &instruction) {
+  switch (instruction.opcode) {
+  case SsaOpcode::Constant:
+  case SsaOpcode::Parameter:
+  case SsaOpcode::Allocate:
+    return false;
+  default:
+    return instruction.type != SsaType::None &&
+           !readsMemory(instruction.opcode);
+  }
+}
+
+Key keyOf(const SsaInstruction &instruction) {
+  std::vector<const SsaInstruction *> operands(
+      instruction.operands.begin(), instruction.operands.end());
+  if (isCommutative(instruction.opcode) && operands[1] < operands[0])
+    std::swap(operands[0], operands[1]);
+  // phis of different blocks merge along different edges
+  int block = instruction.opcode == SsaOpcode::Phi ? instruction.block->id
+                                                   : -1;
+  return Key(instruction.opcode, instruction.type, instruction.a,
+             instruction.b, block, std::move(operands));
+}
+
+} // namespace
+
+int numberValues(SsaFunction &function) {
+  DominatorTree tree(function);
+  std::map<Key, SsaInstruction *> available;
+  std::unordered_map<SsaInstruction *, SsaInstruction *> replaced;
+  // keys each block added, taken out again when its subtree is done
+  std::vector<std::vector<Key>> added(function.blockIds());
+  std::vector<std::pair<SsaBlock *, bool>> stack{{tree.order().front(), false}};
+  while (!stack.empty()) {
+    auto [block, done] = stack.back();
+    stack.pop_back();
+    if (done) {
+      for (const Key &key : added[block->id])
+        available.erase(key);
+      continue;
+    }
+    stack.push_back({block, true});
+    for (SsaBlock *child : tree.children(block))
+      stack.push_back({child, false});
+    for (size_t i = 0; i < block->instructions.size();) {
+      SsaInstruction *instruction = block->instructions[i];
+      for (SsaInstruction *&operand : instruction->operands) {
+        auto known = replaced.find(operand);
+        if (known != replaced.end())
+          operand = known->second;
+      }
+      if (!numbered(*instruction)) {
+        i++;
+        continue;
+      }
+      Key key = keyOf(*instruction);
+      auto [existing, inserted] = available.emplace(key, instruction);
+      if (inserted) {
+        added[block->id].push_back(std::move(key));
+        i++;
+        continue;
+      }
+      replaced[instruction] = existing->second;
+      function.remove(instruction);
+    }
+  }
+  // phis read values along back edges before the walk reaches them
+  function.replaceUses(replaced);
+  return (int)replaced.size();
+}
@@ -1,30 +1,120 @@
 #include "common/Node.hpp"
 #include "grammar/Parser.hpp"
 #include "lexer/Lexer.hpp"
+#include <chrono>
+#include <codegen/CEmitter.hpp>
 #include <fstream>
+#include <ir/Optimizer.hpp>
+#include <ir/SsaBuilder.hpp>
+#include <ir/SsaLowering.hpp>
 #include <semantic_analyzer/CAnalyzer.hpp>
 #include <sstream>
+#include <vector>
+#include <vm/BytecodeCompiler.hpp>
+#include <vm/JitVM.hpp>
+#include <vm/RegisterVM.hpp>
+#include <vm/StackVM.hpp>
 
 void print_node(CNode *node, int margin) {
   if (node == nullptr)
     return;
   for (int i = 0; i < margin; i++)
     std::cout << "   ";
-  std::cout << "<" << node->name << ">\n";
+  std::cout << "<" << node->name << ">";
+  if (node->slot != -1)
+    std::cout << " [" << node->depth << ":" << node->slot << "]";
+  std::cout << "\n";
   for (int j = 0; j < node->children.size(); j++)
     print_node(node->children[j], margin + 1);
 }
 
 void print_tree(CNode *root) { print_node(root, 0); }
 
+// native code reports where the registers of each routine went
+template <typename Machine> void print_allocation(const Machine &) {}
+
+void print_allocation(const JitVM &machine) {
+  for (const JitVM::Allocation &allocation : machine.allocations()) {
+    std::cout << "Registers of " << allocation.routine << ": "
+              << allocation.general << " general, " << allocation.xmm
+              << " xmm, " << allocation.memory << " in memory; "
+              << allocation.spills << " spills, " << allocation.reloads
+              << " reloads\n";
+  }
+}
+
+// run the routine on a virtual machine and report how fast it went
+template <typename Machine, typename Code>
+bool run_routine(const char *name, const Code &code, const std::string &routine,
+                 ConstantValue::Kind kind) {
+  Machine machine(code, std::cerr);
+  print_allocation(machine);
+  Value result;
+  auto start = std::chrono::steady_clock::now();
+  bool correct = machine.run(routine, result);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (!correct)
+    return false;
+  ConstantValue printed;
+  printed.kind = kind;
+  printed.integer = result.integer;
+  if (kind == ConstantValue::Boolean)
+    printed.boolean = result.integer != 0;
+  if (kind != ConstantValue::None)
+    std::cout << "Result: " << printed.toString() << "\n";
+  std::cout << name << " VM: ";
+  // native code does not count its instructions
+  if (machine.executed() == 0) {
+    std::cout << elapsed.count() * 1000 << " ms\n";
+    return true;
+  }
+  std::cout << machine.executed() << " instructions in "
+            << elapsed.count() * 1000 << " ms, "
+            << machine.executed() / std::max(elapsed.count(), 1e-9)
+            << " dispatches/s\n";
+  return true;
+}
+
 int main(int argc, char *argv[]) {
-  if (argc != 2) {
+  std::vector<std::string> entries;
+  std::string run;
+  std::string machine = "stack";
+  std::string c_file;
+  bool bytecode = false;
+  bool optimize = false;
+  int arg = 1;
+  for (; arg + 1 < argc; arg++) {
+    std::string option = argv[arg];
+    if (option == "--entry" && arg + 2 < argc)
+      entries.push_back(argv[++arg]);
+    else if (option == "--run" && arg + 2 < argc)
+      run = argv[++arg];
+    else if (option == "--vm" && arg + 2 < argc &&
+             std::string(" stack register jit both all ")
+                     .find(" " + std::string(argv[arg + 1]) + " ") !=
+                 std::string::npos)
+      machine = argv[++arg];
+    else if (option == "--emit-c" && arg + 2 < argc)
+      c_file = argv[++arg];
+    else if (option == "--bytecode")
+      bytecode = true;
+    else if (option == "--optimize")
+      optimize = true;
+    else
+      break;
+  }
+  if (arg + 1 != argc) {
     std::cerr << "Invalid number of args" << std::endl;
-    std::cerr << "Usage: " << argv[0] << " <path_to_source>" << std::endl;
+    std::cerr << "Usage: " << argv[0]
+              << " [--entry <routine>]... [--run <routine>]"
+                 " [--vm stack|register|jit|both|all] [--bytecode]"
+                 " [--optimize] [--emit-c <file.c>] <path_to_source>"
+              << std::endl;
     return 1;
   }
 
-  std::ifstream src_file(argv[1]);
+  std::ifstream src_file(argv[arg]);
   if (!src_file.is_open()) {
     std::cerr << "File don't open" << std::endl;
     return 1;
@@ -42,12 +132,108 @@ int main(int argc, char *argv[]) {
   print_tree(root);
 
   CAnalayzer analyzer;
+  analyzer.setEntryPoints(entries);
   std::cout << "Check reachable of components\n";
   if (!analyzer.check_reachable(root)) {
     std::cerr << "ERROR: see above" << std::endl;
     return 1;
   }
   std::cout << "Everything is correct\n";
+  for (int rule = 0; rule < Simplifier::RuleCount; rule++) {
+    if (analyzer.simplifications()[rule] != 0)
+      std::cout << "Simplified " << Simplifier::ruleName(rule) << ": "
+                << analyzer.simplifications()[rule] << "\n";
+  }
+  std::cout << "Merged expression nodes: " << analyzer.mergedNodes() << "\n";
+  const CallGraph &calls = analyzer.callGraph();
+  std::cout << "Call graph: " << calls.size() << " routines in "
+            << calls.components().size() << " components\n";
+  for (const auto &component : calls.components()) {
+    if (!calls.isRecursive(component[0]))
+      continue;
+    std::cout << "Recursive:";
+    for (int routine : component)
+      std::cout << " " << calls.name(routine);
+    std::cout << "\n";
+  }
   print_tree(root);
+
+  if (!c_file.empty()) {
+    // the C program runs the routine given to --run, else main if any
+    std::string entry = run;
+    const FunctionNode *main_routine =
+        analyzer.getOriginalTable()->findFunction("main");
+    if (entry.empty() && main_routine != nullptr &&
+        main_routine->parameters_.empty())
+      entry = "main";
+    std::ofstream c_source(c_file);
+    CEmitter emitter(*analyzer.getOriginalTable(), std::cerr);
+    if (!c_source.is_open() ||
+        !emitter.emit(root, entries, entry, c_source)) {
+      std::cerr << "ERROR: cannot emit " << c_file << std::endl;
+      return 1;
+    }
+  }
+
+  if (run.empty() && !bytecode)
+    return 0;
+  Program program;
+  BytecodeCompiler compiler(*analyzer.getOriginalTable(), std::cerr);
+  if (!compiler.compile(root, entries, program)) {
+    std::cerr << "ERROR: see above" << std::endl;
+    return 1;
+  }
+  if (optimize) {
+    // every machine runs the code lowered back from the optimized SSA form
+    SsaProgram ssa = toSsa(program);
+    SsaOptimizer optimizer(std::cerr);
+    if (!optimizer.run(ssa)) {
+      std::cerr << "ERROR: see above" << std::endl;
+      return 1;
+    }
+    for (const Inliner::Decision &decision : optimizer.inlining()) {
+      std::cout << (decision.inlined ? "Inlined " : "Kept call of ")
+                << decision.callee << (decision.inlined ? " into " : " in ")
+                << decision.caller << " (cost " << decision.cost << ", "
+                << decision.reason << ")\n";
+    }
+    for (int pass = 0; pass < SsaOptimizer::PassCount; pass++) {
+      if (optimizer.changes()[pass] != 0)
+        std::cout << "Optimized by " << SsaOptimizer::passName(pass) << ": "
+                  << optimizer.changes()[pass] << "\n";
+    }
+    if (optimizer.checks() != 0) {
+      size_t removed = optimizer.changes()[SsaOptimizer::Ranges];
+      std::cout << "Range analysis removed " << removed << " of "
+                << optimizer.checks() << " runtime checks ("
+                << removed * 100 / optimizer.checks() << "%)\n";
+    }
+    if (bytecode)
+      ssa.print(std::cout);
+    program = toBytecode(ssa);
+  }
+  RegisterProgram registers = toRegisters(program);
+  if (bytecode) {
+    program.disassemble(std::cout);
+    registers.disassemble(std::cout);
+  }
+  if (run.empty())
+    return 0;
+  int entry = program.find(run);
+  if (entry < 0) {
+    std::cerr << "No routine " << run << " to run" << std::endl;
+    return 1;
+  }
+  ConstantValue::Kind kind = program.routines[entry].result_kind;
+  bool all = machine == "all", both = all || machine == "both";
+  if ((both || machine == "stack") &&
+      !run_routine<StackVM>("Stack", program, run, kind))
+    return 1;
+  if ((both || machine == "register") &&
+      !run_routine<RegisterVM>("Register", registers, run, kind))
+    return 1;
+  if ((all || machine == "jit") &&
+      !run_routine<JitVM>("JIT", registers, run, kind))
+    return 1;
   return 0;
 }
@@ -1,149 +1,109 @@
 #include "CAnalyzer.hpp"
 #include <common/Node.hpp>
+#include <common/WorkStealingPool.hpp>
+#include <semantic_analyzer/optimizer/ExpressionDag.hpp>
 #include <iostream>
+#include <sstream>
 
-bool CAnalayzer::check_expression(CNode *node) {
-  if (node->name == "expression") {
-    if (!check_expression(node->children[0]))
-      return false;
-
-    if (node->children.size() == 3) {
-      if (!check_expression(node->children[2]))
-        return false;
-    }
-    return true;
-  } else if (node->name == "relation") {
-    if (!check_expression(node->children[0]))
-      return false;
-
-    if (node->children.size() == 3) {
-      if (!check_expression(node->children[2]))
-        return false;
-    }
-    return true;
-  } else if (node->name == "simple") {
-    if (!check_expression(node->children[0]))
-      return false;
-
-    if (node->children.size() == 3) {
-      if (!check_expression(node->children[2]))
-        return false;
-    }
-    return true;
-  } else if (node->name == "not_factor") {
-    return check_expression(node->children[1]);
-  } else if (node->name == "unary_factor") {
-    return check_expression(node->children[1]);
-  } else if (node->name == "factor") {
-    if (!check_expression(node->children[0]))
-      return false;
-
-    if (node->children.size() == 3) {
-      if (!check_expression(node->children[2]))
-        return false;
-    }
-    return true;
-  } else if (node->name == "summand") {
-    return check_expression(node->children[0]);
-  } else if (node->name == "modifiable_primary_array" ||
-             node->name == "modifiable_primary_field" ||
-             node->name == "modifiable_primary") {
-    return currentTable->check_modifiable(node);
-  } else if (node->name == "integer" || node->name == "boolean" ||
-             node->name == "real") {
-    return true;
+// names of the variables assigned anywhere inside node
+static void collectAssigned(CNode *node, std::vector<std::string> &names) {
+  if (node == nullptr)
+    return;
+  if (node->name == "assignment") {
+    CNode *target = node->children[0];
+    while (target->name != "modifiable_primary")
+      target = target->children[0];
+    names.push_back(target->children[0]->name);
   }
-  return false;
+  for (CNode *child : node->children)
+    collectAssigned(child, names);
+}
+
+// values assigned in a loop body are not known at its start, nor after it
+void CAnalayzer::forget_assigned(CNode *body) {
+  std::vector<std::string> names;
+  collectAssigned(body, names);
+  for (const std::string &name : names)
+    originalTable->forgetValue(name);
 }
 
 bool CAnalayzer::check_statements(CNode *node) {
   CNode *statement = node->children[0];
   if (statement->name == "return") {
-    // first processing
     auto ret_value = statement->children[0];
-    if (!currentTable->processingExpression(ret_value, 0)) {
-      return false;
+    if (ret_value == nullptr) {
+      return true;
     }
-    return check_expression(ret_value->children[0]);
+    // folding annotates the value with its type
+    return originalTable->processingExpression(ret_value, 0);
   } else if (statement->name == "assignment") {
-    if (!currentTable->check_modifiable(statement->children[0])) {
-      return false;
-    }
-    return currentTable->processingExpression(statement, 1);
+    return originalTable->checkAssignment(statement);
   } else if (statement->name == "routine_call") {
     std::string functionName = statement->children[0]->name;
-    return currentTable->checkFunctionCall(functionName,
+    return originalTable->checkFunctionCall(functionName,
                                            statement->children[1]);
   } else if (statement->name == "while_loop") {
-    if (!currentTable->processingExpression(statement, 0)) {
-      return false;
-    }
-    std::string key = currentTable->addSubScope();
-    if (key.empty()) {
+    forget_assigned(statement->children[1]);
+    if (!originalTable->processingExpression(statement, 0)) {
       return false;
     }
-    currentTable = currentTable->getSubScopeTable(key);
+    originalTable->pushScope();
 
     if (!check_reachable(statement->children[1])) {
       return false;
     }
-    currentTable = currentTable->getParent();
+    originalTable->popScope();
+    forget_assigned(statement->children[1]);
     return true;
   } else if (statement->name == "for_loop") {
+    // range keeps its bounds in source order; reverse ranges are marked
+    // by the node name instead of a child
     CNode *range = statement->children[1];
-    std::vector<CNode *> new_range = {};
-    if (range->children[0] != nullptr) {
-      new_range.push_back(range->children[1]);
-      new_range.push_back(range->children[2]);
-    } else {
-      new_range.push_back(range->children[2]);
-      new_range.push_back(range->children[1]);
-      delete range->children[0];
-    }
-    range->children = new_range;
-    if (!currentTable->processingExpression(range, 0) ||
-        !currentTable->processingExpression(range, 1)) {
-      return false;
+    if (range->children.size() == 3) {
+      if (range->children[0] != nullptr) {
+        delete range->children[0];
+        range->name = "reverse_range";
+      }
+      range->children = {range->children[1], range->children[2]};
     }
-    std::string key = currentTable->addSubScope();
-    if (key.empty()) {
+    if (!originalTable->processingExpression(range, 0) ||
+        !originalTable->processingExpression(range, 1)) {
       return false;
     }
-    currentTable = currentTable->getSubScopeTable(key);
+    forget_assigned(statement->children[2]);
+    originalTable->pushScope();
 
-    if (!currentTable->addCounter(statement->children[0]->name)) {
+    if (!originalTable->addCounter(statement->children[0]->name) ||
+        !originalTable->bindDeclaration(statement->children[0])) {
       return false;
     }
     if (!check_reachable(statement->children[2])) {
       return false;
     }
-    currentTable = currentTable->getParent();
+    originalTable->popScope();
+    forget_assigned(statement->children[2]);
     return true;
   } else if (statement->name == "if_statement") {
-    if (!currentTable->processingExpression(statement, 0)) {
+    if (!originalTable->processingExpression(statement, 0)) {
       return false;
     }
-    std::string key = currentTable->addSubScope();
-    if (key.empty()) {
-      return false;
-    }
-    currentTable = currentTable->getSubScopeTable(key);
+    // after the statement only the values both branches agree on are known
+    ControlTable::KnownValues before = originalTable->knownValues();
+    originalTable->pushScope();
     if (!check_reachable(statement->children[1])) {
       return false;
     }
-    currentTable = currentTable->getParent();
-    if (statement->children[2] == nullptr) {
-      return true;
-    }
-    key = currentTable->addSubScope();
-    if (key.empty()) {
-      return false;
-    }
-    currentTable = currentTable->getSubScopeTable(key);
-    if (!check_reachable(statement->children[2]->children[0])) {
-      return false;
+    originalTable->popScope();
+    ControlTable::KnownValues then_values = originalTable->knownValues();
+    originalTable->restoreValues(std::move(before));
+    if (statement->children[2] != nullptr) {
+      originalTable->pushScope();
+      if (!check_reachable(statement->children[2]->children[0])) {
+        return false;
+      }
+      originalTable->popScope();
     }
-    currentTable = currentTable->getParent();
+    originalTable->meetValues(then_values);
     return true;
   }
   return false;
@@ -153,54 +113,209 @@ bool CAnalayzer::check_simple_declaration(CNode *node) {
   CNode *dec = node->children[0];
   if (dec->name == "variable_declaration_auto") {
     if (dec->children.size() != 2) {
-      std::cerr << "Something wrong with CNode " << node->name << std::endl;
+      *err_ << "Something wrong with CNode " << node->name << std::endl;
       return false;
     }
-    return currentTable->addAutoVariable(dec->children[0]->name,
-                                         dec->children[1]);
+    if (!originalTable->processingExpression(dec, 1)) {
+      return false;
+    }
+    return originalTable->addAutoVariable(dec->children[0]->name,
+                                         dec->children[1]) &&
+           originalTable->bindDeclaration(dec->children[0]);
   } else if (dec->name == "variable_declaration") {
     if (dec->children.size() != 3) {
-      std::cerr << "Something wrong with CNode " << node->name << std::endl;
+      *err_ << "Something wrong with CNode " << node->name << std::endl;
       return false;
     }
-    if (!currentTable->processingExpression(dec, 2)){
+    if (!originalTable->processingExpression(dec, 2)){
       return false;
     }
-    return currentTable->addVariable(dec->children[0]->name, dec->children[1],
-                                     dec->children[2]);
+    return originalTable->addVariable(dec->children[0]->name, dec->children[1],
+                                     dec->children[2]) &&
+           originalTable->bindDeclaration(dec->children[0]);
   } else if (dec->name == "type_declaration") {
     if (dec->children.size() != 2) {
-      std::cerr << "Something wrong with CNode " << node->name << std::endl;
+      *err_ << "Something wrong with CNode " << node->name << std::endl;
       return false;
     }
-    return currentTable->addType(dec->children[0]->name, dec->children[1]);
+    return originalTable->addType(dec->children[0]->name, dec->children[1]);
   }
   return false;
 }
 
 bool CAnalayzer::check_routine_declaration(CNode *node) {
+  return declare_routine(node) && check_routine_body(node);
+}
+
+bool CAnalayzer::declare_routine(CNode *node) {
   if (node->children.size() != 4) {
-    std::cerr << "Something wrong with CNode " << node->name << std::endl;
+    *err_ << "Something wrong with CNode " << node->name << std::endl;
     return false;
   }
   std::string functionName = node->children[0]->name;
   CNode *parameters = node->children[1];
   CNode *returnType = node->children[2];
-  if (!currentTable->addFunction(functionName, returnType, parameters)) {
-    std::cerr << "Cannot create function " << functionName << std::endl;
+  if (!originalTable->addFunction(functionName, returnType, parameters,
+                                  node->children[3])) {
+    *err_ << "Cannot create function " << functionName << std::endl;
     return false;
   }
-  currentTable = currentTable->getSubScopeTable(functionName);
-  std::cout << "Processing body of function " << functionName << "\n";
+  return true;
+}
+
+bool CAnalayzer::check_routine_body(CNode *node) {
+  std::string functionName = node->children[0]->name;
+  if (!originalTable->enterFunction(functionName)) {
+    return false;
+  }
+  *out_ << "Processing body of function " << functionName << "\n";
   CNode *body = node->children[3];
   if (check_reachable(body)) {
-    currentTable = currentTable->getParent();
-    std::cout << "Body of function " << functionName << " was processed\n";
+    originalTable->leaveFunction();
+    // rewriting passes run before hash-consing shares the nodes
+    Simplifier simplifier(originalTable->typeArena());
+    simplifier.run(body);
+    for (int rule = 0; rule < Simplifier::RuleCount; rule++)
+      simplified_[rule] += simplifier.hits()[rule];
+    ExpressionDag dag;
+    dag.run(body);
+    merged_ += dag.merged();
+    *out_ << "Body of function " << functionName << " was processed\n";
     return true;
   }
   return false;
 }
 
+// names of the routines called inside node, in order of appearance
+static void collectCalls(CNode *node, std::vector<std::string> &names) {
+  if (node == nullptr)
+    return;
+  if (node->name == "routine_call")
+    names.push_back(node->children[0]->name);
+  for (CNode *child : node->children)
+    collectCalls(child, names);
+}
+
+// Global declarations and routine signatures are registered first, in
+// source order. The global table is not modified afterwards, so routine
+// bodies are then checked on the pool against their own local tables.
+// Bodies are scheduled by levels of the call graph, callees first, so a
+// call to a pure routine of an earlier level can be evaluated at compile
+// time. The buffered messages are replayed in source order.
+bool CAnalayzer::check_program(CNode *node) {
+  // global initializers calling routines must know what those assign
+  std::vector<std::string> assigned;
+  for (CNode *child : node->children) {
+    if (child->name == "routine_declaration")
+      collectAssigned(child->children[3], assigned);
+  }
+  for (const std::string &name : assigned)
+    originalTable->markAssigned(name);
+
+  std::vector<CNode *> routines;
+  for (size_t i = 0; i < node->children.size(); i++) {
+    CNode *child = node->children[i];
+    bool declared = child->name == "routine_declaration"
+                        ? declare_routine(child)
+                        : check_reachable(child);
+    if (!declared) {
+      *err_ << "ERROR: in " << node->name << " with child "
+                << child->name << std::endl;
+      return false;
+    }
+    if (child->name == "routine_declaration") {
+      routines.push_back(child);
+      call_graph_.addRoutine(child->children[0]->name);
+    }
+  }
+
+  // calls of names that are not routines are reported by the body check
+  for (CNode *routine : routines) {
+    std::vector<std::string> calls;
+    collectCalls(routine->children[3], calls);
+    for (const std::string &call : calls) {
+      if (call_graph_.find(call) != -1)
+        call_graph_.addCall(routine->children[0]->name, call);
+    }
+  }
+  call_graph_.build();
+
+  // with entry points only the routines they reach are checked
+  std::vector<bool> wanted(routines.size(), entries_.empty());
+  std::vector<int> reached;
+  for (const std::string &entry : entries_) {
+    int routine = call_graph_.find(entry);
+    if (routine == -1) {
+      *err_ << "Entry routine " << entry << " is not declared" << std::endl;
+      return false;
+    }
+    reached.push_back(routine);
+  }
+  for (size_t i = 0; i < reached.size(); i++) {
+    if (wanted[reached[i]])
+      continue;
+    wanted[reached[i]] = true;
+    for (int callee : call_graph_.callees(reached[i]))
+      reached.push_back(callee);
+  }
+
+  std::vector<Diagnostics> results(routines.size());
+  WorkStealingPool pool(threads_);
+  for (const auto &level : call_graph_.levels()) {
+    std::vector<int> batch;
+    for (int component : level) {
+      for (int routine : call_graph_.components()[component]) {
+        if (wanted[routine])
+          batch.push_back(routine);
+      }
+    }
+    check_routine_bodies(pool, routines, batch, results);
+    for (int routine : batch) {
+      if (results[routine].correct)
+        originalTable->markPure(call_graph_.name(routine));
+    }
+  }
+
+  bool correct = true;
+  for (size_t i = 0; i < routines.size(); i++) {
+    if (!wanted[i]) {
+      *out_ << "Body of function " << routines[i]->children[0]->name
+            << " is unreachable and was skipped\n";
+      continue;
+    }
+    *out_ << results[i].out.str();
+    *err_ << results[i].err.str();
+    if (!results[i].correct) {
+      *err_ << "ERROR: in " << node->name << " with child "
+            << routines[i]->name << std::endl;
+      correct = false;
+    }
+    merged_ += results[i].merged;
+    for (int rule = 0; rule < Simplifier::RuleCount; rule++)
+      simplified_[rule] += results[i].simplified[rule];
+  }
+  return correct;
+}
+
+// check the bodies of routines[i] for every i in batch in parallel
+void CAnalayzer::check_routine_bodies(WorkStealingPool &pool,
+                                      const std::vector<CNode *> &routines,
+                                      const std::vector<int> &batch,
+                                      std::vector<Diagnostics> &results) {
+  for (int i : batch) {
+    pool.submit([this, i, &routines, &results] {
+      Diagnostics &result = results[i];
+      auto table = std::make_shared<ControlTable>(originalTable.get(),
+                                                  result.out, result.err);
+      CAnalayzer routine(table, result.out, result.err);
+      result.correct = routine.check_routine_body(routines[i]);
+      result.merged = routine.mergedNodes();
+      result.simplified = routine.simplifications();
+    });
+  }
+  pool.wait();
+}
+
 bool CAnalayzer::check_reachable(CNode *node) {
   if (node == nullptr)
     return true;
@@ -211,22 +326,40 @@ bool CAnalayzer::check_reachable(CNode *node) {
     return check_routine_declaration(node);
   } else if (node->name == "statement") {
     return check_statements(node);
-  } else if (node->name == "program" || node->name == "body") {
+  } else if (node->name == "program") {
+    return check_program(node);
+  } else if (node->name == "body") {
     for (int i = 0; i < node->children.size(); i++) {
       if (!check_reachable(node->children[i])) {
-        std::cerr << "ERROR: in " << node->name << " with child "
+        *err_ << "ERROR: in " << node->name << " with child "
                   << node->children[i]->name << std::endl;
         return false;
       }
     }
     return true;
   }
-  std::cerr << "ERROR: Unknown CNode type" << std::endl;
+  *err_ << "ERROR: Unknown CNode type" << std::endl;
   return false;
 }
 CAnalayzer::CAnalayzer() {
   originalTable = std::make_shared<ControlTable>();
-  currentTable = originalTable;
+  out_ = &std::cout;
+  err_ = &std::cerr;
+}
+CAnalayzer::CAnalayzer(std::shared_ptr<ControlTable> table, std::ostream &out,
+                       std::ostream &err) {
+  originalTable = table;
+  out_ = &out;
+  err_ = &err;
+}
+void CAnalayzer::setThreads(unsigned threads) { threads_ = threads; }
+size_t CAnalayzer::mergedNodes() const { return merged_; }
+const std::vector<size_t> &CAnalayzer::simplifications() const {
+  return simplified_;
+}
+const CallGraph &CAnalayzer::callGraph() const { return call_graph_; }
+void CAnalayzer::setEntryPoints(std::vector<std::string> entries) {
+  entries_ = std::move(entries);
 }
 std::shared_ptr<ControlTable> CAnalayzer::getOriginalTable() {
   return originalTable;
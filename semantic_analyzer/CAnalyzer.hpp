@@ -1,7 +1,12 @@
 #ifndef ICOMPILER_ANALYZER_HPP
 #define ICOMPILER_ANALYZER_HPP
 
+#include "CallGraph.hpp"
 #include "ControlTable.hpp"
+#include "semantic_analyzer/optimizer/Simplifier.hpp"
+#include <sstream>
+
+class WorkStealingPool;
 
 class CAnalayzer {
 
@@ -13,13 +18,55 @@ public:
 
   std::shared_ptr<ControlTable> getOriginalTable();
 
+  // threads checking routine bodies, 0 means one per hardware thread
+  void setThreads(unsigned threads);
+
+  // Check only the bodies of these routines and of the routines they call,
+  // transitively; the other routines get their signatures checked only.
+  // Empty means every routine body is checked
+  void setEntryPoints(std::vector<std::string> entries);
+
+  // expression nodes shared by hash-consing of the checked bodies
+  size_t mergedNodes() const;
+
+  // applications of each Simplifier rule in the checked bodies
+  const std::vector<size_t> &simplifications() const;
+
+  // calls between the routines of the checked program
+  const CallGraph &callGraph() const;
+
 private:
-  bool check_expression(CNode *node);
+  CAnalayzer(std::shared_ptr<ControlTable> table, std::ostream &out,
+             std::ostream &err);
+
+  bool check_program(CNode *node);
+  bool declare_routine(CNode *node);
+  bool check_routine_body(CNode *node);
+  // messages and results of one routine body checked on the pool
+  struct Diagnostics {
+    std::ostringstream out;
+    std::ostringstream err;
+    size_t merged = 0;
+    std::vector<size_t> simplified;
+    bool correct = false;
+  };
+  void check_routine_bodies(WorkStealingPool &pool,
+                            const std::vector<CNode *> &routines,
+                            const std::vector<int> &batch,
+                            std::vector<Diagnostics> &results);
   bool check_statements(CNode *node);
+  void forget_assigned(CNode *body);
   bool check_simple_declaration(CNode *node);
   bool check_routine_declaration(CNode *node);
   std::shared_ptr<ControlTable> originalTable;
-  std::shared_ptr<ControlTable> currentTable;
+  std::ostream *out_;
+  std::ostream *err_;
+  unsigned threads_ = 0;
+  std::vector<std::string> entries_;
+  size_t merged_ = 0;
+  std::vector<size_t> simplified_ =
+      std::vector<size_t>(Simplifier::RuleCount, 0);
+  CallGraph call_graph_;
 };
 
 #endif // ICOMPILER_ANALYZER_HPP
@@ -0,0 +1,141 @@
+#include "CallGraph.hpp"
+#include <algorithm>
+
+int CallGraph::addRoutine(const std::string &name) {
+  auto id = ids_.emplace(name, (int)routines_.size());
+  if (id.second) {
+    routines_.emplace_back();
+    routines_.back().name = name;
+  }
+  return id.first->second;
+}
+
+void CallGraph::addCall(const std::string &caller, const std::string &callee) {
+  int from = addRoutine(caller);
+  int to = addRoutine(callee);
+  auto &callees = routines_[from].callees;
+  if (std::find(callees.begin(), callees.end(), to) != callees.end())
+    return;
+  callees.push_back(to);
+  routines_[to].callers.push_back(from);
+  if (from == to)
+    routines_[from].calls_itself = true;
+}
+
+// Tarjan's algorithm with an explicit stack, so deep call chains do not
+// overflow; it emits every component after the components it calls
+void CallGraph::build() {
+  int count = size();
+  std::vector<int> index(count, -1), low(count, 0);
+  std::vector<bool> on_stack(count, false);
+  std::vector<int> stack;
+  // routine and position in its callee list
+  std::vector<std::pair<int, size_t>> path;
+  int next = 0;
+  components_.clear();
+
+  for (int root = 0; root < count; root++) {
+    if (index[root] != -1)
+      continue;
+    path.emplace_back(root, 0);
+    while (!path.empty()) {
+      int routine = path.back().first;
+      size_t &edge = path.back().second;
+      if (edge == 0 && index[routine] == -1) {
+        index[routine] = low[routine] = next++;
+        stack.push_back(routine);
+        on_stack[routine] = true;
+      }
+      const auto &callees = routines_[routine].callees;
+      if (edge < callees.size()) {
+        int callee = callees[edge++];
+        if (index[callee] == -1)
+          path.emplace_back(callee, 0);
+        else if (on_stack[callee])
+          low[routine] = std::min(low[routine], index[callee]);
+        continue;
+      }
+      path.pop_back();
+      if (!path.empty()) {
+        int caller = path.back().first;
+        low[caller] = std::min(low[caller], low[routine]);
+      }
+      if (low[routine] != index[routine])
+        continue;
+      components_.emplace_back();
+      int member;
+      do {
+        member = stack.back();
+        stack.pop_back();
+        on_stack[member] = false;
+        routines_[member].component = (int)components_.size() - 1;
+        components_.back().push_back(member);
+      } while (member != routine);
+    }
+  }
+}
+
+int CallGraph::size() const { return (int)routines_.size(); }
+
+int CallGraph::find(const std::string &name) const {
+  auto id = ids_.find(name);
+  return id == ids_.end() ? -1 : id->second;
+}
+
+const std::string &CallGraph::name(int routine) const {
+  return routines_[routine].name;
+}
+
+const std::vector<int> &CallGraph::callees(int routine) const {
+  return routines_[routine].callees;
+}
+
+const std::vector<int> &CallGraph::callers(int routine) const {
+  return routines_[routine].callers;
+}
+
+int CallGraph::component(int routine) const {
+  return routines_[routine].component;
+}
+
+const std::vector<std::vector<int>> &CallGraph::components() const {
+  return components_;
+}
+
+bool CallGraph::isRecursive(int routine) const {
+  return routines_[routine].calls_itself ||
+         components_[component(routine)].size() > 1;
+}
+
+std::vector<std::vector<int>> CallGraph::levels() const {
+  std::vector<int> height(components_.size(), 0);
+  std::vector<std::vector<int>> levels;
+  for (int c = 0; c < (int)components_.size(); c++) {
+    for (int routine : components_[c]) {
+      for (int callee : routines_[routine].callees) {
+        int other = component(callee);
+        if (other != c)
+          height[c] = std::max(height[c], height[other] + 1);
+      }
+    }
+    if (height[c] >= (int)levels.size())
+      levels.resize(height[c] + 1);
+    levels[height[c]].push_back(c);
+  }
+  return levels;
+}
+
+std::vector<int> CallGraph::dependents(int routine) const {
+  std::vector<bool> seen(size(), false);
+  std::vector<int> result = {routine};
+  seen[routine] = true;
+  for (size_t i = 0; i < result.size(); i++) {
+    for (int caller : routines_[result[i]].callers) {
+      if (!seen[caller]) {
+        seen[caller] = true;
+        result.push_back(caller);
+      }
+    }
+  }
+  return result;
+}
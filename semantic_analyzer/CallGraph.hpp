@@ -0,0 +1,57 @@
+#ifndef CC_PROJECT_CALLGRAPH_HPP
+#define CC_PROJECT_CALLGRAPH_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Which routines call which, collected from the routine bodies before any
+// of them is checked.
+// build() groups the routines into strongly connected components (mutually
+// recursive routines) ordered callees first, so a component only calls
+// into itself and into components before it.
+class CallGraph {
+public:
+  CallGraph() = default;
+  ~CallGraph() = default;
+
+  // id of the routine, added when missing
+  int addRoutine(const std::string &name);
+  void addCall(const std::string &caller, const std::string &callee);
+
+  void build();
+
+  int size() const;
+  // -1 when name is not a routine
+  int find(const std::string &name) const;
+  const std::string &name(int routine) const;
+  const std::vector<int> &callees(int routine) const;
+  const std::vector<int> &callers(int routine) const;
+
+  int component(int routine) const;
+  const std::vector<std::vector<int>> &components() const;
+  bool isRecursive(int routine) const;
+
+  // components grouped by height: a group only calls into earlier groups,
+  // so the components of one group are independent of each other
+  std::vector<std::vector<int>> levels() const;
+
+  // routines to check again after routine changes: itself and every
+  // routine calling it, directly or not
+  std::vector<int> dependents(int routine) const;
+
+private:
+  struct Routine {
+    std::string name;
+    std::vector<int> callees;
+    std::vector<int> callers;
+    int component = -1;
+    bool calls_itself = false;
+  };
+
+  std::vector<Routine> routines_;
+  std::unordered_map<std::string, int> ids_;
+  std::vector<std::vector<int>> components_;
+};
+
+#endif // CC_PROJECT_CALLGRAPH_HPP
@@ -1,21 +1,29 @@
 #include "semantic_analyzer/ControlTable.hpp"
+#include "semantic_analyzer/optimizer/ConstantEvaluator.hpp"
+#include "semantic_analyzer/type_table/ConstantFolding.hpp"
 #include <algorithm>
 #include <iostream>
 #include <unordered_set>
 
 ControlTable::ControlTable() {
-  parent_.reset();
+  out_ = &std::cout;
+  err_ = &std::cerr;
   type_table_ = std::make_unique<TypeTable>();
   symbol_table_ = std::make_unique<SymbolTable>();
-  type_table_->addType("integer", std::make_shared<SimpleType>("integer"));
-  type_table_->addType("real", std::make_shared<SimpleType>("real"));
-  type_table_->addType("boolean", std::make_shared<SimpleType>("boolean"));
+  type_arena_ = std::make_shared<TypeArena>();
+  type_table_->addType("integer", type_arena_->simpleType("integer"));
+  type_table_->addType("real", type_arena_->simpleType("real"));
+  type_table_->addType("boolean", type_arena_->simpleType("boolean"));
 }
 
-ControlTable::ControlTable(ControlTable *parent) {
-  parent_ = parent->shared_from_this();
+ControlTable::ControlTable(const ControlTable *globals, std::ostream &out,
+                           std::ostream &err) {
+  globals_ = globals;
+  out_ = &out;
+  err_ = &err;
   type_table_ = std::make_unique<TypeTable>();
   symbol_table_ = std::make_unique<SymbolTable>();
+  type_arena_ = globals->type_arena_;
 }
 
 // std::shared_ptr<TypeNode> CompareTypes(std::shared_ptr<TypeNode> typeNode1,
@@ -73,12 +81,24 @@ std::shared_ptr<TypeNode> ControlTable::CNode2TypeNode(CNode *type) {
 
   CNode *realType = type->children[0];
   if (realType->name == "array_type") {
-    CNode *exp = realType->children[0];
     CNode *itemType = realType->children[1];
     auto typeNode = CNode2TypeNode(itemType);
     if (typeNode == nullptr)
       return nullptr;
-    return std::make_shared<ArrayType>(exp, typeNode);
+    // fold size so that arrays of equal length share one type
+    if (!processingExpression(realType, 0))
+      return nullptr;
+    CNode *size = realType->children[0];
+    if (type_arena_->toPrimitive(whatType(size)) != Primitive::Integer) {
+      *err_ << "Array size must be integer" << std::endl;
+      return nullptr;
+    }
+    if (size->constant && size->value.integer < 1) {
+      *err_ << "Array size must be positive: " << size->value.integer
+            << std::endl;
+      return nullptr;
+    }
+    return type_arena_->arrayType(size, typeNode);
   } else if (realType->name == "record_type") {
     CNode *fields = realType->children[0];
     std::vector<std::shared_ptr<VariableNode>> fields_list;
@@ -86,7 +106,7 @@ std::shared_ptr<TypeNode> ControlTable::CNode2TypeNode(CNode *type) {
       if (!CNode2FieldList(fields, fields_list))
         return nullptr;
     }
-    return std::make_shared<RecordType>(fields_list);
+    return type_arena_->recordType(fields_list);
   } else {
     return getType(realType->name);
   }
@@ -103,17 +123,26 @@ bool ControlTable::CNode2FieldList(
   for (int i = 0; i < amount_children; i++) {
     CNode *child = fields->children[i];
     std::shared_ptr<TypeNode> type;
+    CNode *default_value = nullptr;
     if (child->name == "variable_declaration") {
       type = CNode2TypeNode(child->children[1]);
       if (type == nullptr)
         return false;
+      if (!processingExpression(child, 2))
+        return false;
+      default_value = child->children[2];
     } else if (child->name == "variable_declaration_auto") {
-      type = std::make_shared<AutoType>();
+      if (!processingExpression(child, 1))
+        return false;
+      default_value = child->children[1];
+      type = whatType(default_value);
+      if (type == nullptr)
+        return false;
     } else {
       return false;
     }
     auto new_field = std::make_shared<VariableNode>(child->children[0]->name,
-                                                    type, child->children[1]);
+                                                    type, default_value);
     fields_list.push_back(new_field);
   }
   return true;
@@ -126,13 +155,13 @@ bool ControlTable::addAutoVariable(std::string name, CNode *expression) {
   if (typeNode == nullptr) {
     return false;
   }
-  std::cout << "!"<< typeNode->toStr()<<"!\n";
-  return symbol_table_->addVariable(name, typeNode, expression);
+  *out_ << "!"<< typeNode->toStr()<<"!\n";
+  return addVariable(name, typeNode, expression);
 }
 
 bool ControlTable::addFunction(const std::string &name, CNode *return_type,
-                               CNode *parameters) {
-  std::shared_ptr<TypeNode> typeNode = std::make_shared<NoTypeNode>();
+                               CNode *parameters, CNode *body) {
+  std::shared_ptr<TypeNode> typeNode = type_arena_->noType();
   if (return_type != nullptr) {
     typeNode = CNode2TypeNode(return_type);
     if (typeNode == nullptr)
@@ -166,103 +195,131 @@ bool ControlTable::addFunction(const std::string &name, CNode *return_type,
     }
   }
 
-  if (symbol_table_->addFunction(name, typeNode, parameters_list)) {
-    addSubScope(name);
-    auto subScope = getSubScopeTable(name);
-    for (int i = 0; i < parameters_list.size(); i++) {
-      subScope->addVariable(parameters_list[i]->variable_name_,
-                            parameters_list[i]->variable_type_,
-                            parameters_list[i]->default_value_);
-    }
-    return true;
+  if (!symbol_table_->addFunction(name, typeNode, parameters_list))
+    return false;
+  symbol_table_->getFunction(name)->body_ = body;
+  return true;
+}
+
+bool ControlTable::enterFunction(const std::string &name) {
+  auto function = getFunction(name);
+  if (function == nullptr)
+    return false;
+  routine_ = function;
+  routine_frame_ = Frame();
+  pushScope();
+  for (int i = 0; i < function->parameters_.size(); i++) {
+    addVariable(function->parameters_[i]->variable_name_,
+                function->parameters_[i]->variable_type_,
+                function->parameters_[i]->default_value_);
   }
-  return false;
+  return true;
 }
 
-bool ControlTable::isVariable(const std::string &name) {
-  if (symbol_table_->isVariable(name))
-    return true;
-  if (!parent_.expired())
-    return parent_.lock()->isVariable(name);
-  return false;
+bool ControlTable::isVariable(const std::string &name) const {
+  return getVariable(name) != nullptr;
 }
 
-bool ControlTable::isFunction(const std::string &name) {
-  if (symbol_table_->isFunction(name))
-    return true;
-  if (!parent_.expired())
-    return parent_.lock()->isFunction(name);
-  return false;
+bool ControlTable::isFunction(const std::string &name) const {
+  return getFunction(name) != nullptr;
 }
 
-bool ControlTable::isType(const std::string &name) {
-  if (type_table_->isType(name))
-    return true;
-  if (!parent_.expired())
-    return parent_.lock()->isType(name);
-  return false;
+bool ControlTable::isType(const std::string &name) const {
+  return getType(name) != nullptr;
 }
 
-std::shared_ptr<ControlTable>
-ControlTable::getSubScopeTable(const std::string &scope_name) const {
-  auto scope = sub_scopes_.find(scope_name);
-  if (scope == sub_scopes_.end()) {
-    return nullptr;
-  } else {
-    return (*scope).second;
+void ControlTable::leaveFunction() {
+  popScope();
+  if (routine_ != nullptr)
+    routine_->frame_size_ = routine_frame_.size;
+  routine_ = nullptr;
+}
+
+void ControlTable::pushScope() {
+  type_table_->pushScope();
+  symbol_table_->pushScope();
+  slot_marks_.push_back(frame().next);
+}
+
+// slots of variables going out of scope are reused by later siblings
+void ControlTable::popScope() {
+  type_table_->popScope();
+  symbol_table_->popScope();
+  if (!slot_marks_.empty()) {
+    frame().next = slot_marks_.back();
+    slot_marks_.pop_back();
   }
 }
 
-bool ControlTable::addSubScope(const std::string &scope_name) {
-  auto scope = sub_scopes_.find(scope_name);
-  if (scope != sub_scopes_.end())
+ControlTable::Frame &ControlTable::frame() {
+  return routine_ != nullptr ? routine_frame_ : global_frame_;
+}
+
+int ControlTable::globalFrameSize() const { return global_frame_.size; }
+
+const FunctionNode *ControlTable::findFunction(const std::string &name) const {
+  return getFunction(name).get();
+}
+
+const TypeArena &ControlTable::typeArena() const { return *type_arena_; }
+
+bool ControlTable::bindDeclaration(CNode *identifier) {
+  auto variable = getVariable(identifier->name);
+  if (variable == nullptr)
     return false;
-  auto sub_scope = std::make_shared<ControlTable>(this);
-  sub_scopes_.insert(std::pair<std::string, std::shared_ptr<ControlTable>>(
-      scope_name, sub_scope));
+  identifier->depth = variable->depth_;
+  identifier->slot = variable->slot_;
+  identifier->type = variable->variable_type_;
   return true;
 }
 
-std::string ControlTable::addSubScope() {
-  std::string key_scope = std::to_string(sub_scopes_.size() + 1);
-  if (addSubScope(key_scope))
-    return key_scope;
-  return "";
+void ControlTable::markPure(const std::string &name) {
+  auto function = getFunction(name);
+  if (function != nullptr)
+    function->pure_ = !touchesGlobals(function->body_, function.get());
+}
+
+bool ControlTable::touchesGlobals(const CNode *node,
+                                  const FunctionNode *self) const {
+  if (node == nullptr)
+    return false;
+  if (node->name == "modifiable_primary" && node->depth == 0)
+    return true;
+  if (node->name == "routine_call") {
+    auto callee = getFunction(node->children[0]->name);
+    if (callee == nullptr || (callee.get() != self && !callee->pure_))
+      return true;
+  }
+  for (const CNode *child : node->children) {
+    if (touchesGlobals(child, self))
+      return true;
+  }
+  return false;
 }
 
 std::shared_ptr<VariableNode>
-ControlTable::getVariable(const std::string &name) {
+ControlTable::getVariable(const std::string &name) const {
   auto result = symbol_table_->getVariable(name);
-  if (result != nullptr)
-    return result;
-  if (!parent_.expired())
-    return parent_.lock()->getVariable(name);
-  return nullptr;
+  if (result == nullptr && globals_ != nullptr)
+    return globals_->symbol_table_->getVariable(name);
+  return result;
 }
 
 std::shared_ptr<FunctionNode>
-ControlTable::getFunction(const std::string &name) {
+ControlTable::getFunction(const std::string &name) const {
   auto result = symbol_table_->getFunction(name);
-  if (result != nullptr)
-    return result;
-  if (!parent_.expired())
-    return parent_.lock()->getFunction(name);
-  return nullptr;
+  if (result == nullptr && globals_ != nullptr)
+    return globals_->symbol_table_->getFunction(name);
+  return result;
 }
 
-std::shared_ptr<TypeNode> ControlTable::getType(const std::string &name) {
+std::shared_ptr<TypeNode> ControlTable::getType(const std::string &name) const {
   auto result = type_table_->getType(name);
-  if (result != nullptr)
-    return result;
-  if (!parent_.expired())
-    return parent_.lock()->getType(name);
-  return nullptr;
-}
-std::shared_ptr<ControlTable> ControlTable::getParent() const {
-  if (parent_.expired())
-    return nullptr;
-  return parent_.lock();
+  if (result == nullptr && globals_ != nullptr)
+    return globals_->type_table_->getType(name);
+  return result;
 }
+
 bool ControlTable::addType(const std::string &name, CNode *type) {
   auto typeNode = CNode2TypeNode(type);
   if (typeNode == nullptr)
@@ -282,7 +339,16 @@ bool ControlTable::addVariable(const std::string &name,
                                CNode *expression) {
   if (type == nullptr)
     return false;
-  return symbol_table_->addVariable(name, type, expression);
+  if (!symbol_table_->addVariable(name, type, expression))
+    return false;
+  auto variable = symbol_table_->getVariable(name);
+  setKnown(variable, expression);
+  Frame &current = frame();
+  variable->depth_ = routine_ != nullptr ? 1 : 0;
+  variable->slot_ = current.next++;
+  if (current.next > current.size)
+    current.size = current.next;
+  return true;
 }
 
 bool ControlTable::checkFunctionCall(const std::string &functionName,
@@ -292,32 +358,39 @@ bool ControlTable::checkFunctionCall(const std::string &functionName,
   }
   auto function = getFunction(functionName);
   auto param = function->parameters_;
-  if (param.size() == 0 and arguments == nullptr)
-    return true;
-  else if (arguments != nullptr && param.size() == arguments->children.size()) {
-
+  size_t count = arguments == nullptr ? 0 : arguments->children.size();
+  if (param.size() != count)
+    return false;
+  if (count != 0) {
     std::vector<CNode *> arg_list = {};
     if (!CNode2ArgList(arguments, arg_list)) {
       return false;
     }
-    // TODO Compare types and variables;
-    return true;
+    // arguments are passed as if assigned to the parameters
+    for (size_t i = 0; i < count; i++) {
+      if (CompareTypes(param[i]->variable_type_,
+                       whatType(arguments->children[i]), ":=") == nullptr) {
+        *err_ << "Argument " << i + 1 << " of " << functionName
+              << " does not match the type of its parameter" << std::endl;
+        return false;
+      }
+    }
   }
-  return false;
+  return true;
 }
 
 bool ControlTable::CNode2ArgList(CNode *args, std::vector<CNode *> &args_list){
-  std::cout << args->children[0]->name;
+  *out_ << args->children[0]->name;
   for (int i =0; i < args ->children.size(); i++)
   {
-    processingExpression(args, i);
+    if (!processingExpression(args, i))
+      return false;
   }
   return true;
 }
 
 bool ControlTable::check_modifiable(CNode *node) {
-  std::shared_ptr<TypeNode> currentType = nullptr;
-  return check_modifiable(node, currentType);
+  return type_modifiable(node) != nullptr;
 }
 
 std::shared_ptr<TypeNode> ControlTable::type_modifiable(CNode *node) {
@@ -328,35 +401,147 @@ std::shared_ptr<TypeNode> ControlTable::type_modifiable(CNode *node) {
   return nullptr;
 }
 
+bool ControlTable::checkAssignment(CNode *assignment) {
+  auto target = type_modifiable(assignment->children[0]);
+  if (target == nullptr)
+    return false;
+  if (!processingExpression(assignment, 1))
+    return false;
+  if (CompareTypes(target, whatType(assignment->children[1]), ":=") ==
+      nullptr)
+    return false;
+  // elements and fields are not tracked
+  CNode *destination = assignment->children[0];
+  if (destination->name == "modifiable_primary")
+    setKnown(getVariable(destination->children[0]->name),
+             assignment->children[1]);
+  return true;
+}
+
+const ControlTable::KnownValues &ControlTable::knownValues() const {
+  return known_;
+}
+
+void ControlTable::restoreValues(KnownValues values) {
+  known_ = std::move(values);
+}
+
+void ControlTable::meetValues(const KnownValues &other) {
+  for (auto known = known_.begin(); known != known_.end();) {
+    auto found = other.find(known->first);
+    bool kept = found != other.end() && found->second.same(known->second);
+    known = kept ? std::next(known) : known_.erase(known);
+  }
+}
+
+void ControlTable::forgetValue(const std::string &name) {
+  auto variable = getVariable(name);
+  if (variable != nullptr)
+    known_.erase(variable.get());
+}
+
+void ControlTable::markAssigned(const std::string &name) {
+  assigned_.insert(name);
+}
+
+// only values of exactly the variable type are kept, an integer stored
+// into a real variable must not turn later reads into integers
+void ControlTable::setKnown(const std::shared_ptr<VariableNode> &variable,
+                            CNode *value) {
+  if (variable == nullptr)
+    return;
+  if (value != nullptr && value->constant && value->type != nullptr &&
+      variable->variable_type_ != nullptr &&
+      value->type->id == variable->variable_type_->id)
+    known_[variable.get()] = value->value;
+  else
+    known_.erase(variable.get());
+}
+
+CNode *ControlTable::knownLiteral(CNode *node) {
+  auto variable = getVariable(node->children[0]->name);
+  if (variable == nullptr)
+    return nullptr;
+  const KnownValues *values = &known_;
+  // globals read in a routine are constant only if no routine assigns them
+  if (variable->depth_ == 0 && globals_ != nullptr) {
+    if (globals_->assigned_.count(variable->variable_name_) != 0)
+      return nullptr;
+    values = &globals_->known_;
+  }
+  auto known = values->find(variable.get());
+  if (known == values->end())
+    return nullptr;
+  CNode *literal =
+      new CNode(primitiveName(type_arena_->toPrimitive(variable->variable_type_)));
+  literal->children.push_back(new CNode(known->second.toString()));
+  literal->value = known->second;
+  literal->type = variable->variable_type_;
+  return literal;
+}
+
 bool ControlTable::addVariable(std::string name, CNode *type,
                                CNode *expression) {
   auto typeNode = CNode2TypeNode(type);
   if (typeNode == nullptr)
     return false;
-  return symbol_table_->addVariable(name, typeNode, expression);
+  return addVariable(name, typeNode, expression);
 }
 
+// Resolved types are cached on the nodes of the chain, so chains such as
+// a.b[i].c are resolved once no matter how often later passes query them
 bool ControlTable::check_modifiable(CNode *node,
                                     std::shared_ptr<TypeNode> &currentType) {
+  if (node->type != nullptr) {
+    currentType = node->type;
+    return true;
+  }
+  if (!resolve_modifiable(node, currentType)) {
+    return false;
+  }
+  node->type = currentType;
+  return true;
+}
+
+// arrays are indexed from 1; constant indices into arrays of constant
+// length are checked here and need no runtime check
+bool ControlTable::checkIndex(CNode *access, const ArrayType *array) {
+  CNode *index = access->children[1];
+  if (type_arena_->toPrimitive(whatType(index)) != Primitive::Integer) {
+    *err_ << "Array index must be integer" << std::endl;
+    return false;
+  }
+  if (!index->constant || array->length < 0) {
+    return true;
+  }
+  if (index->value.integer < 1 || index->value.integer > array->length) {
+    *err_ << "Index " << index->value.integer << " is out of bounds 1.."
+          << array->length << std::endl;
+    return false;
+  }
+  access->proven |= CNode::InBounds;
+  return true;
+}
+
+bool ControlTable::resolve_modifiable(CNode *node,
+                                      std::shared_ptr<TypeNode> &currentType) {
   if (node->name == "modifiable_primary") {
     if (currentType == nullptr) {
       auto var = getVariable(node->children[0]->name);
       if (var == nullptr) {
         return false;
       }
+      node->depth = var->depth_;
+      node->slot = var->slot_;
       currentType = var->variable_type_;
       return true;
     } else if (currentType->getType() == Types::Record) {
-      auto fields = std::dynamic_pointer_cast<RecordType>(currentType)->fields;
-      auto field = std::find_if(
-          fields.begin(), fields.end(),
-          [=](const std::shared_ptr<VariableNode> &field) {
-            return field->variable_name_ == node->children[0]->name;
-          });
-      if (field == fields.end()) {
+      auto field = static_cast<RecordType *>(currentType.get())
+                       ->findField(node->children[0]->name);
+      if (field == nullptr) {
         return false;
       }
-      currentType = (*field)->variable_type_;
+      currentType = field->type;
       return true;
     }
   } else if (node->name == "modifiable_primary_array") {
@@ -366,8 +551,12 @@ bool ControlTable::check_modifiable(CNode *node,
     if (currentType->getType() != Types::Array) {
       return false;
     }
-    currentType = std::dynamic_pointer_cast<ArrayType>(currentType)->arrayType;
-    return processingExpression(node, 1);
+    auto array = static_cast<ArrayType *>(currentType.get());
+    currentType = array->arrayType;
+    if (!processingExpression(node, 1)) {
+      return false;
+    }
+    return checkIndex(node, array);
   } else if (node->name == "modifiable_primary_field") {
     if (!check_modifiable(node->children[0], currentType)) {
       return false;
@@ -395,413 +584,186 @@ void changeChild(CNode *&src_node, CNode *res_node) {
   src_node = res_node;
 }
 
-int toInteger(const CNode *node) {
-  if (node->name == "integer") {
-    return std::stoi(node->children[0]->name);
-  } else if (node->name == "real") {
-    double d = std::stod(node->children[0]->name);
-    int i = (int)d;
-    if ((i + 0.5) <= d)
-      i++;
-    return i;
-  } else if (node->name == "boolean") {
-    if (node->children[0]->name == "true") {
-      return 1;
-    }
-    return 0;
-  }
-  std::cerr << "Unknown type of CNode" << std::endl;
-  std::exit(1);
+bool isLiteral(const CNode *node) {
+  return node->name == "integer" || node->name == "boolean" ||
+         node->name == "real";
 }
 
-bool toBoolean(const CNode *node) {
-  if (node->name == "integer") {
-    int g = std::stoi(node->children[0]->name);
-    if (g == 1)
-      return true;
-    else if (g == 0)
-      return false;
-    else {
-      std::cerr << "Cannot convert " << g << " to boolean" << std::endl;
-      exit(1);
-    }
-  } else if (node->name == "real") {
-    std::cerr << "Real " << node->children[0]->name
-              << " cannot be converted to boolean" << std::endl;
-    exit(1);
-  } else if (node->name == "boolean") {
-    return node->children[0]->name == "true";
-  }
-  std::cerr << "Unknown type of CNode" << std::endl;
-  std::exit(1);
-}
-
-double toReal(const CNode *node) {
-  if (node->name == "integer") {
-    return std::stod(node->children[0]->name);
-  } else if (node->name == "real") {
-    return std::stod(node->children[0]->name);
-  } else if (node->name == "boolean") {
-    return node->children[0]->name == "true";
+// literal text is produced only for output, once the expression is folded
+void syncLiteralText(CNode *node) {
+  if (node == nullptr)
+    return;
+  if (node->constant && node->children.size() == 1) {
+    node->children[0]->name = node->value.toString();
+    return;
   }
-  std::cerr << "Unknown type of CNode" << std::endl;
-  std::exit(1);
+  for (CNode *child : node->children)
+    syncLiteralText(child);
 }
 
+// Type checking and folding share this single bottom-up walk: children are
+// folded and annotated before their parent, so the type of every node is
+// derived from the annotations below it
 CNode *ControlTable::calculate(CNode *node) {
-  CNode *res_node = nullptr;
-  if (node->name == "expression") {
-    res_node = calculate(node->children[0]);
-
-    if (res_node != node->children[0])
-      changeChild(node->children[0], res_node);
-
-    if (node->children.size() == 3) {
-      auto second_node = calculate(node->children[2]);
-      if (second_node != node->children[2])
-        changeChild(node->children[2], second_node);
-
-      if (!(res_node->name == "integer" || res_node->name == "boolean")) {
-        if (res_node->name == "real") {
-          std::cerr << "Real " << res_node->children[0]->name
-                    << " cannot be converted to boolean" << std::endl;
-          exit(1);
-        }
-        return node;
-      }
-
-      if (!(second_node->name == "integer" || second_node->name == "boolean")) {
-        if (second_node->name == "real") {
-          std::cerr << "Real " << second_node->children[0]->name
-                    << " cannot be converted to boolean" << std::endl;
-          exit(1);
-        }
-        return node;
-      }
-
-      bool real_l = toBoolean(res_node);
-      bool real_r = toBoolean(second_node);
-
-      std::string op = node->children[1]->name;
-      bool res;
-      if (op == "and") {
-        res = real_l && real_r;
-      } else if (op == "or") {
-        res = real_l || real_r;
-      } else if (op == "xor") {
-        res = (real_l || real_r) && !(real_l && real_r);
-      } else {
-        // ERROR
-        return node;
-      }
-
-      CNode *resultNode = new CNode("boolean");
-      if (res) {
-        resultNode->children.push_back(new CNode("true"));
-      } else {
-        resultNode->children.push_back(new CNode("false"));
-      }
-      return resultNode;
-    }
-    return node->children[0];
-  } else if (node->name == "relation") {
-    res_node = calculate(node->children[0]);
-
-    if (res_node != node->children[0])
-      changeChild(node->children[0], res_node);
-    if (node->children.size() == 3) {
-      auto second_node = calculate(node->children[2]);
-      if (second_node != node->children[2])
-        changeChild(node->children[2], second_node);
-
-      if (!(res_node->name == "integer" || res_node->name == "real")) {
-        if (res_node->name == "boolean") {
-          std::cerr << "Cannot use comparing with boolean" << std::endl;
-          exit(1);
-        }
-        return node;
-      }
-
-      if (!(second_node->name == "integer" || second_node->name == "real")) {
-        if (second_node->name == "boolean") {
-          std::cerr << "Cannot use comparing with boolean" << std::endl;
-          exit(1);
-        }
-        return node;
-      }
-
-      double real_l = toReal(res_node);
-      double real_r = toReal(second_node);
-
-      std::string op = node->children[1]->name;
-      bool res;
-      if (op == "<") {
-        res = real_l < real_r;
-      } else if (op == "<=") {
-        res = real_l <= real_r;
-      } else if (op == ">") {
-        res = real_l > real_r;
-      } else if (op == ">=") {
-        res = real_l >= real_r;
-      } else if (op == "=") {
-        res = real_l == real_r;
-      } else if (op == "/=") {
-        res = real_l != real_r;
-      } else {
-        // ERROR
-        exit(1);
-      }
-
-      CNode *resultNode = new CNode("boolean");
-      if (res) {
-        resultNode->children.push_back(new CNode("true"));
-      } else {
-        resultNode->children.push_back(new CNode("false"));
-      }
-      return resultNode;
+  CNode *res = foldNode(node);
+  if (res == nullptr)
+    return nullptr;
+  if (res->type == nullptr) {
+    res->type = deduceType(res);
+    if (res->type == nullptr) {
+      *err_ << "Type mismatch in " << res->name << std::endl;
+      return nullptr;
     }
-    return node->children[0];
-
-  } else if (node->name == "simple") {
-    res_node = calculate(node->children[0]);
-
-    if (res_node != node->children[0])
-      changeChild(node->children[0], res_node);
-    if (node->children.size() == 3) {
-      auto second_node = calculate(node->children[2]);
-      if (second_node != node->children[2])
-        changeChild(node->children[2], second_node);
-
-      if (!(res_node->name == "integer" || res_node->name == "real")) {
-        if (res_node->name == "boolean") {
-          std::cerr << "Cannot use arithmetic operations with boolean"
-                    << std::endl;
-          exit(1);
-        }
-        return node;
-      }
+  }
+  res->constant = isLiteral(res);
+  return res;
+}
 
-      if (!(second_node->name == "integer" || second_node->name == "real")) {
-        if (second_node->name == "boolean") {
-          std::cerr << "Cannot use arithmetic operations with boolean"
-                    << std::endl;
-          exit(1);
-        }
-        return node;
-      }
+bool ControlTable::foldChild(CNode *node, int idChild) {
+  CNode *res = calculate(node->children[idChild]);
+  if (res == nullptr)
+    return false;
+  if (res != node->children[idChild])
+    changeChild(node->children[idChild], res);
+  return true;
+}
 
-      std::string op = node->children[1]->name;
-      if (res_node->name == "integer" && second_node->name == "integer") {
-        int l = toInteger(res_node);
-        int r = toInteger(second_node);
-        int res = 0;
-        if (op == "/") {
-          if (r == 0) {
-            std::cerr << "Сannot be divided by zero" << std::endl;
-            exit(1);
-          }
-          res = l / r;
-        } else if (op == "*") {
-          res = l * r;
-        } else if (op == "%") {
-          if (r == 0) {
-            std::cerr << "Сannot be divided by zero" << std::endl;
-            exit(1);
-          }
-          res = l % r;
-        }
-
-        CNode *resultNode = new CNode("integer");
-        resultNode->children.push_back(new CNode(std::to_string(res)));
-        return resultNode;
-      } else {
-        double l = toReal(res_node);
-        double r = toReal(second_node);
-
-        double res = 0;
-        if (op == "/") {
-          if (r == 0) {
-            std::cerr << "Сannot be divided by zero" << std::endl;
-            exit(1);
-          }
-          res = l / r;
-        } else if (op == "*") {
-          res = l * r;
-        } else if (op == "%") {
-          std::cerr << "Not mod operation for real numbers" << std::endl;
-          exit(1);
-        }
-
-        CNode *resultNode = new CNode("real");
-        resultNode->children.push_back(new CNode(std::to_string(res)));
-        return resultNode;
+// Constant results are written into the literal operand in place, so
+// folding a chain of literals allocates nothing
+CNode *ControlTable::foldNode(CNode *node) {
+  if (isLiteral(node)) {
+    if (node->value.kind == ConstantValue::None) {
+      node->value =
+          ConstantValue::parse(node->name, node->children[0]->name);
+      if (node->value.kind == ConstantValue::None) {
+        *err_ << "Invalid literal " << node->children[0]->name
+                  << std::endl;
+        return nullptr;
       }
     }
-    return node->children[0];
-  } else if (node->name == "not_factor") {
-    auto res = calculate(node->children[1]);
-    if (res != node->children[1])
-      changeChild(node->children[1], res);
-
-    if (res->name == "real") {
-      std::cerr << "Real " << res->children[0]->name
-                << " cannot be converted to boolean" << std::endl;
-      exit(1);
-    }
+    return node;
+  } else if (node->name == "expression" || node->name == "relation" ||
+             node->name == "simple" || node->name == "factor") {
+    if (!foldChild(node, 0))
+      return nullptr;
+    if (node->children.size() == 1)
+      return node->children[0];
+    if (!foldChild(node, 2))
+      return nullptr;
 
-    if (!(res->name == "integer" || res->name == "boolean")) {
+    CNode *left = node->children[0];
+    CNode *right = node->children[2];
+    if (!left->constant || !right->constant)
       return node;
-    }
-
-    bool real_a = toBoolean(res);
 
-    real_a = !real_a;
-
-    CNode *resultNode = new CNode("boolean");
-    if (real_a) {
-      resultNode->children.push_back(new CNode("true"));
-    } else {
-      resultNode->children.push_back(new CNode("false"));
-    }
-    return resultNode;
-  } else if (node->name == "unary_factor") {
-    auto res = calculate(node->children[1]);
-    if (res != node->children[1])
-      changeChild(node->children[1], res);
-
-    if (res->name == "boolean") {
-      std::cerr << "Cannot use unary signs with Boolean: "
-                << res->children[0]->name << std::endl;
-      exit(1);
-    }
-
-    std::string op = node->children[0]->name;
-    std::string a = res->children[0]->name;
-    if (res->name == "integer") {
-      if (op == "+") {
-        return res;
-      }
-      int result = -std::stoi(a);
-      CNode *resultNode = new CNode("integer");
-      resultNode->children.push_back(new CNode(std::to_string(result)));
-      return resultNode;
-    } else if (res->name == "real") {
-      if (op == "+") {
-        return res;
-      }
-      double result = -std::stod(a);
-      CNode *resultNode = new CNode("real");
-      resultNode->children.push_back(new CNode(std::to_string(result)));
-      return resultNode;
-    } else {
+    std::string &operation = node->children[1]->name;
+    auto type = CompareTypes(left->type, right->type, operation);
+    if (type == nullptr)
+      return nullptr;
+    if (!foldBinary(toOperator(operation), left->value, right->value,
+                    type_arena_->toPrimitive(type), left->value, *err_))
+      return nullptr;
+    left->name = primitiveName(type_arena_->toPrimitive(type));
+    left->type = type;
+    return left;
+  } else if (node->name == "not_factor" || node->name == "unary_factor") {
+    if (!foldChild(node, 1))
+      return nullptr;
+    CNode *operand = node->children[1];
+    if (!operand->constant)
       return node;
-    }
-
-  } else if (node->name == "factor") {
-    res_node = calculate(node->children[0]);
-    if (res_node != node->children[0])
-      changeChild(node->children[0], res_node);
-
-    if (node->children.size() == 3) {
-      auto second_node = calculate(node->children[2]);
-      if (second_node != node->children[2])
-        changeChild(node->children[2], second_node);
-
-      if (!(res_node->name == "integer" || res_node->name == "real")) {
-        if (res_node->name == "boolean") {
-          std::cerr << "Cannot use arithmetic operations with boolean"
-                    << std::endl;
-          exit(1);
-        }
-        return node;
-      }
-
-      if (!(second_node->name == "integer" || second_node->name == "real")) {
-        if (second_node->name == "boolean") {
-          std::cerr << "Cannot use arithmetic operations with boolean"
-                    << std::endl;
-          exit(1);
-        }
-        return node;
-      }
 
-      if (res_node->name == "integer" && second_node->name == "integer") {
-        int real_l = toInteger(res_node);
-        int real_r = toInteger(second_node);
-
-        std::string op = node->children[1]->name;
-        int res;
-        if (op == "+") {
-          res = real_l + real_r;
-        } else if (op == "-") {
-          res = real_l - real_r;
-        } else {
-          // ERROR
-          exit(1);
-        }
-
-        CNode *resultNode = new CNode("integer");
-        resultNode->children.push_back(new CNode(std::to_string(res)));
-        return resultNode;
-      } else {
-        double real_l = toReal(res_node);
-        double real_r = toReal(second_node);
-
-        std::string op = node->children[1]->name;
-        double res;
-        if (op == "+") {
-          res = real_l + real_r;
-        } else if (op == "-") {
-          res = real_l - real_r;
-        } else {
-          // ERROR
-          exit(1);
-        }
-
-        CNode *resultNode = new CNode("real");
-        resultNode->children.push_back(new CNode(std::to_string(res)));
-        return resultNode;
-      }
-    }
-    return node->children[0];
+    std::string operation =
+        node->name == "not_factor" ? "not" : node->children[0]->name;
+    auto type = CompareTypes(operand->type, operand->type, operation);
+    if (type == nullptr)
+      return nullptr;
+    if (!foldUnary(toOperator(operation), operand->value, operand->value,
+                   *err_))
+      return nullptr;
+    operand->name = primitiveName(type_arena_->toPrimitive(type));
+    operand->type = type;
+    return operand;
   } else if (node->name == "summand") {
     return calculate(node->children[0]);
-
-  } else if (node->name == "integer" || node->name == "boolean" ||
-             node->name == "real") {
-    return node;
   } else if (node->name == "modifiable_primary" ||
              node->name == "modifiable_primary_array" ||
              node->name == "modifiable_primary_field") {
     if (!check_modifiable(node)) {
       return nullptr;
     }
+    if (node->name == "modifiable_primary") {
+      CNode *literal = knownLiteral(node);
+      if (literal != nullptr)
+        return literal;
+    }
     return node;
+  } else if (node->name == "routine_call") {
+    CNode *folded = foldCall(node);
+    // a call left for runtime in a global initializer may assign globals
+    if (folded == node && globals_ == nullptr) {
+      for (const std::string &name : assigned_)
+        forgetValue(name);
+    }
+    return folded;
   }
   return nullptr;
 }
 
+// Calls of pure routines with constant arguments are run by the
+// evaluator and replaced with their result; a call it gives up on (budget,
+// runtime error) is kept for runtime
+CNode *ControlTable::foldCall(CNode *call) {
+  const std::string &name = call->children[0]->name;
+  if (!checkFunctionCall(name, call->children[1]))
+    return nullptr;
+  auto function = getFunction(name);
+  Primitive result = type_arena_->toPrimitive(function->return_type_);
+  if (function->return_type_->getType() == Types::NoType) {
+    *err_ << "Routine " << name << " does not return a value" << std::endl;
+    return nullptr;
+  }
+  call->type = function->return_type_;
+  if (!function->pure_ || result == Primitive::Invalid)
+    return call;
+  std::vector<ConstantValue> arguments;
+  if (call->children[1] != nullptr) {
+    for (CNode *argument : call->children[1]->children) {
+      if (!argument->constant)
+        return call;
+      arguments.push_back(argument->value);
+    }
+  }
+  ConstantEvaluator evaluator(
+      *type_arena_, [this](const std::string &callee) {
+        return getFunction(callee).get();
+      });
+  ConstantValue value;
+  if (!evaluator.call(*function, arguments, value))
+    return call;
+  CNode *literal = new CNode(primitiveName(result));
+  literal->children.push_back(new CNode(value.toString()));
+  literal->value = value;
+  literal->type = function->return_type_;
+  return literal;
+}
+
 bool ControlTable::processingExpression(CNode *&parent, int idChild) {
   if (parent->children[idChild] == nullptr)
     return true;
-  CNode *res = calculate(parent->children[idChild]);
-  if (res == nullptr)
+  if (!foldChild(parent, idChild))
     return false;
-  if (res != parent->children[idChild])
-    changeChild(parent->children[idChild], res);
+  syncLiteralText(parent->children[idChild]);
   return true;
 }
 
-bool isNumber(const std::string &s) {
-  return !s.empty() && std::find_if(s.begin(), s.end(), [](char c) {
-                         return !std::isdigit(c);
-                       }) == s.end();
-}
-
 std::shared_ptr<TypeNode>
 ControlTable::CompareTypes(std::shared_ptr<TypeNode> typeNode1,
                            std::shared_ptr<TypeNode> typeNode2,
                            std::string operation) {
+  if (typeNode1 == nullptr || typeNode2 == nullptr) {
+    return nullptr;
+  }
   auto type1 = typeNode1->getType();
   auto type2 = typeNode2->getType();
 
@@ -810,185 +772,42 @@ ControlTable::CompareTypes(std::shared_ptr<TypeNode> typeNode1,
   }
 
   if (type1 == Types::Simple) {
-    std::shared_ptr<SimpleType> left =
-        std::dynamic_pointer_cast<SimpleType>(typeNode1);
-    std::shared_ptr<SimpleType> right =
-        std::dynamic_pointer_cast<SimpleType>(typeNode2);
-    std::string name1 = left->name;
-    std::string name2 = right->name;
-    // Check operation
-    if (operation == "+" || operation == "-" || operation == "*") {
-      if (name1 == "boolean" || name2 == "boolean") {
-        std::cout << "Invalid type\n";
+    if (operation == "EQ") {
+      if (typeNode1->id != typeNode2->id) {
+        *out_ << "Types incorrect\n";
         return nullptr;
       }
-      if (name1 == "real") {
-        std::cout << "Cast to real\n";
-        return typeNode1;
-      }
-      if (name2 == "real") {
-        std::cout << "Cast to real\n";
-        return typeNode2;
-      }
-      if (name1 == "integer" && name2 == "integer") {
-        std::cout << "Cast to integer\n";
-        return typeNode1;
-      }
-    } else if (operation == "%") {
-      if (name1 == "integer" && name2 == "integer") {
-        std::cout << "Cast to integer\n";
-        return typeNode1;
-      }
-      std::cout << "Invalid type\n";
-      return nullptr;
-    } else if (operation == "/") {
-      if (name1 == "boolean" || name2 == "boolean") {
-        std::cout << "Invalid type\n";
-        return nullptr;
-      }
-      if (name1 == "real") {
-        std::cout << "Cast to real\n";
-        return typeNode1;
-      }
-      if (name2 == "real") {
-        std::cout << "Cast to real\n";
-        return typeNode2;
-      }
-      if (name1 == "integer" && name2 == "integer") {
-        std::cout << "Cast to integer\n";
-        return typeNode1;
-      }
-    } else if (operation == "and" || operation == "or" || operation == "xor" ||
-               operation == "not") {
-      if (name1 == "real" || name2 == "real") {
-        std::cout << "Invalid type\n";
-        return nullptr;
-      }
-      if (name1 == "boolean" && name2 == "integer") {
-        std::cout << "Cast to boolean\n";
-        return typeNode1;
-      }
-      if (name2 == "boolean" && name1 == "integer") {
-        std::cout << "Cast to boolean\n";
-        return typeNode2;
-      }
-      if (name1 == "integer" && name2 == "integer") {
-        std::cout << "Cast to boolean\n";
-        // Create new boolean type Node
-        auto res = getType("boolean");
-        return res;
-      }
-      if (name1 == "boolean" && name2 == "boolean") {
-        std::cout << "Cast to boolean\n";
-        return typeNode1;
-      }
-
-    } else if (operation == "<" || operation == "<=" || operation == ">" ||
-               operation == ">=" || operation == "=" || operation == "/=") {
-
-      if (name1 == "boolean" || name2 == "boolean") {
-        std::cout << "Invalid type\n";
-        return nullptr;
-      }
-      // Create new boolean type node
-      auto res = getType("boolean");
-      std::cout << "Cast to boolean\n";
-      return res;
-    } else if (operation == ":=") {
-      if (name1 == "boolean") {
-        if (name2 == "real") {
-          std::cout << "Invalid type\n";
-          return nullptr;
-        }
-        if (name2 == "integer" || name2 == "boolean") {
-          std::cout << "Cast to boolean\n";
-          return typeNode1;
-        }
-      }
-      if (name1 == "integer") {
-        std::cout << "Cast to integer\n";
-        return typeNode1;
-      }
-      if (name1 == "real") {
-        std::cout << "Cast to real\n";
-        return typeNode1;
-      }
-    } else if (operation == "EQ") {
-      // std::cout << "NAME1: "<< name1 <<'\n';
-      // std::cout << "NAME2: "<< name2 <<'\n';
-
-      if (name1 != name2) {
-        std::cout << "Types incorrect\n";
-        return nullptr;
-      }
-      std::cout << "Types correct\n";
+      *out_ << "Types correct\n";
       return typeNode1;
     }
-    return nullptr;
+    Primitive result = operatorResult(toOperator(operation),
+                                      type_arena_->toPrimitive(typeNode1),
+                                      type_arena_->toPrimitive(typeNode2));
+    if (result == Primitive::Invalid) {
+      *out_ << "Invalid type\n";
+      return nullptr;
+    }
+    *out_ << "Cast to " << primitiveName(result) << "\n";
+    return type_arena_->primitiveType(result);
 
   } else if (type1 == Types::Array) {
-    std::shared_ptr<ArrayType> left =
-        std::dynamic_pointer_cast<ArrayType>(typeNode1);
-    std::shared_ptr<ArrayType> right =
-        std::dynamic_pointer_cast<ArrayType>(typeNode2);
-    if (operation == ":=") {
-
-      CNode *expression1 = left->expression;
-      CNode *expression2 = right->expression;
-
-      std::shared_ptr<TypeNode> res =
-          CompareTypes(left->arrayType, right->arrayType, "EQ");
-      if (res == nullptr) {
-        std::cout << "Types incorrect\n";
-        return nullptr;
-      }
-
-      if (isNumber(expression1->children[0]->name) &&
-          isNumber(expression2->children[0]->name)) {
-        int size1 = stoi(expression1->children[0]->name);
-        int size2 = stoi(expression2->children[0]->name);
-        std::cout << size1 << "\n";
-        std::cout << size2 << "\n";
-
-        if (size1 == size2) {
-          std::cout << "Array can be assigned\n";
-          return typeNode1;
-        }
-        std::cout << "Array cannot be assigned\n";
-        return nullptr;
+    // interned arrays are equal iff item types and folded sizes are equal
+    if (operation == ":=" || operation == "EQ") {
+      if (typeNode1->id == typeNode2->id) {
+        *out_ << "Array can be assigned\n";
+        return typeNode1;
       }
+      *out_ << "Array cannot be assigned\n";
     }
     return nullptr;
 
   } else if (type1 == Types::Record) {
-    std::shared_ptr<RecordType> left =
-        std::dynamic_pointer_cast<RecordType>(typeNode1);
-    std::shared_ptr<RecordType> right =
-        std::dynamic_pointer_cast<RecordType>(typeNode2);
-
-    auto r1 = left->fields;
-    auto r2 = right->fields;
-
-    if (r1.size() != r2.size()) {
-      return nullptr;
-    }
-    bool res =
-        std::equal(r1.begin(), r1.end(), r2.begin(), r2.end(),
-                   [this](std::shared_ptr<VariableNode> lhs,
-                          std::shared_ptr<VariableNode> rhs) {
-                     std::shared_ptr<TypeNode> res = CompareTypes(
-                         lhs->variable_type_, rhs->variable_type_, "EQ");
-                     if (res == nullptr) {
-                       return false;
-                     }
-                     return !(lhs->variable_name_ != rhs->variable_name_);
-                   });
-    if (!res) {
-      std::cout << "Record cannot be assigned\n";
+    if (typeNode1->id != typeNode2->id) {
+      *out_ << "Record cannot be assigned\n";
       return nullptr;
     }
 
-    std::cout << "Record can be assigned\n";
+    *out_ << "Record can be assigned\n";
     return typeNode1;
 
   } else if (type1 == Types::NoType) {
@@ -998,82 +817,31 @@ ControlTable::CompareTypes(std::shared_ptr<TypeNode> typeNode1,
 }
 
 std::shared_ptr<TypeNode> ControlTable::whatType(CNode *node) {
-  std::shared_ptr<TypeNode> result = nullptr;
-  std::shared_ptr<TypeNode> result_left = nullptr;
-  std::shared_ptr<TypeNode> result_right = nullptr;
+  if (node == nullptr)
+    return nullptr;
+  return node->type;
+}
 
-  std::string operation = "";
-  if (node->name == "expression") {
+std::shared_ptr<TypeNode> ControlTable::deduceType(CNode *node) {
+  if (node->name == "integer" || node->name == "boolean" ||
+      node->name == "real") {
+    return getType(node->name);
+  } else if (node->name == "expression" || node->name == "relation" ||
+             node->name == "simple" || node->name == "factor") {
     if (node->children.size() == 3) {
-      operation = node->children[1]->name;
-      result_left = whatType(node->children[0]);
-      result_right = whatType(node->children[2]);
-      if (result_left == nullptr && result_right == nullptr) {
-        std::cout << "Not type!\n";
-        return nullptr;
-      }
-      result = CompareTypes(result_left, result_right, operation);
-      return result;
-    }
-    if (node->children.size() == 1) {
-      return whatType(node->children[0]);
-    }
-  } else if (node->name == "relation") {
-    if (node->children.size() == 3) {
-      result_left = whatType(node->children[0]);
-      operation = node->children[1]->name;
-      result_right = whatType(node->children[2]);
-      if (result_left == nullptr && result_right == nullptr) {
-        std::cout << "Not type!\n";
-        return nullptr;
-      }
-      result = CompareTypes(result_left, result_right, operation);
-      return result;
-    }
-    if (node->children.size() == 1) {
-      return whatType(node->children[0]);
-    }
-  } else if (node->name == "simple") {
-    if (node->children.size() == 3) {
-      operation = node->children[1]->name;
-      result_left = whatType(node->children[0]);
-      result_right = whatType(node->children[2]);
-      if (result_left == nullptr && result_right == nullptr) {
-        std::cout << "Not type!\n";
-        return nullptr;
-      }
-      result = CompareTypes(result_left, result_right, operation);
-      return result;
-    }
-    if (node->children.size() == 1) {
-      return whatType(node->children[0]);
-    }
-  } else if (node->name == "factor") {
-    if (node->children.size() == 3) {
-      operation = node->children[1]->name;
-      result_left = whatType(node->children[0]);
-      result_right = whatType(node->children[2]);
-      if (result_left == nullptr && result_right == nullptr) {
-        std::cout << "Not type!\n";
-        return nullptr;
-      }
-      result = CompareTypes(result_left, result_right, operation);
-      return result;
-    }
-    if (node->children.size() == 1) {
-      return whatType(node->children[0]);
+      return CompareTypes(whatType(node->children[0]),
+                          whatType(node->children[2]),
+                          node->children[1]->name);
     }
+    return whatType(node->children[0]);
+  } else if (node->name == "not_factor") {
+    auto operand = whatType(node->children[1]);
+    return CompareTypes(operand, operand, "not");
+  } else if (node->name == "unary_factor") {
+    auto operand = whatType(node->children[1]);
+    return CompareTypes(operand, operand, node->children[0]->name);
   } else if (node->name == "summand") {
     return whatType(node->children[0]);
-  } else if (node->name == "integer" || node->name == "boolean" ||
-             node->name == "real") {
-    std::cout << node->name << '\n';
-    result = getType(node->name);
-    return result;
-  } else if (node->name == "modifiable_primary_array" ||
-             node->name == "modifiable_primary" ||
-             node->name == "modifiable_primary_field") {
-    return type_modifiable(node);
   }
   return nullptr;
 }
@@ -2,13 +2,22 @@
 #define TUTORIAL_CONTROLTABLE_HPP
 
 #include "semantic_analyzer/symbol_table/SymbolTable.hpp"
+#include "semantic_analyzer/type_table/TypeArena.hpp"
 #include "semantic_analyzer/type_table/TypeTable.hpp"
 #include <memory>
+#include <ostream>
+#include <unordered_set>
 
-class ControlTable : public std::enable_shared_from_this<ControlTable> {
+// All scopes share one flat table: nested scopes are pushed and popped
+// instead of being allocated as separate ControlTable objects
+class ControlTable {
 public:
   ControlTable();
-  ControlTable(ControlTable *parent);
+  // Table for one routine body. Names missing from it are looked up in
+  // globals, which must not change while this table is in use; messages
+  // go to the given streams instead of std::cout and std::cerr
+  ControlTable(const ControlTable *globals, std::ostream &out,
+               std::ostream &err);
   ~ControlTable() = default;
 
   bool addType(const std::string &name, CNode *type);
@@ -17,50 +26,88 @@ public:
   bool addAutoVariable(const std::string name, CNode *expression);
   bool addCounter(const std::string &name);
   bool addFunction(const std::string &name, CNode *return_type,
-                   CNode *parameters);
+                   CNode *parameters, CNode *body);
 
-  bool isVariable(const std::string &name);
-  bool isFunction(const std::string &name);
+  bool isVariable(const std::string &name) const;
+  bool isFunction(const std::string &name) const;
 
-  bool isType(const std::string &name);
+  bool isType(const std::string &name) const;
 
-  std::shared_ptr<ControlTable>
-  getSubScopeTable(const std::string &scope_name) const;
+  // open scope of routine body and declare its parameters
+  bool enterFunction(const std::string &name);
 
-  // add subScope
-  bool addSubScope(const std::string &scope_name);
+  // close routine scope and record the size of its frame
+  void leaveFunction();
 
   // for inner structures
-  // index will be number of scope
-  // in superscope start from 1
-  // return key
-  std::string addSubScope();
+  void pushScope();
 
-  std::shared_ptr<ControlTable> getParent() const;
+  void popScope();
 
   bool check_modifiable(CNode *node);
 
+  // store frame depth, slot and type of the declared variable on its
+  // identifier
+  bool bindDeclaration(CNode *identifier);
+
+  // decide purity of a routine whose body is checked; its callees other
+  // than itself must be decided before
+  void markPure(const std::string &name);
+
+  int globalFrameSize() const;
+
+  // nullptr if name is not a routine
+  const FunctionNode *findFunction(const std::string &name) const;
+
+  const TypeArena &typeArena() const;
+
+  // modifiable target and folded value must be assignment compatible
+  bool checkAssignment(CNode *assignment);
+
   bool checkFunctionCall(const std::string &functionName, CNode *arguments);
 
   bool processingExpression(CNode *&parent, int idChild);
 
+  // Constant propagation: values of primitive variables known at the
+  // current point of the checked code. Reads of such variables fold to
+  // literals; the analyzer saves and merges the values around branches
+  // and forgets the variables a loop assigns
+  using KnownValues = std::unordered_map<const VariableNode *, ConstantValue>;
+  const KnownValues &knownValues() const;
+  void restoreValues(KnownValues values);
+  // keep only the values that other knows too, with the same value
+  void meetValues(const KnownValues &other);
+  void forgetValue(const std::string &name);
+
+  // name is assigned in some routine body, so a global of that name is
+  // not constant inside routines, nor after a call in a global initializer
+  void markAssigned(const std::string &name);
+
 private:
-  std::shared_ptr<TypeNode> getType(const std::string &name);
+  std::shared_ptr<TypeNode> getType(const std::string &name) const;
 
   std::shared_ptr<TypeNode> type_modifiable(CNode *node);
 
+  // type annotated by calculate
   std::shared_ptr<TypeNode> whatType(CNode *node);
 
+  // type of node from the annotations of its children
+  std::shared_ptr<TypeNode> deduceType(CNode *node);
+
   std::shared_ptr<TypeNode> CompareTypes(std::shared_ptr<TypeNode> typeNode1,
                                          std::shared_ptr<TypeNode> typeNode2,
                                          std::string operation);
 
-  std::shared_ptr<FunctionNode> getFunction(const std::string &name);
-  std::shared_ptr<VariableNode> getVariable(const std::string &name);
-  //  std::shared_ptr<TypeNode> getType(const std::string &name);
+  std::shared_ptr<FunctionNode> getFunction(const std::string &name) const;
+  std::shared_ptr<VariableNode> getVariable(const std::string &name) const;
 
   bool check_modifiable(CNode *node, std::shared_ptr<TypeNode> &currentType);
 
+  bool resolve_modifiable(CNode *node,
+                          std::shared_ptr<TypeNode> &currentType);
+
+  bool checkIndex(CNode *access, const ArrayType *array);
+
   bool CNode2FieldList(CNode *fields,
                        std::vector<std::shared_ptr<VariableNode>> &fields_list);
 
@@ -75,10 +122,37 @@ private:
 
   CNode *calculate(CNode *node);
 
-  std::weak_ptr<ControlTable> parent_;
+  CNode *foldNode(CNode *node);
+
+  // fold child in place, replacing it by its folded result
+  bool foldChild(CNode *node, int idChild);
+  void setKnown(const std::shared_ptr<VariableNode> &variable, CNode *value);
+  // literal holding the known value of a variable read, or nullptr
+  CNode *knownLiteral(CNode *node);
+  CNode *foldCall(CNode *call);
+  bool touchesGlobals(const CNode *node, const FunctionNode *self) const;
+
+  // Variables get consecutive slots of the global frame or of the frame of
+  // the routine being checked
+  struct Frame {
+    int next = 0;
+    int size = 0;
+  };
+
+  Frame &frame();
+
+  const ControlTable *globals_ = nullptr;
+  std::shared_ptr<FunctionNode> routine_;
+  Frame global_frame_;
+  Frame routine_frame_;
+  std::vector<int> slot_marks_;
+  KnownValues known_;
+  std::unordered_set<std::string> assigned_;
+  std::ostream *out_;
+  std::ostream *err_;
+  std::shared_ptr<TypeArena> type_arena_;
   std::unique_ptr<TypeTable> type_table_;
   std::unique_ptr<SymbolTable> symbol_table_;
-  std::unordered_map<std::string, std::shared_ptr<ControlTable>> sub_scopes_;
 };
 
 #endif // TUTORIAL_CONTROLTABLE_HPP
@@ -0,0 +1,319 @@
+#include "ConstantEvaluator.hpp"
+#include "semantic_analyzer/type_table/ConstantFolding.hpp"
+
+namespace {
+
+constexpr int kMaxCallDepth = 256;
+
+bool isBinary(const CNode *node) {
+  return node->children.size() == 3 &&
+         (node->name == "expression" || node->name == "relation" ||
+          node->name == "simple" || node->name == "factor");
+}
+
+} // namespace
+
+ConstantEvaluator::ConstantEvaluator(const TypeArena &arena, Lookup lookup,
+                                     size_t budget)
+    : arena_(arena), lookup_(std::move(lookup)), budget_(budget) {}
+
+size_t ConstantEvaluator::steps() const { return steps_; }
+
+bool ConstantEvaluator::step() { return ++steps_ <= budget_; }
+
+bool ConstantEvaluator::call(const FunctionNode &function,
+                             const std::vector<ConstantValue> &arguments,
+                             ConstantValue &result) {
+  std::vector<Value> values(arguments.size());
+  for (size_t i = 0; i < arguments.size(); i++)
+    values[i].scalar = arguments[i];
+  Value value;
+  if (!invoke(function, std::move(values), value) ||
+      value.scalar.kind == ConstantValue::None)
+    return false;
+  result = value.scalar;
+  return true;
+}
+
+bool ConstantEvaluator::invoke(const FunctionNode &function,
+                               std::vector<Value> arguments, Value &result) {
+  if (function.body_ == nullptr ||
+      arguments.size() != function.parameters_.size() ||
+      depth_ >= kMaxCallDepth)
+    return false;
+  Frame frame;
+  frame.slots.resize(function.frame_size_);
+  for (size_t i = 0; i < arguments.size(); i++) {
+    if (!store(function.parameters_[i]->variable_type_,
+               std::move(arguments[i]), frame.slots[i]))
+      return false;
+  }
+  depth_++;
+  Flow flow = block(function.body_, frame);
+  depth_--;
+  if (flow == Flow::Fail)
+    return false;
+  // the returned expression may still have to become the declared type
+  return store(function.return_type_, std::move(frame.result), result);
+}
+
+ConstantEvaluator::Flow ConstantEvaluator::block(CNode *body, Frame &frame) {
+  if (body == nullptr)
+    return Flow::Next;
+  for (CNode *child : body->children) {
+    Flow flow = child->name == "statement"
+                    ? statement(child->children[0], frame)
+                    : declaration(child->children[0], frame);
+    if (flow != Flow::Next)
+      return flow;
+  }
+  return Flow::Next;
+}
+
+ConstantEvaluator::Flow ConstantEvaluator::declaration(CNode *node,
+                                                       Frame &frame) {
+  if (node->name == "type_declaration")
+    return Flow::Next;
+  if (!step())
+    return Flow::Fail;
+  CNode *identifier = node->children[0];
+  CNode *expression = node->name == "variable_declaration_auto"
+                          ? node->children[1]
+                          : node->children[2];
+  if (identifier->depth != 1)
+    return Flow::Fail;
+  Value &slot = frame.slots[identifier->slot];
+  if (expression == nullptr)
+    return initial(identifier->type, frame, slot) ? Flow::Next : Flow::Fail;
+  Value value;
+  if (!evaluate(expression, frame, value) ||
+      !store(identifier->type, std::move(value), slot))
+    return Flow::Fail;
+  return Flow::Next;
+}
+
+ConstantEvaluator::Flow ConstantEvaluator::statement(CNode *node,
+                                                     Frame &frame) {
+  if (!step())
+    return Flow::Fail;
+  if (node->name == "return") {
+    if (node->children[0] != nullptr &&
+        !evaluate(node->children[0]->children[0], frame, frame.result))
+      return Flow::Fail;
+    return Flow::Return;
+  } else if (node->name == "assignment") {
+    Value value;
+    if (!evaluate(node->children[1], frame, value))
+      return Flow::Fail;
+    Value *target = locate(node->children[0], frame);
+    if (target == nullptr ||
+        !store(node->children[0]->type, std::move(value), *target))
+      return Flow::Fail;
+    return Flow::Next;
+  } else if (node->name == "routine_call") {
+    Value ignored;
+    return evaluate(node, frame, ignored) ? Flow::Next : Flow::Fail;
+  } else if (node->name == "if_statement") {
+    bool taken;
+    if (!condition(node->children[0], frame, taken))
+      return Flow::Fail;
+    if (taken)
+      return block(node->children[1], frame);
+    if (node->children[2] != nullptr)
+      return block(node->children[2]->children[0], frame);
+    return Flow::Next;
+  }
+  return loop(node, frame);
+}
+
+ConstantEvaluator::Flow ConstantEvaluator::loop(CNode *node, Frame &frame) {
+  if (node->name == "while_loop") {
+    while (true) {
+      bool running;
+      if (!step() || !condition(node->children[0], frame, running))
+        return Flow::Fail;
+      if (!running)
+        return Flow::Next;
+      Flow flow = block(node->children[1], frame);
+      if (flow != Flow::Next)
+        return flow;
+    }
+  }
+  if (node->name != "for_loop")
+    return Flow::Fail;
+  CNode *counter = node->children[0];
+  CNode *range = node->children[1];
+  Value low, high;
+  if (counter->depth != 1 || !evaluate(range->children[0], frame, low) ||
+      !evaluate(range->children[1], frame, high))
+    return Flow::Fail;
+  int64_t first = low.scalar.integer, last = high.scalar.integer;
+  bool reverse = range->name == "reverse_range";
+  if (reverse)
+    std::swap(first, last);
+  for (int64_t i = first; reverse ? i >= last : i <= last;
+       reverse ? i-- : i++) {
+    if (!step())
+      return Flow::Fail;
+    frame.slots[counter->slot].scalar = ConstantValue::ofInteger(i);
+    Flow flow = block(node->children[2], frame);
+    if (flow != Flow::Next)
+      return flow;
+    if (i == (reverse ? INT64_MIN : INT64_MAX))
+      break;
+  }
+  return Flow::Next;
+}
+
+bool ConstantEvaluator::condition(CNode *node, Frame &frame, bool &result) {
+  Value value;
+  return evaluate(node, frame, value) &&
+         toBoolean(value.scalar, result, ignored_);
+}
+
+bool ConstantEvaluator::evaluate(CNode *node, Frame &frame, Value &result) {
+  if (!step())
+    return false;
+  if (node->constant) {
+    result.scalar = node->value;
+    return true;
+  }
+  Primitive type = arena_.toPrimitive(node->type);
+  if (isBinary(node)) {
+    Value left, right;
+    if (!evaluate(node->children[0], frame, left) ||
+        !evaluate(node->children[2], frame, right))
+      return false;
+    return foldBinary(toOperator(node->children[1]->name), left.scalar,
+                      right.scalar, type, result.scalar, ignored_);
+  } else if (node->name == "unary_factor" || node->name == "not_factor") {
+    Value operand;
+    if (!evaluate(node->children[1], frame, operand))
+      return false;
+    Operator op = node->name == "not_factor"
+                      ? Operator::Not
+                      : toOperator(node->children[0]->name);
+    return foldUnary(op, operand.scalar, result.scalar, ignored_);
+  } else if (node->name == "routine_call") {
+    const FunctionNode *function = lookup_(node->children[0]->name);
+    if (function == nullptr)
+      return false;
+    std::vector<Value> arguments;
+    if (node->children[1] != nullptr) {
+      arguments.resize(node->children[1]->children.size());
+      for (size_t i = 0; i < arguments.size(); i++) {
+        if (!evaluate(node->children[1]->children[i], frame, arguments[i]))
+          return false;
+      }
+    }
+    return invoke(*function, std::move(arguments), result);
+  }
+  Value *location = locate(node, frame);
+  if (location == nullptr)
+    return false;
+  result = *location;
+  return true;
+}
+
+// only the frame of the running routine is reachable
+ConstantEvaluator::Value *ConstantEvaluator::locate(CNode *node,
+                                                    Frame &frame) {
+  if (node->name == "modifiable_primary") {
+    if (node->depth != 1 || node->slot >= (int)frame.slots.size())
+      return nullptr;
+    return &frame.slots[node->slot];
+  }
+  Value *base = locate(node->children[0], frame);
+  return base == nullptr ? nullptr : select(node, base, frame);
+}
+
+ConstantEvaluator::Value *ConstantEvaluator::select(CNode *node, Value *base,
+                                                    Frame &frame) {
+  if (node->name == "modifiable_primary_array") {
+    Value index;
+    if (!evaluate(node->children[1], frame, index))
+      return nullptr;
+    int64_t position = index.scalar.integer;
+    if (position < 1 || position > (int64_t)base->items.size())
+      return nullptr;
+    return &base->items[position - 1];
+  }
+  // the grammar nests the rest of a chain such as a.b[i].c to the right
+  return member(node->children[1], base, node->children[0]->type, frame);
+}
+
+ConstantEvaluator::Value *
+ConstantEvaluator::member(CNode *node, Value *record,
+                          const std::shared_ptr<TypeNode> &type,
+                          Frame &frame) {
+  if (node->name != "modifiable_primary") {
+    Value *base = member(node->children[0], record, type, frame);
+    return base == nullptr ? nullptr : select(node, base, frame);
+  }
+  if (type == nullptr || type->getType() != Types::Record)
+    return nullptr;
+  auto field =
+      static_cast<RecordType *>(type.get())->findField(node->children[0]->name);
+  if (field == nullptr || field->ordinal >= (int)record->items.size())
+    return nullptr;
+  return &record->items[field->ordinal];
+}
+
+bool ConstantEvaluator::store(const std::shared_ptr<TypeNode> &type,
+                              Value value, Value &target) {
+  Primitive primitive = arena_.toPrimitive(type);
+  if (primitive == Primitive::Invalid) {
+    target = std::move(value);
+    return true;
+  }
+  return convertValue(value.scalar, primitive, target.scalar, ignored_);
+}
+
+// zero of the type; sizes of arrays that are not constant are computed in
+// the frame declaring them
+bool ConstantEvaluator::initial(const std::shared_ptr<TypeNode> &type,
+                                Frame &frame, Value &result) {
+  if (type == nullptr)
+    return false;
+  Primitive primitive = arena_.toPrimitive(type);
+  if (primitive != Primitive::Invalid)
+    return convertValue(ConstantValue::ofInteger(0), primitive,
+                        result.scalar, ignored_);
+  if (type->getType() == Types::Array) {
+    auto array = static_cast<ArrayType *>(type.get());
+    int64_t length = array->length;
+    if (length < 0) {
+      Value size;
+      if (!evaluate(array->expression, frame, size))
+        return false;
+      length = size.scalar.integer;
+    }
+    if (length < 0 || (size_t)length > budget_ - steps_)
+      return false;
+    steps_ += length;
+    result.items.resize(length);
+    for (Value &item : result.items) {
+      if (!initial(array->arrayType, frame, item))
+        return false;
+    }
+    return true;
+  }
+  if (type->getType() == Types::Record) {
+    auto record = static_cast<RecordType *>(type.get());
+    result.items.resize(record->layout.size());
+    // fields start with their folded default when they have one
+    for (const FieldLayout &field : record->layout) {
+      Value &item = result.items[field.ordinal];
+      CNode *value = record->fields[field.ordinal]->default_value_;
+      if (value != nullptr && value->constant) {
+        if (!convertValue(value->value, arena_.toPrimitive(field.type),
+                          item.scalar, ignored_))
+          return false;
+      } else if (value != nullptr || !initial(field.type, frame, item)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,71 @@
+#ifndef CC_PROJECT_CONSTANTEVALUATOR_HPP
+#define CC_PROJECT_CONSTANTEVALUATOR_HPP
+
+#include "semantic_analyzer/symbol_table/SymbolNode.hpp"
+#include "semantic_analyzer/type_table/TypeArena.hpp"
+#include <functional>
+#include <sstream>
+#include <vector>
+
+// Interpreter over checked routine bodies used at compile time.
+// It runs calls of pure routines with constant arguments under a budget of
+// evaluation steps. Anything it cannot finish (runtime error, budget or
+// call depth exceeded, access to a global) makes the call fail, and the
+// caller keeps it for runtime.
+class ConstantEvaluator {
+public:
+  using Lookup = std::function<const FunctionNode *(const std::string &)>;
+
+  ConstantEvaluator(const TypeArena &arena, Lookup lookup,
+                    size_t budget = 1000000);
+  ~ConstantEvaluator() = default;
+
+  bool call(const FunctionNode &function,
+            const std::vector<ConstantValue> &arguments,
+            ConstantValue &result);
+
+  size_t steps() const;
+
+private:
+  // scalar, or the items of an array or the fields of a record in layout
+  // order; assignment copies the whole value
+  struct Value {
+    ConstantValue scalar;
+    std::vector<Value> items;
+  };
+  enum class Flow { Next, Return, Fail };
+  struct Frame {
+    std::vector<Value> slots;
+    Value result;
+  };
+
+  bool invoke(const FunctionNode &function, std::vector<Value> arguments,
+              Value &result);
+  Flow block(CNode *body, Frame &frame);
+  Flow statement(CNode *node, Frame &frame);
+  Flow declaration(CNode *node, Frame &frame);
+  Flow loop(CNode *node, Frame &frame);
+  bool evaluate(CNode *node, Frame &frame, Value &result);
+  bool condition(CNode *node, Frame &frame, bool &result);
+  Value *locate(CNode *node, Frame &frame);
+  // node within the value of its base
+  Value *select(CNode *node, Value *base, Frame &frame);
+  // a chain of selectors such as b[i].c within the value of a record
+  Value *member(CNode *node, Value *record,
+                const std::shared_ptr<TypeNode> &type, Frame &frame);
+  bool store(const std::shared_ptr<TypeNode> &type, Value value,
+             Value &target);
+  bool initial(const std::shared_ptr<TypeNode> &type, Frame &frame,
+               Value &result);
+  bool step();
+
+  const TypeArena &arena_;
+  Lookup lookup_;
+  size_t budget_;
+  size_t steps_ = 0;
+  int depth_ = 0;
+  // diagnostics of failed evaluations are not shown
+  std::ostringstream ignored_;
+};
+
+#endif // CC_PROJECT_CONSTANTEVALUATOR_HPP
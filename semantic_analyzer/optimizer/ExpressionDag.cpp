@@ -0,0 +1,171 @@
+#include "ExpressionDag.hpp"
+#include <functional>
+
+namespace {
+
+size_t combine(size_t seed, size_t value) {
+  return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+size_t hashValue(const ConstantValue &value) {
+  switch (value.kind) {
+  case ConstantValue::Integer:
+    return std::hash<int64_t>()(value.integer);
+  case ConstantValue::Real:
+    return std::hash<double>()(value.real);
+  case ConstantValue::Boolean:
+    return value.boolean;
+  default:
+    return 0;
+  }
+}
+
+// variable whose value is changed by assigning to target
+std::pair<int, int> baseVariable(const CNode *target) {
+  while (target->name != "modifiable_primary")
+    target = target->children[0];
+  return {target->depth, target->slot};
+}
+
+} // namespace
+
+bool ExpressionDag::Key::operator==(const Key &other) const {
+  const CNode *a = node, *b = other.node;
+  return a->name == b->name && a->type == b->type &&
+         a->depth == b->depth && a->slot == b->slot &&
+         a->proven == b->proven && a->constant == b->constant &&
+         a->value.same(b->value) && a->children == b->children;
+}
+
+size_t ExpressionDag::KeyHash::operator()(const Key &key) const {
+  const CNode *node = key.node;
+  size_t seed = std::hash<std::string>()(node->name);
+  seed = combine(seed, std::hash<const void *>()(node->type.get()));
+  seed = combine(seed, (size_t)node->depth * 31 + node->slot);
+  seed = combine(seed, hashValue(node->value));
+  for (const CNode *child : node->children)
+    seed = combine(seed, std::hash<const void *>()(child));
+  return seed;
+}
+
+void ExpressionDag::run(CNode *body) {
+  clear();
+  block(body);
+  clear();
+}
+
+size_t ExpressionDag::merged() const { return merged_; }
+
+void ExpressionDag::block(CNode *body) {
+  if (body == nullptr)
+    return;
+  for (CNode *child : body->children) {
+    if (child->name == "statement")
+      statement(child->children[0]);
+    else if (child->name == "simple_declaration")
+      declaration(child->children[0]);
+  }
+}
+
+void ExpressionDag::declaration(CNode *node) {
+  if (node->name == "variable_declaration_auto") {
+    intern(node->children[1]);
+  } else if (node->name == "variable_declaration") {
+    intern(node->children[2]);
+  } else {
+    return;
+  }
+  kill({node->children[0]->depth, node->children[0]->slot});
+}
+
+void ExpressionDag::statement(CNode *node) {
+  if (node->name == "return") {
+    if (node->children[0] != nullptr)
+      intern(node->children[0]->children[0]);
+  } else if (node->name == "assignment") {
+    intern(node->children[1]);
+    kill(baseVariable(node->children[0]));
+  } else if (node->name == "routine_call") {
+    if (node->children[1] != nullptr) {
+      for (CNode *&argument : node->children[1]->children)
+        intern(argument);
+    }
+    // the callee may write any global
+    clear();
+  } else if (node->name == "while_loop") {
+    // the condition is evaluated again after every iteration
+    clear();
+    intern(node->children[0]);
+    clear();
+    block(node->children[1]);
+    clear();
+  } else if (node->name == "for_loop") {
+    CNode *range = node->children[1];
+    intern(range->children[0]);
+    intern(range->children[1]);
+    clear();
+    block(node->children[2]);
+    clear();
+  } else if (node->name == "if_statement") {
+    intern(node->children[0]);
+    clear();
+    block(node->children[1]);
+    clear();
+    if (node->children[2] != nullptr)
+      block(node->children[2]->children[0]);
+    clear();
+  }
+}
+
+void ExpressionDag::intern(CNode *&node) {
+  if (node == nullptr)
+    return;
+  std::vector<Variable> reads;
+  node = intern(node, reads);
+}
+
+// children first, so equal subtrees have pointer-equal children and the
+// key only looks one level deep
+CNode *ExpressionDag::intern(CNode *node, std::vector<Variable> &reads) {
+  if (node->name == "routine_call") {
+    // calls are never shared, and the callee may write any global
+    if (node->children[1] != nullptr) {
+      for (CNode *&argument : node->children[1]->children)
+        argument = intern(argument, reads);
+    }
+    clear();
+    return node;
+  }
+  std::vector<Variable> own;
+  for (CNode *&child : node->children) {
+    if (child != nullptr)
+      child = intern(child, own);
+  }
+  if (node->name == "modifiable_primary" && node->slot != -1)
+    own.emplace_back(node->depth, node->slot);
+  reads.insert(reads.end(), own.begin(), own.end());
+
+  auto found = table_.find(Key{node});
+  if (found != table_.end()) {
+    if (found->second.node == node)
+      return node;
+    // the children are shared with the kept node
+    delete node;
+    merged_++;
+    return found->second.node;
+  }
+  table_.emplace(Key{node}, Entry{node, std::move(own)});
+  return node;
+}
+
+void ExpressionDag::kill(Variable variable) {
+  for (auto entry = table_.begin(); entry != table_.end();) {
+    auto &reads = entry->second.reads;
+    bool read = false;
+    for (const Variable &other : reads)
+      read = read || other == variable;
+    entry = read ? table_.erase(entry) : std::next(entry);
+  }
+}
+
+void ExpressionDag::clear() { table_.clear(); }
@@ -0,0 +1,54 @@
+#ifndef CC_PROJECT_EXPRESSIONDAG_HPP
+#define CC_PROJECT_EXPRESSIONDAG_HPP
+
+#include "common/Node.hpp"
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Hash-consing of checked routine bodies.
+// Within a basic block every expression node is looked up by its name,
+// type, value, variable and (already shared) children; structurally equal
+// subexpressions are replaced by the first one, so the body becomes a DAG
+// and each computation appears once per block.
+// A write to a variable drops the entries reading it, a routine call or a
+// branch drops all of them. Passes that rewrite nodes in place must run
+// before this one.
+class ExpressionDag {
+public:
+  ExpressionDag() = default;
+  ~ExpressionDag() = default;
+
+  void run(CNode *body);
+
+  // nodes replaced by an equal node seen earlier
+  size_t merged() const;
+
+private:
+  using Variable = std::pair<int, int>;
+
+  struct Key {
+    const CNode *node;
+    bool operator==(const Key &other) const;
+  };
+  struct KeyHash {
+    size_t operator()(const Key &key) const;
+  };
+  struct Entry {
+    CNode *node;
+    std::vector<Variable> reads;
+  };
+
+  void block(CNode *body);
+  void statement(CNode *node);
+  void declaration(CNode *node);
+  CNode *intern(CNode *node, std::vector<Variable> &reads);
+  void intern(CNode *&node);
+  void kill(Variable variable);
+  void clear();
+
+  std::unordered_map<Key, Entry, KeyHash> table_;
+  size_t merged_ = 0;
+};
+
+#endif // CC_PROJECT_EXPRESSIONDAG_HPP
@@ -0,0 +1,384 @@
+#include "Simplifier.hpp"
+#include "semantic_analyzer/type_table/ConstantFolding.hpp"
+#include <cmath>
+#include <sstream>
+
+namespace {
+
+bool isBinary(const CNode *node) {
+  return node->children.size() == 3 &&
+         (node->name == "expression" || node->name == "relation" ||
+          node->name == "simple" || node->name == "factor");
+}
+
+bool isUnary(const CNode *node) {
+  return node->children.size() == 2 &&
+         (node->name == "unary_factor" || node->name == "not_factor");
+}
+
+bool isExpression(const CNode *node) {
+  return isBinary(node) || isUnary(node) || node->constant ||
+         node->name == "routine_call" ||
+         node->name.compare(0, 18, "modifiable_primary") == 0;
+}
+
+bool isVariable(const CNode *node) {
+  return node->name == "modifiable_primary" && node->slot != -1;
+}
+
+bool sameType(const CNode *a, const CNode *b) {
+  return a->type != nullptr && b->type != nullptr &&
+         a->type->id == b->type->id;
+}
+
+bool sameTree(const CNode *a, const CNode *b) {
+  if (a == nullptr || b == nullptr)
+    return a == b;
+  if (a->name != b->name || a->constant != b->constant ||
+      !a->value.same(b->value) || a->depth != b->depth ||
+      a->slot != b->slot || a->children.size() != b->children.size())
+    return false;
+  for (size_t i = 0; i < a->children.size(); i++) {
+    if (!sameTree(a->children[i], b->children[i]))
+      return false;
+  }
+  return true;
+}
+
+// evaluating node may stop the program (a division by zero, an index out
+// of bounds) or change it (a call)
+bool canFail(const CNode *node) {
+  if (node->name == "routine_call")
+    return true;
+  if (node->name == "modifiable_primary_array" &&
+      (node->proven & CNode::InBounds) == 0)
+    return true;
+  if (isBinary(node)) {
+    const std::string &op = node->children[1]->name;
+    const CNode *divisor = node->children[2];
+    if ((op == "/" || op == "%") &&
+        !(divisor->constant && divisor->value.asReal() != 0))
+      return true;
+  }
+  for (const CNode *child : node->children) {
+    if (child != nullptr && canFail(child))
+      return true;
+  }
+  return false;
+}
+
+CNode *clone(const CNode *node) {
+  CNode *copy = new CNode(*node);
+  for (CNode *&child : copy->children) {
+    if (child != nullptr)
+      child = clone(child);
+  }
+  return copy;
+}
+
+void destroy(CNode *node) {
+  if (node == nullptr)
+    return;
+  for (CNode *child : node->children)
+    destroy(child);
+  delete node;
+}
+
+// cut child out of node, so destroying node keeps it
+CNode *detach(CNode *node, CNode *child) {
+  for (CNode *&slot : node->children) {
+    if (slot == child)
+      slot = nullptr;
+  }
+  return child;
+}
+
+void setValue(CNode *literal, const ConstantValue &value) {
+  literal->value = value;
+  literal->children[0]->name = value.toString();
+}
+
+CNode *negation(CNode *operand) {
+  CNode *result = new CNode("unary_factor");
+  result->children = {new CNode("-"), operand};
+  result->type = operand->type;
+  return result;
+}
+
+} // namespace
+
+Simplifier::Simplifier(const TypeArena &arena)
+    : arena_(arena), hits_(RuleCount, 0) {}
+
+const std::vector<size_t> &Simplifier::hits() const { return hits_; }
+
+const char *Simplifier::ruleName(int rule) {
+  static const char *names[RuleCount] = {
+      "fold",           "add zero",
+      "multiply by one", "multiply by zero",
+      "modulo one",      "x - x",
+      "negate",          "unary plus",
+      "double negation", "double not",
+      "boolean identity", "boolean absorption",
+      "xor true",        "reassociate",
+      "x * 2 to x + x",  "division to multiplication"};
+  return names[rule];
+}
+
+void Simplifier::run(CNode *body) {
+  if (body != nullptr)
+    visit(body);
+}
+
+// array types keep pointers to their size expressions, so types are left
+// as they were checked
+void Simplifier::visit(CNode *node) {
+  for (CNode *&child : node->children) {
+    if (child == nullptr || child->name == "type" ||
+        child->name == "array_type")
+      continue;
+    if (isExpression(child))
+      child = simplify(child);
+    else
+      visit(child);
+  }
+}
+
+// operands are simplified before the node itself
+CNode *Simplifier::simplify(CNode *node) {
+  for (CNode *&child : node->children) {
+    if (child == nullptr)
+      continue;
+    if (isExpression(child))
+      child = simplify(child);
+    else
+      visit(child);
+  }
+  return rewrite(node);
+}
+
+CNode *Simplifier::rewrite(CNode *node) {
+  if (isBinary(node))
+    return binary(node);
+  if (isUnary(node))
+    return unary(node);
+  return node;
+}
+
+Primitive Simplifier::primitive(const CNode *node) const {
+  return arena_.toPrimitive(node->type);
+}
+
+// a real zero must be +0.0: x + 0.0 is not x when x is -0.0
+bool Simplifier::isValue(const CNode *node, double value) const {
+  if (!node->constant)
+    return false;
+  switch (node->value.kind) {
+  case ConstantValue::Integer:
+    return node->value.integer == (int64_t)value;
+  case ConstantValue::Real:
+    return node->value.real == value &&
+           std::signbit(node->value.real) == std::signbit(value);
+  case ConstantValue::Boolean:
+    return node->value.boolean == (value != 0);
+  default:
+    return false;
+  }
+}
+
+CNode *Simplifier::literal(const ConstantValue &value,
+                           const CNode *like) const {
+  const char *name = value.kind == ConstantValue::Integer ? "integer"
+                     : value.kind == ConstantValue::Real  ? "real"
+                                                          : "boolean";
+  CNode *result = new CNode(name);
+  result->children.push_back(new CNode(value.toString()));
+  result->value = value;
+  result->constant = true;
+  result->type = like->type;
+  return result;
+}
+
+CNode *Simplifier::keep(CNode *node, CNode *kept, Rule rule) {
+  return replace(node, detach(node, kept), rule);
+}
+
+CNode *Simplifier::replace(CNode *node, CNode *result, Rule rule) {
+  hits_[rule]++;
+  destroy(node);
+  return rewrite(result);
+}
+
+CNode *Simplifier::binary(CNode *node) {
+  CNode *left = node->children[0];
+  CNode *right = node->children[2];
+  Operator op = toOperator(node->children[1]->name);
+  Primitive type = primitive(node);
+  if (left->constant && right->constant) {
+    // operands made constant by earlier rewrites; failures are left for
+    // runtime
+    ConstantValue value;
+    std::ostringstream ignored;
+    if (!foldBinary(op, left->value, right->value, type, value, ignored))
+      return node;
+    return replace(node, literal(value, node), Fold);
+  }
+  bool keepsLeft = sameType(node, left);
+  bool keepsRight = sameType(node, right);
+  bool integer = type == Primitive::Integer;
+
+  switch (op) {
+  case Operator::Add:
+    if (integer && isValue(right, 0) && keepsLeft)
+      return keep(node, left, AddZero);
+    if (integer && isValue(left, 0) && keepsRight)
+      return keep(node, right, AddZero);
+    // only -0.0 is neutral for real addition
+    if (type == Primitive::Real && isValue(right, -0.0) && keepsLeft)
+      return keep(node, left, AddZero);
+    if (type == Primitive::Real && isValue(left, -0.0) && keepsRight)
+      return keep(node, right, AddZero);
+    return reassociate(node, op);
+  case Operator::Sub:
+    if (isValue(right, 0) && keepsLeft)
+      return keep(node, left, AddZero);
+    if (integer && isValue(left, 0) && keepsRight)
+      return replace(node, negation(detach(node, right)), Negate);
+    if (integer && sameTree(left, right) && !canFail(left))
+      return replace(node, literal(ConstantValue::ofInteger(0), node),
+                     SubSelf);
+    return reassociate(node, op);
+  case Operator::Mul:
+    if (isValue(right, 1) && keepsLeft)
+      return keep(node, left, MulOne);
+    if (isValue(left, 1) && keepsRight)
+      return keep(node, right, MulOne);
+    if (integer && ((isValue(right, 0) && !canFail(left)) ||
+                    (isValue(left, 0) && !canFail(right))))
+      return replace(node, literal(ConstantValue::ofInteger(0), node),
+                     MulZero);
+    if (isValue(right, -1) && keepsLeft)
+      return replace(node, negation(detach(node, left)), Negate);
+    if (isValue(left, -1) && keepsRight)
+      return replace(node, negation(detach(node, right)), Negate);
+    // an addition is cheaper than a multiplication, also for reals where
+    // x + x equals x * 2 exactly
+    if (isValue(right, 2) && keepsLeft && isVariable(left)) {
+      CNode *sum = new CNode("factor");
+      sum->children = {detach(node, left), new CNode("+"), clone(left)};
+      sum->type = node->type;
+      return replace(node, sum, MulTwoToAdd);
+    }
+    if (isValue(left, 2) && keepsRight && isVariable(right)) {
+      CNode *sum = new CNode("factor");
+      sum->children = {detach(node, right), new CNode("+"), clone(right)};
+      sum->type = node->type;
+      return replace(node, sum, MulTwoToAdd);
+    }
+    return reassociate(node, op);
+  case Operator::Div:
+    if (isValue(right, 1) && keepsLeft)
+      return keep(node, left, MulOne);
+    if (isValue(right, -1) && keepsLeft)
+      return replace(node, negation(detach(node, left)), Negate);
+    // dividing by a power of two is multiplying by its exact reciprocal
+    if (type == Primitive::Real && right->constant &&
+        right->value.kind == ConstantValue::Real) {
+      int exponent;
+      double divisor = right->value.real;
+      double reciprocal = 1 / divisor;
+      if (std::isfinite(divisor) && divisor != 0 &&
+          std::frexp(divisor, &exponent) == (divisor < 0 ? -0.5 : 0.5) &&
+          std::isnormal(reciprocal)) {
+        node->children[1]->name = "*";
+        setValue(right, ConstantValue::ofReal(reciprocal));
+        hits_[DivToMul]++;
+        return rewrite(node);
+      }
+    }
+    return node;
+  case Operator::Mod:
+    if ((isValue(right, 1) || isValue(right, -1)) && !canFail(left))
+      return replace(node, literal(ConstantValue::ofInteger(0), node),
+                     ModOne);
+    return node;
+  case Operator::And:
+  case Operator::Or:
+  case Operator::Xor: {
+    if (primitive(left) != Primitive::Boolean ||
+        primitive(right) != Primitive::Boolean)
+      return node;
+    // identity element of the operator and the value absorbing the other
+    bool identity = op == Operator::And;
+    CNode *constant = left->constant ? left : right;
+    CNode *other = left->constant ? right : left;
+    if (!constant->constant)
+      return node;
+    if (isValue(constant, identity))
+      return keep(node, other, BoolIdentity);
+    if (op == Operator::Xor) {
+      CNode *inverse = new CNode("not_factor");
+      inverse->children = {new CNode("not"), detach(node, other)};
+      inverse->type = node->type;
+      return replace(node, inverse, XorTrue);
+    }
+    if (!canFail(other))
+      return replace(node, literal(constant->value, node), BoolAnnihilate);
+    return node;
+  }
+  default:
+    return node;
+  }
+}
+
+// (x + c1) + c2 becomes x + (c1 + c2) and (x * c1) * c2 becomes
+// x * (c1 * c2); wrapping integer arithmetic keeps both associative
+CNode *Simplifier::reassociate(CNode *node, Operator op) {
+  CNode *inner = node->children[0];
+  CNode *outer = node->children[2];
+  if (primitive(node) != Primitive::Integer || !outer->constant ||
+      outer->value.kind != ConstantValue::Integer || !isBinary(inner) ||
+      primitive(inner) != Primitive::Integer)
+    return node;
+  CNode *constant = inner->children[2];
+  if (!constant->constant || constant->value.kind != ConstantValue::Integer)
+    return node;
+  Operator innerOp = toOperator(inner->children[1]->name);
+  uint64_t c1 = constant->value.integer, c2 = outer->value.integer;
+  if (op == Operator::Mul && innerOp == Operator::Mul) {
+    setValue(constant, ConstantValue::ofInteger((int64_t)(c1 * c2)));
+  } else if ((op == Operator::Add || op == Operator::Sub) &&
+             (innerOp == Operator::Add || innerOp == Operator::Sub)) {
+    int64_t sum = (int64_t)((innerOp == Operator::Add ? c1 : 0 - c1) +
+                            (op == Operator::Add ? c2 : 0 - c2));
+    bool subtract = sum < 0 && sum != INT64_MIN;
+    inner->children[1]->name = subtract ? "-" : "+";
+    setValue(constant, ConstantValue::ofInteger(subtract ? -sum : sum));
+  } else {
+    return node;
+  }
+  return replace(node, detach(node, inner), Reassociate);
+}
+
+CNode *Simplifier::unary(CNode *node) {
+  CNode *operand = node->children[1];
+  bool negates = node->name == "not_factor";
+  Operator op = negates ? Operator::Not : toOperator(node->children[0]->name);
+  if (operand->constant) {
+    ConstantValue value;
+    std::ostringstream ignored;
+    if (!foldUnary(op, operand->value, value, ignored))
+      return node;
+    return replace(node, literal(value, node), Fold);
+  }
+  if (op == Operator::Add && sameType(node, operand))
+    return keep(node, operand, UnaryPlus);
+  if (op == Operator::Sub && operand->name == "unary_factor" &&
+      operand->children[0]->name == "-")
+    return replace(node, detach(operand, operand->children[1]),
+                   DoubleNegation);
+  if (negates && operand->name == "not_factor" &&
+      primitive(operand->children[1]) == Primitive::Boolean)
+    return replace(node, detach(operand, operand->children[1]), DoubleNot);
+  return node;
+}
@@ -0,0 +1,64 @@
+#ifndef CC_PROJECT_SIMPLIFIER_HPP
+#define CC_PROJECT_SIMPLIFIER_HPP
+
+#include "common/Node.hpp"
+#include "semantic_analyzer/type_table/TypeArena.hpp"
+#include <vector>
+
+// Rule based rewriting of folded expressions with some non constant
+// operands: identities, constant reassociation and strength reduction.
+// Every rule keeps the value and the type of the rewritten node, with
+// integers wrapping around. Operands are only dropped when evaluating them
+// cannot fail (division, unchecked array access).
+class Simplifier {
+public:
+  enum Rule {
+    Fold,
+    AddZero,
+    MulOne,
+    MulZero,
+    ModOne,
+    SubSelf,
+    Negate,
+    UnaryPlus,
+    DoubleNegation,
+    DoubleNot,
+    BoolIdentity,
+    BoolAnnihilate,
+    XorTrue,
+    Reassociate,
+    MulTwoToAdd,
+    DivToMul,
+    RuleCount
+  };
+
+  explicit Simplifier(const TypeArena &arena);
+  ~Simplifier() = default;
+
+  // rewrite every expression of a checked body
+  void run(CNode *body);
+
+  // times each rule was applied
+  const std::vector<size_t> &hits() const;
+
+  static const char *ruleName(int rule);
+
+private:
+  void visit(CNode *node);
+  CNode *simplify(CNode *node);
+  CNode *rewrite(CNode *node);
+  CNode *binary(CNode *node);
+  CNode *unary(CNode *node);
+
+  CNode *reassociate(CNode *node, Operator op);
+  Primitive primitive(const CNode *node) const;
+  bool isValue(const CNode *node, double value) const;
+  CNode *literal(const ConstantValue &value, const CNode *like) const;
+  CNode *keep(CNode *node, CNode *kept, Rule rule);
+  CNode *replace(CNode *node, CNode *result, Rule rule);
+
+  const TypeArena &arena_;
+  std::vector<size_t> hits_;
+};
+
+#endif // CC_PROJECT_SIMPLIFIER_HPP
@@ -0,0 +1,81 @@
+#ifndef CC_PROJECT_SCOPEDMAP_HPP
+#define CC_PROJECT_SCOPEDMAP_HPP
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Flat scoped name table.
+// Every name has a single hash slot holding the index of its innermost
+// binding; bindings of outer scopes are reachable through `shadowed`.
+// `bindings_` doubles as the undo log: popping a scope unwinds the bindings
+// made since the matching push and restores the shadowed heads.
+template <typename T> class ScopedMap {
+public:
+  ScopedMap() = default;
+  ~ScopedMap() = default;
+
+  // fails if name is already bound in the current scope
+  bool insert(const std::string &name, std::shared_ptr<T> value) {
+    auto head = heads_.try_emplace(name, -1).first;
+    int shadowed = head->second;
+    if (shadowed != -1 && bindings_[shadowed].depth == depth())
+      return false;
+    bindings_.push_back({&*head, std::move(value), depth(), shadowed});
+    head->second = (int)bindings_.size() - 1;
+    return true;
+  }
+
+  std::shared_ptr<T> find(const std::string &name) const {
+    auto head = heads_.find(name);
+    if (head == heads_.end() || head->second == -1)
+      return nullptr;
+    return bindings_[head->second].value;
+  }
+
+  bool contains(const std::string &name) const {
+    auto head = heads_.find(name);
+    return head != heads_.end() && head->second != -1;
+  }
+
+  // depth of the scope holding the visible binding of name, -1 if unbound
+  int depthOf(const std::string &name) const {
+    auto head = heads_.find(name);
+    if (head == heads_.end() || head->second == -1)
+      return -1;
+    return bindings_[head->second].depth;
+  }
+
+  void pushScope() { marks_.push_back(bindings_.size()); }
+
+  void popScope() {
+    if (marks_.empty())
+      return;
+    size_t mark = marks_.back();
+    marks_.pop_back();
+    while (bindings_.size() > mark) {
+      Binding &binding = bindings_.back();
+      // names stay in heads_ so re-entering a scope does not rehash them
+      binding.head->second = binding.shadowed;
+      bindings_.pop_back();
+    }
+  }
+
+  int depth() const { return (int)marks_.size(); }
+
+private:
+  // element pointers of unordered_map survive rehashing
+  struct Binding {
+    std::pair<const std::string, int> *head;
+    std::shared_ptr<T> value;
+    int depth;
+    int shadowed;
+  };
+
+  std::unordered_map<std::string, int> heads_;
+  std::vector<Binding> bindings_;
+  std::vector<size_t> marks_;
+};
+
+#endif // CC_PROJECT_SCOPEDMAP_HPP
@@ -17,6 +17,9 @@ public:
   std::shared_ptr<TypeNode> variable_type_;
   std::string variable_name_;
   CNode *default_value_;
+  // frame (0 globals, 1 routine) and slot assigned by ControlTable
+  int depth_ = -1;
+  int slot_ = -1;
 };
 
 class FunctionNode{
@@ -31,6 +34,12 @@ public:
   std::shared_ptr<TypeNode> return_type_;
   std::string function_name_;
   std::vector<std::shared_ptr<VariableNode>> parameters_;
+  // slots of the routine frame; parameters take the first ones
+  int frame_size_ = 0;
+  CNode *body_ = nullptr;
+  // the checked body touches no global, directly or through its calls, so
+  // calls with constant arguments can be evaluated at compile time
+  bool pure_ = false;
 };
 
 #endif // CC_PROJECT_SYMBOLNODE_HPP
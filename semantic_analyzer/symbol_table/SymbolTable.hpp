@@ -1,8 +1,8 @@
 #ifndef CC_PROJECT_SYMBOLTABLE_HPP
 #define CC_PROJECT_SYMBOLTABLE_HPP
 
+#include "semantic_analyzer/symbol_table/ScopedMap.hpp"
 #include "semantic_analyzer/symbol_table/SymbolNode.hpp"
-#include <unordered_map>
 
 class SymbolTable {
 public:
@@ -17,22 +17,22 @@ public:
   addFunction(const std::string &name, std::shared_ptr<TypeNode> return_type,
               const std::vector<std::shared_ptr<VariableNode>> &parameters);
 
-  std::shared_ptr<VariableNode> getVariable(const std::string &name);
+  std::shared_ptr<VariableNode> getVariable(const std::string &name) const;
 
-  std::shared_ptr<FunctionNode> getFunction(const std::string &name);
+  std::shared_ptr<FunctionNode> getFunction(const std::string &name) const;
 
-  bool isVariable(const std::string &name);
+  bool isVariable(const std::string &name) const;
 
-  bool isFunction(const std::string &name);
+  bool isFunction(const std::string &name) const;
 
-  bool removeFunction(const std::string &name);
+  void pushScope();
 
-  bool removeVariable(const std::string &name);
+  void popScope();
 
 private:
-  std::unordered_map<std::string, std::shared_ptr<VariableNode>> variables_;
+  ScopedMap<VariableNode> variables_;
 
-  std::unordered_map<std::string, std::shared_ptr<FunctionNode>> functions_;
+  ScopedMap<FunctionNode> functions_;
 };
 
 #endif // CC_PROJECT_SYMBOLTABLE_HPP
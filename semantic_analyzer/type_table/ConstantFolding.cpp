@@ -0,0 +1,186 @@
+#include "semantic_analyzer/type_table/ConstantFolding.hpp"
+#include <cmath>
+
+bool toBoolean(const ConstantValue &value, bool &result, std::ostream &err) {
+  if (value.kind == ConstantValue::Boolean) {
+    result = value.boolean;
+    return true;
+  }
+  if (value.kind == ConstantValue::Integer &&
+      (value.integer == 0 || value.integer == 1)) {
+    result = value.integer == 1;
+    return true;
+  }
+  err << "Cannot convert " << value.toString() << " to boolean" << std::endl;
+  return false;
+}
+
+// integer arithmetic wraps around instead of overflowing
+static bool foldInteger(Operator op, int64_t l, int64_t r, int64_t &result,
+                        std::ostream &err) {
+  uint64_t ul = (uint64_t)l, ur = (uint64_t)r;
+  switch (op) {
+  case Operator::Add:
+    result = (int64_t)(ul + ur);
+    return true;
+  case Operator::Sub:
+    result = (int64_t)(ul - ur);
+    return true;
+  case Operator::Mul:
+    result = (int64_t)(ul * ur);
+    return true;
+  case Operator::Div:
+  case Operator::Mod:
+    if (r == 0) {
+      err << "Сannot be divided by zero" << std::endl;
+      return false;
+    }
+    if (r == -1) {
+      result = op == Operator::Div ? (int64_t)(0 - ul) : 0;
+      return true;
+    }
+    result = op == Operator::Div ? l / r : l % r;
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool foldReal(Operator op, double l, double r, double &result,
+                     std::ostream &err) {
+  switch (op) {
+  case Operator::Add:
+    result = l + r;
+    return true;
+  case Operator::Sub:
+    result = l - r;
+    return true;
+  case Operator::Mul:
+    result = l * r;
+    return true;
+  case Operator::Div:
+    if (r == 0) {
+      err << "Сannot be divided by zero" << std::endl;
+      return false;
+    }
+    result = l / r;
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool compareValues(Operator op, const ConstantValue &left,
+                          const ConstantValue &right) {
+  int order;
+  if (left.kind == ConstantValue::Integer &&
+      right.kind == ConstantValue::Integer) {
+    order = (left.integer > right.integer) - (left.integer < right.integer);
+  } else {
+    double l = left.asReal(), r = right.asReal();
+    if (l != l || r != r)
+      return op == Operator::NotEqual;
+    order = (l > r) - (l < r);
+  }
+  switch (op) {
+  case Operator::Less:
+    return order < 0;
+  case Operator::LessEq:
+    return order <= 0;
+  case Operator::Greater:
+    return order > 0;
+  case Operator::GreaterEq:
+    return order >= 0;
+  case Operator::Equal:
+    return order == 0;
+  default:
+    return order != 0;
+  }
+}
+
+bool foldBinary(Operator op, const ConstantValue &left,
+                const ConstantValue &right, Primitive type,
+                ConstantValue &result, std::ostream &err) {
+  if (op >= Operator::Less && op <= Operator::NotEqual) {
+    result = ConstantValue::ofBoolean(compareValues(op, left, right));
+    return true;
+  }
+  if (type == Primitive::Boolean) {
+    bool l, r;
+    if (!toBoolean(left, l, err) || !toBoolean(right, r, err))
+      return false;
+    if (op == Operator::And)
+      result = ConstantValue::ofBoolean(l && r);
+    else if (op == Operator::Or)
+      result = ConstantValue::ofBoolean(l || r);
+    else if (op == Operator::Xor)
+      result = ConstantValue::ofBoolean(l != r);
+    else
+      return false;
+    return true;
+  }
+  if (type == Primitive::Integer) {
+    int64_t res;
+    if (!foldInteger(op, left.integer, right.integer, res, err))
+      return false;
+    result = ConstantValue::ofInteger(res);
+    return true;
+  }
+  double res;
+  if (!foldReal(op, left.asReal(), right.asReal(), res, err))
+    return false;
+  result = ConstantValue::ofReal(res);
+  return true;
+}
+
+bool foldUnary(Operator op, const ConstantValue &operand,
+               ConstantValue &result, std::ostream &err) {
+  if (op == Operator::Not) {
+    bool value;
+    if (!toBoolean(operand, value, err))
+      return false;
+    result = ConstantValue::ofBoolean(!value);
+    return true;
+  }
+  result = operand;
+  if (op == Operator::Sub) {
+    if (operand.kind == ConstantValue::Integer)
+      result.integer = (int64_t)(0 - (uint64_t)operand.integer);
+    else
+      result.real = -operand.real;
+  }
+  return true;
+}
+
+
+bool convertValue(const ConstantValue &value, Primitive target,
+                  ConstantValue &result, std::ostream &err) {
+  switch (target) {
+  case Primitive::Integer:
+    if (value.kind == ConstantValue::Real) {
+      if (!(std::fabs(value.real) < 9.2e18)) {
+        err << "Real " << value.toString() << " does not fit integer"
+            << std::endl;
+        return false;
+      }
+      result = ConstantValue::ofInteger(std::llround(value.real));
+    } else if (value.kind == ConstantValue::Boolean) {
+      result = ConstantValue::ofInteger(value.boolean);
+    } else {
+      result = value;
+    }
+    return true;
+  case Primitive::Real:
+    result = ConstantValue::ofReal(value.asReal());
+    return true;
+  case Primitive::Boolean: {
+    bool flag;
+    if (value.kind == ConstantValue::Real || !toBoolean(value, flag, err))
+      return false;
+    result = ConstantValue::ofBoolean(flag);
+    return true;
+  }
+  default:
+    return false;
+  }
+}
@@ -0,0 +1,29 @@
+#ifndef CC_PROJECT_CONSTANTFOLDING_HPP
+#define CC_PROJECT_CONSTANTFOLDING_HPP
+
+#include "common/ConstantValue.hpp"
+#include "semantic_analyzer/type_table/OperatorRules.hpp"
+#include <ostream>
+
+// Arithmetic of the language on constant values, shared by every stage
+// that computes values at compile time. Errors such as division by zero
+// are reported to err and make the functions return false.
+
+// integer 0 and 1 convert to boolean
+bool toBoolean(const ConstantValue &value, bool &result, std::ostream &err);
+
+// value of `left op right` where both operands passed type checking
+// and the result type is already known
+bool foldBinary(Operator op, const ConstantValue &left,
+                const ConstantValue &right, Primitive type,
+                ConstantValue &result, std::ostream &err);
+
+bool foldUnary(Operator op, const ConstantValue &operand,
+               ConstantValue &result, std::ostream &err);
+
+// value stored into a variable of type target; reals are rounded to the
+// nearest integer, halves away from zero
+bool convertValue(const ConstantValue &value, Primitive target,
+                  ConstantValue &result, std::ostream &err);
+
+#endif // CC_PROJECT_CONSTANTFOLDING_HPP
@@ -0,0 +1,56 @@
+#include "semantic_analyzer/type_table/OperatorRules.hpp"
+
+Operator toOperator(const std::string &operation) {
+  if (operation.empty() || operation.size() > 3)
+    return Operator::Unknown;
+  char second = operation.size() > 1 ? operation[1] : '\0';
+  switch (operation[0]) {
+  case '+':
+    return second == '\0' ? Operator::Add : Operator::Unknown;
+  case '-':
+    return second == '\0' ? Operator::Sub : Operator::Unknown;
+  case '*':
+    return second == '\0' ? Operator::Mul : Operator::Unknown;
+  case '%':
+    return second == '\0' ? Operator::Mod : Operator::Unknown;
+  case '=':
+    return second == '\0' ? Operator::Equal : Operator::Unknown;
+  case '/':
+    if (second == '\0')
+      return Operator::Div;
+    return operation == "/=" ? Operator::NotEqual : Operator::Unknown;
+  case '<':
+    if (second == '\0')
+      return Operator::Less;
+    return operation == "<=" ? Operator::LessEq : Operator::Unknown;
+  case '>':
+    if (second == '\0')
+      return Operator::Greater;
+    return operation == ">=" ? Operator::GreaterEq : Operator::Unknown;
+  case ':':
+    return operation == ":=" ? Operator::Assign : Operator::Unknown;
+  case 'a':
+    return operation == "and" ? Operator::And : Operator::Unknown;
+  case 'o':
+    return operation == "or" ? Operator::Or : Operator::Unknown;
+  case 'x':
+    return operation == "xor" ? Operator::Xor : Operator::Unknown;
+  case 'n':
+    return operation == "not" ? Operator::Not : Operator::Unknown;
+  default:
+    return Operator::Unknown;
+  }
+}
+
+const char *primitiveName(Primitive primitive) {
+  switch (primitive) {
+  case Primitive::Integer:
+    return "integer";
+  case Primitive::Real:
+    return "real";
+  case Primitive::Boolean:
+    return "boolean";
+  default:
+    return "invalid";
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef CC_PROJECT_OPERATORRULES_HPP
+#define CC_PROJECT_OPERATORRULES_HPP
+
+#include <string>
+
+// Primitive types in the order TypeArena interns them
+enum class Primitive : signed char { Invalid = -1, Integer, Real, Boolean };
+
+constexpr int kPrimitiveCount = 3;
+
+enum class Operator : signed char {
+  Unknown = -1,
+  Add,
+  Sub,
+  Mul,
+  Div,
+  Mod,
+  And,
+  Or,
+  Xor,
+  Not,
+  Less,
+  LessEq,
+  Greater,
+  GreaterEq,
+  Equal,
+  NotEqual,
+  Assign
+};
+
+constexpr int kOperatorCount = 16;
+
+namespace operator_rules {
+constexpr Primitive I = Primitive::Integer;
+constexpr Primitive R = Primitive::Real;
+constexpr Primitive B = Primitive::Boolean;
+constexpr Primitive X = Primitive::Invalid;
+
+// result type of `left op right`, indexed [op][left][right]
+// unary `not` is looked up with its operand on both sides
+constexpr Primitive kTable[kOperatorCount][kPrimitiveCount][kPrimitiveCount] =
+    {
+        // +
+        {{I, R, X}, {R, R, X}, {X, X, X}},
+        // -
+        {{I, R, X}, {R, R, X}, {X, X, X}},
+        // *
+        {{I, R, X}, {R, R, X}, {X, X, X}},
+        // /
+        {{I, R, X}, {R, R, X}, {X, X, X}},
+        // %
+        {{I, X, X}, {X, X, X}, {X, X, X}},
+        // and
+        {{B, X, B}, {X, X, X}, {B, X, B}},
+        // or
+        {{B, X, B}, {X, X, X}, {B, X, B}},
+        // xor
+        {{B, X, B}, {X, X, X}, {B, X, B}},
+        // not
+        {{B, X, B}, {X, X, X}, {B, X, B}},
+        // <
+        {{B, B, X}, {B, B, X}, {X, X, X}},
+        // <=
+        {{B, B, X}, {B, B, X}, {X, X, X}},
+        // >
+        {{B, B, X}, {B, B, X}, {X, X, X}},
+        // >=
+        {{B, B, X}, {B, B, X}, {X, X, X}},
+        // =
+        {{B, B, X}, {B, B, X}, {X, X, X}},
+        // /=
+        {{B, B, X}, {B, B, X}, {X, X, X}},
+        // :=
+        {{I, I, I}, {R, R, R}, {B, X, B}},
+};
+} // namespace operator_rules
+
+constexpr Primitive operatorResult(Operator op, Primitive left,
+                                   Primitive right) {
+  if (op == Operator::Unknown || left == Primitive::Invalid ||
+      right == Primitive::Invalid)
+    return Primitive::Invalid;
+  return operator_rules::kTable[(int)op][(int)left][(int)right];
+}
+
+Operator toOperator(const std::string &operation);
+
+const char *primitiveName(Primitive primitive);
+
+#endif // CC_PROJECT_OPERATORRULES_HPP
@@ -0,0 +1,127 @@
+#include "semantic_analyzer/type_table/TypeArena.hpp"
+#include "semantic_analyzer/symbol_table/SymbolNode.hpp"
+#include <cstdint>
+
+namespace {
+// literal text of folded constant, empty if node is not a literal
+std::string literalKey(const CNode *node) {
+  if (node == nullptr || !node->constant)
+    return "";
+  return node->name + ":" + node->value.toString();
+}
+
+// defaults that are not literals make the type unique
+std::string defaultKey(const CNode *node) {
+  if (node == nullptr)
+    return "";
+  std::string key = literalKey(node);
+  if (key.empty())
+    key = "@" + std::to_string((uintptr_t)node);
+  return key;
+}
+} // namespace
+
+// primitives follow none so that their id is 1 + Primitive
+TypeArena::TypeArena() {
+  none_ = intern("none", [] { return std::make_shared<NoTypeNode>(); });
+  for (int i = 0; i < kPrimitiveCount; i++)
+    primitives_[i] = simpleType(primitiveName((Primitive)i));
+}
+
+template <typename Make>
+std::shared_ptr<TypeNode> TypeArena::intern(const std::string &key,
+                                            Make make) {
+  return intern(key, make, [](const TypeNode &) { return true; });
+}
+
+template <typename Make, typename Same>
+std::shared_ptr<TypeNode> TypeArena::intern(const std::string &key, Make make,
+                                            Same same) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto id = ids_.find(key);
+  if (id != ids_.end()) {
+    if (same(*types_[id->second]))
+      return types_[id->second];
+    // equal to the interned type, but with defaults of its own
+    std::shared_ptr<TypeNode> type = make();
+    type->id = id->second;
+    variants_.push_back(type);
+    return type;
+  }
+  std::shared_ptr<TypeNode> type = make();
+  type->id = (int)types_.size();
+  ids_.insert(std::pair<std::string, int>(key, type->id));
+  types_.push_back(type);
+  return type;
+}
+
+std::shared_ptr<TypeNode> TypeArena::simpleType(const std::string &name) {
+  return intern(name, [&] { return std::make_shared<SimpleType>(name); });
+}
+
+std::shared_ptr<TypeNode>
+TypeArena::arrayType(CNode *expression, std::shared_ptr<TypeNode> item) {
+  if (item == nullptr || item->id < 0)
+    return nullptr;
+  std::string length = "@" + std::to_string((uintptr_t)expression);
+  if (expression != nullptr && expression->constant &&
+      expression->value.kind == ConstantValue::Integer)
+    length = std::to_string(expression->value.integer);
+  std::string key = "array[" + length + "]" + std::to_string(item->id);
+  return intern(
+      key, [&] { return std::make_shared<ArrayType>(expression, item); },
+      [&](const TypeNode &type) {
+        return static_cast<const ArrayType &>(type).arrayType == item;
+      });
+}
+
+std::shared_ptr<TypeNode> TypeArena::recordType(
+    const std::vector<std::shared_ptr<VariableNode>> &fields) {
+  std::string key = "record{";
+  for (auto &field : fields) {
+    if (field->variable_type_ == nullptr || field->variable_type_->id < 0)
+      return nullptr;
+    key += field->variable_name_ + ":" +
+           std::to_string(field->variable_type_->id) + ";";
+  }
+  key += "}";
+  return intern(
+      key, [&] { return std::make_shared<RecordType>(fields); },
+      [&](const TypeNode &type) {
+        auto &interned = static_cast<const RecordType &>(type).fields;
+        for (size_t i = 0; i < fields.size(); i++) {
+          if (interned[i]->variable_type_ != fields[i]->variable_type_ ||
+              defaultKey(interned[i]->default_value_) !=
+                  defaultKey(fields[i]->default_value_))
+            return false;
+        }
+        return true;
+      });
+}
+
+std::shared_ptr<TypeNode> TypeArena::noType() const { return none_; }
+
+std::shared_ptr<TypeNode> TypeArena::primitiveType(Primitive primitive) const {
+  if (primitive == Primitive::Invalid)
+    return nullptr;
+  return primitives_[(int)primitive];
+}
+
+Primitive
+TypeArena::toPrimitive(const std::shared_ptr<TypeNode> &type) const {
+  if (type == nullptr || type->id < 1 || type->id > kPrimitiveCount)
+    return Primitive::Invalid;
+  return (Primitive)(type->id - 1);
+}
+
+std::shared_ptr<TypeNode> TypeArena::getType(int id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (id < 0 || (size_t)id >= types_.size())
+    return nullptr;
+  return types_[id];
+}
+
+int TypeArena::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return (int)types_.size();
+}
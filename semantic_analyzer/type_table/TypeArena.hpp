@@ -0,0 +1,60 @@
+#ifndef CC_PROJECT_TYPEARENA_HPP
+#define CC_PROJECT_TYPEARENA_HPP
+
+#include "semantic_analyzer/type_table/OperatorRules.hpp"
+#include "semantic_analyzer/type_table/TypeNode.hpp"
+#include <mutex>
+#include <unordered_map>
+
+// Owner of all types built during analysis.
+// Structurally equal types are interned to a single node, so two types are
+// equal exactly when their ids are equal. Field defaults do not take part:
+// a type whose defaults differ from the interned one gets a node of its
+// own with the same id.
+// Interning is guarded by a mutex so routine bodies analysed in parallel
+// can share one arena; none and primitive types are fixed at construction
+// and read without locking.
+class TypeArena {
+public:
+  TypeArena();
+  ~TypeArena() = default;
+
+  std::shared_ptr<TypeNode> simpleType(const std::string &name);
+
+  // expression is the (folded) size expression of the array
+  std::shared_ptr<TypeNode> arrayType(CNode *expression,
+                                      std::shared_ptr<TypeNode> item);
+
+  std::shared_ptr<TypeNode>
+  recordType(const std::vector<std::shared_ptr<VariableNode>> &fields);
+
+  std::shared_ptr<TypeNode> noType() const;
+
+  std::shared_ptr<TypeNode> primitiveType(Primitive primitive) const;
+
+  // Primitive::Invalid for non primitive types
+  Primitive toPrimitive(const std::shared_ptr<TypeNode> &type) const;
+
+  std::shared_ptr<TypeNode> getType(int id) const;
+
+  int size() const;
+
+private:
+  template <typename Make>
+  std::shared_ptr<TypeNode> intern(const std::string &key, Make make);
+  // same tells whether the interned type has the defaults of the new one
+  template <typename Make, typename Same>
+  std::shared_ptr<TypeNode> intern(const std::string &key, Make make,
+                                   Same same);
+
+  std::shared_ptr<TypeNode> none_;
+  std::shared_ptr<TypeNode> primitives_[kPrimitiveCount];
+
+  mutable std::mutex mutex_;
+  std::vector<std::shared_ptr<TypeNode>> types_;
+  std::unordered_map<std::string, int> ids_;
+  // nodes sharing the id of an interned type
+  std::vector<std::shared_ptr<TypeNode>> variants_;
+};
+
+#endif // CC_PROJECT_TYPEARENA_HPP
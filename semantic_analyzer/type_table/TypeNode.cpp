@@ -9,6 +9,9 @@ std::string AutoType::toStr() const { return "Auto: need to determine"; }
 SimpleType::SimpleType(const std::string &name) {
   this->type = Types ::Simple;
   this->name = name;
+  // integer is int64_t, real is double
+  this->size = name == "boolean" ? 1 : 8;
+  this->alignment = this->size;
 }
 std::string SimpleType::toStr() const { return "Simple type: " + name; }
 
@@ -17,12 +20,45 @@ ArrayType::ArrayType(CNode *expression, std::shared_ptr<TypeNode>type)
   this->type = Types ::Array;
   this->arrayType = type;
   this->expression = expression;
+  if (expression != nullptr && expression->constant &&
+      expression->value.kind == ConstantValue::Integer) {
+    this->length = expression->value.integer;
+  }
+  // arrays of runtime length are stored as pointer and length
+  this->size = 16;
+  this->alignment = 8;
+  if (this->length >= 0) {
+    this->size = (size_t)this->length * type->size;
+    this->alignment = type->alignment;
+  }
 }
 std::string ArrayType::toStr() const { return "Array type: " + arrayType->toStr(); }
 
 RecordType::RecordType(const std::vector<std::shared_ptr<VariableNode>> &fields) {
   this->type = Types ::Record;
   this->fields = fields;
+  size_t offset = 0;
+  for (size_t i = 0; i < fields.size(); i++) {
+    auto field_type = fields[i]->variable_type_;
+    offset = (offset + field_type->alignment - 1) / field_type->alignment *
+             field_type->alignment;
+    layout.push_back(
+        {(int)i, field_type, offset, field_type->size, field_type->alignment});
+    field_index_.insert(
+        std::pair<std::string, int>(fields[i]->variable_name_, (int)i));
+    offset += field_type->size;
+    if (field_type->alignment > this->alignment)
+      this->alignment = field_type->alignment;
+  }
+  this->size = (offset + this->alignment - 1) / this->alignment *
+               this->alignment;
+}
+
+const FieldLayout *RecordType::findField(const std::string &name) const {
+  auto field = field_index_.find(name);
+  if (field == field_index_.end())
+    return nullptr;
+  return &layout[field->second];
 }
 
 std::string RecordType::toStr() const { 
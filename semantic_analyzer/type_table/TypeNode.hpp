@@ -3,6 +3,7 @@
 
 #include "common/Node.hpp"
 #include <string>
+#include <unordered_map>
 
 class VariableNode;
 
@@ -19,6 +20,11 @@ public:
   virtual ~TypeNode() = default;
   Types getType() const;
   virtual std::string toStr() const = 0;
+  // canonical id assigned by TypeArena, -1 for types outside of it
+  int id = -1;
+  // storage layout in bytes
+  size_t size = 0;
+  size_t alignment = 1;
 protected:
   Types type;
 };
@@ -54,17 +60,37 @@ public:
   ~ArrayType() = default;
   CNode *expression;
   std::shared_ptr<TypeNode> arrayType;
+  // number of items when the folded size is a constant, -1 when it is
+  // only known at runtime
+  int64_t length = -1;
 
   std::string toStr() const override ;
 };
 
+// Placement of one record field, computed once with the record type
+struct FieldLayout {
+  int ordinal;
+  std::shared_ptr<TypeNode> type;
+  size_t offset;
+  size_t size;
+  size_t alignment;
+};
+
 class RecordType : public TypeNode{
 public:
   RecordType(const std::vector<std::shared_ptr<VariableNode>> &fields);
   ~RecordType() = default;
   std::vector<std::shared_ptr<VariableNode>> fields;
+  // fields laid out in declaration order with natural alignment
+  std::vector<FieldLayout> layout;
+
+  // nullptr if the record has no such field
+  const FieldLayout *findField(const std::string &name) const;
 
   std::string toStr() const override ;
+
+private:
+  std::unordered_map<std::string, int> field_index_;
 };
 
 #endif // CC_PROJECT_TYPENODE_HPP
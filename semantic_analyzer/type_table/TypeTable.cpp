@@ -1,33 +1,18 @@
 #include "semantic_analyzer/type_table/TypeTable.hpp"
 
-bool TypeTable::isType(const std::string &cname) {
-  return types.find(cname) != types.end();
+bool TypeTable::isType(const std::string &cname) const {
+  return types.contains(cname);
 }
 
 bool TypeTable::addType(const std::string &cname,
                               std::shared_ptr<TypeNode> type) {
-  if (isType(cname))
-    return false;
-
-  types.insert(std::pair<std::string, std::shared_ptr<TypeNode>>(cname, type));
-
-  return true;
+  return types.insert(cname, type);
 }
 
-std::shared_ptr<TypeNode> TypeTable::getType(const std::string &cname) {
-  auto type = types.find(cname);
-  if (type == types.end()) {
-    return nullptr;
-  } else {
-    return (*type).second;
-  }
+std::shared_ptr<TypeNode> TypeTable::getType(const std::string &cname) const {
+  return types.find(cname);
 }
 
-bool TypeTable::removeType(const std::string &cname) {
-  if (!isType(cname))
-    return false;
+void TypeTable::pushScope() { types.pushScope(); }
 
-  types.erase(cname);
-
-  return true;
-}
+void TypeTable::popScope() { types.popScope(); }
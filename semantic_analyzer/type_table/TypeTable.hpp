@@ -1,8 +1,8 @@
 #ifndef CC_PROJECT_TYPETABLE_HPP
 #define CC_PROJECT_TYPETABLE_HPP
 
+#include "semantic_analyzer/symbol_table/ScopedMap.hpp"
 #include "semantic_analyzer/type_table/TypeNode.hpp"
-#include <unordered_map>
 
 class TypeTable {
 public:
@@ -12,14 +12,16 @@ public:
 
   bool addType(const std::string &cname, std::shared_ptr<TypeNode> type);
 
-  std::shared_ptr<TypeNode> getType(const std::string &cname);
+  std::shared_ptr<TypeNode> getType(const std::string &cname) const;
 
-  bool isType(const std::string &cname);
+  bool isType(const std::string &cname) const;
 
-  bool removeType(const std::string &cname);
+  void pushScope();
+
+  void popScope();
 
 private:
-  std::unordered_map<std::string, std::shared_ptr<TypeNode>> types;
+  ScopedMap<TypeNode> types;
 };
 
 #endif // CC_PROJECT_TYPETABLE_HPP
@@ -0,0 +1,43 @@
+#!/bin/sh
+# usage: all_vms.sh <ICompiler> <source> [expected]
+# runs main on every machine, with and without --optimize, and checks that
+# they all print what the unoptimized stack VM prints, and the expected
+# result when one is given. The machines run one at a time, since --vm all
+# stops at the first one that fails
+compiler=$1
+source=$2
+expected=$3
+
+# programs without a main routine are checked elsewhere
+if ! grep -q "^routine main *( *)" "$source"; then
+  exit 0
+fi
+
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+status=0
+for optimize in "" --optimize; do
+  for machine in stack register jit; do
+    run="$machine${optimize:+ optimized}"
+    "$compiler" --run main --vm $machine $optimize "$source" \
+      >"$work/log" 2>&1
+    grep -E "^(Result|Runtime error)" "$work/log" >"$work/$machine$optimize"
+    if [ ! -s "$work/$machine$optimize" ]; then
+      cat "$work/log"
+      echo "$run printed no result"
+      exit 1
+    fi
+    if [ ! -f "$work/reference" ]; then
+      cp "$work/$machine$optimize" "$work/reference"
+    elif ! diff "$work/reference" "$work/$machine$optimize"; then
+      echo "$run differs from the stack VM"
+      status=1
+    fi
+  done
+done
+if [ -n "$expected" ] && ! diff "$expected" "$work/reference"; then
+  echo "stack VM differs from $expected"
+  exit 1
+fi
+exit $status
@@ -0,0 +1,39 @@
+#!/bin/sh
+# usage: emitted_c.sh <ICompiler> <cc> <source> [expected]
+# builds the C emitted for the source and checks that it prints what the
+# stack VM prints for main, and the expected result when one is given
+compiler=$1
+cc=$2
+source=$3
+expected=$4
+
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+# programs without a main routine are only built
+run=
+if grep -q "^routine main *( *)" "$source"; then
+  run="--run main --vm stack"
+fi
+
+"$compiler" $run --emit-c "$work/program.c" "$source" >"$work/vm.log" 2>&1
+status=$?
+grep -E "^(Result|Runtime error)" "$work/vm.log" >"$work/vm.txt"
+if [ $status -ne 0 ] && [ ! -s "$work/vm.txt" ]; then
+  cat "$work/vm.log"
+  exit 1
+fi
+
+"$cc" -O2 -o "$work/program" "$work/program.c" -lm || exit 1
+"$work/program" >"$work/c.log" 2>&1
+grep -E "^(Result|Runtime error)" "$work/c.log" >"$work/c.txt"
+
+if ! diff "$work/vm.txt" "$work/c.txt"; then
+  echo "emitted C differs from the stack VM"
+  exit 1
+fi
+if [ -n "$expected" ] && ! diff "$expected" "$work/vm.txt"; then
+  echo "stack VM differs from $expected"
+  exit 1
+fi
+exit 0
@@ -0,0 +1,81 @@
+#!/bin/sh
+# usage: operator_rules.sh <ICompiler> <rules>
+# checks the type the analyzer gives each operator and pair of simple
+# operands against a line of rules. One program declares the result,
+# which compiles only for valid operands; a second assigns 2.5 to it,
+# which booleans reject and integers round
+compiler=$1
+rules=$2
+
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+value() {
+  case $1 in
+  integer) echo 1 ;;
+  real) echo 1.5 ;;
+  boolean) echo true ;;
+  esac
+}
+
+# prints what main returns, or nothing when the program is rejected
+run() {
+  "$compiler" --run main --vm stack "$work/program.txt" >"$work/log" 2>&1
+  sed -n "s/^Result: //p" "$work/log"
+}
+
+status=0
+while read -r operator left right expected; do
+  case $operator in
+  "#"* | "") continue ;;
+  esac
+  l=$(value "$left")
+  r=$(value "$right")
+  name="$left $operator $right"
+  if [ "$operator" = not ]; then
+    result="not l"
+    name="not $left"
+  else
+    result="l $operator r"
+  fi
+  # the result of an assignment is its target
+  assign=
+  if [ "$operator" = := ]; then
+    result="l"
+    assign="  l := r"
+  fi
+
+  cat >"$work/program.txt" <<EOF
+routine main() : real is
+  var l : $left is $l
+  var r : $right is $r
+$assign
+  var x is $result
+  return 1.0
+end
+EOF
+  if [ -z "$(run)" ]; then
+    actual=invalid
+  else
+    cat >"$work/program.txt" <<EOF
+routine main() : real is
+  var l : $left is $l
+  var r : $right is $r
+$assign
+  var x is $result
+  x := 2.5
+  return x
+end
+EOF
+    case $(run) in
+    "") actual=boolean ;;
+    2.5) actual=real ;;
+    *) actual=integer ;;
+    esac
+  fi
+  if [ "$actual" != "$expected" ]; then
+    echo "$name: $actual, expected $expected"
+    status=1
+  fi
+done <"$rules"
+exit $status
@@ -0,0 +1,103 @@
+#include "vm/Bytecode.hpp"
+#include <algorithm>
+
+namespace {
+
+const char *const kOpcodeNames[] = {
+    "push_int",      "push_const",   "pop",           "load_local",
+    "store_local",   "load_global",  "store_global",  "allocate",
+    "allocate_global", "field",      "index",         "length",
+    "load_int",      "load_real",    "load_bool",     "store_int",
+    "store_real",    "store_bool",   "copy",          "add_int",
+    "sub_int",       "mul_int",      "div_int",       "mod_int",
+    "add_real",      "sub_real",     "mul_real",      "div_real",
+    "neg_int",       "neg_real",     "less_int",      "less_eq_int",
+    "greater_int",   "greater_eq_int", "equal_int",   "not_equal_int",
+    "less_real",     "less_eq_real", "greater_real",  "greater_eq_real",
+    "equal_real",    "not_equal_real", "and",         "or",
+    "xor",           "not",          "int_to_real",   "real_to_int",
+    "int_to_bool",   "jump",         "jump_if_false", "call",
+    "return",        "return_void",  "missing_return"};
+
+static_assert(sizeof(kOpcodeNames) / sizeof(kOpcodeNames[0]) ==
+                  (size_t)Opcode::OpcodeCount,
+              "every opcode needs a name");
+
+} // namespace
+
+const char *opcodeName(Opcode opcode) {
+  return kOpcodeNames[(int)opcode];
+}
+
+int operandCount(Opcode opcode) {
+  switch (opcode) {
+  case Opcode::PushInt:
+  case Opcode::PushConst:
+  case Opcode::LoadLocal:
+  case Opcode::StoreLocal:
+  case Opcode::LoadGlobal:
+  case Opcode::StoreGlobal:
+  case Opcode::Field:
+  case Opcode::Length:
+  case Opcode::Copy:
+  case Opcode::DivInt:
+  case Opcode::ModInt:
+  case Opcode::Jump:
+  case Opcode::JumpIfFalse:
+    return 1;
+  case Opcode::Allocate:
+  case Opcode::AllocateGlobal:
+  case Opcode::Index:
+  case Opcode::Call:
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+int originAt(const Origins &origins, size_t position) {
+  auto next = std::upper_bound(
+      origins.begin(), origins.end(), position,
+      [](size_t position, const std::pair<uint32_t, int> &origin) {
+        return position < origin.first;
+      });
+  return next == origins.begin() ? -1 : (next - 1)->second;
+}
+
+int Program::find(const std::string &name) const {
+  auto routine = routine_index.find(name);
+  return routine == routine_index.end() ? -1 : routine->second;
+}
+
+void Program::disassemble(std::ostream &out) const {
+  for (size_t i = 0; i < constants.size(); i++)
+    out << "const " << i << ": " << constants[i].toString() << "\n";
+  for (size_t i = 0; i < shapes.size(); i++)
+    out << "shape " << i << ": " << shapes[i].name << ", " << shapes[i].size
+        << " bytes\n";
+  disassemble(initializer, out);
+  for (const Routine &routine : routines)
+    disassemble(routine, out);
+}
+
+void Program::disassemble(const Routine &routine, std::ostream &out) const {
+  out << "routine " << routine.name << " (" << routine.parameters
+      << " parameters, " << routine.frame_size << " slots, stack "
+      << routine.max_stack << ")\n";
+  const uint8_t *code = routine.code.data();
+  const uint8_t *end = code + routine.code.size();
+  while (code < end) {
+    Opcode opcode = (Opcode)*code;
+    out << "  " << code - routine.code.data() << ": " << opcodeName(opcode);
+    code++;
+    for (int i = 0; i < operandCount(opcode); i++, code += 4) {
+      int32_t operand = readOperand(code);
+      out << " " << operand;
+      if (opcode == Opcode::Call && i == 0)
+        out << " (" << routines[operand].name << ")";
+      else if (opcode == Opcode::PushConst)
+        out << " (" << constants[operand].toString() << ")";
+    }
+    out << "\n";
+  }
+}
@@ -0,0 +1,156 @@
+#ifndef CC_PROJECT_BYTECODE_HPP
+#define CC_PROJECT_BYTECODE_HPP
+
+#include "common/ConstantValue.hpp"
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// One slot of a frame or of the operand stack. Booleans are the integers
+// 0 and 1; arrays and records live in buffers owned by frames and are
+// handled through their address
+union Value {
+  int64_t integer;
+  double real;
+  uint8_t *address;
+};
+
+// Operands follow the opcode as 32 bit little endian integers; the
+// comment lists them and the stack effect
+enum class Opcode : uint8_t {
+  PushInt,       // value              -> integer
+  PushConst,     // pool index         -> value
+  Pop,           //          value     ->
+  LoadLocal,     // slot               -> value
+  StoreLocal,    // slot     value     ->
+  LoadGlobal,    // slot               -> value
+  StoreGlobal,   // slot     value     ->
+  Allocate,      // slot shape         -> (length) for runtime arrays
+  AllocateGlobal,// slot shape
+  Field,         // offset   address   -> address
+  Index,         // shape checked  address index -> address
+  Length,        // shape    address   -> integer
+  LoadInt,       //          address   -> integer
+  LoadReal,      //          address   -> real
+  LoadBool,      //          address   -> boolean
+  StoreInt,      //          address value ->
+  StoreReal,     //          address value ->
+  StoreBool,     //          address value ->
+  Copy,          // shape    target source ->
+  AddInt,
+  SubInt,
+  MulInt,
+  DivInt,        // checked  left right -> integer
+  ModInt,        // checked  left right -> integer
+  AddReal,
+  SubReal,
+  MulReal,
+  DivReal,
+  NegInt,
+  NegReal,
+  LessInt,
+  LessEqInt,
+  GreaterInt,
+  GreaterEqInt,
+  EqualInt,
+  NotEqualInt,
+  LessReal,
+  LessEqReal,
+  GreaterReal,
+  GreaterEqReal,
+  EqualReal,
+  NotEqualReal,
+  And,
+  Or,
+  Xor,
+  Not,
+  IntToReal,
+  RealToInt,
+  IntToBool,     // fails unless the integer is 0 or 1
+  Jump,          // target
+  JumpIfFalse,   // target   boolean   ->
+  Call,          // routine result_slot  arguments -> (result)
+  Return,        //          value     ->
+  ReturnVoid,
+  MissingReturn, // a routine with a result ran off its end
+  OpcodeCount
+};
+
+const char *opcodeName(Opcode opcode);
+
+// number of 32 bit operands following the opcode
+int operandCount(Opcode opcode);
+
+inline int32_t readOperand(const uint8_t *code) {
+  int32_t operand;
+  std::memcpy(&operand, code, sizeof(operand));
+  return operand;
+}
+
+// Storage of an array or record type. Constant sized values are laid out
+// as TypeNode describes them; arrays of runtime length keep their length
+// in an 8 byte header in front of the items and may only be variables of
+// their own, not parts of other values
+struct Shape {
+  std::string name;
+  size_t size = 0;
+  // items of an array, -1 for runtime length, 0 for records
+  int64_t length = 0;
+  size_t item_size = 0;
+  // initial bytes: zeros and the defaults of record fields; for arrays of
+  // runtime length the image of one item
+  std::vector<uint8_t> image;
+};
+
+// Positions in the code where code inlined from another routine starts,
+// with the index of that routine, or -1 where the routine's own code
+// resumes; sorted by position
+using Origins = std::vector<std::pair<uint32_t, int>>;
+
+// routine the code at position came from, -1 for the routine's own
+int originAt(const Origins &origins, size_t position);
+
+struct Routine {
+  std::string name;
+  std::vector<uint8_t> code;
+  int parameters = 0;
+  // slots of the analyzer frame plus the ones the compiler adds
+  int frame_size = 0;
+  // deepest operand stack the code reaches
+  int max_stack = 0;
+  // shape of each aggregate parameter, -1 for scalars
+  std::vector<int> parameter_shapes;
+  // kind of each scalar parameter, None for aggregates
+  std::vector<ConstantValue::Kind> parameter_kinds;
+  bool returns = false;
+  // kind of a scalar result
+  ConstantValue::Kind result_kind = ConstantValue::None;
+  // shape of an aggregate result, -1 for scalars
+  int result_shape = -1;
+  // some slot holds an aggregate, so frames need buffers
+  bool aggregates = false;
+  // by byte offset, so that runtime errors name the inlined routine
+  Origins origins;
+};
+
+struct Program {
+  std::vector<ConstantValue> constants;
+  std::vector<Shape> shapes;
+  std::vector<Routine> routines;
+  // declarations of the globals, run once before any routine
+  Routine initializer;
+  int global_frame_size = 0;
+  std::unordered_map<std::string, int> routine_index;
+
+  // -1 when there is no such routine
+  int find(const std::string &name) const;
+
+  void disassemble(std::ostream &out) const;
+  void disassemble(const Routine &routine, std::ostream &out) const;
+};
+
+#endif // CC_PROJECT_BYTECODE_HPP
@@ -0,0 +1,704 @@
+#include "vm/BytecodeCompiler.hpp"
+#include "semantic_analyzer/type_table/ConstantFolding.hpp"
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+namespace {
+
+// a counter at the last value of the range may step past the integers,
+// unless the value is a constant away from their end
+bool mayWrap(const CNode *last, bool reverse) {
+  if (!last->constant || last->value.kind != ConstantValue::Integer)
+    return true;
+  return last->value.integer == (reverse
+                                     ? std::numeric_limits<int64_t>::min()
+                                     : std::numeric_limits<int64_t>::max());
+}
+
+bool isBinary(const CNode *node) {
+  return node->children.size() == 3 &&
+         (node->name == "expression" || node->name == "relation" ||
+          node->name == "simple" || node->name == "factor");
+}
+
+void writeScalar(const ConstantValue &value, size_t size, uint8_t *bytes) {
+  if (size == 1) {
+    bytes[0] = value.kind == ConstantValue::Boolean ? value.boolean
+                                                    : (uint8_t)value.integer;
+  } else if (value.kind == ConstantValue::Real) {
+    std::memcpy(bytes, &value.real, sizeof(value.real));
+  } else {
+    std::memcpy(bytes, &value.integer, sizeof(value.integer));
+  }
+}
+
+ConstantValue::Kind kindOf(Primitive type) {
+  switch (type) {
+  case Primitive::Integer:
+    return ConstantValue::Integer;
+  case Primitive::Real:
+    return ConstantValue::Real;
+  case Primitive::Boolean:
+    return ConstantValue::Boolean;
+  default:
+    return ConstantValue::None;
+  }
+}
+
+} // namespace
+
+BytecodeCompiler::BytecodeCompiler(const ControlTable &table,
+                                   std::ostream &err)
+    : table_(table), err_(&err) {}
+
+bool BytecodeCompiler::compile(CNode *program,
+                               const std::vector<std::string> &entries,
+                               Program &result) {
+  program_ = &result;
+  std::vector<CNode *> globals;
+  for (CNode *child : program->children) {
+    if (child->name == "routine_declaration")
+      bodies_[child->children[0]->name] = child->children[3];
+    else
+      globals.push_back(child);
+  }
+
+  // globals are declared by a routine of their own, whose slots are the
+  // ones the compiler adds
+  Routine initializer;
+  initializer.name = "<globals>";
+  routine_ = &initializer;
+  depth_ = 0;
+  for (CNode *global : globals) {
+    if (!declaration(global->children[0]))
+      return false;
+  }
+  emit(Opcode::ReturnVoid, 0);
+  result.global_frame_size = table_.globalFrameSize();
+
+  if (entries.empty()) {
+    for (CNode *child : program->children) {
+      if (child->name == "routine_declaration")
+        request(child->children[0]->name);
+    }
+  }
+  for (const std::string &entry : entries) {
+    if (request(entry) == -1) {
+      *err_ << "Routine " << entry << " is not declared" << std::endl;
+      return false;
+    }
+  }
+  // compiled routines request their callees
+  for (size_t i = 0; i < queue_.size(); i++) {
+    Routine compiled;
+    if (!routine(queue_[i], bodies_[queue_[i]], compiled))
+      return false;
+    result.routines[i] = std::move(compiled);
+  }
+  result.initializer = std::move(initializer);
+  return true;
+}
+
+int BytecodeCompiler::request(const std::string &name) {
+  int known = program_->find(name);
+  if (known != -1)
+    return known;
+  if (table_.findFunction(name) == nullptr || bodies_.count(name) == 0)
+    return -1;
+  int id = (int)program_->routines.size();
+  program_->routine_index[name] = id;
+  program_->routines.emplace_back();
+  queue_.push_back(name);
+  return id;
+}
+
+bool BytecodeCompiler::routine(const std::string &name, CNode *body,
+                               Routine &result) {
+  const FunctionNode *function = table_.findFunction(name);
+  result.name = name;
+  result.parameters = (int)function->parameters_.size();
+  result.frame_size = function->frame_size_;
+  for (const auto &parameter : function->parameters_) {
+    int parameter_shape;
+    if (!shape(parameter->variable_type_, parameter_shape))
+      return false;
+    result.parameter_shapes.push_back(parameter_shape);
+    result.parameter_kinds.push_back(
+        kindOf(primitive(parameter->variable_type_)));
+    result.aggregates |= parameter_shape != -1;
+  }
+  result.returns = function->return_type_ != nullptr &&
+                   function->return_type_->getType() != Types::NoType;
+  if (result.returns && !shape(function->return_type_, result.result_shape))
+    return false;
+  result.result_kind = kindOf(primitive(function->return_type_));
+
+  routine_ = &result;
+  depth_ = 0;
+  if (!block(body)) {
+    *err_ << "ERROR: in bytecode of routine " << name << std::endl;
+    return false;
+  }
+  emit(result.returns ? Opcode::MissingReturn : Opcode::ReturnVoid, 0);
+  return true;
+}
+
+bool BytecodeCompiler::block(CNode *body) {
+  if (body == nullptr)
+    return true;
+  for (CNode *child : body->children) {
+    bool compiled = child->name == "statement"
+                        ? statement(child->children[0])
+                        : declaration(child->children[0]);
+    if (!compiled)
+      return false;
+  }
+  return true;
+}
+
+bool BytecodeCompiler::declaration(CNode *node) {
+  if (node->name == "type_declaration")
+    return true;
+  CNode *identifier = node->children[0];
+  CNode *initial = node->name == "variable_declaration_auto"
+                      ? node->children[1]
+                      : node->children[2];
+  if (identifier->slot == -1) {
+    *err_ << "Variable " << identifier->name << " was not analysed"
+          << std::endl;
+    return false;
+  }
+  bool global = identifier->depth == 0;
+  int declared;
+  if (!shape(identifier->type, declared))
+    return false;
+  if (declared == -1) {
+    if (initial == nullptr)
+      emit(Opcode::PushInt, 1), operand(0);
+    else if (!value(initial, primitive(identifier->type)))
+      return false;
+    emit(global ? Opcode::StoreGlobal : Opcode::StoreLocal, -1);
+    operand(identifier->slot);
+    return true;
+  }
+
+  // shapes may grow while the initializer is compiled
+  bool runtime = program_->shapes[declared].length < 0;
+  int source = -1;
+  if (runtime) {
+    // the length comes from the initializer when there is one, else from
+    // the size expression of the type
+    if (initial != nullptr) {
+      Primitive ignored;
+      source = hiddenSlot();
+      if (!expression(initial, ignored))
+        return false;
+      emit(Opcode::StoreLocal, -1), operand(source);
+      emit(Opcode::LoadLocal, 1), operand(source);
+      emit(Opcode::Length, 0), operand(declared);
+    } else {
+      auto array = static_cast<ArrayType *>(identifier->type.get());
+      if (!value(array->expression, Primitive::Integer))
+        return false;
+    }
+  }
+  routine_->aggregates |= !global;
+  emit(global ? Opcode::AllocateGlobal : Opcode::Allocate,
+       runtime ? -1 : 0);
+  operand(identifier->slot), operand(declared);
+  if (initial == nullptr)
+    return true;
+  if (source != -1) {
+    emit(Opcode::LoadLocal, 1), operand(source);
+  } else {
+    Primitive ignored;
+    if (!expression(initial, ignored))
+      return false;
+  }
+  emit(global ? Opcode::LoadGlobal : Opcode::LoadLocal, 1);
+  operand(identifier->slot);
+  emit(Opcode::Copy, -2), operand(declared);
+  return true;
+}
+
+bool BytecodeCompiler::statement(CNode *node) {
+  if (node->name == "return") {
+    if (node->children[0] == nullptr) {
+      emit(Opcode::ReturnVoid, 0);
+      return true;
+    }
+    CNode *result = node->children[0]->children[0];
+    bool compiled;
+    if (routine_->result_shape != -1) {
+      Primitive ignored;
+      compiled = expression(result, ignored);
+    } else {
+      const FunctionNode *function = table_.findFunction(routine_->name);
+      compiled = value(result, primitive(function->return_type_));
+    }
+    emit(Opcode::Return, -1);
+    return compiled;
+  } else if (node->name == "assignment") {
+    return assignment(node);
+  } else if (node->name == "routine_call") {
+    return call(node, false);
+  } else if (node->name == "if_statement") {
+    if (!value(node->children[0], Primitive::Boolean))
+      return false;
+    size_t otherwise = jump(Opcode::JumpIfFalse);
+    if (!block(node->children[1]))
+      return false;
+    if (node->children[2] == nullptr) {
+      patch(otherwise);
+      return true;
+    }
+    size_t end = jump(Opcode::Jump);
+    patch(otherwise);
+    if (!block(node->children[2]->children[0]))
+      return false;
+    patch(end);
+    return true;
+  } else if (node->name == "while_loop") {
+    size_t top = here();
+    if (!value(node->children[0], Primitive::Boolean))
+      return false;
+    size_t exit = jump(Opcode::JumpIfFalse);
+    if (!block(node->children[1]))
+      return false;
+    emit(Opcode::Jump, 0), operand((int32_t)top);
+    patch(exit);
+    return true;
+  } else if (node->name == "for_loop") {
+    return forLoop(node);
+  }
+  *err_ << "Statement " << node->name << " has no bytecode" << std::endl;
+  return false;
+}
+
+bool BytecodeCompiler::assignment(CNode *node) {
+  CNode *target = node->children[0];
+  int assigned;
+  if (!shape(target->type, assigned))
+    return false;
+  Primitive ignored;
+  if (assigned != -1) {
+    if (!expression(node->children[1], ignored) || !address(target))
+      return false;
+    emit(Opcode::Copy, -2), operand(assigned);
+    return true;
+  }
+  Primitive type = primitive(target->type);
+  if (!value(node->children[1], type))
+    return false;
+  if (target->name == "modifiable_primary")
+    return variable(target, true);
+  if (!address(target))
+    return false;
+  emit(type == Primitive::Real      ? Opcode::StoreReal
+       : type == Primitive::Boolean ? Opcode::StoreBool
+                                    : Opcode::StoreInt,
+       -2);
+  return true;
+}
+
+// the counter runs between its slot and a slot holding the other bound
+bool BytecodeCompiler::forLoop(CNode *node) {
+  CNode *counter = node->children[0];
+  CNode *range = node->children[1];
+  bool reverse = range->name == "reverse_range";
+  int bound = hiddenSlot();
+  if (counter->slot == -1) {
+    *err_ << "Loop counter " << counter->name << " was not analysed"
+          << std::endl;
+    return false;
+  }
+  if (!value(range->children[0], Primitive::Integer))
+    return false;
+  emit(Opcode::StoreLocal, -1), operand(reverse ? bound : counter->slot);
+  if (!value(range->children[1], Primitive::Integer))
+    return false;
+  emit(Opcode::StoreLocal, -1), operand(reverse ? counter->slot : bound);
+
+  size_t top = here();
+  emit(Opcode::LoadLocal, 1), operand(counter->slot);
+  emit(Opcode::LoadLocal, 1), operand(bound);
+  emit(reverse ? Opcode::GreaterEqInt : Opcode::LessEqInt, -1);
+  size_t exit = jump(Opcode::JumpIfFalse);
+  if (!block(node->children[2]))
+    return false;
+  // the loop ends at the bound instead of stepping past it
+  bool wraps = mayWrap(range->children[reverse ? 0 : 1], reverse);
+  size_t last = 0;
+  if (wraps) {
+    emit(Opcode::LoadLocal, 1), operand(counter->slot);
+    emit(Opcode::LoadLocal, 1), operand(bound);
+    emit(Opcode::NotEqualInt, -1);
+    last = jump(Opcode::JumpIfFalse);
+  }
+  emit(Opcode::LoadLocal, 1), operand(counter->slot);
+  emit(Opcode::PushInt, 1), operand(1);
+  emit(reverse ? Opcode::SubInt : Opcode::AddInt, -1);
+  emit(Opcode::StoreLocal, -1), operand(counter->slot);
+  emit(Opcode::Jump, 0), operand((int32_t)top);
+  patch(exit);
+  if (wraps)
+    patch(last);
+  return true;
+}
+
+bool BytecodeCompiler::call(CNode *node, bool used) {
+  const std::string &name = node->children[0]->name;
+  const FunctionNode *function = table_.findFunction(name);
+  int callee = request(name);
+  if (function == nullptr || callee == -1) {
+    *err_ << "Routine " << name << " has no body to call" << std::endl;
+    return false;
+  }
+  size_t count = node->children[1] == nullptr
+                     ? 0
+                     : node->children[1]->children.size();
+  for (size_t i = 0; i < count; i++) {
+    CNode *argument = node->children[1]->children[i];
+    const auto &type = function->parameters_[i]->variable_type_;
+    Primitive ignored;
+    bool compiled = primitive(type) == Primitive::Invalid
+                        ? expression(argument, ignored)
+                        : value(argument, primitive(type));
+    if (!compiled)
+      return false;
+  }
+  bool returns = function->return_type_ != nullptr &&
+                 function->return_type_->getType() != Types::NoType;
+  int result_slot = -1;
+  if (returns && primitive(function->return_type_) == Primitive::Invalid) {
+    result_slot = hiddenSlot();
+    routine_->aggregates = true;
+  }
+  emit(Opcode::Call, (returns ? 1 : 0) - (int)count);
+  operand(callee), operand(result_slot);
+  if (returns && !used)
+    emit(Opcode::Pop, -1);
+  if (!returns && used) {
+    *err_ << "Routine " << name << " returns no value" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool BytecodeCompiler::value(CNode *node, Primitive type) {
+  Primitive actual;
+  return expression(node, actual) && convert(actual, type);
+}
+
+bool BytecodeCompiler::expression(CNode *node, Primitive &type) {
+  if (node->constant) {
+    const ConstantValue &literal = node->value;
+    if (literal.kind == ConstantValue::Real) {
+      type = Primitive::Real;
+      emit(Opcode::PushConst, 1), operand(constant(literal));
+    } else if (literal.kind == ConstantValue::Boolean) {
+      type = Primitive::Boolean;
+      emit(Opcode::PushInt, 1), operand(literal.boolean);
+    } else if (literal.integer == (int32_t)literal.integer) {
+      type = Primitive::Integer;
+      emit(Opcode::PushInt, 1), operand((int32_t)literal.integer);
+    } else {
+      type = Primitive::Integer;
+      emit(Opcode::PushConst, 1), operand(constant(literal));
+    }
+    return true;
+  }
+  type = primitive(node->type);
+  if (isBinary(node))
+    return binary(node, type);
+  if (node->name == "unary_factor") {
+    Primitive operand_type;
+    if (!expression(node->children[1], operand_type))
+      return false;
+    if (node->children[0]->name == "-")
+      emit(operand_type == Primitive::Real ? Opcode::NegReal : Opcode::NegInt,
+           0);
+    return convert(operand_type, type);
+  } else if (node->name == "not_factor") {
+    if (!value(node->children[1], Primitive::Boolean))
+      return false;
+    emit(Opcode::Not, 0);
+    return true;
+  } else if (node->name == "routine_call") {
+    return call(node, true);
+  } else if (node->name == "modifiable_primary") {
+    return variable(node, false);
+  }
+  if (!address(node))
+    return false;
+  if (type == Primitive::Integer)
+    emit(Opcode::LoadInt, 0);
+  else if (type == Primitive::Real)
+    emit(Opcode::LoadReal, 0);
+  else if (type == Primitive::Boolean)
+    emit(Opcode::LoadBool, 0);
+  return true;
+}
+
+bool BytecodeCompiler::binary(CNode *node, Primitive type) {
+  Operator op = toOperator(node->children[1]->name);
+  if (op >= Operator::Less && op <= Operator::NotEqual) {
+    Primitive left = typeOf(node->children[0]);
+    Primitive right = typeOf(node->children[2]);
+    Primitive common = left == Primitive::Real || right == Primitive::Real
+                           ? Primitive::Real
+                           : Primitive::Integer;
+    if (!value(node->children[0], common) ||
+        !value(node->children[2], common))
+      return false;
+    int relation = (int)op - (int)Operator::Less;
+    emit((Opcode)((int)(common == Primitive::Real ? Opcode::LessReal
+                                                  : Opcode::LessInt) +
+                  relation),
+         -1);
+    return true;
+  }
+  if (!value(node->children[0], type) || !value(node->children[2], type))
+    return false;
+  switch (op) {
+  case Operator::And:
+    emit(Opcode::And, -1);
+    return true;
+  case Operator::Or:
+    emit(Opcode::Or, -1);
+    return true;
+  case Operator::Xor:
+    emit(Opcode::Xor, -1);
+    return true;
+  case Operator::Add:
+    emit(type == Primitive::Real ? Opcode::AddReal : Opcode::AddInt, -1);
+    return true;
+  case Operator::Sub:
+    emit(type == Primitive::Real ? Opcode::SubReal : Opcode::SubInt, -1);
+    return true;
+  case Operator::Mul:
+    emit(type == Primitive::Real ? Opcode::MulReal : Opcode::MulInt, -1);
+    return true;
+  case Operator::Div:
+    if (type == Primitive::Real)
+      emit(Opcode::DivReal, -1);
+    else
+      emit(Opcode::DivInt, -1), operand(1);
+    return true;
+  case Operator::Mod:
+    emit(Opcode::ModInt, -1), operand(1);
+    return true;
+  default:
+    *err_ << "Operator " << node->children[1]->name << " has no bytecode"
+          << std::endl;
+    return false;
+  }
+}
+
+bool BytecodeCompiler::convert(Primitive from, Primitive to) {
+  if (from == to || (from == Primitive::Boolean && to == Primitive::Integer))
+    return true;
+  if (to == Primitive::Real && from != Primitive::Invalid) {
+    emit(Opcode::IntToReal, 0);
+    return true;
+  }
+  if (to == Primitive::Integer && from == Primitive::Real) {
+    emit(Opcode::RealToInt, 0);
+    return true;
+  }
+  if (to == Primitive::Boolean && from == Primitive::Integer) {
+    emit(Opcode::IntToBool, 0);
+    return true;
+  }
+  *err_ << "Cannot convert " << primitiveName(from) << " to "
+        << primitiveName(to) << std::endl;
+  return false;
+}
+
+bool BytecodeCompiler::address(CNode *node) {
+  if (node->name == "modifiable_primary")
+    return variable(node, false);
+  return address(node->children[0]) && selector(node);
+}
+
+bool BytecodeCompiler::selector(CNode *node) {
+  CNode *base = node->children[0];
+  if (node->name == "modifiable_primary_array") {
+    int array;
+    if (!shape(base->type, array) || array == -1 ||
+        !value(node->children[1], Primitive::Integer))
+      return false;
+    emit(Opcode::Index, -1), operand(array);
+    operand((node->proven & CNode::InBounds) == 0);
+    return true;
+  }
+  // the grammar nests the rest of a chain such as a.b[i].c to the right
+  return member(node->children[1], base->type);
+}
+
+bool BytecodeCompiler::member(CNode *node,
+                              const std::shared_ptr<TypeNode> &record) {
+  if (node->name != "modifiable_primary")
+    return member(node->children[0], record) && selector(node);
+  auto fields = record == nullptr || record->getType() != Types::Record
+                    ? nullptr
+                    : static_cast<RecordType *>(record.get());
+  const FieldLayout *field =
+      fields == nullptr ? nullptr : fields->findField(node->children[0]->name);
+  if (field == nullptr) {
+    *err_ << "Field access " << node->children[0]->name << " is not typed"
+          << std::endl;
+    return false;
+  }
+  emit(Opcode::Field, 0), operand((int32_t)field->offset);
+  return true;
+}
+
+bool BytecodeCompiler::variable(CNode *node, bool store) {
+  if (node->slot == -1) {
+    *err_ << "Variable " << node->children[0]->name << " was not analysed"
+          << std::endl;
+    return false;
+  }
+  bool global = node->depth == 0;
+  if (store)
+    emit(global ? Opcode::StoreGlobal : Opcode::StoreLocal, -1);
+  else
+    emit(global ? Opcode::LoadGlobal : Opcode::LoadLocal, 1);
+  operand(node->slot);
+  return true;
+}
+
+bool BytecodeCompiler::shape(const std::shared_ptr<TypeNode> &type,
+                             int &result) {
+  result = -1;
+  if (type == nullptr ||
+      (type->getType() != Types::Array && type->getType() != Types::Record))
+    return true;
+  auto known = shapes_.find(type.get());
+  if (known != shapes_.end()) {
+    result = known->second;
+    return true;
+  }
+  Shape storage;
+  storage.name = type->toStr();
+  storage.size = type->size;
+  if (type->getType() == Types::Array) {
+    auto array = static_cast<ArrayType *>(type.get());
+    storage.length = array->length;
+    storage.item_size = array->arrayType->size;
+  }
+  // runtime arrays start from copies of one item
+  size_t bytes = storage.length < 0 ? storage.item_size : storage.size;
+  storage.image.assign(bytes, 0);
+  const std::shared_ptr<TypeNode> &initial =
+      storage.length < 0 ? static_cast<ArrayType *>(type.get())->arrayType
+                         : type;
+  if (!image(initial, storage.image.data()))
+    return false;
+  result = (int)program_->shapes.size();
+  shapes_[type.get()] = result;
+  program_->shapes.push_back(std::move(storage));
+  return true;
+}
+
+bool BytecodeCompiler::image(const std::shared_ptr<TypeNode> &type,
+                             uint8_t *bytes) {
+  if (type->getType() == Types::Array) {
+    auto array = static_cast<ArrayType *>(type.get());
+    if (array->length < 0) {
+      *err_ << "Arrays of runtime length must be variables of their own"
+            << std::endl;
+      return false;
+    }
+    for (int64_t i = 0; i < array->length; i++) {
+      if (!image(array->arrayType, bytes + i * array->arrayType->size))
+        return false;
+    }
+  } else if (type->getType() == Types::Record) {
+    auto record = static_cast<RecordType *>(type.get());
+    for (const FieldLayout &field : record->layout) {
+      CNode *initial = record->fields[field.ordinal]->default_value_;
+      if (initial == nullptr) {
+        if (!image(field.type, bytes + field.offset))
+          return false;
+        continue;
+      }
+      ConstantValue converted;
+      std::ostringstream ignored;
+      if (!initial->constant ||
+          !convertValue(initial->value, primitive(field.type), converted,
+                        ignored)) {
+        *err_ << "Default of field "
+              << record->fields[field.ordinal]->variable_name_
+              << " is not a constant" << std::endl;
+        return false;
+      }
+      writeScalar(converted, field.size, bytes + field.offset);
+    }
+  }
+  return true;
+}
+
+Primitive BytecodeCompiler::typeOf(const CNode *node) const {
+  if (!node->constant)
+    return primitive(node->type);
+  switch (node->value.kind) {
+  case ConstantValue::Integer:
+    return Primitive::Integer;
+  case ConstantValue::Real:
+    return Primitive::Real;
+  case ConstantValue::Boolean:
+    return Primitive::Boolean;
+  default:
+    return Primitive::Invalid;
+  }
+}
+
+Primitive BytecodeCompiler::primitive(
+    const std::shared_ptr<TypeNode> &type) const {
+  return type == nullptr ? Primitive::Invalid
+                         : table_.typeArena().toPrimitive(type);
+}
+
+int BytecodeCompiler::constant(const ConstantValue &value) {
+  int64_t bits = value.integer;
+  auto key = std::make_pair((int)value.kind, bits);
+  auto known = constants_.find(key);
+  if (known != constants_.end())
+    return known->second;
+  int index = (int)program_->constants.size();
+  program_->constants.push_back(value);
+  constants_[key] = index;
+  return index;
+}
+
+int BytecodeCompiler::hiddenSlot() { return routine_->frame_size++; }
+
+void BytecodeCompiler::emit(Opcode opcode, int effect) {
+  routine_->code.push_back((uint8_t)opcode);
+  depth_ += effect;
+  if (depth_ > routine_->max_stack)
+    routine_->max_stack = depth_;
+}
+
+void BytecodeCompiler::operand(int32_t value) {
+  uint8_t bytes[sizeof(value)];
+  std::memcpy(bytes, &value, sizeof(value));
+  routine_->code.insert(routine_->code.end(), bytes, bytes + sizeof(value));
+}
+
+size_t BytecodeCompiler::jump(Opcode opcode) {
+  emit(opcode, opcode == Opcode::JumpIfFalse ? -1 : 0);
+  size_t position = here();
+  operand(0);
+  return position;
+}
+
+void BytecodeCompiler::patch(size_t position) {
+  int32_t target = (int32_t)here();
+  std::memcpy(&routine_->code[position], &target, sizeof(target));
+}
+
+size_t BytecodeCompiler::here() const { return routine_->code.size(); }
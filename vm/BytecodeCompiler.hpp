@@ -0,0 +1,78 @@
+#ifndef CC_PROJECT_BYTECODECOMPILER_HPP
+#define CC_PROJECT_BYTECODECOMPILER_HPP
+
+#include "semantic_analyzer/ControlTable.hpp"
+#include "vm/Bytecode.hpp"
+#include <map>
+
+// Translation of an analysed program to bytecode.
+// Variables keep the frame slots the analyzer gave them; the compiler adds
+// slots for loop bounds and for aggregates returned by calls. Expressions
+// convert their operands to the type the analyzer annotated, so the code
+// computes what constant folding would.
+class BytecodeCompiler {
+public:
+  BytecodeCompiler(const ControlTable &table, std::ostream &err);
+  ~BytecodeCompiler() = default;
+
+  // Compile the global declarations and the routines reachable from
+  // entries, or every routine when entries is empty. The bodies must have
+  // been checked by the analyzer
+  bool compile(CNode *program, const std::vector<std::string> &entries,
+               Program &result);
+
+private:
+  // id of the routine in the program, queued for compilation when new
+  int request(const std::string &name);
+  bool routine(const std::string &name, CNode *body, Routine &result);
+
+  bool block(CNode *body);
+  bool statement(CNode *node);
+  bool declaration(CNode *node);
+  bool assignment(CNode *node);
+  bool forLoop(CNode *node);
+  bool call(CNode *node, bool used);
+
+  // push the value of node; aggregates push their address
+  bool expression(CNode *node, Primitive &type);
+  // push the value of node converted to type
+  bool value(CNode *node, Primitive type);
+  bool binary(CNode *node, Primitive type);
+  bool convert(Primitive from, Primitive to);
+  // push the address of an array item, a record field or an aggregate
+  bool address(CNode *node);
+  // step from the address of the base of node to node itself
+  bool selector(CNode *node);
+  // step from the address of a record to a chain of selectors such as
+  // b[i].c, which starts with a field of the record
+  bool member(CNode *node, const std::shared_ptr<TypeNode> &record);
+  bool variable(CNode *node, bool store);
+
+  // -1 for primitive types
+  bool shape(const std::shared_ptr<TypeNode> &type, int &result);
+  bool image(const std::shared_ptr<TypeNode> &type, uint8_t *bytes);
+  Primitive primitive(const std::shared_ptr<TypeNode> &type) const;
+  // type of the value an expression computes
+  Primitive typeOf(const CNode *node) const;
+  int constant(const ConstantValue &value);
+  int hiddenSlot();
+
+  void emit(Opcode opcode, int effect);
+  void operand(int32_t value);
+  // position of the operand to patch with the jump target
+  size_t jump(Opcode opcode);
+  void patch(size_t position);
+  size_t here() const;
+
+  const ControlTable &table_;
+  std::ostream *err_;
+  Program *program_ = nullptr;
+  Routine *routine_ = nullptr;
+  int depth_ = 0;
+  std::unordered_map<std::string, CNode *> bodies_;
+  std::vector<std::string> queue_;
+  std::unordered_map<const TypeNode *, int> shapes_;
+  std::map<std::pair<int, int64_t>, int> constants_;
+};
+
+#endif // CC_PROJECT_BYTECODECOMPILER_HPP
@@ -0,0 +1,1131 @@
+#include "vm/JitVM.hpp"
+#include "vm/LinearScan.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#ifdef CC_PROJECT_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr size_t kRegisterCount = 1 << 20;
+// machine stack native calls may use below the frame of run
+constexpr uintptr_t kNativeStack = 4 << 20;
+
+int64_t wrapNegate(int64_t value) { return (int64_t)(0 - (uint64_t)value); }
+
+#ifdef CC_PROJECT_JIT
+
+enum Reg {
+  Rax = 0,
+  Rcx = 1,
+  Rdx = 2,
+  Rbx = 3,
+  Rsp = 4,
+  Rbp = 5,
+  Rsi = 6,
+  Rdi = 7,
+  R8 = 8,
+  R9 = 9,
+  R10 = 10,
+  R11 = 11,
+  R12 = 12,
+  R13 = 13,
+  R14 = 14,
+  R15 = 15
+};
+
+// condition codes of jcc and setcc
+enum Condition {
+  Below = 0x2,
+  AboveEqual = 0x3,
+  Equal = 0x4,
+  NotEqual = 0x5,
+  BelowEqual = 0x6,
+  Above = 0x7,
+  Parity = 0xA,
+  NoParity = 0xB,
+  Less = 0xC,
+  GreaterEqual = 0xD,
+  LessEqual = 0xE,
+  Greater = 0xF
+};
+constexpr int kAlways = -1;
+
+// Encoder for the few x86-64 instruction forms the generator needs; xmm
+// registers are numbered like the general purpose ones
+class Assembler {
+public:
+  std::vector<uint8_t> code;
+
+  size_t size() const { return code.size(); }
+  void byte(uint8_t value) { code.push_back(value); }
+  void int32(int32_t value) { append(&value, sizeof(value)); }
+  void int64(int64_t value) { append(&value, sizeof(value)); }
+
+  // opcode with a register, or opcode extension, and [base + offset]
+  void memory(std::initializer_list<uint8_t> opcode, int reg, int base,
+              int32_t offset, bool wide = true, uint8_t prefix = 0) {
+    start(opcode, reg, base, wide, prefix);
+    int mode = offset == 0 && (base & 7) != Rbp ? 0
+               : offset == (int8_t)offset       ? 1
+                                                : 2;
+    byte((uint8_t)(mode << 6 | (reg & 7) << 3 | (base & 7)));
+    if ((base & 7) == Rsp)
+      byte(0x24);
+    if (mode == 1)
+      byte((uint8_t)offset);
+    else if (mode == 2)
+      int32(offset);
+  }
+  // opcode with a register, or opcode extension, and register rm
+  void registers(std::initializer_list<uint8_t> opcode, int reg, int rm,
+                 bool wide = true, uint8_t prefix = 0) {
+    start(opcode, reg, rm, wide, prefix);
+    byte((uint8_t)(0xC0 | (reg & 7) << 3 | (rm & 7)));
+  }
+  void load(int reg, int base, int32_t offset) {
+    memory({0x8B}, reg, base, offset);
+  }
+  void store(int base, int32_t offset, int reg) {
+    memory({0x89}, reg, base, offset);
+  }
+  void move(int target, int source) { registers({0x89}, source, target); }
+  void immediate(int reg, int64_t value) {
+    if (value == (int32_t)value) {
+      registers({0xC7}, 0, reg);
+      int32((int32_t)value);
+      return;
+    }
+    byte((uint8_t)(0x48 | reg >> 3));
+    byte((uint8_t)(0xB8 + (reg & 7)));
+    int64(value);
+  }
+  void push(int reg) {
+    if (reg & 8)
+      byte(0x41);
+    byte((uint8_t)(0x50 + (reg & 7)));
+  }
+  void pop(int reg) {
+    if (reg & 8)
+      byte(0x41);
+    byte((uint8_t)(0x58 + (reg & 7)));
+  }
+  void callAbsolute(const void *function) {
+    immediate(Rax, (int64_t)(uintptr_t)function);
+    registers({0xFF}, 2, Rax, false);
+  }
+  // al := condition, zero extended into rax
+  void set(int condition, int reg = Rax) {
+    registers({0x0F, (uint8_t)(0x90 + condition)}, 0, reg, false);
+  }
+  // jump, unless kAlways only when the condition holds; returns where
+  // its displacement is for patch
+  size_t jump(int condition) {
+    if (condition == kAlways) {
+      byte(0xE9);
+    } else {
+      byte(0x0F);
+      byte((uint8_t)(0x80 + condition));
+    }
+    int32(0);
+    return size() - 4;
+  }
+  size_t call() {
+    byte(0xE8);
+    int32(0);
+    return size() - 4;
+  }
+  void patch(size_t at, size_t target) {
+    int32_t displacement = (int32_t)((int64_t)target - (int64_t)(at + 4));
+    std::memcpy(code.data() + at, &displacement, sizeof(displacement));
+  }
+
+private:
+  void append(const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    code.insert(code.end(), bytes, bytes + size);
+  }
+  void start(std::initializer_list<uint8_t> opcode, int reg, int rm,
+             bool wide, uint8_t prefix) {
+    if (prefix != 0)
+      byte(prefix);
+    uint8_t rex = (uint8_t)(0x40 | (wide ? 8 : 0) | (reg & 8 ? 4 : 0) |
+                            (rm & 8 ? 1 : 0));
+    if (rex != 0x40)
+      byte(rex);
+    for (uint8_t value : opcode)
+      byte(value);
+  }
+};
+
+// where the generated code finds the runtime
+struct Runtime {
+  const void *slow_path;
+  const void *enter_frame;
+  const void *leave_frame;
+  const void *keep_result;
+  int32_t globals;
+  int32_t limit;
+  int32_t stack_limit;
+};
+
+// machine registers of the allocation: homes from kXmm on are xmm
+// registers. rax, rcx, rdx, rsi, rdi and xmm0-2 stay free for the
+// instruction sequences
+constexpr int kXmm = 16;
+const RegisterFile kGeneralRegisters = {{Rbp, R14, R15}, {R8, R9, R10, R11}};
+const RegisterFile kXmmRegisters = {
+    {},
+    {kXmm + 3, kXmm + 4, kXmm + 5, kXmm + 6, kXmm + 7, kXmm + 8, kXmm + 9,
+     kXmm + 10, kXmm + 11, kXmm + 12, kXmm + 13, kXmm + 14, kXmm + 15}};
+
+bool preserved(int home) { return home == Rbp || home == R14 || home == R15; }
+
+CallKind callKind(RegisterOpcode opcode) {
+  switch (opcode) {
+  case RegisterOpcode::Index:
+  case RegisterOpcode::DivInt:
+  case RegisterOpcode::ModInt:
+  case RegisterOpcode::DivReal:
+  case RegisterOpcode::IntToBool:
+    return CallKind::OutOfLine;
+  case RegisterOpcode::Call:
+  case RegisterOpcode::Allocate:
+  case RegisterOpcode::AllocateGlobal:
+  case RegisterOpcode::Copy:
+  case RegisterOpcode::RealToInt:
+  case RegisterOpcode::MissingReturn:
+    return CallKind::Inline;
+  default:
+    return CallKind::None;
+  }
+}
+
+// Generates one function per routine. rbx holds the registers of the
+// frame, r12 the context and r13 the globals. Registers of the routine
+// live in the machine registers linear scan gives them, the others in
+// their frame slots; instructions work through rax, rcx, rdx and xmm0-2.
+// Calls read and write frame slots, so the operands of an instruction
+// that calls out are spilled to them before and its results reloaded
+// after, as are the registers calls clobber that live across it
+class Generator {
+public:
+  Generator(const RegisterProgram &program, const Runtime &runtime)
+      : program_(program), runtime_(runtime) {}
+
+  void routine(int index, const RegisterRoutine &routine);
+  // link the calls; returns the machine code
+  std::vector<uint8_t> finish();
+  const std::vector<size_t> &entries() const { return entries_; }
+  const std::vector<JitVM::Allocation> &allocations() const {
+    return allocations_;
+  }
+
+private:
+  // out of line call of the slow path for instruction, then resume after it
+  struct Stub {
+    size_t instruction;
+    std::vector<size_t> jumps;
+  };
+
+  void instruction(size_t index);
+  void index(size_t index);
+  void compareReal(const Instruction &instruction, Condition condition);
+  void slowCall(size_t index);
+  void failUnlessZero();
+  void stub(size_t jump, size_t index);
+  void epilogue();
+
+  int home(int reg) const { return allocation_.homes[reg]; }
+  // the value of reg into a general purpose or an xmm machine register,
+  // and back
+  void get(int machine, int reg);
+  void put(int reg, int machine);
+  void getReal(int xmm, int reg);
+  void putReal(int reg, int xmm);
+  // an instruction of machine and reg, in the form with an operand in
+  // memory or in a general purpose register
+  void operand(std::initializer_list<uint8_t> opcode, int machine, int reg);
+  void realOperand(std::initializer_list<uint8_t> opcode, uint8_t prefix,
+                   int xmm, int reg);
+  // between the machine register of reg and its frame slot
+  void spill(int reg);
+  void reload(int reg);
+  void beforeCall(size_t index);
+  void afterCall(size_t index);
+
+  const RegisterProgram &program_;
+  const Runtime &runtime_;
+  Assembler assembler_;
+  std::vector<size_t> entries_;
+  std::vector<JitVM::Allocation> allocations_;
+  // displacement of each call and the routine it calls
+  std::vector<std::pair<size_t, int>> calls_;
+
+  // state of the routine being generated
+  int index_ = 0;
+  const RegisterRoutine *routine_ = nullptr;
+  RegisterAllocation allocation_;
+  // machine registers the prologue pushes
+  std::vector<int> saved_;
+  std::vector<std::pair<size_t, int>> jumps_;
+  std::vector<Stub> stubs_;
+  std::vector<size_t> failures_;
+  int spills_ = 0;
+  int reloads_ = 0;
+};
+
+int32_t offset(int reg) { return reg * (int32_t)sizeof(Value); }
+
+void Generator::routine(int index, const RegisterRoutine &routine) {
+  Assembler &a = assembler_;
+  index_ = index;
+  routine_ = &routine;
+  jumps_.clear();
+  stubs_.clear();
+  failures_.clear();
+  spills_ = 0;
+  reloads_ = 0;
+  entries_.push_back(a.size());
+  std::vector<CallKind> calls;
+  for (const Instruction &instruction : routine.code)
+    calls.push_back(callKind(instruction.opcode));
+  allocation_ = allocateRegisters(program_, routine, calls,
+                                  kGeneralRegisters, kXmmRegisters);
+
+  // the preserved registers the allocation uses are saved with those of
+  // the generator; an odd number of pushes after the return address keeps
+  // calls 16 byte aligned
+  saved_ = {Rbx, R12, R13};
+  for (int machine : kGeneralRegisters.preserved) {
+    if (std::find(allocation_.homes.begin(), allocation_.homes.end(),
+                  machine) != allocation_.homes.end())
+      saved_.push_back(machine);
+  }
+  for (int machine : saved_)
+    a.push(machine);
+  if (saved_.size() % 2 == 0) {
+    a.registers({0x83}, 5, Rsp); // sub rsp, 8
+    a.byte(8);
+  }
+  a.move(Rbx, Rdi);
+  a.move(R12, Rsi);
+  a.load(R13, R12, runtime_.globals);
+  for (size_t i = 0; i < routine.constants.size(); i++) {
+    if (home(routine.constant_base + (int)i) != RegisterAllocation::kMemory)
+      continue;
+    a.immediate(Rax, routine.constants[i].integer);
+    a.store(Rbx, offset(routine.constant_base + (int)i), Rax);
+  }
+  if (routine.aggregates) {
+    a.move(Rdi, R12);
+    a.byte(0xBE); // mov esi, index
+    a.int32(index);
+    a.move(Rdx, Rbx);
+    a.callAbsolute(runtime_.enter_frame);
+  }
+  // constants in machine registers reach their frame slots only when
+  // something reads them there
+  for (size_t i = 0; i < routine.constants.size(); i++) {
+    int reg = routine.constant_base + (int)i;
+    if (home(reg) == RegisterAllocation::kMemory)
+      continue;
+    if (home(reg) >= kXmm) {
+      a.immediate(Rax, routine.constants[i].integer);
+      put(reg, Rax);
+    } else {
+      a.immediate(home(reg), routine.constants[i].integer);
+    }
+  }
+  for (int reg : allocation_.live_in) {
+    if (reg < routine.constant_base ||
+        reg >= routine.constant_base + (int)routine.constants.size())
+      reload(reg);
+  }
+
+  std::vector<size_t> starts;
+  for (size_t i = 0; i < routine.code.size(); i++) {
+    starts.push_back(a.size());
+    instruction(i);
+  }
+  starts.push_back(a.size());
+  for (const auto &jump : jumps_)
+    a.patch(jump.first, starts[jump.second]);
+  for (const Stub &stub : stubs_) {
+    for (size_t jump : stub.jumps)
+      a.patch(jump, a.size());
+    // a call has saved its registers before its checks
+    bool call = routine.code[stub.instruction].opcode == RegisterOpcode::Call;
+    if (!call)
+      beforeCall(stub.instruction);
+    slowCall(stub.instruction);
+    failUnlessZero();
+    if (!call)
+      afterCall(stub.instruction);
+    a.patch(a.jump(kAlways), starts[stub.instruction + 1]);
+  }
+  for (size_t failure : failures_)
+    a.patch(failure, a.size());
+  a.byte(0xB8); // mov eax, 1
+  a.int32(1);
+  epilogue();
+  allocations_.push_back({routine.name, allocation_.general, allocation_.xmm,
+                          allocation_.memory, spills_, reloads_});
+}
+
+std::vector<uint8_t> Generator::finish() {
+  for (const auto &call : calls_)
+    assembler_.patch(call.first, entries_[call.second]);
+  return std::move(assembler_.code);
+}
+
+void Generator::epilogue() {
+  if (saved_.size() % 2 == 0) {
+    assembler_.registers({0x83}, 0, Rsp); // add rsp, 8
+    assembler_.byte(8);
+  }
+  for (size_t i = saved_.size(); i-- > 0;)
+    assembler_.pop(saved_[i]);
+  assembler_.byte(0xC3);
+}
+
+void Generator::get(int machine, int reg) {
+  int from = home(reg);
+  if (from == RegisterAllocation::kMemory)
+    assembler_.load(machine, Rbx, offset(reg));
+  else if (from >= kXmm) // movq machine, xmm
+    assembler_.registers({0x0F, 0x7E}, from - kXmm, machine, true, 0x66);
+  else if (from != machine)
+    assembler_.move(machine, from);
+}
+
+void Generator::put(int reg, int machine) {
+  int to = home(reg);
+  if (to == RegisterAllocation::kMemory)
+    assembler_.store(Rbx, offset(reg), machine);
+  else if (to >= kXmm) // movq xmm, machine
+    assembler_.registers({0x0F, 0x6E}, to - kXmm, machine, true, 0x66);
+  else if (to != machine)
+    assembler_.move(to, machine);
+}
+
+void Generator::getReal(int xmm, int reg) {
+  int from = home(reg);
+  if (from == RegisterAllocation::kMemory)
+    assembler_.memory({0x0F, 0x10}, xmm, Rbx, offset(reg), false, 0xF2);
+  else if (from < kXmm) // movq xmm, from
+    assembler_.registers({0x0F, 0x6E}, xmm, from, true, 0x66);
+  else if (from - kXmm != xmm) // movapd
+    assembler_.registers({0x0F, 0x28}, xmm, from - kXmm, false, 0x66);
+}
+
+void Generator::putReal(int reg, int xmm) {
+  int to = home(reg);
+  if (to == RegisterAllocation::kMemory)
+    assembler_.memory({0x0F, 0x11}, xmm, Rbx, offset(reg), false, 0xF2);
+  else if (to < kXmm) // movq to, xmm
+    assembler_.registers({0x0F, 0x7E}, xmm, to, true, 0x66);
+  else if (to - kXmm != xmm)
+    assembler_.registers({0x0F, 0x28}, to - kXmm, xmm, false, 0x66);
+}
+
+void Generator::operand(std::initializer_list<uint8_t> opcode, int machine,
+                        int reg) {
+  int from = home(reg);
+  if (from == RegisterAllocation::kMemory) {
+    assembler_.memory(opcode, machine, Rbx, offset(reg));
+    return;
+  }
+  if (from >= kXmm) {
+    get(Rcx, reg);
+    from = Rcx;
+  }
+  assembler_.registers(opcode, machine, from);
+}
+
+void Generator::realOperand(std::initializer_list<uint8_t> opcode,
+                            uint8_t prefix, int xmm, int reg) {
+  int from = home(reg);
+  if (from == RegisterAllocation::kMemory) {
+    assembler_.memory(opcode, xmm, Rbx, offset(reg), false, prefix);
+    return;
+  }
+  if (from < kXmm) {
+    getReal(2, reg);
+    from = kXmm + 2;
+  }
+  assembler_.registers(opcode, xmm, from - kXmm, false, prefix);
+}
+
+void Generator::spill(int reg) {
+  int from = home(reg);
+  if (from == RegisterAllocation::kMemory)
+    return;
+  if (from >= kXmm)
+    assembler_.memory({0x0F, 0x11}, from - kXmm, Rbx, offset(reg), false,
+                      0xF2);
+  else
+    assembler_.store(Rbx, offset(reg), from);
+  spills_++;
+}
+
+void Generator::reload(int reg) {
+  int to = home(reg);
+  if (to == RegisterAllocation::kMemory)
+    return;
+  if (to >= kXmm)
+    assembler_.memory({0x0F, 0x10}, to - kXmm, Rbx, offset(reg), false,
+                      0xF2);
+  else
+    assembler_.load(to, Rbx, offset(reg));
+  reloads_++;
+}
+
+void Generator::beforeCall(size_t index) {
+  std::vector<int> uses, defs;
+  registerOperands(program_, routine_->code[index], uses, defs);
+  for (int reg : allocation_.live_across[index]) {
+    if (!preserved(home(reg)))
+      uses.push_back(reg);
+  }
+  std::sort(uses.begin(), uses.end());
+  uses.erase(std::unique(uses.begin(), uses.end()), uses.end());
+  for (int reg : uses)
+    spill(reg);
+}
+
+void Generator::afterCall(size_t index) {
+  std::vector<int> uses, defs;
+  registerOperands(program_, routine_->code[index], uses, defs);
+  for (int reg : allocation_.live_across[index]) {
+    if (!preserved(home(reg)))
+      reload(reg);
+  }
+  for (int reg : defs)
+    reload(reg);
+}
+
+void Generator::slowCall(size_t index) {
+  Assembler &a = assembler_;
+  a.move(Rdi, R12);
+  a.move(Rsi, Rbx);
+  a.byte(0xBA); // mov edx, routine
+  a.int32(index_);
+  a.immediate(Rcx, (int64_t)(uintptr_t)&routine_->code[index]);
+  a.callAbsolute(runtime_.slow_path);
+}
+
+void Generator::failUnlessZero() {
+  assembler_.registers({0x85}, Rax, Rax, false);
+  failures_.push_back(assembler_.jump(NotEqual));
+}
+
+void Generator::stub(size_t jump, size_t index) {
+  if (stubs_.empty() || stubs_.back().instruction != index)
+    stubs_.push_back({index, {}});
+  stubs_.back().jumps.push_back(jump);
+}
+
+void Generator::index(size_t index) {
+  Assembler &a = assembler_;
+  const Instruction &instruction = routine_->code[index];
+  const Shape &shape = program_.shapes[instruction.d];
+  get(Rax, instruction.b);
+  get(Rdx, instruction.c);
+  if (shape.length < 0) {
+    a.load(Rcx, Rax, 0);
+    a.registers({0x83}, 0, Rax); // add rax, 8
+    a.byte(sizeof(int64_t));
+  } else {
+    a.immediate(Rcx, shape.length);
+  }
+  if (instruction.opcode == RegisterOpcode::Index) {
+    // index - 1 below the length as unsigned covers both bounds
+    a.memory({0x8D}, Rsi, Rdx, -1);
+    a.registers({0x3B}, Rsi, Rcx);
+    stub(a.jump(AboveEqual), index);
+  }
+  a.registers({0x69}, Rdx, Rdx); // imul rdx, rdx, item size
+  a.int32((int32_t)shape.item_size);
+  a.registers({0x03}, Rax, Rdx);
+  a.registers({0x81}, 0, Rax);
+  a.int32(-(int32_t)shape.item_size);
+  put(instruction.a, Rax);
+}
+
+void Generator::compareReal(const Instruction &instruction,
+                            Condition condition) {
+  Assembler &a = assembler_;
+  int left = instruction.b, right = instruction.c;
+  // below is true for unordered operands, so compare the other way round
+  if (condition == Below || condition == BelowEqual) {
+    std::swap(left, right);
+    condition = condition == Below ? Above : AboveEqual;
+  }
+  getReal(0, left);
+  realOperand({0x0F, 0x2E}, 0x66, 0, right);
+  if (condition == Equal || condition == NotEqual) {
+    bool equal = condition == Equal;
+    a.set(condition, Rax);
+    a.set(equal ? NoParity : Parity, Rcx);
+    a.registers({(uint8_t)(equal ? 0x20 : 0x08)}, Rcx, Rax, false);
+  } else {
+    a.set(condition, Rax);
+  }
+  a.registers({0x0F, 0xB6}, Rax, Rax, false);
+  put(instruction.a, Rax);
+}
+
+void Generator::instruction(size_t index) {
+  Assembler &a = assembler_;
+  const Instruction &instruction = routine_->code[index];
+  int32_t ra = offset(instruction.a), rb = offset(instruction.b);
+  auto binary = [&](std::initializer_list<uint8_t> opcode) {
+    get(Rax, instruction.b);
+    operand(opcode, Rax, instruction.c);
+    put(instruction.a, Rax);
+  };
+  auto real = [&](uint8_t opcode) {
+    getReal(0, instruction.b);
+    realOperand({0x0F, opcode}, 0xF2, 0, instruction.c);
+    putReal(instruction.a, 0);
+  };
+  auto compare = [&](Condition condition) {
+    get(Rax, instruction.b);
+    operand({0x3B}, Rax, instruction.c);
+    a.set(condition);
+    a.registers({0x0F, 0xB6}, Rax, Rax, false);
+    put(instruction.a, Rax);
+  };
+  auto jumpUnless = [&](Condition otherwise) {
+    get(Rax, instruction.b);
+    operand({0x3B}, Rax, instruction.c);
+    jumps_.push_back({a.jump(otherwise), instruction.a});
+  };
+
+  switch (instruction.opcode) {
+  case RegisterOpcode::Move:
+    if (home(instruction.a) >= kXmm) {
+      getReal(home(instruction.a) - kXmm, instruction.b);
+    } else if (home(instruction.a) != RegisterAllocation::kMemory) {
+      get(home(instruction.a), instruction.b);
+    } else if (home(instruction.b) >= kXmm) {
+      putReal(instruction.a, home(instruction.b) - kXmm);
+    } else if (home(instruction.b) != RegisterAllocation::kMemory) {
+      put(instruction.a, home(instruction.b));
+    } else {
+      a.load(Rax, Rbx, rb);
+      a.store(Rbx, ra, Rax);
+    }
+    break;
+  case RegisterOpcode::LoadGlobal:
+    a.load(Rax, R13, rb);
+    put(instruction.a, Rax);
+    break;
+  case RegisterOpcode::StoreGlobal:
+    get(Rax, instruction.b);
+    a.store(R13, ra, Rax);
+    break;
+  case RegisterOpcode::Field:
+    get(Rax, instruction.b);
+    a.registers({0x81}, 0, Rax);
+    a.int32(instruction.c);
+    put(instruction.a, Rax);
+    break;
+  case RegisterOpcode::Index:
+  case RegisterOpcode::IndexUnchecked:
+    this->index(index);
+    break;
+  case RegisterOpcode::Length: {
+    const Shape &shape = program_.shapes[instruction.c];
+    if (shape.length >= 0) {
+      a.immediate(Rax, shape.length);
+    } else {
+      get(Rax, instruction.b);
+      a.load(Rax, Rax, 0);
+    }
+    put(instruction.a, Rax);
+    break;
+  }
+  case RegisterOpcode::LoadInt:
+  case RegisterOpcode::LoadReal:
+    get(Rax, instruction.b);
+    a.load(Rax, Rax, 0);
+    put(instruction.a, Rax);
+    break;
+  case RegisterOpcode::LoadBool:
+    get(Rax, instruction.b);
+    a.memory({0x0F, 0xB6}, Rax, Rax, 0, false);
+    put(instruction.a, Rax);
+    break;
+  case RegisterOpcode::StoreInt:
+  case RegisterOpcode::StoreReal:
+    get(Rax, instruction.a);
+    get(Rcx, instruction.b);
+    a.store(Rax, 0, Rcx);
+    break;
+  case RegisterOpcode::StoreBool:
+    get(Rax, instruction.a);
+    get(Rcx, instruction.b);
+    a.memory({0x88}, Rcx, Rax, 0, false);
+    break;
+  case RegisterOpcode::AddInt:
+    binary({0x03});
+    break;
+  case RegisterOpcode::SubInt:
+    binary({0x2B});
+    break;
+  case RegisterOpcode::MulInt:
+    binary({0x0F, 0xAF});
+    break;
+  case RegisterOpcode::And:
+    binary({0x23});
+    break;
+  case RegisterOpcode::Or:
+    binary({0x0B});
+    break;
+  case RegisterOpcode::Xor:
+    binary({0x33});
+    break;
+  case RegisterOpcode::DivInt:
+  case RegisterOpcode::ModInt:
+    // zero fails and -1 would trap on the smallest integer
+    get(Rcx, instruction.c);
+    a.registers({0x85}, Rcx, Rcx);
+    stub(a.jump(Equal), index);
+    a.registers({0x83}, 7, Rcx); // cmp rcx, -1
+    a.byte(0xFF);
+    stub(a.jump(Equal), index);
+    get(Rax, instruction.b);
+    a.byte(0x48); // cqo
+    a.byte(0x99);
+    a.registers({0xF7}, 7, Rcx);
+    put(instruction.a,
+        instruction.opcode == RegisterOpcode::DivInt ? Rax : Rdx);
+    break;
+  case RegisterOpcode::DivIntUnchecked:
+  case RegisterOpcode::ModIntUnchecked:
+    get(Rcx, instruction.c);
+    get(Rax, instruction.b);
+    a.byte(0x48); // cqo
+    a.byte(0x99);
+    a.registers({0xF7}, 7, Rcx);
+    put(instruction.a,
+        instruction.opcode == RegisterOpcode::DivIntUnchecked ? Rax : Rdx);
+    break;
+  case RegisterOpcode::AddReal:
+    real(0x58);
+    break;
+  case RegisterOpcode::SubReal:
+    real(0x5C);
+    break;
+  case RegisterOpcode::MulReal:
+    real(0x59);
+    break;
+  case RegisterOpcode::DivReal:
+    // zero and NaN divisors take the slow path
+    getReal(1, instruction.c);
+    a.registers({0x0F, 0x57}, 2, 2, false, 0x66);
+    a.registers({0x0F, 0x2E}, 1, 2, false, 0x66);
+    stub(a.jump(Equal), index);
+    getReal(0, instruction.b);
+    a.registers({0x0F, 0x5E}, 0, 1, false, 0xF2);
+    putReal(instruction.a, 0);
+    break;
+  case RegisterOpcode::NegInt:
+    get(Rax, instruction.b);
+    a.registers({0xF7}, 3, Rax);
+    put(instruction.a, Rax);
+    break;
+  case RegisterOpcode::NegReal:
+    get(Rax, instruction.b);
+    a.immediate(Rcx, INT64_MIN);
+    a.registers({0x33}, Rax, Rcx);
+    put(instruction.a, Rax);
+    break;
+  case RegisterOpcode::LessInt:
+    compare(Less);
+    break;
+  case RegisterOpcode::LessEqInt:
+    compare(LessEqual);
+    break;
+  case RegisterOpcode::GreaterInt:
+    compare(Greater);
+    break;
+  case RegisterOpcode::GreaterEqInt:
+    compare(GreaterEqual);
+    break;
+  case RegisterOpcode::EqualInt:
+    compare(Equal);
+    break;
+  case RegisterOpcode::NotEqualInt:
+    compare(NotEqual);
+    break;
+  case RegisterOpcode::LessReal:
+    compareReal(instruction, Below);
+    break;
+  case RegisterOpcode::LessEqReal:
+    compareReal(instruction, BelowEqual);
+    break;
+  case RegisterOpcode::GreaterReal:
+    compareReal(instruction, Above);
+    break;
+  case RegisterOpcode::GreaterEqReal:
+    compareReal(instruction, AboveEqual);
+    break;
+  case RegisterOpcode::EqualReal:
+    compareReal(instruction, Equal);
+    break;
+  case RegisterOpcode::NotEqualReal:
+    compareReal(instruction, NotEqual);
+    break;
+  case RegisterOpcode::Not:
+    get(Rax, instruction.b);
+    a.registers({0x83}, 6, Rax); // xor rax, 1
+    a.byte(1);
+    put(instruction.a, Rax);
+    break;
+  case RegisterOpcode::IntToReal:
+    get(Rax, instruction.b);
+    a.registers({0x0F, 0x2A}, 0, Rax, true, 0xF2);
+    putReal(instruction.a, 0);
+    break;
+  case RegisterOpcode::IntToBool:
+    get(Rax, instruction.b);
+    a.registers({0x83}, 7, Rax); // cmp rax, 1
+    a.byte(1);
+    stub(a.jump(Above), index);
+    put(instruction.a, Rax);
+    break;
+  case RegisterOpcode::Jump:
+    jumps_.push_back({a.jump(kAlways), instruction.a});
+    break;
+  case RegisterOpcode::JumpIfFalse:
+    if (home(instruction.b) == RegisterAllocation::kMemory) {
+      a.memory({0x83}, 7, Rbx, rb); // cmp qword [b], 0
+      a.byte(0);
+    } else {
+      get(Rax, instruction.b);
+      a.registers({0x85}, Rax, Rax);
+    }
+    jumps_.push_back({a.jump(Equal), instruction.a});
+    break;
+  case RegisterOpcode::JumpUnlessLessInt:
+    jumpUnless(GreaterEqual);
+    break;
+  case RegisterOpcode::JumpUnlessLessEqInt:
+    jumpUnless(Greater);
+    break;
+  case RegisterOpcode::JumpUnlessGreaterInt:
+    jumpUnless(LessEqual);
+    break;
+  case RegisterOpcode::JumpUnlessGreaterEqInt:
+    jumpUnless(Less);
+    break;
+  case RegisterOpcode::JumpUnlessEqualInt:
+    jumpUnless(NotEqual);
+    break;
+  case RegisterOpcode::JumpUnlessNotEqualInt:
+    jumpUnless(Equal);
+    break;
+  case RegisterOpcode::Call: {
+    const RegisterRoutine &callee = program_.routines[instruction.b];
+    beforeCall(index);
+    // the slow path of a call reports the overflow of either stack
+    a.memory({0x8D}, Rdi, Rbx, ra);
+    a.memory({0x8D}, Rax, Rdi, offset(callee.frame_size));
+    a.memory({0x3B}, Rax, R12, runtime_.limit);
+    stub(a.jump(Above), index);
+    a.memory({0x3B}, Rsp, R12, runtime_.stack_limit);
+    stub(a.jump(Below), index);
+    a.move(Rsi, R12);
+    calls_.push_back({a.call(), instruction.b});
+    failUnlessZero();
+    if (instruction.c != -1) {
+      a.move(Rdi, R12);
+      a.move(Rsi, Rbx);
+      a.immediate(Rdx, (int64_t)(uintptr_t)&instruction);
+      a.callAbsolute(runtime_.keep_result);
+    }
+    afterCall(index);
+    break;
+  }
+  case RegisterOpcode::Return:
+  case RegisterOpcode::ReturnVoid:
+    if (instruction.opcode == RegisterOpcode::Return) {
+      get(Rax, instruction.a);
+      a.store(Rbx, 0, Rax);
+    }
+    if (routine_->aggregates) {
+      a.move(Rdi, R12);
+      a.callAbsolute(runtime_.leave_frame);
+    }
+    a.registers({0x31}, Rax, Rax, false); // xor eax, eax
+    epilogue();
+    break;
+  default:
+    // allocation, copies, real to integer conversion and missing returns
+    beforeCall(index);
+    slowCall(index);
+    failUnlessZero();
+    afterCall(index);
+    break;
+  }
+}
+
+#endif // CC_PROJECT_JIT
+
+} // namespace
+
+JitVM::JitVM(const RegisterProgram &program, std::ostream &err)
+    : program_(program), err_(&err) {
+  if (compile())
+    registers_.resize(kRegisterCount);
+  else
+    interpreter_.reset(new RegisterVM(program, err));
+}
+
+JitVM::~JitVM() {
+#ifdef CC_PROJECT_JIT
+  if (code_ != nullptr)
+    munmap(code_, code_size_);
+#endif
+}
+
+uint64_t JitVM::executed() const {
+  return interpreter_ ? interpreter_->executed() : 0;
+}
+
+bool JitVM::native() const { return code_ != nullptr; }
+
+const std::vector<JitVM::Allocation> &JitVM::allocations() const {
+  return allocations_;
+}
+
+const RegisterRoutine &JitVM::routine(int index) const {
+  return index < (int)program_.routines.size() ? program_.routines[index]
+                                               : program_.initializer;
+}
+
+bool JitVM::compile() {
+#ifdef CC_PROJECT_JIT
+  Runtime runtime{(const void *)&slowPath,
+                  (const void *)&enterFrame,
+                  (const void *)&leaveFrame,
+                  (const void *)&keepResult,
+                  (int32_t)offsetof(Context, globals),
+                  (int32_t)offsetof(Context, limit),
+                  (int32_t)offsetof(Context, stack_limit)};
+  Generator generator(program_, runtime);
+  for (size_t i = 0; i <= program_.routines.size(); i++)
+    generator.routine((int)i, routine((int)i));
+  std::vector<uint8_t> code = generator.finish();
+  allocations_ = generator.allocations();
+
+  // write the code, then make it executable and no longer writable
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t size = (code.size() + page - 1) / page * page;
+  void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED)
+    return false;
+  std::memcpy(memory, code.data(), code.size());
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, size);
+    return false;
+  }
+  code_ = static_cast<uint8_t *>(memory);
+  code_size_ = size;
+  for (size_t entry : generator.entries())
+    entries_.push_back(reinterpret_cast<Entry>(code_ + entry));
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool JitVM::run(const std::string &routine, Value &result) {
+  if (interpreter_)
+    return interpreter_->run(routine, result);
+  int entry = program_.find(routine);
+  if (entry == -1 || program_.routines[entry].parameters != 0) {
+    *err_ << "Routine " << routine
+          << " is not compiled or takes parameters" << std::endl;
+    return false;
+  }
+  globals_.assign(program_.global_frame_size, Value());
+  global_buffers_.assign(program_.global_frame_size, {});
+  frames_.resize(1);
+  depth_ = 0;
+  char here;
+  context_.globals = globals_.data();
+  context_.limit = registers_.data() + registers_.size();
+  context_.stack_limit = (uintptr_t)&here - kNativeStack;
+  context_.vm = this;
+  if (!call((int)program_.routines.size(), registers_.data()) ||
+      !call(entry, registers_.data()))
+    return false;
+  result = registers_[0];
+  return true;
+}
+
+bool JitVM::call(int index, Value *registers) {
+  if ((size_t)this->routine(index).frame_size > registers_.size())
+    return fail(index, "stack overflow") == 0;
+  return entries_[index](registers, &context_) == 0;
+}
+
+size_t JitVM::bytes(const Shape &shape, const uint8_t *value) const {
+  if (shape.length >= 0)
+    return shape.size;
+  int64_t length;
+  std::memcpy(&length, value, sizeof(length));
+  return sizeof(length) + (size_t)length * shape.item_size;
+}
+
+bool JitVM::allocate(const Shape &shape, int64_t length,
+                     std::vector<uint8_t> &buffer, Value &slot) {
+  if (shape.length >= 0) {
+    buffer.assign(shape.image.begin(), shape.image.end());
+  } else {
+    if (length < 0 ||
+        (shape.item_size != 0 && (uint64_t)length > (1ull << 40) /
+                                                         shape.item_size))
+      return false;
+    buffer.resize(sizeof(length) + (size_t)length * shape.item_size);
+    std::memcpy(buffer.data(), &length, sizeof(length));
+    for (int64_t i = 0; i < length; i++)
+      std::memcpy(buffer.data() + sizeof(length) + i * shape.item_size,
+                  shape.image.data(), shape.item_size);
+  }
+  slot.address = buffer.data();
+  return true;
+}
+
+int JitVM::fail(int routine, const std::string &message) {
+  *err_ << "Runtime error in " << this->routine(routine).name << ": "
+        << message << std::endl;
+  return 1;
+}
+
+int JitVM::slowPath(Context *context, Value *r, int routine,
+                    const Instruction *instruction) {
+  JitVM &vm = *context->vm;
+  // inlined code fails in the name of the routine it came from
+  const RegisterRoutine &code = vm.routine(routine);
+  int origin = originAt(code.origins, instruction - code.code.data());
+  if (origin != -1)
+    routine = origin;
+  int32_t a = instruction->a, b = instruction->b, c = instruction->c;
+  switch (instruction->opcode) {
+  case RegisterOpcode::Allocate:
+  case RegisterOpcode::AllocateGlobal: {
+    const Shape &shape = vm.program_.shapes[b];
+    int64_t length = c == -1 ? shape.length : r[c].integer;
+    bool global = instruction->opcode == RegisterOpcode::AllocateGlobal;
+    std::vector<uint8_t> &buffer =
+        global ? vm.global_buffers_[a] : vm.frames_[vm.depth_][a];
+    if (!vm.allocate(shape, length, buffer,
+                     global ? context->globals[a] : r[a]))
+      return vm.fail(routine, "cannot allocate array of length " +
+                                  std::to_string(length));
+    return 0;
+  }
+  case RegisterOpcode::Index: {
+    const Shape &shape = vm.program_.shapes[instruction->d];
+    int64_t index = r[c].integer;
+    uint8_t *items = r[b].address;
+    int64_t length = shape.length;
+    if (length < 0) {
+      std::memcpy(&length, items, sizeof(length));
+      items += sizeof(length);
+    }
+    if (index < 1 || index > length)
+      return vm.fail(routine, "index " + std::to_string(index) +
+                                  " is out of 1.." + std::to_string(length));
+    r[a].address = items + (index - 1) * shape.item_size;
+    return 0;
+  }
+  case RegisterOpcode::Copy: {
+    const Shape &shape = vm.program_.shapes[c];
+    size_t size = vm.bytes(shape, r[b].address);
+    if (size != vm.bytes(shape, r[a].address))
+      return vm.fail(routine, "assigned arrays differ in length");
+    std::memmove(r[a].address, r[b].address, size);
+    return 0;
+  }
+  case RegisterOpcode::DivInt:
+  case RegisterOpcode::ModInt: {
+    int64_t divisor = r[c].integer;
+    if (divisor == 0)
+      return vm.fail(routine, "division by zero");
+    if (instruction->opcode == RegisterOpcode::DivInt)
+      r[a].integer = divisor == -1 ? wrapNegate(r[b].integer)
+                                   : r[b].integer / divisor;
+    else
+      r[a].integer = divisor == -1 ? 0 : r[b].integer % divisor;
+    return 0;
+  }
+  case RegisterOpcode::DivReal:
+    if (r[c].real == 0)
+      return vm.fail(routine, "division by zero");
+    r[a].real = r[b].real / r[c].real;
+    return 0;
+  case RegisterOpcode::RealToInt: {
+    double real = r[b].real;
+    if (!(std::fabs(real) < 9.2e18))
+      return vm.fail(routine, "real does not fit integer");
+    r[a].integer = std::llround(real);
+    return 0;
+  }
+  case RegisterOpcode::IntToBool: {
+    int64_t value = r[b].integer;
+    if (value != 0 && value != 1)
+      return vm.fail(routine, "cannot convert " + std::to_string(value) +
+                                  " to boolean");
+    r[a].integer = value;
+    return 0;
+  }
+  case RegisterOpcode::Call:
+    return vm.fail(routine, "stack overflow");
+  case RegisterOpcode::MissingReturn:
+    return vm.fail(routine, "routine ends without returning a value");
+  default:
+    return vm.fail(routine, "invalid opcode");
+  }
+}
+
+void JitVM::enterFrame(Context *context, int routine, Value *r) {
+  JitVM &vm = *context->vm;
+  if (++vm.depth_ == vm.frames_.size())
+    vm.frames_.emplace_back();
+  std::vector<std::vector<uint8_t>> &buffers = vm.frames_[vm.depth_];
+  const RegisterRoutine &callee = vm.routine(routine);
+  buffers.resize(callee.frame_size);
+  for (int i = 0; i < callee.parameters; i++) {
+    if (callee.parameter_shapes[i] == -1)
+      continue;
+    const Shape &shape = vm.program_.shapes[callee.parameter_shapes[i]];
+    const uint8_t *argument = r[i].address;
+    buffers[i].assign(argument, argument + vm.bytes(shape, argument));
+    r[i].address = buffers[i].data();
+  }
+}
+
+void JitVM::leaveFrame(Context *context) { context->vm->depth_--; }
+
+void JitVM::keepResult(Context *context, Value *r,
+                       const Instruction *instruction) {
+  // the callee has left; its buffers stay intact until the next call
+  JitVM &vm = *context->vm;
+  const RegisterRoutine &callee = vm.program_.routines[instruction->b];
+  const Shape &shape = vm.program_.shapes[callee.result_shape];
+  Value &value = r[instruction->a];
+  std::vector<uint8_t> &buffer = vm.frames_[vm.depth_][instruction->c];
+  buffer.assign(value.address, value.address + vm.bytes(shape, value.address));
+  value.address = buffer.data();
+}
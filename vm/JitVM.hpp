@@ -0,0 +1,97 @@
+#ifndef CC_PROJECT_JITVM_HPP
+#define CC_PROJECT_JITVM_HPP
+
+#include "vm/RegisterVM.hpp"
+#include <memory>
+
+// Native code is generated for x86-64 with the System V calling
+// convention; on other targets JitVM interprets the register code
+#if defined(__x86_64__) && defined(__unix__)
+#define CC_PROJECT_JIT 1
+#endif
+
+// Compiles register code to machine code in memory that is writable while
+// it is generated and executable afterwards, never both. Frames are
+// windows of one register stack as in RegisterVM; linear scan keeps the
+// registers of a routine in machine registers where that pays, and the
+// rest in the frame. Each routine becomes a function
+// int (Value *frame, Context *) that returns nonzero when it failed.
+// Aggregates, conversions and failing checks call back into C++
+class JitVM {
+public:
+  // where the registers of a routine went; spills and reloads are the
+  // stores to and loads from frame slots the code has for them
+  struct Allocation {
+    std::string routine;
+    int general = 0;
+    int xmm = 0;
+    int memory = 0;
+    int spills = 0;
+    int reloads = 0;
+  };
+
+  JitVM(const RegisterProgram &program, std::ostream &err);
+  ~JitVM();
+  JitVM(const JitVM &) = delete;
+  JitVM &operator=(const JitVM &) = delete;
+
+  // Declare the globals, then run the routine, which must have no
+  // parameters. result is its return value when it returns a scalar
+  bool run(const std::string &routine, Value &result);
+
+  // instructions executed by the last run; native code does not count
+  // them, so this is 0 unless the program was interpreted
+  uint64_t executed() const;
+
+  // the program was compiled to native code
+  bool native() const;
+  // of each routine, then of the initializer, when native
+  const std::vector<Allocation> &allocations() const;
+
+private:
+  // state the native code reaches through its second argument
+  struct Context {
+    Value *globals;
+    // end of the register stack
+    Value *limit;
+    // lowest address of the machine stack calls may use
+    uintptr_t stack_limit;
+    JitVM *vm;
+  };
+  using Entry = int (*)(Value *, Context *);
+
+  bool compile();
+  const RegisterRoutine &routine(int index) const;
+  bool call(int index, Value *registers);
+  bool allocate(const Shape &shape, int64_t length,
+                std::vector<uint8_t> &buffer, Value &slot);
+  size_t bytes(const Shape &shape, const uint8_t *value) const;
+  int fail(int routine, const std::string &message);
+
+  // called from native code
+  static int slowPath(Context *context, Value *r, int routine,
+                      const Instruction *instruction);
+  static void enterFrame(Context *context, int routine, Value *r);
+  static void leaveFrame(Context *context);
+  static void keepResult(Context *context, Value *r,
+                         const Instruction *instruction);
+
+  const RegisterProgram &program_;
+  std::ostream *err_;
+  // runs the program when it could not be compiled
+  std::unique_ptr<RegisterVM> interpreter_;
+  Context context_{};
+  uint8_t *code_ = nullptr;
+  size_t code_size_ = 0;
+  // entry of each routine, then of the initializer
+  std::vector<Entry> entries_;
+  std::vector<Allocation> allocations_;
+  std::vector<Value> registers_;
+  std::vector<Value> globals_;
+  std::vector<std::vector<uint8_t>> global_buffers_;
+  // aggregate buffers of the routines that have them, innermost last
+  std::vector<std::vector<std::vector<uint8_t>>> frames_;
+  size_t depth_ = 0;
+};
+
+#endif // CC_PROJECT_JITVM_HPP
@@ -0,0 +1,445 @@
+#include "vm/LinearScan.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace {
+
+// times a loop is taken to run per entry
+const double kLoopWeight = 8;
+// nesting deeper than this weighs no more
+const int kMaxDepth = 6;
+// a preserved register is saved and restored once per call of the routine
+const double kPreservedCost = 2;
+
+bool isJump(RegisterOpcode opcode) {
+  return opcode == RegisterOpcode::Jump ||
+         opcode == RegisterOpcode::JumpIfFalse ||
+         (opcode >= RegisterOpcode::JumpUnlessLessInt &&
+          opcode <= RegisterOpcode::JumpUnlessNotEqualInt);
+}
+
+// control never reaches the next instruction
+bool endsFlow(RegisterOpcode opcode) {
+  return opcode == RegisterOpcode::Jump ||
+         opcode == RegisterOpcode::Return ||
+         opcode == RegisterOpcode::ReturnVoid ||
+         opcode == RegisterOpcode::MissingReturn;
+}
+
+enum class Kind { Neutral, Integer, Real };
+
+// what reg holds as an operand of instruction
+Kind kindOf(const Instruction &instruction, int reg) {
+  bool target = reg == instruction.a;
+  switch (instruction.opcode) {
+  case RegisterOpcode::Move:
+  case RegisterOpcode::Call:
+  case RegisterOpcode::Return:
+    return Kind::Neutral;
+  case RegisterOpcode::AddReal:
+  case RegisterOpcode::SubReal:
+  case RegisterOpcode::MulReal:
+  case RegisterOpcode::DivReal:
+  case RegisterOpcode::NegReal:
+    return Kind::Real;
+  case RegisterOpcode::LessReal:
+  case RegisterOpcode::LessEqReal:
+  case RegisterOpcode::GreaterReal:
+  case RegisterOpcode::GreaterEqReal:
+  case RegisterOpcode::EqualReal:
+  case RegisterOpcode::NotEqualReal:
+  case RegisterOpcode::RealToInt:
+    return target ? Kind::Integer : Kind::Real;
+  case RegisterOpcode::IntToReal:
+  case RegisterOpcode::LoadReal:
+    return target ? Kind::Real : Kind::Integer;
+  case RegisterOpcode::StoreReal:
+    return reg == instruction.b ? Kind::Real : Kind::Integer;
+  default:
+    return Kind::Integer;
+  }
+}
+
+// Positions where a register is live or defined, as one interval over the
+// instructions of the routine; -1 stands for its entry
+struct LiveInterval {
+  int reg = -1;
+  int start = INT_MAX;
+  int end = INT_MIN;
+  int reals = 0;
+  int integers = 0;
+  // accesses weighted by loop depth; those that go through the frame
+  // slot anyway count against keeping it in a machine register
+  double weight = 0;
+  // what saving it around the calls it lives across would cost
+  double call_cost = 0;
+
+  bool used() const { return start <= end; }
+  void extend(int position) {
+    start = std::min(start, position);
+    end = std::max(end, position);
+  }
+};
+
+struct Block {
+  int first = 0;
+  int last = 0;
+  std::vector<int> successors;
+  // registers live where it starts and ends
+  std::vector<bool> in;
+  std::vector<bool> out;
+};
+
+class Allocator {
+public:
+  Allocator(const RegisterProgram &program, const RegisterRoutine &routine,
+            const std::vector<CallKind> &calls)
+      : program_(program), routine_(routine), calls_(calls),
+        intervals_(routine.frame_size) {}
+
+  void liveness();
+  RegisterAllocation allocate(const RegisterFile &general,
+                              const RegisterFile &xmm);
+
+private:
+  void findBlocks();
+  std::vector<double> frequencies() const;
+  void scan(const RegisterFile &file, bool real,
+            RegisterAllocation &allocation) const;
+  double benefit(const LiveInterval &interval, int machine,
+                 const RegisterFile &file) const;
+
+  const RegisterProgram &program_;
+  const RegisterRoutine &routine_;
+  const std::vector<CallKind> &calls_;
+  std::vector<Block> blocks_;
+  std::vector<LiveInterval> intervals_;
+  std::vector<std::vector<int>> live_across_;
+  std::vector<int> live_in_;
+};
+
+void Allocator::findBlocks() {
+  const std::vector<Instruction> &code = routine_.code;
+  int size = (int)code.size();
+  std::vector<bool> leader(size + 1, false);
+  leader[0] = true;
+  for (int i = 0; i < size; i++) {
+    if (isJump(code[i].opcode))
+      leader[code[i].a] = true;
+    if (isJump(code[i].opcode) || endsFlow(code[i].opcode))
+      leader[i + 1] = true;
+  }
+  std::vector<int> block_of(size + 1, -1);
+  for (int i = 0; i < size; i++) {
+    if (leader[i]) {
+      blocks_.emplace_back();
+      blocks_.back().first = i;
+    }
+    blocks_.back().last = i;
+    block_of[i] = (int)blocks_.size() - 1;
+  }
+  for (Block &block : blocks_) {
+    const Instruction &last = code[block.last];
+    if (isJump(last.opcode))
+      block.successors.push_back(block_of[last.a]);
+    if (!endsFlow(last.opcode) && block.last + 1 < size)
+      block.successors.push_back(block_of[block.last + 1]);
+    block.in.assign(routine_.frame_size, false);
+    block.out.assign(routine_.frame_size, false);
+  }
+}
+
+std::vector<double> Allocator::frequencies() const {
+  // a jump back to t from i closes a loop over t..i
+  const std::vector<Instruction> &code = routine_.code;
+  std::vector<int> depth(code.size(), 0);
+  for (size_t i = 0; i < code.size(); i++) {
+    if (isJump(code[i].opcode) && (size_t)code[i].a <= i) {
+      for (size_t j = code[i].a; j <= i; j++)
+        depth[j]++;
+    }
+  }
+  std::vector<double> frequency;
+  for (int nesting : depth)
+    frequency.push_back(std::pow(kLoopWeight, std::min(nesting, kMaxDepth)));
+  return frequency;
+}
+
+void Allocator::liveness() {
+  const std::vector<Instruction> &code = routine_.code;
+  live_across_.assign(code.size(), {});
+  if (code.empty())
+    return;
+  findBlocks();
+  std::vector<int> uses, defs;
+  // registers each block reads before it writes them, and writes
+  std::vector<std::vector<bool>> reads, writes;
+  for (const Block &block : blocks_) {
+    reads.emplace_back(routine_.frame_size, false);
+    writes.emplace_back(routine_.frame_size, false);
+    for (int i = block.first; i <= block.last; i++) {
+      registerOperands(program_, code[i], uses, defs);
+      for (int reg : uses) {
+        if (!writes.back()[reg])
+          reads.back()[reg] = true;
+      }
+      for (int reg : defs)
+        writes.back()[reg] = true;
+    }
+  }
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t b = blocks_.size(); b-- > 0;) {
+      Block &block = blocks_[b];
+      for (int successor : block.successors) {
+        for (int reg = 0; reg < routine_.frame_size; reg++) {
+          if (blocks_[successor].in[reg] && !block.out[reg])
+            block.out[reg] = true;
+        }
+      }
+      for (int reg = 0; reg < routine_.frame_size; reg++) {
+        bool live = reads[b][reg] || (block.out[reg] && !writes[b][reg]);
+        if (live && !block.in[reg]) {
+          block.in[reg] = true;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  // walk each block backwards from what is live at its end
+  std::vector<double> frequency = frequencies();
+  for (size_t b = 0; b < blocks_.size(); b++) {
+    const Block &block = blocks_[b];
+    std::vector<bool> live = block.out;
+    for (int reg = 0; reg < routine_.frame_size; reg++) {
+      if (live[reg])
+        intervals_[reg].extend(block.last);
+    }
+    for (int i = block.last; i >= block.first; i--) {
+      registerOperands(program_, code[i], uses, defs);
+      // operands of a call go through the frame slots
+      double access = calls_[i] == CallKind::Inline ? -frequency[i]
+                                                    : frequency[i];
+      for (int reg : defs) {
+        live[reg] = false;
+        intervals_[reg].extend(i);
+      }
+      if (calls_[i] != CallKind::None) {
+        for (int reg = 0; reg < routine_.frame_size; reg++) {
+          if (!live[reg])
+            continue;
+          live_across_[i].push_back(reg);
+          if (calls_[i] == CallKind::Inline)
+            intervals_[reg].call_cost += 2 * frequency[i];
+        }
+      }
+      for (int reg : defs) {
+        intervals_[reg].weight += access;
+        Kind kind = kindOf(code[i], reg);
+        intervals_[reg].reals += kind == Kind::Real;
+        intervals_[reg].integers += kind == Kind::Integer;
+      }
+      for (int reg : uses) {
+        live[reg] = true;
+        intervals_[reg].extend(i);
+        intervals_[reg].weight += access;
+        Kind kind = kindOf(code[i], reg);
+        intervals_[reg].reals += kind == Kind::Real;
+        intervals_[reg].integers += kind == Kind::Integer;
+      }
+    }
+    for (int reg = 0; reg < routine_.frame_size; reg++) {
+      if (!live[reg])
+        continue;
+      intervals_[reg].extend(block.first);
+      if (b == 0) {
+        // loaded from its frame slot once on entry
+        intervals_[reg].extend(-1);
+        intervals_[reg].weight -= 1;
+        live_in_.push_back(reg);
+      }
+    }
+  }
+  for (int reg = 0; reg < routine_.frame_size; reg++)
+    intervals_[reg].reg = reg;
+}
+
+double Allocator::benefit(const LiveInterval &interval, int machine,
+                          const RegisterFile &file) const {
+  bool preserved = std::find(file.preserved.begin(), file.preserved.end(),
+                             machine) != file.preserved.end();
+  return interval.weight -
+         (preserved ? kPreservedCost : interval.call_cost);
+}
+
+void Allocator::scan(const RegisterFile &file, bool real,
+                     RegisterAllocation &allocation) const {
+  std::vector<const LiveInterval *> order;
+  for (const LiveInterval &interval : intervals_) {
+    if (interval.used() && (interval.reals > interval.integers) == real)
+      order.push_back(&interval);
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [](const LiveInterval *a, const LiveInterval *b) {
+                     return a->start < b->start;
+                   });
+  // intervals holding a machine register, and where they end
+  std::vector<std::pair<const LiveInterval *, int>> active;
+  std::vector<int> free = file.clobbered;
+  free.insert(free.end(), file.preserved.begin(), file.preserved.end());
+  for (const LiveInterval *interval : order) {
+    for (size_t i = 0; i < active.size();) {
+      if (active[i].first->end < interval->start) {
+        free.push_back(active[i].second);
+        active.erase(active.begin() + i);
+      } else {
+        i++;
+      }
+    }
+    // a free register, preserved ones first for intervals that live
+    // across calls and last for the others
+    int best = RegisterAllocation::kMemory;
+    double most = 0;
+    for (int machine : free) {
+      double gain = benefit(*interval, machine, file);
+      bool preserved =
+          std::find(file.preserved.begin(), file.preserved.end(),
+                    machine) != file.preserved.end();
+      if (gain > most || (gain == most && gain > 0 &&
+                          preserved == (interval->call_cost > 0))) {
+        best = machine;
+        most = gain;
+      }
+    }
+    if (best != RegisterAllocation::kMemory) {
+      free.erase(std::find(free.begin(), free.end(), best));
+      active.push_back({interval, best});
+      allocation.homes[interval->reg] = best;
+      continue;
+    }
+    // otherwise take the register of the active interval that gains
+    // least from it, if this one gains more
+    int victim = -1;
+    for (size_t i = 0; i < active.size(); i++) {
+      int machine = active[i].second;
+      double gain = benefit(*interval, machine, file);
+      double kept = benefit(*active[i].first, machine, file);
+      if (gain > kept &&
+          (victim == -1 ||
+           kept < benefit(*active[victim].first, active[victim].second,
+                          file)))
+        victim = (int)i;
+    }
+    if (victim == -1)
+      continue;
+    allocation.homes[active[victim].first->reg] = RegisterAllocation::kMemory;
+    allocation.homes[interval->reg] = active[victim].second;
+    active[victim].first = interval;
+  }
+}
+
+RegisterAllocation Allocator::allocate(const RegisterFile &general,
+                                       const RegisterFile &xmm) {
+  RegisterAllocation allocation;
+  allocation.homes.assign(routine_.frame_size, RegisterAllocation::kMemory);
+  scan(general, false, allocation);
+  scan(xmm, true, allocation);
+  for (const LiveInterval &interval : intervals_) {
+    if (!interval.used())
+      continue;
+    if (allocation.homes[interval.reg] == RegisterAllocation::kMemory)
+      allocation.memory++;
+    else if (interval.reals > interval.integers)
+      allocation.xmm++;
+    else
+      allocation.general++;
+  }
+  allocation.live_across = std::move(live_across_);
+  allocation.live_in = std::move(live_in_);
+  return allocation;
+}
+
+} // namespace
+
+void registerOperands(const RegisterProgram &program,
+                      const Instruction &instruction, std::vector<int> &uses,
+                      std::vector<int> &defs) {
+  uses.clear();
+  defs.clear();
+  int32_t a = instruction.a, b = instruction.b, c = instruction.c;
+  switch (instruction.opcode) {
+  case RegisterOpcode::LoadGlobal:
+    defs.push_back(a);
+    break;
+  case RegisterOpcode::StoreGlobal:
+    uses.push_back(b);
+    break;
+  case RegisterOpcode::Allocate:
+  case RegisterOpcode::AllocateGlobal:
+    if (c != -1)
+      uses.push_back(c);
+    if (instruction.opcode == RegisterOpcode::Allocate)
+      defs.push_back(a);
+    break;
+  case RegisterOpcode::Index:
+  case RegisterOpcode::IndexUnchecked:
+    uses.push_back(b);
+    uses.push_back(c);
+    defs.push_back(a);
+    break;
+  case RegisterOpcode::StoreInt:
+  case RegisterOpcode::StoreReal:
+  case RegisterOpcode::StoreBool:
+  case RegisterOpcode::Copy:
+    uses.push_back(a);
+    uses.push_back(b);
+    break;
+  case RegisterOpcode::Jump:
+  case RegisterOpcode::ReturnVoid:
+  case RegisterOpcode::MissingReturn:
+    break;
+  case RegisterOpcode::JumpIfFalse:
+    uses.push_back(b);
+    break;
+  case RegisterOpcode::Call: {
+    const RegisterRoutine &callee = program.routines[b];
+    for (int i = 0; i < callee.parameters; i++)
+      uses.push_back(a + i);
+    if (callee.returns)
+      defs.push_back(a);
+    break;
+  }
+  case RegisterOpcode::Return:
+    uses.push_back(a);
+    break;
+  default:
+    if (isJump(instruction.opcode)) {
+      uses.push_back(b);
+      uses.push_back(c);
+      break;
+    }
+    // the rest compute a from b, and from c when they are binary
+    uses.push_back(b);
+    if ((instruction.opcode >= RegisterOpcode::AddInt &&
+         instruction.opcode <= RegisterOpcode::DivReal) ||
+        (instruction.opcode >= RegisterOpcode::LessInt &&
+         instruction.opcode <= RegisterOpcode::Xor) ||
+        instruction.opcode == RegisterOpcode::DivIntUnchecked ||
+        instruction.opcode == RegisterOpcode::ModIntUnchecked)
+      uses.push_back(c);
+    defs.push_back(a);
+    break;
+  }
+}
+
+RegisterAllocation allocateRegisters(const RegisterProgram &program,
+                                     const RegisterRoutine &routine,
+                                     const std::vector<CallKind> &calls,
+                                     const RegisterFile &general,
+                                     const RegisterFile &xmm) {
+  Allocator allocator(program, routine, calls);
+  allocator.liveness();
+  return allocator.allocate(general, xmm);
+}
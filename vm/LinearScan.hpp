@@ -0,0 +1,50 @@
+#ifndef CC_PROJECT_LINEARSCAN_HPP
+#define CC_PROJECT_LINEARSCAN_HPP
+
+#include "vm/RegisterCode.hpp"
+
+// registers instruction reads and writes
+void registerOperands(const RegisterProgram &program,
+                      const Instruction &instruction, std::vector<int> &uses,
+                      std::vector<int> &defs);
+
+// How an instruction calls out of the generated code: not at all, every
+// time it runs, or only on a slow path that jumps back after it
+enum class CallKind { None, Inline, OutOfLine };
+
+// Allocatable machine registers of one class, preserved by calls or not
+struct RegisterFile {
+  std::vector<int> preserved;
+  std::vector<int> clobbered;
+};
+
+struct RegisterAllocation {
+  static constexpr int kMemory = -1;
+
+  // machine register of each register of the routine, or kMemory for
+  // those left in their frame slots
+  std::vector<int> homes;
+  // registers live across each instruction that calls out, by position
+  std::vector<std::vector<int>> live_across;
+  // registers live when the routine starts
+  std::vector<int> live_in;
+  int general = 0;
+  int xmm = 0;
+  int memory = 0;
+};
+
+// Linear scan allocation in the manner of Poletto and Sarkar. Liveness is
+// solved over the blocks of the register code and each register gets one
+// interval from the first to the last position it is live at; intervals
+// are visited by start, and when a class runs out of machine registers
+// the interval with the lowest weight goes to memory. Intervals that live
+// across calls prefer preserved registers; in clobbered ones they are
+// saved around each call, or left in memory when that costs more than
+// the accesses it saves
+RegisterAllocation allocateRegisters(const RegisterProgram &program,
+                                     const RegisterRoutine &routine,
+                                     const std::vector<CallKind> &calls,
+                                     const RegisterFile &general,
+                                     const RegisterFile &xmm);
+
+#endif // CC_PROJECT_LINEARSCAN_HPP
@@ -0,0 +1,385 @@
+#include "vm/RegisterCode.hpp"
+#include <unordered_set>
+
+namespace {
+
+const char *const kRegisterOpcodeNames[] = {
+#define CC_PROJECT_OPCODE(opcode, name) name,
+    CC_PROJECT_REGISTER_OPCODES(CC_PROJECT_OPCODE)
+#undef CC_PROJECT_OPCODE
+};
+
+// stack and register opcodes of the arithmetic, comparison and logic
+// groups come in the same order
+static_assert((int)Opcode::Xor - (int)Opcode::AddInt ==
+                  (int)RegisterOpcode::Xor - (int)RegisterOpcode::AddInt,
+              "operator opcodes must line up");
+static_assert((int)Opcode::IntToBool - (int)Opcode::Not ==
+                  (int)RegisterOpcode::IntToBool - (int)RegisterOpcode::Not,
+              "unary opcodes must line up");
+
+RegisterOpcode registerOpcode(Opcode opcode, Opcode first,
+                              RegisterOpcode first_register) {
+  return (RegisterOpcode)((int)first_register + (int)opcode - (int)first);
+}
+
+class Translator {
+public:
+  explicit Translator(const Program &program) : program_(program) {}
+
+  RegisterRoutine translate(const Routine &routine);
+
+private:
+  void scan(const Routine &routine);
+  void instruction(Opcode opcode, const uint8_t *operands);
+  Value constant(Opcode opcode, int32_t operand) const;
+  int temporary(size_t position) const { return temporaries_ + (int)position; }
+  int pop();
+  void push(int reg) { stack_.push_back(reg); }
+  // put the value of a stack position into its own register
+  void materialize(size_t position);
+  void materializeAll();
+  void materializeSlot(int slot);
+  void emit(RegisterOpcode opcode, int a, int b = 0, int c = 0, int d = 0);
+  // emit into the register of the next stack position and push it
+  void produce(RegisterOpcode opcode, int b, int c = 0, int d = 0);
+  // last instruction computed reg and nothing jumps between them
+  bool producedLast(int reg) const;
+
+  const Program &program_;
+  RegisterRoutine result_;
+  std::unordered_map<int64_t, int> constants_;
+  std::unordered_set<size_t> labels_;
+  std::unordered_map<size_t, int> targets_;
+  std::vector<int> stack_;
+  int temporaries_ = 0;
+  int produced_ = -1;
+  // routine the stack instruction being translated came from
+  int origin_ = -1;
+};
+
+RegisterRoutine Translator::translate(const Routine &routine) {
+  result_ = RegisterRoutine();
+  result_.name = routine.name;
+  result_.parameters = routine.parameters;
+  result_.parameter_shapes = routine.parameter_shapes;
+  result_.returns = routine.returns;
+  result_.result_kind = routine.result_kind;
+  result_.result_shape = routine.result_shape;
+  result_.aggregates = routine.aggregates;
+  result_.constant_base = routine.frame_size;
+  constants_.clear();
+  labels_.clear();
+  targets_.clear();
+  stack_.clear();
+  produced_ = -1;
+  origin_ = -1;
+  scan(routine);
+  temporaries_ = result_.constant_base + (int)result_.constants.size();
+  result_.frame_size = temporaries_ + routine.max_stack;
+
+  const uint8_t *code = routine.code.data();
+  for (size_t pc = 0; pc < routine.code.size();) {
+    if (labels_.count(pc) != 0) {
+      materializeAll();
+      targets_[pc] = (int)result_.code.size();
+      produced_ = -1;
+    }
+    Opcode opcode = (Opcode)code[pc];
+    origin_ = originAt(routine.origins, pc);
+    instruction(opcode, code + pc + 1);
+    pc += 1 + 4 * operandCount(opcode);
+  }
+  for (Instruction &instruction : result_.code) {
+    if (instruction.opcode == RegisterOpcode::Jump ||
+        instruction.opcode == RegisterOpcode::JumpIfFalse ||
+        (instruction.opcode >= RegisterOpcode::JumpUnlessLessInt &&
+         instruction.opcode <= RegisterOpcode::JumpUnlessNotEqualInt))
+      instruction.a = targets_[instruction.a];
+  }
+  return std::move(result_);
+}
+
+// constants get their registers before the code is translated
+void Translator::scan(const Routine &routine) {
+  const uint8_t *code = routine.code.data();
+  for (size_t pc = 0; pc < routine.code.size();) {
+    Opcode opcode = (Opcode)code[pc];
+    int32_t operand =
+        operandCount(opcode) > 0 ? readOperand(code + pc + 1) : 0;
+    if (opcode == Opcode::PushInt || opcode == Opcode::PushConst) {
+      Value value = constant(opcode, operand);
+      if (constants_.count(value.integer) == 0) {
+        constants_[value.integer] =
+            result_.constant_base + (int)result_.constants.size();
+        result_.constants.push_back(value);
+      }
+    } else if (opcode == Opcode::Jump || opcode == Opcode::JumpIfFalse) {
+      labels_.insert((size_t)operand);
+    }
+    pc += 1 + 4 * operandCount(opcode);
+  }
+}
+
+// constants with the same bits share their register
+Value Translator::constant(Opcode opcode, int32_t operand) const {
+  Value value;
+  value.integer = operand;
+  if (opcode == Opcode::PushConst) {
+    const ConstantValue &constant = program_.constants[operand];
+    if (constant.kind == ConstantValue::Real)
+      value.real = constant.real;
+    else
+      value.integer = constant.integer;
+  }
+  return value;
+}
+
+void Translator::instruction(Opcode opcode, const uint8_t *operands) {
+  int32_t first = operandCount(opcode) > 0 ? readOperand(operands) : 0;
+  int32_t second = operandCount(opcode) > 1 ? readOperand(operands + 4) : 0;
+  switch (opcode) {
+  case Opcode::PushInt:
+  case Opcode::PushConst:
+    push(constants_[constant(opcode, first).integer]);
+    return;
+  case Opcode::Pop:
+    pop();
+    return;
+  case Opcode::LoadLocal:
+    push(first);
+    return;
+  case Opcode::StoreLocal: {
+    int value = pop();
+    materializeSlot(first);
+    if (producedLast(value))
+      result_.code.back().a = first;
+    else if (value != first)
+      emit(RegisterOpcode::Move, first, value);
+    return;
+  }
+  case Opcode::LoadGlobal:
+    produce(RegisterOpcode::LoadGlobal, first);
+    return;
+  case Opcode::StoreGlobal:
+    emit(RegisterOpcode::StoreGlobal, first, pop());
+    return;
+  case Opcode::Allocate:
+  case Opcode::AllocateGlobal: {
+    int length = program_.shapes[second].length < 0 ? pop() : -1;
+    if (opcode == Opcode::Allocate)
+      materializeSlot(first);
+    emit(opcode == Opcode::Allocate ? RegisterOpcode::Allocate
+                                    : RegisterOpcode::AllocateGlobal,
+         first, second, length);
+    return;
+  }
+  case Opcode::Field:
+    produce(RegisterOpcode::Field, pop(), first);
+    return;
+  case Opcode::Index: {
+    int index = pop();
+    int base = pop();
+    produce(second != 0 ? RegisterOpcode::Index
+                        : RegisterOpcode::IndexUnchecked,
+            base, index, first);
+    return;
+  }
+  case Opcode::Length:
+    produce(RegisterOpcode::Length, pop(), first);
+    return;
+  case Opcode::LoadInt:
+  case Opcode::LoadReal:
+  case Opcode::LoadBool:
+    produce(registerOpcode(opcode, Opcode::LoadInt, RegisterOpcode::LoadInt),
+            pop());
+    return;
+  case Opcode::StoreInt:
+  case Opcode::StoreReal:
+  case Opcode::StoreBool: {
+    int address = pop();
+    int value = pop();
+    emit(registerOpcode(opcode, Opcode::StoreInt, RegisterOpcode::StoreInt),
+         address, value);
+    return;
+  }
+  case Opcode::Copy: {
+    int target = pop();
+    int source = pop();
+    emit(RegisterOpcode::Copy, target, source, first);
+    return;
+  }
+  case Opcode::NegInt:
+  case Opcode::NegReal:
+  case Opcode::Not:
+  case Opcode::IntToReal:
+  case Opcode::RealToInt:
+  case Opcode::IntToBool:
+    produce(opcode == Opcode::NegInt || opcode == Opcode::NegReal
+                ? registerOpcode(opcode, Opcode::NegInt, RegisterOpcode::NegInt)
+                : registerOpcode(opcode, Opcode::Not, RegisterOpcode::Not),
+            pop());
+    return;
+  case Opcode::Jump:
+    materializeAll();
+    emit(RegisterOpcode::Jump, first);
+    return;
+  case Opcode::JumpIfFalse: {
+    int condition = pop();
+    if (stack_.empty() && producedLast(condition) &&
+        result_.code.back().opcode >= RegisterOpcode::LessInt &&
+        result_.code.back().opcode <= RegisterOpcode::NotEqualInt) {
+      // compare and branch in one instruction
+      Instruction &compare = result_.code.back();
+      compare.opcode = (RegisterOpcode)(
+          (int)RegisterOpcode::JumpUnlessLessInt + (int)compare.opcode -
+          (int)RegisterOpcode::LessInt);
+      compare.a = first;
+      produced_ = -1;
+      return;
+    }
+    materializeAll();
+    emit(RegisterOpcode::JumpIfFalse, first, condition);
+    return;
+  }
+  case Opcode::DivInt:
+  case Opcode::ModInt: {
+    int right = pop();
+    int left = pop();
+    if (first != 0)
+      produce(opcode == Opcode::DivInt ? RegisterOpcode::DivInt
+                                       : RegisterOpcode::ModInt,
+              left, right);
+    else
+      produce(opcode == Opcode::DivInt ? RegisterOpcode::DivIntUnchecked
+                                       : RegisterOpcode::ModIntUnchecked,
+              left, right);
+    return;
+  }
+  case Opcode::Call: {
+    const Routine &callee = program_.routines[first];
+    size_t base = stack_.size() - callee.parameters;
+    for (size_t position = base; position < stack_.size(); position++)
+      materialize(position);
+    stack_.resize(base);
+    emit(RegisterOpcode::Call, temporary(base), first, second);
+    if (callee.returns)
+      push(temporary(base));
+    return;
+  }
+  case Opcode::Return:
+    emit(RegisterOpcode::Return, pop());
+    return;
+  case Opcode::ReturnVoid:
+    emit(RegisterOpcode::ReturnVoid, 0);
+    return;
+  case Opcode::MissingReturn:
+    emit(RegisterOpcode::MissingReturn, 0);
+    return;
+  default: {
+    int right = pop();
+    int left = pop();
+    produce(registerOpcode(opcode, Opcode::AddInt, RegisterOpcode::AddInt),
+            left, right);
+    return;
+  }
+  }
+}
+
+int Translator::pop() {
+  int reg = stack_.back();
+  stack_.pop_back();
+  return reg;
+}
+
+void Translator::materialize(size_t position) {
+  if (stack_[position] == temporary(position))
+    return;
+  emit(RegisterOpcode::Move, temporary(position), stack_[position]);
+  stack_[position] = temporary(position);
+}
+
+void Translator::materializeAll() {
+  for (size_t position = 0; position < stack_.size(); position++)
+    materialize(position);
+}
+
+// a slot about to change must not stay referenced by the stack
+void Translator::materializeSlot(int slot) {
+  for (size_t position = 0; position < stack_.size(); position++) {
+    if (stack_[position] == slot)
+      materialize(position);
+  }
+}
+
+void Translator::emit(RegisterOpcode opcode, int a, int b, int c, int d) {
+  Instruction instruction;
+  instruction.opcode = opcode;
+  instruction.a = a;
+  instruction.b = b;
+  instruction.c = c;
+  instruction.d = d;
+  int origin = result_.origins.empty() ? -1 : result_.origins.back().second;
+  if (origin_ != origin)
+    result_.origins.push_back({(uint32_t)result_.code.size(), origin_});
+  result_.code.push_back(instruction);
+  produced_ = -1;
+}
+
+void Translator::produce(RegisterOpcode opcode, int b, int c, int d) {
+  int target = temporary(stack_.size());
+  emit(opcode, target, b, c, d);
+  produced_ = (int)result_.code.size() - 1;
+  push(target);
+}
+
+bool Translator::producedLast(int reg) const {
+  return produced_ != -1 && produced_ == (int)result_.code.size() - 1 &&
+         result_.code[produced_].a == reg &&
+         reg == temporary(stack_.size());
+}
+
+} // namespace
+
+const char *registerOpcodeName(RegisterOpcode opcode) {
+  return kRegisterOpcodeNames[(int)opcode];
+}
+
+int RegisterProgram::find(const std::string &name) const {
+  auto routine = routine_index.find(name);
+  return routine == routine_index.end() ? -1 : routine->second;
+}
+
+void RegisterProgram::disassemble(std::ostream &out) const {
+  disassemble(initializer, out);
+  for (const RegisterRoutine &routine : routines)
+    disassemble(routine, out);
+}
+
+void RegisterProgram::disassemble(const RegisterRoutine &routine,
+                                  std::ostream &out) const {
+  out << "routine " << routine.name << " (" << routine.parameters
+      << " parameters, " << routine.frame_size << " registers, constants from "
+      << routine.constant_base << ")\n";
+  for (size_t i = 0; i < routine.code.size(); i++) {
+    const Instruction &instruction = routine.code[i];
+    out << "  " << i << ": " << registerOpcodeName(instruction.opcode) << " "
+        << instruction.a << " " << instruction.b << " " << instruction.c
+        << " " << instruction.d;
+    if (instruction.opcode == RegisterOpcode::Call)
+      out << " (" << routines[instruction.b].name << ")";
+    out << "\n";
+  }
+}
+
+RegisterProgram toRegisters(const Program &program) {
+  RegisterProgram result;
+  result.shapes = program.shapes;
+  result.global_frame_size = program.global_frame_size;
+  result.routine_index = program.routine_index;
+  Translator translator(program);
+  result.initializer = translator.translate(program.initializer);
+  for (const Routine &routine : program.routines)
+    result.routines.push_back(translator.translate(routine));
+  return result;
+}
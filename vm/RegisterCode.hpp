@@ -0,0 +1,130 @@
+#ifndef CC_PROJECT_REGISTERCODE_HPP
+#define CC_PROJECT_REGISTERCODE_HPP
+
+#include "vm/Bytecode.hpp"
+
+// Three address form of the bytecode. Registers are frame slots: first the
+// slots of the analyzer layout, then one register per distinct constant of
+// the routine, then one per operand stack position of the stack code.
+// Calls take their arguments from consecutive registers starting at a;
+// the callee frame starts there and its result replaces the first one.
+// An aggregate result is first copied to the buffer of slot c.
+
+// X(opcode, printed name) for every opcode; the comments give operands
+#define CC_PROJECT_REGISTER_OPCODES(X)                                        \
+  X(Move, "move")                     /* a := b */                            \
+  X(LoadGlobal, "load_global")        /* a := global b */                     \
+  X(StoreGlobal, "store_global")      /* global a := b */                     \
+  X(Allocate, "allocate")             /* slot a, shape b, length c or -1 */   \
+  X(AllocateGlobal, "allocate_global") /* global a, shape b, length c */      \
+  X(Field, "field")                   /* a := b + offset c */                 \
+  X(Index, "index")                   /* a := &b[c], b of shape d */          \
+  X(IndexUnchecked, "index_unchecked") /* proven in bounds */                 \
+  X(Length, "length")                 /* a := length of b, shape c */         \
+  X(LoadInt, "load_int")              /* a := *b */                           \
+  X(LoadReal, "load_real")                                                    \
+  X(LoadBool, "load_bool")                                                    \
+  X(StoreInt, "store_int")            /* *a := b */                           \
+  X(StoreReal, "store_real")                                                  \
+  X(StoreBool, "store_bool")                                                  \
+  X(Copy, "copy")                     /* aggregate *a := *b of shape c */     \
+  X(AddInt, "add_int")                /* a := b op c */                       \
+  X(SubInt, "sub_int")                                                        \
+  X(MulInt, "mul_int")                                                        \
+  X(DivInt, "div_int")                                                        \
+  X(ModInt, "mod_int")                                                        \
+  X(AddReal, "add_real")                                                      \
+  X(SubReal, "sub_real")                                                      \
+  X(MulReal, "mul_real")                                                      \
+  X(DivReal, "div_real")                                                      \
+  X(NegInt, "neg_int")                /* a := op b */                         \
+  X(NegReal, "neg_real")                                                      \
+  X(LessInt, "less_int")              /* a := b op c */                       \
+  X(LessEqInt, "less_eq_int")                                                 \
+  X(GreaterInt, "greater_int")                                                \
+  X(GreaterEqInt, "greater_eq_int")                                           \
+  X(EqualInt, "equal_int")                                                    \
+  X(NotEqualInt, "not_equal_int")                                             \
+  X(LessReal, "less_real")                                                    \
+  X(LessEqReal, "less_eq_real")                                               \
+  X(GreaterReal, "greater_real")                                              \
+  X(GreaterEqReal, "greater_eq_real")                                         \
+  X(EqualReal, "equal_real")                                                  \
+  X(NotEqualReal, "not_equal_real")                                           \
+  X(And, "and")                                                               \
+  X(Or, "or")                                                                 \
+  X(Xor, "xor")                                                               \
+  X(Not, "not")                       /* a := op b */                         \
+  X(IntToReal, "int_to_real")                                                 \
+  X(RealToInt, "real_to_int")                                                 \
+  X(IntToBool, "int_to_bool")                                                 \
+  X(DivIntUnchecked, "div_int_unchecked") /* divisor not 0 or -1 */           \
+  X(ModIntUnchecked, "mod_int_unchecked")                                     \
+  X(Jump, "jump")                     /* to a */                              \
+  X(JumpIfFalse, "jump_if_false")     /* to a unless b */                     \
+  X(JumpUnlessLessInt, "jump_unless_less_int") /* to a unless b op c */       \
+  X(JumpUnlessLessEqInt, "jump_unless_less_eq_int")                           \
+  X(JumpUnlessGreaterInt, "jump_unless_greater_int")                          \
+  X(JumpUnlessGreaterEqInt, "jump_unless_greater_eq_int")                     \
+  X(JumpUnlessEqualInt, "jump_unless_equal_int")                              \
+  X(JumpUnlessNotEqualInt, "jump_unless_not_equal_int")                       \
+  X(Call, "call")                     /* routine b, arguments at a */         \
+  X(Return, "return")                 /* a */                                 \
+  X(ReturnVoid, "return_void")                                                \
+  X(MissingReturn, "missing_return")
+
+enum class RegisterOpcode : uint8_t {
+#define CC_PROJECT_OPCODE(opcode, name) opcode,
+  CC_PROJECT_REGISTER_OPCODES(CC_PROJECT_OPCODE)
+#undef CC_PROJECT_OPCODE
+  OpcodeCount
+};
+
+const char *registerOpcodeName(RegisterOpcode opcode);
+
+struct Instruction {
+  RegisterOpcode opcode;
+  int32_t a = 0;
+  int32_t b = 0;
+  int32_t c = 0;
+  int32_t d = 0;
+};
+
+struct RegisterRoutine {
+  std::string name;
+  std::vector<Instruction> code;
+  int parameters = 0;
+  // all registers: slots, constants and operand positions
+  int frame_size = 0;
+  // values of the constant registers, copied in when a frame starts
+  int constant_base = 0;
+  std::vector<Value> constants;
+  std::vector<int> parameter_shapes;
+  bool returns = false;
+  ConstantValue::Kind result_kind = ConstantValue::None;
+  int result_shape = -1;
+  bool aggregates = false;
+  // by instruction index
+  Origins origins;
+};
+
+struct RegisterProgram {
+  std::vector<Shape> shapes;
+  std::vector<RegisterRoutine> routines;
+  RegisterRoutine initializer;
+  int global_frame_size = 0;
+  std::unordered_map<std::string, int> routine_index;
+
+  // -1 when there is no such routine
+  int find(const std::string &name) const;
+
+  void disassemble(std::ostream &out) const;
+  void disassemble(const RegisterRoutine &routine, std::ostream &out) const;
+};
+
+// Translate stack code by tracking which register holds each operand
+// stack position: variable reads and constants are used in place, and a
+// value stored right after it was computed is computed into its slot
+RegisterProgram toRegisters(const Program &program);
+
+#endif // CC_PROJECT_REGISTERCODE_HPP
@@ -0,0 +1,438 @@
+#include "vm/RegisterVM.hpp"
+#include <cmath>
+
+namespace {
+
+constexpr size_t kRegisterCount = 1 << 20;
+
+int64_t wrapNegate(int64_t value) { return (int64_t)(0 - (uint64_t)value); }
+
+} // namespace
+
+RegisterVM::RegisterVM(const RegisterProgram &program, std::ostream &err)
+    : program_(program), err_(&err), registers_(kRegisterCount) {}
+
+uint64_t RegisterVM::executed() const { return executed_; }
+
+bool RegisterVM::run(const std::string &routine, Value &result) {
+  executed_ = 0;
+  int entry = program_.find(routine);
+  if (entry == -1 || program_.routines[entry].parameters != 0) {
+    *err_ << "Routine " << routine
+          << " is not compiled or takes parameters" << std::endl;
+    return false;
+  }
+  globals_.assign(program_.global_frame_size, Value());
+  global_buffers_.assign(program_.global_frame_size, {});
+  Value ignored;
+  return execute((int)program_.routines.size(), ignored) &&
+         execute(entry, result);
+}
+
+void RegisterVM::thread(const void *const *handlers) {
+  code_.clear();
+  for (size_t i = 0; i <= program_.routines.size(); i++) {
+    const RegisterRoutine &routine = i < program_.routines.size()
+                                         ? program_.routines[i]
+                                         : program_.initializer;
+    std::vector<Step> steps;
+    for (const Instruction &instruction : routine.code)
+      steps.push_back(
+          {handlers ? handlers[(int)instruction.opcode] : nullptr,
+           instruction});
+    code_.push_back(std::move(steps));
+  }
+}
+
+void RegisterVM::enter(Frame &frame, int routine, Value *registers) {
+  frame.routine = routine < (int)program_.routines.size()
+                      ? &program_.routines[routine]
+                      : &program_.initializer;
+  frame.code = code_[routine].data();
+  frame.registers = registers;
+  const RegisterRoutine &callee = *frame.routine;
+  std::copy(callee.constants.begin(), callee.constants.end(),
+            registers + callee.constant_base);
+  if (callee.aggregates)
+    frame.buffers.resize(callee.frame_size);
+}
+
+size_t RegisterVM::bytes(const Shape &shape, const uint8_t *value) const {
+  if (shape.length >= 0)
+    return shape.size;
+  int64_t length;
+  std::memcpy(&length, value, sizeof(length));
+  return sizeof(length) + (size_t)length * shape.item_size;
+}
+
+bool RegisterVM::allocate(const Shape &shape, int64_t length,
+                          std::vector<uint8_t> &buffer, Value &slot) {
+  if (shape.length >= 0) {
+    buffer.assign(shape.image.begin(), shape.image.end());
+  } else {
+    if (length < 0 ||
+        (shape.item_size != 0 && (uint64_t)length > (1ull << 40) /
+                                                         shape.item_size))
+      return false;
+    buffer.resize(sizeof(length) + (size_t)length * shape.item_size);
+    std::memcpy(buffer.data(), &length, sizeof(length));
+    for (int64_t i = 0; i < length; i++)
+      std::memcpy(buffer.data() + sizeof(length) + i * shape.item_size,
+                  shape.image.data(), shape.item_size);
+  }
+  slot.address = buffer.data();
+  return true;
+}
+
+bool RegisterVM::fail(const Frame &frame, int origin,
+                      const std::string &message) {
+  const std::string &name =
+      origin == -1 ? frame.routine->name : program_.routines[origin].name;
+  *err_ << "Runtime error in " << name << ": " << message << std::endl;
+  return false;
+}
+
+bool RegisterVM::execute(int entry, Value &result) {
+#ifdef CC_PROJECT_COMPUTED_GOTO
+  static const void *const handlers[] = {
+#define CC_PROJECT_OPCODE(opcode, name) &&handle_##opcode,
+      CC_PROJECT_REGISTER_OPCODES(CC_PROJECT_OPCODE)
+#undef CC_PROJECT_OPCODE
+  };
+#else
+  static const void *const *handlers = nullptr;
+#endif
+  if (code_.size() != program_.routines.size() + 1)
+    thread(handlers);
+
+  size_t depth = 0;
+  if (frames_.empty())
+    frames_.emplace_back();
+  Frame *frame = &frames_[0];
+  enter(*frame, entry, registers_.data());
+  const Value *limit = registers_.data() + registers_.size();
+  if (registers_.data() + frame->routine->frame_size > limit)
+    return fail(*frame, -1, "stack overflow");
+  Value *r = frame->registers;
+  const Step *code = frame->code;
+  const Step *pc = code;
+  uint64_t executed = 0;
+
+#define A pc->instruction.a
+#define B pc->instruction.b
+#define C pc->instruction.c
+#define D pc->instruction.d
+#define FAIL(message)                                                         \
+  return (executed_ += executed,                                              \
+          fail(*frame, originAt(frame->routine->origins, pc - code),          \
+               message))
+#ifdef CC_PROJECT_COMPUTED_GOTO
+#define CASE(opcode) handle_##opcode:
+#define DISPATCH()                                                            \
+  do {                                                                        \
+    executed++;                                                               \
+    goto *pc->handler;                                                        \
+  } while (0)
+#else
+#define CASE(opcode) case RegisterOpcode::opcode:
+#define DISPATCH() goto dispatch
+#endif
+#define NEXT()                                                                \
+  do {                                                                        \
+    pc++;                                                                     \
+    DISPATCH();                                                               \
+  } while (0)
+#define BINARY_INT(opcode, expression)                                        \
+  CASE(opcode) {                                                              \
+    uint64_t l = (uint64_t)r[B].integer, rr = (uint64_t)r[C].integer;        \
+    r[A].integer = (int64_t)(expression);                                     \
+    NEXT();                                                                   \
+  }
+#define BINARY_REAL(opcode, operator)                                         \
+  CASE(opcode) {                                                              \
+    r[A].real = r[B].real operator r[C].real;                                 \
+    NEXT();                                                                   \
+  }
+#define COMPARE(opcode, field, operator)                                      \
+  CASE(opcode) {                                                              \
+    r[A].integer = r[B].field operator r[C].field;                            \
+    NEXT();                                                                   \
+  }
+#define JUMP_UNLESS(opcode, operator)                                         \
+  CASE(opcode) {                                                              \
+    if (r[B].integer operator r[C].integer)                                   \
+      NEXT();                                                                 \
+    pc = code + A;                                                            \
+    DISPATCH();                                                               \
+  }
+
+  DISPATCH();
+#ifndef CC_PROJECT_COMPUTED_GOTO
+dispatch:
+  executed++;
+  switch (pc->instruction.opcode) {
+#endif
+  CASE(Move) {
+    r[A] = r[B];
+    NEXT();
+  }
+  CASE(LoadGlobal) {
+    r[A] = globals_[B];
+    NEXT();
+  }
+  CASE(StoreGlobal) {
+    globals_[A] = r[B];
+    NEXT();
+  }
+  CASE(Allocate) {
+    const Shape &shape = program_.shapes[B];
+    int64_t length = C == -1 ? shape.length : r[C].integer;
+    if (!allocate(shape, length, frame->buffers[A], r[A]))
+      FAIL("cannot allocate array of length " + std::to_string(length));
+    NEXT();
+  }
+  CASE(AllocateGlobal) {
+    const Shape &shape = program_.shapes[B];
+    int64_t length = C == -1 ? shape.length : r[C].integer;
+    if (!allocate(shape, length, global_buffers_[A], globals_[A]))
+      FAIL("cannot allocate array of length " + std::to_string(length));
+    NEXT();
+  }
+  CASE(Field) {
+    r[A].address = r[B].address + C;
+    NEXT();
+  }
+  CASE(Index) {
+    const Shape &shape = program_.shapes[D];
+    int64_t index = r[C].integer;
+    uint8_t *items = r[B].address;
+    int64_t length = shape.length;
+    if (length < 0) {
+      std::memcpy(&length, items, sizeof(length));
+      items += sizeof(length);
+    }
+    if (index < 1 || index > length)
+      FAIL("index " + std::to_string(index) + " is out of 1.." +
+           std::to_string(length));
+    r[A].address = items + (index - 1) * shape.item_size;
+    NEXT();
+  }
+  CASE(IndexUnchecked) {
+    const Shape &shape = program_.shapes[D];
+    uint8_t *items = r[B].address;
+    if (shape.length < 0)
+      items += sizeof(int64_t);
+    r[A].address = items + (r[C].integer - 1) * shape.item_size;
+    NEXT();
+  }
+  CASE(Length) {
+    const Shape &shape = program_.shapes[C];
+    int64_t length = shape.length;
+    if (length < 0)
+      std::memcpy(&length, r[B].address, sizeof(length));
+    r[A].integer = length;
+    NEXT();
+  }
+  CASE(LoadInt) {
+    std::memcpy(&r[A].integer, r[B].address, sizeof(int64_t));
+    NEXT();
+  }
+  CASE(LoadReal) {
+    std::memcpy(&r[A].real, r[B].address, sizeof(double));
+    NEXT();
+  }
+  CASE(LoadBool) {
+    r[A].integer = *r[B].address;
+    NEXT();
+  }
+  CASE(StoreInt) {
+    std::memcpy(r[A].address, &r[B].integer, sizeof(int64_t));
+    NEXT();
+  }
+  CASE(StoreReal) {
+    std::memcpy(r[A].address, &r[B].real, sizeof(double));
+    NEXT();
+  }
+  CASE(StoreBool) {
+    *r[A].address = (uint8_t)r[B].integer;
+    NEXT();
+  }
+  CASE(Copy) {
+    const Shape &shape = program_.shapes[C];
+    size_t size = bytes(shape, r[B].address);
+    if (size != bytes(shape, r[A].address))
+      FAIL("assigned arrays differ in length");
+    std::memmove(r[A].address, r[B].address, size);
+    NEXT();
+  }
+  BINARY_INT(AddInt, l + rr)
+  BINARY_INT(SubInt, l - rr)
+  BINARY_INT(MulInt, l * rr)
+  CASE(DivInt) {
+    int64_t divisor = r[C].integer;
+    if (divisor == 0)
+      FAIL("division by zero");
+    r[A].integer = divisor == -1 ? wrapNegate(r[B].integer)
+                                 : r[B].integer / divisor;
+    NEXT();
+  }
+  CASE(ModInt) {
+    int64_t divisor = r[C].integer;
+    if (divisor == 0)
+      FAIL("division by zero");
+    r[A].integer = divisor == -1 ? 0 : r[B].integer % divisor;
+    NEXT();
+  }
+  CASE(DivIntUnchecked) {
+    r[A].integer = r[B].integer / r[C].integer;
+    NEXT();
+  }
+  CASE(ModIntUnchecked) {
+    r[A].integer = r[B].integer % r[C].integer;
+    NEXT();
+  }
+  BINARY_REAL(AddReal, +)
+  BINARY_REAL(SubReal, -)
+  BINARY_REAL(MulReal, *)
+  CASE(DivReal) {
+    if (r[C].real == 0)
+      FAIL("division by zero");
+    r[A].real = r[B].real / r[C].real;
+    NEXT();
+  }
+  CASE(NegInt) {
+    r[A].integer = wrapNegate(r[B].integer);
+    NEXT();
+  }
+  CASE(NegReal) {
+    r[A].real = -r[B].real;
+    NEXT();
+  }
+  COMPARE(LessInt, integer, <)
+  COMPARE(LessEqInt, integer, <=)
+  COMPARE(GreaterInt, integer, >)
+  COMPARE(GreaterEqInt, integer, >=)
+  COMPARE(EqualInt, integer, ==)
+  COMPARE(NotEqualInt, integer, !=)
+  COMPARE(LessReal, real, <)
+  COMPARE(LessEqReal, real, <=)
+  COMPARE(GreaterReal, real, >)
+  COMPARE(GreaterEqReal, real, >=)
+  COMPARE(EqualReal, real, ==)
+  COMPARE(NotEqualReal, real, !=)
+  BINARY_INT(And, l & rr)
+  BINARY_INT(Or, l | rr)
+  BINARY_INT(Xor, l ^ rr)
+  CASE(Not) {
+    r[A].integer = r[B].integer ^ 1;
+    NEXT();
+  }
+  CASE(IntToReal) {
+    r[A].real = (double)r[B].integer;
+    NEXT();
+  }
+  CASE(RealToInt) {
+    double real = r[B].real;
+    if (!(std::fabs(real) < 9.2e18))
+      FAIL("real does not fit integer");
+    r[A].integer = std::llround(real);
+    NEXT();
+  }
+  CASE(IntToBool) {
+    int64_t value = r[B].integer;
+    if (value != 0 && value != 1)
+      FAIL("cannot convert " + std::to_string(value) + " to boolean");
+    r[A].integer = value;
+    NEXT();
+  }
+  CASE(Jump) {
+    pc = code + A;
+    DISPATCH();
+  }
+  CASE(JumpIfFalse) {
+    if (r[B].integer != 0)
+      NEXT();
+    pc = code + A;
+    DISPATCH();
+  }
+  JUMP_UNLESS(JumpUnlessLessInt, <)
+  JUMP_UNLESS(JumpUnlessLessEqInt, <=)
+  JUMP_UNLESS(JumpUnlessGreaterInt, >)
+  JUMP_UNLESS(JumpUnlessGreaterEqInt, >=)
+  JUMP_UNLESS(JumpUnlessEqualInt, ==)
+  JUMP_UNLESS(JumpUnlessNotEqualInt, !=)
+  CASE(Call) {
+    int routine = B;
+    const RegisterRoutine &callee = program_.routines[routine];
+    Value *base = r + A;
+    if (base + callee.frame_size > limit)
+      FAIL("stack overflow");
+    frame->return_pc = pc + 1;
+    int result_slot = C;
+    if (++depth == frames_.size())
+      frames_.emplace_back();
+    frame = &frames_[depth];
+    enter(*frame, routine, base);
+    frame->result_slot = result_slot;
+    for (int i = 0; i < callee.parameters && callee.aggregates; i++) {
+      if (callee.parameter_shapes[i] == -1)
+        continue;
+      const Shape &shape = program_.shapes[callee.parameter_shapes[i]];
+      const uint8_t *argument = base[i].address;
+      frame->buffers[i].assign(argument, argument + bytes(shape, argument));
+      base[i].address = frame->buffers[i].data();
+    }
+    r = base;
+    code = frame->code;
+    pc = code;
+    DISPATCH();
+  }
+  CASE(Return)
+  CASE(ReturnVoid) {
+    Value value{};
+    if (pc->instruction.opcode == RegisterOpcode::Return)
+      value = r[A];
+    if (depth == 0) {
+      result = value;
+      executed_ += executed;
+      return true;
+    }
+    Frame &caller = frames_[depth - 1];
+    if (frame->result_slot != -1) {
+      const Shape &shape = program_.shapes[frame->routine->result_shape];
+      std::vector<uint8_t> &buffer = caller.buffers[frame->result_slot];
+      buffer.assign(value.address,
+                    value.address + bytes(shape, value.address));
+      value.address = buffer.data();
+    }
+    r[0] = value;
+    depth--;
+    frame = &caller;
+    r = frame->registers;
+    code = frame->code;
+    pc = frame->return_pc;
+    DISPATCH();
+  }
+  CASE(MissingReturn) {
+    FAIL("routine ends without returning a value");
+  }
+#ifndef CC_PROJECT_COMPUTED_GOTO
+  default:
+    FAIL("invalid opcode");
+  }
+#endif
+  return false;
+
+#undef A
+#undef B
+#undef C
+#undef D
+#undef FAIL
+#undef CASE
+#undef DISPATCH
+#undef NEXT
+#undef BINARY_INT
+#undef BINARY_REAL
+#undef COMPARE
+#undef JUMP_UNLESS
+}
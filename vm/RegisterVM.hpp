@@ -0,0 +1,63 @@
+#ifndef CC_PROJECT_REGISTERVM_HPP
+#define CC_PROJECT_REGISTERVM_HPP
+
+#include "vm/RegisterCode.hpp"
+#include <ostream>
+
+// Direct threaded dispatch needs the labels as values extension of GCC
+// and Clang; other compilers, or a build defining
+// CC_PROJECT_SWITCH_DISPATCH, dispatch through a switch
+#if defined(__GNUC__) && !defined(CC_PROJECT_SWITCH_DISPATCH)
+#define CC_PROJECT_COMPUTED_GOTO 1
+#endif
+
+// Interpreter of register code. Frames are windows of one register stack;
+// aggregates are handled as in StackVM.
+class RegisterVM {
+public:
+  RegisterVM(const RegisterProgram &program, std::ostream &err);
+  ~RegisterVM() = default;
+
+  // Declare the globals, then run the routine, which must have no
+  // parameters. result is its return value when it returns a scalar
+  bool run(const std::string &routine, Value &result);
+
+  // instructions executed by the last run
+  uint64_t executed() const;
+
+private:
+  // instruction with the address of its handler when threaded
+  struct Step {
+    const void *handler;
+    Instruction instruction;
+  };
+  struct Frame {
+    const RegisterRoutine *routine = nullptr;
+    const Step *code = nullptr;
+    Value *registers = nullptr;
+    const Step *return_pc = nullptr;
+    int result_slot = -1;
+    std::vector<std::vector<uint8_t>> buffers;
+  };
+
+  bool execute(int entry, Value &result);
+  void thread(const void *const *handlers);
+  void enter(Frame &frame, int routine, Value *registers);
+  bool allocate(const Shape &shape, int64_t length,
+                std::vector<uint8_t> &buffer, Value &slot);
+  size_t bytes(const Shape &shape, const uint8_t *value) const;
+  // origin is the routine inlined code came from, -1 for the frame's own
+  bool fail(const Frame &frame, int origin, const std::string &message);
+
+  const RegisterProgram &program_;
+  std::ostream *err_;
+  // code of the routines, then of the initializer
+  std::vector<std::vector<Step>> code_;
+  std::vector<Value> registers_;
+  std::vector<Value> globals_;
+  std::vector<std::vector<uint8_t>> global_buffers_;
+  std::vector<Frame> frames_;
+  uint64_t executed_ = 0;
+};
+
+#endif // CC_PROJECT_REGISTERVM_HPP
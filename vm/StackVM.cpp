@@ -0,0 +1,393 @@
+#include "vm/StackVM.hpp"
+#include <cmath>
+
+namespace {
+
+constexpr size_t kStackSize = 1 << 20;
+
+int64_t wrapNegate(int64_t value) { return (int64_t)(0 - (uint64_t)value); }
+
+} // namespace
+
+StackVM::StackVM(const Program &program, std::ostream &err)
+    : program_(program), err_(&err), stack_(kStackSize) {
+  for (const ConstantValue &constant : program.constants) {
+    Value value;
+    if (constant.kind == ConstantValue::Real)
+      value.real = constant.real;
+    else
+      value.integer = constant.kind == ConstantValue::Boolean
+                          ? constant.boolean
+                          : constant.integer;
+    constants_.push_back(value);
+  }
+}
+
+uint64_t StackVM::executed() const { return executed_; }
+
+bool StackVM::run(const std::string &routine, Value &result) {
+  executed_ = 0;
+  int entry = program_.find(routine);
+  if (entry == -1 || program_.routines[entry].parameters != 0) {
+    *err_ << "Routine " << routine
+          << " is not compiled or takes parameters" << std::endl;
+    return false;
+  }
+  globals_.assign(program_.global_frame_size, Value());
+  global_buffers_.assign(program_.global_frame_size, {});
+  Value ignored;
+  return execute(program_.initializer, ignored) &&
+         execute(program_.routines[entry], result);
+}
+
+size_t StackVM::bytes(const Shape &shape, const uint8_t *value) const {
+  if (shape.length >= 0)
+    return shape.size;
+  int64_t length;
+  std::memcpy(&length, value, sizeof(length));
+  return sizeof(length) + (size_t)length * shape.item_size;
+}
+
+bool StackVM::allocate(const Shape &shape, int64_t length,
+                       std::vector<uint8_t> &buffer, Value &slot) {
+  if (shape.length >= 0) {
+    buffer.assign(shape.image.begin(), shape.image.end());
+  } else {
+    if (length < 0 ||
+        (shape.item_size != 0 && (uint64_t)length > (1ull << 40) /
+                                                         shape.item_size))
+      return false;
+    buffer.resize(sizeof(length) + (size_t)length * shape.item_size);
+    std::memcpy(buffer.data(), &length, sizeof(length));
+    for (int64_t i = 0; i < length; i++)
+      std::memcpy(buffer.data() + sizeof(length) + i * shape.item_size,
+                  shape.image.data(), shape.item_size);
+  }
+  slot.address = buffer.data();
+  return true;
+}
+
+bool StackVM::fail(const Frame &frame, int origin,
+                   const std::string &message) {
+  const std::string &name =
+      origin == -1 ? frame.routine->name : program_.routines[origin].name;
+  *err_ << "Runtime error in " << name << ": " << message << std::endl;
+  return false;
+}
+
+bool StackVM::execute(const Routine &entry, Value &result) {
+  size_t depth = 0;
+  if (frames_.empty())
+    frames_.emplace_back();
+  Frame *frame = &frames_[0];
+  frame->routine = &entry;
+  frame->slots = stack_.data();
+  if (entry.aggregates)
+    frame->buffers.resize(entry.frame_size);
+  Value *slots = frame->slots;
+  Value *sp = slots + entry.frame_size;
+  const Value *limit = stack_.data() + stack_.size();
+  if (sp + entry.max_stack > limit)
+    return fail(*frame, -1, "stack overflow");
+  const uint8_t *code = entry.code.data();
+  const uint8_t *pc = code;
+  uint64_t executed = 0;
+
+#define OPERAND(n) readOperand(pc + 4 * (n))
+#define FAIL(message)                                                         \
+  return (executed_ += executed,                                              \
+          fail(*frame, originAt(frame->routine->origins, pc - 1 - code),      \
+               message))
+#define BINARY_INT(expression)                                                \
+  {                                                                           \
+    uint64_t r = (uint64_t)sp[-1].integer, l = (uint64_t)sp[-2].integer;     \
+    sp[-2].integer = (int64_t)(expression);                                   \
+    sp--;                                                                     \
+    break;                                                                    \
+  }
+#define BINARY_REAL(expression)                                               \
+  {                                                                           \
+    double r = sp[-1].real, l = sp[-2].real;                                  \
+    sp[-2].real = expression;                                                 \
+    sp--;                                                                     \
+    break;                                                                    \
+  }
+#define COMPARE(field, operator)                                              \
+  {                                                                           \
+    sp[-2].integer = sp[-2].field operator sp[-1].field;                      \
+    sp--;                                                                     \
+    break;                                                                    \
+  }
+
+  while (true) {
+    executed++;
+    Opcode opcode = (Opcode)*pc++;
+    switch (opcode) {
+    case Opcode::PushInt:
+      sp++->integer = OPERAND(0);
+      pc += 4;
+      break;
+    case Opcode::PushConst:
+      *sp++ = constants_[OPERAND(0)];
+      pc += 4;
+      break;
+    case Opcode::Pop:
+      sp--;
+      break;
+    case Opcode::LoadLocal:
+      *sp++ = slots[OPERAND(0)];
+      pc += 4;
+      break;
+    case Opcode::StoreLocal:
+      slots[OPERAND(0)] = *--sp;
+      pc += 4;
+      break;
+    case Opcode::LoadGlobal:
+      *sp++ = globals_[OPERAND(0)];
+      pc += 4;
+      break;
+    case Opcode::StoreGlobal:
+      globals_[OPERAND(0)] = *--sp;
+      pc += 4;
+      break;
+    case Opcode::Allocate:
+    case Opcode::AllocateGlobal: {
+      int slot = OPERAND(0);
+      const Shape &shape = program_.shapes[OPERAND(1)];
+      pc += 8;
+      int64_t length = shape.length < 0 ? (--sp)->integer : shape.length;
+      bool global = opcode == Opcode::AllocateGlobal;
+      if (!allocate(shape, length,
+                    global ? global_buffers_[slot] : frame->buffers[slot],
+                    global ? globals_[slot] : slots[slot]))
+        FAIL("cannot allocate array of length " +
+             std::to_string(length));
+      break;
+    }
+    case Opcode::Field:
+      sp[-1].address += OPERAND(0);
+      pc += 4;
+      break;
+    case Opcode::Index: {
+      const Shape &shape = program_.shapes[OPERAND(0)];
+      bool checked = OPERAND(1) != 0;
+      pc += 8;
+      int64_t index = (--sp)->integer;
+      uint8_t *items = sp[-1].address;
+      int64_t length = shape.length;
+      if (length < 0) {
+        std::memcpy(&length, items, sizeof(length));
+        items += sizeof(length);
+      }
+      if (checked && (index < 1 || index > length))
+        FAIL("index " + std::to_string(index) +
+             " is out of 1.." + std::to_string(length));
+      sp[-1].address = items + (index - 1) * shape.item_size;
+      break;
+    }
+    case Opcode::Length: {
+      const Shape &shape = program_.shapes[OPERAND(0)];
+      pc += 4;
+      int64_t length = shape.length;
+      if (length < 0)
+        std::memcpy(&length, sp[-1].address, sizeof(length));
+      sp[-1].integer = length;
+      break;
+    }
+    case Opcode::LoadInt:
+      std::memcpy(&sp[-1].integer, sp[-1].address, sizeof(int64_t));
+      break;
+    case Opcode::LoadReal:
+      std::memcpy(&sp[-1].real, sp[-1].address, sizeof(double));
+      break;
+    case Opcode::LoadBool:
+      sp[-1].integer = *sp[-1].address;
+      break;
+    case Opcode::StoreInt:
+      std::memcpy(sp[-1].address, &sp[-2].integer, sizeof(int64_t));
+      sp -= 2;
+      break;
+    case Opcode::StoreReal:
+      std::memcpy(sp[-1].address, &sp[-2].real, sizeof(double));
+      sp -= 2;
+      break;
+    case Opcode::StoreBool:
+      *sp[-1].address = (uint8_t)sp[-2].integer;
+      sp -= 2;
+      break;
+    case Opcode::Copy: {
+      const Shape &shape = program_.shapes[OPERAND(0)];
+      pc += 4;
+      uint8_t *target = sp[-1].address;
+      const uint8_t *source = sp[-2].address;
+      sp -= 2;
+      size_t size = bytes(shape, source);
+      if (size != bytes(shape, target))
+        FAIL("assigned arrays differ in length");
+      std::memmove(target, source, size);
+      break;
+    }
+    case Opcode::AddInt:
+      BINARY_INT(l + r)
+    case Opcode::SubInt:
+      BINARY_INT(l - r)
+    case Opcode::MulInt:
+      BINARY_INT(l * r)
+    case Opcode::DivInt:
+    case Opcode::ModInt: {
+      // unchecked divisors are proven to be neither 0 nor -1
+      bool checked = OPERAND(0) != 0;
+      pc += 4;
+      int64_t r = sp[-1].integer, l = sp[-2].integer;
+      if (checked && r == 0)
+        FAIL("division by zero");
+      if (checked && r == -1)
+        sp[-2].integer = opcode == Opcode::DivInt ? wrapNegate(l) : 0;
+      else
+        sp[-2].integer = opcode == Opcode::DivInt ? l / r : l % r;
+      sp--;
+      break;
+    }
+    case Opcode::AddReal:
+      BINARY_REAL(l + r)
+    case Opcode::SubReal:
+      BINARY_REAL(l - r)
+    case Opcode::MulReal:
+      BINARY_REAL(l * r)
+    case Opcode::DivReal:
+      if (sp[-1].real == 0)
+        FAIL("division by zero");
+      BINARY_REAL(l / r)
+    case Opcode::NegInt:
+      sp[-1].integer = wrapNegate(sp[-1].integer);
+      break;
+    case Opcode::NegReal:
+      sp[-1].real = -sp[-1].real;
+      break;
+    case Opcode::LessInt:
+      COMPARE(integer, <)
+    case Opcode::LessEqInt:
+      COMPARE(integer, <=)
+    case Opcode::GreaterInt:
+      COMPARE(integer, >)
+    case Opcode::GreaterEqInt:
+      COMPARE(integer, >=)
+    case Opcode::EqualInt:
+      COMPARE(integer, ==)
+    case Opcode::NotEqualInt:
+      COMPARE(integer, !=)
+    case Opcode::LessReal:
+      COMPARE(real, <)
+    case Opcode::LessEqReal:
+      COMPARE(real, <=)
+    case Opcode::GreaterReal:
+      COMPARE(real, >)
+    case Opcode::GreaterEqReal:
+      COMPARE(real, >=)
+    case Opcode::EqualReal:
+      COMPARE(real, ==)
+    case Opcode::NotEqualReal:
+      COMPARE(real, !=)
+    case Opcode::And:
+      BINARY_INT(l & r)
+    case Opcode::Or:
+      BINARY_INT(l | r)
+    case Opcode::Xor:
+      BINARY_INT(l ^ r)
+    case Opcode::Not:
+      sp[-1].integer ^= 1;
+      break;
+    case Opcode::IntToReal:
+      sp[-1].real = (double)sp[-1].integer;
+      break;
+    case Opcode::RealToInt: {
+      double real = sp[-1].real;
+      if (!(std::fabs(real) < 9.2e18))
+        FAIL("real does not fit integer");
+      sp[-1].integer = std::llround(real);
+      break;
+    }
+    case Opcode::IntToBool:
+      if (sp[-1].integer != 0 && sp[-1].integer != 1)
+        FAIL("cannot convert " + std::to_string(sp[-1].integer) +
+             " to boolean");
+      break;
+    case Opcode::Jump:
+      pc = code + OPERAND(0);
+      break;
+    case Opcode::JumpIfFalse:
+      pc = (--sp)->integer == 0 ? code + OPERAND(0) : pc + 4;
+      break;
+    case Opcode::Call: {
+      const Routine &callee = program_.routines[OPERAND(0)];
+      int result_slot = OPERAND(1);
+      pc += 8;
+      Value *base = sp - callee.parameters;
+      if (base + callee.frame_size + callee.max_stack > limit)
+        FAIL("stack overflow");
+      frame->return_pc = pc;
+      if (++depth == frames_.size())
+        frames_.emplace_back();
+      frame = &frames_[depth];
+      frame->routine = &callee;
+      frame->slots = base;
+      frame->result_slot = result_slot;
+      if (callee.aggregates) {
+        frame->buffers.resize(callee.frame_size);
+        for (int i = 0; i < callee.parameters; i++) {
+          if (callee.parameter_shapes[i] == -1)
+            continue;
+          const Shape &shape = program_.shapes[callee.parameter_shapes[i]];
+          const uint8_t *argument = base[i].address;
+          frame->buffers[i].assign(argument,
+                                   argument + bytes(shape, argument));
+          base[i].address = frame->buffers[i].data();
+        }
+      }
+      slots = base;
+      sp = base + callee.frame_size;
+      code = callee.code.data();
+      pc = code;
+      break;
+    }
+    case Opcode::Return:
+    case Opcode::ReturnVoid: {
+      Value value;
+      if (opcode == Opcode::Return)
+        value = *--sp;
+      if (depth == 0) {
+        result = value;
+        executed_ += executed;
+        return true;
+      }
+      Frame &caller = frames_[depth - 1];
+      if (frame->result_slot != -1) {
+        const Shape &shape = program_.shapes[frame->routine->result_shape];
+        std::vector<uint8_t> &buffer = caller.buffers[frame->result_slot];
+        buffer.assign(value.address, value.address + bytes(shape,
+                                                           value.address));
+        value.address = buffer.data();
+      }
+      sp = frame->slots;
+      if (opcode == Opcode::Return)
+        *sp++ = value;
+      depth--;
+      frame = &caller;
+      slots = frame->slots;
+      code = frame->routine->code.data();
+      pc = frame->return_pc;
+      break;
+    }
+    case Opcode::MissingReturn:
+      FAIL("routine ends without returning a value");
+    default:
+      FAIL("invalid opcode");
+    }
+  }
+
+#undef OPERAND
+#undef FAIL
+#undef BINARY_INT
+#undef BINARY_REAL
+#undef COMPARE
+}
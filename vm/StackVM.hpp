@@ -0,0 +1,53 @@
+#ifndef CC_PROJECT_STACKVM_HPP
+#define CC_PROJECT_STACKVM_HPP
+
+#include "vm/Bytecode.hpp"
+#include <ostream>
+
+// Interpreter of compiled programs.
+// Frames and operand stacks share one value stack: the arguments pushed by
+// a call become the first slots of the callee frame. Aggregates live in
+// buffers of the frame whose slot holds them, and are copied when they are
+// assigned, passed or returned.
+class StackVM {
+public:
+  StackVM(const Program &program, std::ostream &err);
+  ~StackVM() = default;
+
+  // Declare the globals, then run the routine, which must have no
+  // parameters. result is its return value when it returns a scalar
+  bool run(const std::string &routine, Value &result);
+
+  // instructions executed by the last run
+  uint64_t executed() const;
+
+private:
+  struct Frame {
+    const Routine *routine = nullptr;
+    Value *slots = nullptr;
+    const uint8_t *return_pc = nullptr;
+    // slot of the caller receiving an aggregate result
+    int result_slot = -1;
+    std::vector<std::vector<uint8_t>> buffers;
+  };
+
+  bool execute(const Routine &entry, Value &result);
+  // fill buffer with a new value of shape and point slot to it
+  bool allocate(const Shape &shape, int64_t length,
+                std::vector<uint8_t> &buffer, Value &slot);
+  size_t bytes(const Shape &shape, const uint8_t *value) const;
+  // origin is the routine inlined code came from, -1 for the frame's own
+  bool fail(const Frame &frame, int origin, const std::string &message);
+
+  const Program &program_;
+  std::ostream *err_;
+  std::vector<Value> constants_;
+  std::vector<Value> stack_;
+  std::vector<Value> globals_;
+  std::vector<std::vector<uint8_t>> global_buffers_;
+  // reused between calls, so buffers keep their memory
+  std::vector<Frame> frames_;
+  uint64_t executed_ = 0;
+};
+
+#endif // CC_PROJECT_STACKVM_HPP